@@ -0,0 +1,124 @@
+/** \file arrow_ipc.h
+ *  \brief Dependency-free Apache Arrow IPC stream writer for result tables.
+ *
+ *  A stream is a Schema message, any number of RecordBatch messages and an
+ *  end-of-stream marker (Arrow columnar format, metadata version 5). The
+ *  flatbuffer metadata is encoded here; column buffers are handed to
+ *  writev() straight from the caller's arrays, so a structure-of-arrays
+ *  result is written without formatting or copying. Buffers are 8-byte
+ *  padded and validity bitmaps are LSB-first; a column without nulls gets
+ *  an empty validity buffer.
+ *
+ *  ArrowChangeBatch gathers change results (amount, system, strategy,
+ *  counts per denomination as list<int32> in system order, total coins and
+ *  nullable mass / diameter / area) into such arrays, one row per query.
+ */
+#ifndef ARROW_IPC_H
+#define ARROW_IPC_H
+
+#include "coins.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Column types the writer supports. */
+typedef enum {
+  ARROW_INT32,     /**< int32 values. */
+  ARROW_INT64,     /**< int64 values. */
+  ARROW_FLOAT64,   /**< double values. */
+  ARROW_UTF8,      /**< Strings: int32 offsets plus bytes. */
+  ARROW_LIST_INT32 /**< list<int32>: int32 offsets plus int32 items. */
+} ArrowType;
+
+/** \brief Schema entry. */
+typedef struct {
+  const char *name; /**< Column name (UTF-8). */
+  ArrowType type;   /**< Column type. */
+  int nullable;     /**< Whether the column may hold nulls. */
+} ArrowField;
+
+/** \brief Buffers of one column of a record batch (borrowed, not copied). */
+typedef struct {
+  const void *values;      /**< nrows fixed-width values, or the UTF-8 bytes
+                                / list items addressed by offsets. */
+  const int32_t *offsets;  /**< UTF8 and LIST_INT32: nrows + 1 offsets. */
+  const uint8_t *validity; /**< LSB-first bitmap (1 = valid), NULL if no
+                                nulls. */
+} ArrowColumn;
+
+/** \brief Stream writer bound to a file descriptor (opaque). */
+typedef struct ArrowWriter ArrowWriter;
+
+/** \brief Start a stream on fd (not closed by the writer) and write the
+ *  schema of nfields columns. Returns NULL on bad arguments, allocation or
+ *  write failure. */
+ArrowWriter *arrow_writer_open(int fd, const ArrowField *fields, int nfields);
+
+/** \brief Write one record batch of nrows rows, cols in schema order.
+ *  Returns 0, or -1 on bad arguments or a failed write (which also fails
+ *  every later call). */
+int arrow_writer_batch(ArrowWriter *w, int64_t nrows, const ArrowColumn *cols);
+
+/** \brief Write the end-of-stream marker and free w. Returns 0 if every
+ *  write of the stream succeeded. */
+int arrow_writer_close(ArrowWriter *w);
+
+/** \brief Bytes written to the stream so far. */
+uint64_t arrow_writer_bytes(const ArrowWriter *w);
+
+/** \brief Columns of ArrowChangeBatch. */
+#define ARROW_CHANGE_COLUMNS 8
+
+/** \brief Change results in column form (grown on append). */
+typedef struct {
+  size_t n;                 /**< Rows. */
+  size_t cap;               /**< Row capacity. */
+  int32_t *amount;          /**< Amount paid. */
+  int32_t *system_offsets;  /**< system: n + 1 offsets into system_bytes. */
+  char *system_bytes;
+  size_t system_cap;
+  int32_t *strategy_offsets; /**< strategy: n + 1 offsets into
+                                  strategy_bytes. */
+  char *strategy_bytes;
+  size_t strategy_cap;
+  int32_t *count_offsets; /**< counts: n + 1 offsets into count_items. */
+  int32_t *count_items;
+  size_t count_cap;
+  int32_t *total_coins; /**< Sum of the counts. */
+  double *mass_g;       /**< Totals; null when metadata is missing. */
+  double *diameter_mm;
+  double *area_mm2;
+  uint8_t *valid_mass; /**< Validity bitmaps of the three totals. */
+  uint8_t *valid_diameter;
+  uint8_t *valid_area;
+} ArrowChangeBatch;
+
+/** \brief Schema of ArrowChangeBatch (ARROW_CHANGE_COLUMNS entries). */
+const ArrowField *arrow_change_fields(void);
+
+/** \brief Zero b. */
+void arrow_change_init(ArrowChangeBatch *b);
+
+/** \brief Append the result counts (system order) of paying amount in sys.
+ *  Returns 0, or -1 on allocation failure. */
+int arrow_change_append(ArrowChangeBatch *b, const CoinSystem *sys,
+                        int amount, const int *counts, const char *strategy);
+
+/** \brief Point cols (ARROW_CHANGE_COLUMNS entries) at the arrays of b. */
+void arrow_change_columns(const ArrowChangeBatch *b, ArrowColumn *cols);
+
+/** \brief Write b as one record batch (nothing if empty) and empty it,
+ *  keeping its storage. Returns arrow_writer_batch's result. */
+int arrow_change_flush(ArrowWriter *w, ArrowChangeBatch *b);
+
+/** \brief Release the storage of b and zero it. */
+void arrow_change_free(ArrowChangeBatch *b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ARROW_IPC_H */
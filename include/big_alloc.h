@@ -0,0 +1,87 @@
+/** \file big_alloc.h
+ *  \brief Allocation of large fields and tables on huge pages with NUMA
+ *  first-touch placement.
+ *
+ *  Blocks of at least BIG_ALLOC_MIN_BYTES are mapped 2 MiB aligned and
+ *  backed, in order of preference, by hugetlb pages (when requested and the
+ *  pool has room), transparent huge pages (madvise) or normal pages. Smaller
+ *  blocks come from the heap. On machines with more than one NUMA node a
+ *  block is first touched by the threads that will work on it, so the
+ *  kernel places each region on that thread's node; single-node machines
+ *  skip the touch and fault pages in lazily.
+ *
+ *  Environment: COINSORTER_HUGEPAGES=off|thp|hugetlb (default thp) and
+ *  COINSORTER_FIRST_TOUCH=0|1 (default: 1 on multi-node machines).
+ */
+#ifndef BIG_ALLOC_H
+#define BIG_ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Smallest block that is mapped instead of taken from the heap. */
+#define BIG_ALLOC_MIN_BYTES ((size_t)2 << 20)
+/** \brief Huge page size assumed for alignment and hugetlb mappings. */
+#define BIG_ALLOC_HUGE_PAGE ((size_t)2 << 20)
+
+/** \brief Backing actually obtained for a block. */
+typedef enum {
+  BIG_ALLOC_HEAP = 0,    /**< calloc (small block or no mmap support). */
+  BIG_ALLOC_PAGES = 1,   /**< Anonymous mapping on normal pages. */
+  BIG_ALLOC_THP = 2,     /**< Mapping advised for transparent huge pages. */
+  BIG_ALLOC_HUGETLB = 3, /**< Mapping on reserved hugetlb pages. */
+  BIG_ALLOC_KINDS = 4
+} BigAllocKind;
+
+/** \brief How one block was placed. */
+typedef struct {
+  BigAllocKind kind;    /**< Backing obtained. */
+  size_t mapped_bytes;  /**< Bytes reserved (rounded up for mappings). */
+  int touch_threads;    /**< Threads that first touched it (0: lazy). */
+  int numa_nodes;       /**< NUMA nodes seen on this machine. */
+} BigAllocInfo;
+
+/** \brief Process-wide counters of big_alloc. */
+typedef struct {
+  uint64_t allocs[BIG_ALLOC_KINDS]; /**< Blocks per backing kind. */
+  uint64_t bytes[BIG_ALLOC_KINDS];  /**< Requested bytes per backing kind. */
+  uint64_t hugetlb_fallbacks;       /**< hugetlb requested but unavailable. */
+  uint64_t first_touched;           /**< Blocks touched in parallel. */
+  int numa_nodes;                   /**< NUMA nodes seen on this machine. */
+} BigAllocStats;
+
+/** \brief Allocate bytes of zeroed memory.
+ *  \param threads Threads that will process the block (<= 0 => default);
+ *         with first touch enabled, the block is split into planes equal
+ *         arrays and each array into threads contiguous ranges, matching
+ *         the static partition of parallel_for over its rows.
+ *  \param planes Number of equal consecutive arrays in the block (<= 0 =>
+ *         1).
+ *  \param info Receives the placement (may be NULL).
+ *  \return The block, or NULL for zero bytes or on failure. Release with
+ *          big_free and the same byte count.
+ */
+void *big_alloc(size_t bytes, int threads, int planes, BigAllocInfo *info);
+
+/** \brief Release a block from big_alloc (NULL is ignored). */
+void big_free(void *p, size_t bytes);
+
+/** \brief Human-readable name of a backing kind ("heap", "pages", "thp",
+ *  "hugetlb"). */
+const char *big_alloc_kind_name(BigAllocKind kind);
+
+/** \brief Copy the process-wide counters into s. */
+void big_alloc_stats(BigAllocStats *s);
+
+/** \brief Number of online NUMA nodes (1 if unknown). */
+int big_alloc_numa_nodes(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BIG_ALLOC_H */
@@ -0,0 +1,115 @@
+/**
+ * \file change_table.h
+ * \brief Compressed precomputed change tables (minimal coin counts).
+ *
+ * A plain DP table keeps best[a] (int) and last[a] (unsigned short) for every
+ * amount. This format stores the same information in about one byte per
+ * amount or less:
+ *  - a count is stored as its excess over the trend a / max_coin, which is
+ *    bounded by the counts below the largest coin;
+ *  - amounts are grouped in blocks of CHANGE_TABLE_BLOCK; each block keeps a
+ *    sampled absolute value (the smallest excess) and bit-packs the deltas of
+ *    every excess from it at the narrowest width that fits the block;
+ *  - the coin index of the last step (predecessor link) is bit-packed at a
+ *    fixed ceil(log2 ncoins) bits per amount;
+ *  - each block also records how many reachable amounts precede it, which
+ *    gives rank/select over the reachable set.
+ *
+ * Lookups are O(1) (one directory entry plus two bit-field reads). The table
+ * is built by one streaming pass of the DP that only keeps a ring buffer of
+ * the last max-coin counts, and saved files are used in place through mmap.
+ */
+#ifndef CHANGE_TABLE_H
+#define CHANGE_TABLE_H
+
+#include "checkpoint.h"
+#include "coins.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Amounts per directory block. */
+#define CHANGE_TABLE_BLOCK 256
+/** \brief Largest supported number of denominations. */
+#define CHANGE_TABLE_MAX_COINS 255
+
+/** \brief Directory entry for one block of amounts. */
+typedef struct {
+  uint64_t bits;  /**< counts bit offset << 8 | width << 1 | unreachable flag */
+  uint32_t base;  /**< smallest count excess in the block */
+  uint32_t rank;  /**< reachable amounts in all earlier blocks */
+} ChangeTableBlock;
+
+/** \brief Compressed table for amounts 0..max_amount of one coin system. */
+typedef struct {
+  int max_amount;                 /**< Largest tabulated amount. */
+  int ncoins;                     /**< Denominations (system order). */
+  int max_coin;                   /**< Largest coin value (count trend). */
+  int last_bits;                  /**< Bits per predecessor index. */
+  size_t nblocks;                 /**< Directory entries. */
+  const uint32_t *coins;          /**< Coin values, system order. */
+  const ChangeTableBlock *blocks; /**< Block directory. */
+  const uint64_t *counts;         /**< Bit-packed count offsets. */
+  const uint64_t *last;           /**< Bit-packed predecessor indices. */
+  size_t counts_words;            /**< Words in counts (incl. padding). */
+  size_t last_words;              /**< Words in last (incl. padding). */
+  void *storage;                  /**< Block from big_alloc (coins,
+                                       directory, links) when built; counts
+                                       is then a separate heap array. */
+  size_t storage_size;            /**< Bytes in storage. */
+  void *mapping;                  /**< mmap base when loaded from a file. */
+  size_t mapping_size;            /**< Bytes mapped. */
+} ChangeTable;
+
+/** \brief Build the table for amounts 0..max_amount with one streaming DP
+ * pass (same tie-breaking as dp_make_change). Returns 0 on success. */
+int change_table_build(const CoinSystem *sys, int max_amount, ChangeTable *t);
+
+/** \brief change_table_build with checkpoint/restart: if ck's file holds a
+ * snapshot of the same coin system and max_amount, the directory, link and
+ * count streams and the DP ring are restored from it and the build continues
+ * at the next block. Snapshots are taken at block boundaries whenever
+ * checkpoint_due(ck, blocks done) says so, and once at the end. The table is
+ * identical to change_table_build's (ck NULL: plain build). */
+int change_table_build_resume(const CoinSystem *sys, int max_amount,
+                              ChangeTable *t, Checkpointer *ck);
+
+/** \brief Release a built or mapped table. */
+void change_table_free(ChangeTable *t);
+
+/** \brief Minimal coin count for amount, or -1 if unreachable / out of range.
+ */
+int change_table_count(const ChangeTable *t, int amount);
+
+/** \brief Coin index used by the last step for amount, or -1 for amount 0,
+ * unreachable or out-of-range amounts. */
+int change_table_last(const ChangeTable *t, int amount);
+
+/** \brief Reconstruct per-coin counts (ncoins entries) by following the
+ * predecessor links. Returns 0 on success, -1 if amount has no solution. */
+int change_table_make_change(const ChangeTable *t, int amount, int *counts);
+
+/** \brief Number of reachable amounts in [0, amount]. */
+long change_table_rank(const ChangeTable *t, int amount);
+
+/** \brief The k-th reachable amount (k from 0), or -1 if there are fewer. */
+int change_table_select(const ChangeTable *t, long k);
+
+/** \brief Bytes used by directory and bit streams (excluding file header). */
+size_t change_table_bytes(const ChangeTable *t);
+
+/** \brief Write the table to path (via a temporary file and rename). */
+int change_table_save(const ChangeTable *t, const char *path);
+
+/** \brief Map a saved table for zero-copy use; validates the header,
+ * directory checksum and section bounds. Release with change_table_free. */
+int change_table_load_mmap(ChangeTable *t, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CHANGE_TABLE_H */
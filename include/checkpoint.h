@@ -0,0 +1,153 @@
+/** \file checkpoint.h
+ *  \brief Periodic snapshots of long-running solver state with asynchronous
+ *  writes, and the loading side used by the resume entry points.
+ *
+ *  A snapshot is a list of tagged byte sections (fields, counters, RNG
+ *  streams, weights, ...) plus the step it was taken at. Submitting copies
+ *  the sections into a private buffer and returns; a background thread
+ *  writes the buffer beside the target path and renames it into place, so a
+ *  preempted process always leaves the last complete snapshot behind. If a
+ *  newer snapshot arrives while one is still waiting, the waiting one is
+ *  dropped. Builds without thread support (COINSORTER_NO_THREADS) write
+ *  synchronously.
+ *
+ *  File layout: a 64-byte header, then per section a 16-byte entry (tag,
+ *  length) followed by the payload padded to 8 bytes. Host-endian, with an
+ *  endian tag; a 64-bit checksum (checkpoint_hash) covers everything after
+ *  the header.
+ *
+ *  Resume entry points (poisson_jacobi_resume, mlp_train_resume,
+ *  change_table_build_resume) take a Checkpointer: they restore from its
+ *  file when the snapshot belongs to the same problem, snapshot whenever
+ *  checkpoint_due says so, write a final snapshot and return exactly what
+ *  the uninterrupted routine would have returned.
+ */
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Four-character section tag. */
+#define CHECKPOINT_TAG(a, b, c, d)                                             \
+  ((uint32_t)(unsigned char)(a) | (uint32_t)(unsigned char)(b) << 8 |          \
+   (uint32_t)(unsigned char)(c) << 16 | (uint32_t)(unsigned char)(d) << 24)
+
+/** \brief Section holding the problem key of the resume entry points. */
+#define CHECKPOINT_TAG_KEY CHECKPOINT_TAG('K', 'E', 'Y', ' ')
+
+/** \brief Routine a snapshot belongs to. */
+typedef enum {
+  CHECKPOINT_KIND_POISSON = 1,     /**< poisson_jacobi_resume */
+  CHECKPOINT_KIND_MLP = 2,         /**< mlp_train_resume */
+  CHECKPOINT_KIND_CHANGE_TABLE = 3 /**< change_table_build_resume */
+} CheckpointKind;
+
+/** \brief One section of a snapshot. */
+typedef struct {
+  uint32_t tag;     /**< CHECKPOINT_TAG value, unique per snapshot. */
+  const void *data; /**< Payload (copied on submit). */
+  size_t bytes;     /**< Payload length. */
+} CheckpointSection;
+
+/** \brief Snapshot writer bound to one file (opaque). */
+typedef struct Checkpointer Checkpointer;
+
+/** \brief Counters of a Checkpointer. */
+typedef struct {
+  uint64_t submitted;   /**< Snapshots handed to the writer. */
+  uint64_t written;     /**< Snapshots renamed into place. */
+  uint64_t superseded;  /**< Snapshots dropped for a newer one. */
+  uint64_t failed;      /**< Writes that failed. */
+  uint64_t bytes;       /**< File bytes written. */
+  double write_seconds; /**< Time spent writing in the background. */
+} CheckpointStats;
+
+/** \brief Open a writer for path and start its thread.
+ *  \param interval_s Snapshot at most this often in seconds (<= 0: never by
+ *         time).
+ *  \param every Also snapshot every this many steps (<= 0: never by count).
+ *  \return The writer, or NULL on bad arguments or failure.
+ */
+Checkpointer *checkpoint_open(const char *path, double interval_s,
+                              long every);
+
+/** \brief Wait for pending writes, stop the thread and free ck (NULL is
+ *  ignored). */
+void checkpoint_close(Checkpointer *ck);
+
+/** \brief Target file of ck. */
+const char *checkpoint_path(const Checkpointer *ck);
+
+/** \brief Whether a snapshot should be taken now that step steps are done:
+ *  step is a multiple of every, or interval_s passed since the last submit
+ *  (or since open). */
+int checkpoint_due(Checkpointer *ck, long step);
+
+/** \brief Copy n sections into a snapshot of routine kind at step and queue
+ *  it for writing. Returns 0, or -1 on bad arguments or allocation failure.
+ *  Builds without threads write it at once and also return -1 if that fails.
+ */
+int checkpoint_submit(Checkpointer *ck, uint32_t kind, long step,
+                      const CheckpointSection *sections, int n);
+
+/** \brief Wait until every submitted snapshot is written or dropped.
+ *  Returns 0 if the last write succeeded (or none happened), -1 otherwise.
+ */
+int checkpoint_flush(Checkpointer *ck);
+
+/** \brief Copy the counters of ck into s. */
+void checkpoint_stats(const Checkpointer *ck, CheckpointStats *s);
+
+/** \brief A snapshot loaded from disk (read-only mapping). */
+typedef struct {
+  uint32_t kind;    /**< Routine (CheckpointKind). */
+  long step;        /**< Step the snapshot was taken at. */
+  int nsections;    /**< Number of sections. */
+  void *mapping;    /**< File mapping. */
+  size_t mapping_size; /**< Bytes mapped. */
+} CheckpointImage;
+
+/** \brief Map and validate a snapshot file. Returns 0, or -1 if it is
+ *  missing, truncated, foreign or fails the checksum. */
+int checkpoint_load(const char *path, CheckpointImage *img);
+
+/** \brief Load the snapshot of ck's file if it is of routine kind and its
+ *  CHECKPOINT_TAG_KEY section equals key. Returns 0 on a match (release
+ *  img with checkpoint_image_free), -1 otherwise. */
+int checkpoint_resume(const Checkpointer *ck, uint32_t kind, const void *key,
+                      size_t key_bytes, CheckpointImage *img);
+
+/** \brief Payload of the section tagged tag (8-byte aligned), or NULL;
+ *  bytes receives its length. */
+const void *checkpoint_image_section(const CheckpointImage *img, uint32_t tag,
+                                     size_t *bytes);
+
+/** \brief Unmap a loaded snapshot and zero img. */
+void checkpoint_image_free(CheckpointImage *img);
+
+/** \brief 64-bit FNV-1a over 8-byte words (bytewise tail): the file
+ *  checksum, also used to key snapshots to their inputs. */
+uint64_t checkpoint_hash(uint64_t h, const void *data, size_t bytes);
+
+/** \brief Initial value for checkpoint_hash. */
+#define CHECKPOINT_HASH_INIT 1469598103934665603ull
+
+/** \brief Write nparts buffers back to back to a uniquely named temporary
+ *  file beside path, fsync it and rename it over path, so readers see either
+ *  the old file or the complete new one. Snapshots and the weight, change
+ *  table and field codec files are written this way. A process killed
+ *  mid-write leaves its "<path>.XXXXXX" file behind. Returns 0 on success,
+ *  -1 on failure (path is left untouched). */
+int checkpoint_write_file(const char *path, const void *const *parts,
+                          const size_t *bytes, int nparts);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CHECKPOINT_H */
@@ -0,0 +1,142 @@
+/**
+ * \file coin_acoustics.h
+ * \brief Acoustic ring signatures: modal frequencies of coins and matching of
+ * recorded drop sounds against every coin of every system.
+ *
+ * A coin is modelled as a free thin circular plate (Kirchhoff). Mode (n, s)
+ * has n nodal diameters and s nodal circles. Its frequency parameter
+ * lambda^2 is a root of the free-edge frequency equation in J_n and I_n,
+ * which depends only on Poisson's ratio, and
+ *
+ *   f = lambda^2 / (2 pi a^2) * sqrt(D / (rho h)),  D = E h^3 / 12(1-nu^2).
+ *
+ * The plate thickness is the uniform disc with the coin's mass and diameter,
+ * clamped to 4-12% of the diameter, since rims and relief make real coins
+ * thinner than that in the field and thicker at the edge.
+ *
+ * Matching works on a log-frequency axis, where a uniform scaling of all
+ * modes (thickness tolerance, temperature, alloy spread) becomes a shift.
+ * Recorded signals are transformed two per complex FFT, max-pooled onto the
+ * log bins, square-root compressed and normalized. The score against each
+ * reference is the largest normalized correlation over shifts of up to
+ * max_scale, ranked with a discount of 0.2% per bin of shift so that
+ * near-ties go to the unscaled reading. References are synthesized through the same pooling from
+ * analytic Lorentzian line shapes, so both sides share the same binning.
+ */
+#ifndef COIN_ACOUSTICS_H
+#define COIN_ACOUSTICS_H
+
+#include "coins.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief One vibration mode of a coin. */
+typedef struct {
+  int nodal_diameters; /**< n: 0 for axisymmetric modes. */
+  int nodal_circles;   /**< s. */
+  double lambda2;      /**< Frequency parameter lambda^2. */
+  double freq_hz;      /**< Modal frequency (Hz). */
+} CoinMode;
+
+/** \brief lambda^2 of mode (n, s) of a free circular plate with Poisson's
+ * ratio nu. (0, 0) and (1, 0) are the rigid-body motions, so the lowest
+ * axisymmetric (umbrella) mode is (0, 1) and the gravest mode is (2, 0).
+ * Returns -1 on bad input (n < 0, a rigid-body mode, nu outside [0, 0.5))
+ * or if the root lies beyond lambda = 40. */
+double coin_plate_lambda2(int n, int s, double nu);
+
+/** \brief Equivalent plate thickness (mm) of coin: see the file comment.
+ * Returns 0 if the coin has no diameter or known material. */
+double coin_plate_thickness_mm(const CoinSpec *coin);
+
+/** \brief The lowest n_axisymmetric modes with n = 0 followed by the lowest
+ * n_asymmetric modes with n >= 1, each group in ascending frequency, for
+ * coin at thickness_mm (<= 0: coin_plate_thickness_mm). modes receives
+ * n_axisymmetric + n_asymmetric entries. Returns that count, or -1 if the
+ * coin has no diameter or known material. */
+int coin_ring_modes(const CoinSpec *coin, double thickness_mm,
+                    int n_axisymmetric, int n_asymmetric, CoinMode *modes);
+
+/** \brief Matcher settings (see acoustic_default_config). */
+typedef struct {
+  double sample_rate;     /**< Recording sample rate (Hz). */
+  int fft_size;           /**< Samples analysed per drop (power of two). */
+  int log_bins;           /**< Bins of the log-frequency axis. */
+  double f_min;           /**< Lowest analysed frequency (Hz); the axis ends
+                               at Nyquist. */
+  double max_scale;       /**< Largest uniform frequency scaling searched
+                               (>= 1; 1 disables the shift search). */
+  int axisymmetric_modes; /**< Modes with n = 0 per reference. */
+  int asymmetric_modes;   /**< Modes with n >= 1 per reference. */
+  double q_factor;        /**< Quality factor of the reference lines. */
+  double thickness_mm;    /**< Plate thickness for every coin (<= 0: from
+                               coin_plate_thickness_mm). */
+  int threads;            /**< Worker threads (<= 0: default). */
+} AcousticConfig;
+
+/** \brief Fill c with 96 kHz, 4096-sample frames, 256 log bins from 1 kHz,
+ * +-4% scaling, 3 axisymmetric and 5 asymmetric modes and Q = 500. */
+void acoustic_default_config(AcousticConfig *c);
+
+/** \brief Reference spectra of all coins of all systems. */
+typedef struct AcousticMatcher AcousticMatcher;
+
+/** \brief Build references for every coin of every predefined system that
+ * has a diameter, a known material and at least one mode inside the
+ * analysed band. c may be NULL for defaults. Returns NULL on bad settings
+ * or no memory. */
+AcousticMatcher *acoustic_matcher_create(const AcousticConfig *c);
+/** \brief Free a matcher (NULL is ignored). */
+void acoustic_matcher_destroy(AcousticMatcher *m);
+
+/** \brief Number of references. */
+size_t acoustic_reference_count(const AcousticMatcher *m);
+/** \brief Coin and system of reference i; sys may be NULL. Returns NULL if
+ * i is out of range. */
+const CoinSpec *acoustic_reference_coin(const AcousticMatcher *m, size_t i,
+                                        const CoinSystem **sys);
+/** \brief Modes of reference i (axisymmetric first); *modes may be NULL.
+ * Returns the mode count, or 0 if i is out of range. */
+int acoustic_reference_modes(const AcousticMatcher *m, size_t i,
+                             const CoinMode **modes);
+/** \brief Normalized log-frequency spectrum of reference i (log_bins
+ * values), or NULL. */
+const float *acoustic_reference_spectrum(const AcousticMatcher *m, size_t i);
+/** \brief Centre frequency (Hz) of log bin b. */
+double acoustic_bin_frequency(const AcousticMatcher *m, int b);
+
+/** \brief Synthesize n samples of reference ref struck and ringing: every
+ * mode, scaled in frequency by scale, rings with a random amplitude in
+ * [0.5, 1], random phase and the decay of Q = q_factor, plus Gaussian
+ * noise of standard deviation noise (relative to a unit mode amplitude).
+ * Returns 0, or -1 on bad input. */
+int acoustic_synthesize(const AcousticMatcher *m, size_t ref, double scale,
+                        double noise, unsigned seed, double *signal,
+                        size_t n);
+
+/** \brief Best match of one recorded drop. */
+typedef struct {
+  long ref;     /**< Best reference, or -1 for a silent signal. */
+  double score; /**< Normalized correlation in [-1, 1]. */
+  double scale; /**< Frequency scaling of the recording relative to the
+                     reference at the best shift. */
+  long runner_up;      /**< Second-best reference, or -1. */
+  double runner_score; /**< Its score. */
+} AcousticMatch;
+
+/** \brief Match count recordings. Recording i starts at signals + i*stride
+ * and holds len samples at the configured rate (truncated or zero-padded to
+ * fft_size). Recordings are transformed in pairs and spread over the
+ * configured threads. Returns 0, or -1 on bad input or no memory. */
+int acoustic_match_batch(const AcousticMatcher *m, const double *signals,
+                         size_t count, size_t stride, size_t len,
+                         AcousticMatch *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COIN_ACOUSTICS_H */
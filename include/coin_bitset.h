@@ -0,0 +1,70 @@
+/**
+ * \file coin_bitset.h
+ * \brief Word-parallel reachability sets for coin feasibility questions.
+ *
+ * Amount a is bit a of an array of 64-bit words; adding a coin of value v to
+ * every amount of a set is one shift-by-v OR pass over the words, so each
+ * pass handles 64 amounts per word operation (256 per AVX2 operation). No
+ * per-amount coin indices are stored, so systems are not limited to the
+ * unsigned short index range of the cellwise DP.
+ */
+#ifndef COIN_BITSET_H
+#define COIN_BITSET_H
+
+#include "coins.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Set of amounts 0..max_amount. */
+typedef struct {
+  uint64_t *words;  /**< Bit a of words[a / 64] is amount a. */
+  size_t nwords;    /**< Words allocated (covers max_amount). */
+  int max_amount;   /**< Largest representable amount. */
+} CoinBitset;
+
+/** \brief Allocate an empty set for amounts 0..max_amount. Returns 0 on
+ * success. */
+int coin_bitset_init(CoinBitset *b, int max_amount);
+
+/** \brief Release the set. */
+void coin_bitset_free(CoinBitset *b);
+
+/** \brief 1 if amount is in the set (0 when out of range). */
+static inline int coin_bitset_test(const CoinBitset *b, int amount) {
+  return amount >= 0 && amount <= b->max_amount &&
+         (int)((b->words[(unsigned)amount >> 6] >> (amount & 63)) & 1u);
+}
+
+/** \brief Number of amounts in the set. */
+size_t coin_bitset_count(const CoinBitset *b);
+
+/** \brief Amounts payable with any number of coins (out must be initialized;
+ * its max_amount sets the range). Returns 0, or -1 on invalid input. */
+int coin_bitset_reachable(const CoinSystem *sys, CoinBitset *out);
+
+/** \brief Amounts payable with at most k coins. Returns 0, or -1. */
+int coin_bitset_reachable_k(const CoinSystem *sys, int k, CoinBitset *out);
+
+/** \brief Amounts payable when coin i may be used at most supply[i] times
+ * (negative supply = unlimited). Bounded coins are split into power-of-two
+ * bundles, each applied as one 0/1 shift-OR pass. Returns 0, or -1. */
+int coin_bitset_reachable_bounded(const CoinSystem *sys, const int *supply,
+                                  CoinBitset *out);
+
+/** \brief Minimal coin count per amount, computed layer by layer: min_k[a]
+ * receives the first k whose reachable set contains a, or -1 if a needs
+ * more than max_k coins (max_k <= 0: run until no layer adds amounts).
+ * Cost is O(k * ncoins * max_amount / 64), so this suits small k.
+ * Returns the number of layers run, or -1 on invalid input. */
+int coin_bitset_min_coins(const CoinSystem *sys, int max_amount, int max_k,
+                          int *min_k);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COIN_BITSET_H */
@@ -44,6 +44,10 @@ typedef struct {
 /* Predefined systems */
 /** \brief Retrieve a predefined system by name ("usd", "eur"). */
 const CoinSystem *get_coin_system(const char *name);
+/** \brief Number of predefined systems. */
+size_t coin_system_count(void);
+/** \brief Predefined system i (0 <= i < coin_system_count()), or NULL. */
+const CoinSystem *get_coin_system_by_index(size_t i);
 /** \brief Print available systems to stdout. */
 void list_systems(void);
 
@@ -52,6 +56,21 @@ void list_systems(void);
 int greedy_make_change(const CoinSystem *sys, int amount, int *counts);
 /** \brief Dynamic programming minimal coin count solution. */
 int dp_make_change(const CoinSystem *sys, int amount, int *counts);
+/** \brief Greedy change for n amounts at once (SIMD, division-free).
+ *
+ *  Counts are written transposed: counts_out[c * n + i] is the count of coin
+ *  c for amounts[i] (counts_out holds ncoins * n ints). Negative amounts get
+ *  all-zero counts. Uses AVX2 when the CPU has it; outputs of 8 MiB or
+ *  more with 32-byte alignment are written with streaming stores. Returns
+ *  the number of amounts greedy could not pay exactly (remainder or
+ *  negative), or -1 on invalid input.
+ */
+int greedy_make_change_batch(const CoinSystem *sys, const int *amounts,
+                             size_t n, int *counts_out);
+/** \brief Convert transposed batch counts into per-amount rows:
+ * counts[i * ncoins + c] = transposed[c * n + i]. */
+void change_counts_transpose(const int *transposed, size_t n, size_t ncoins,
+                             int *counts);
 
 /* Audit canonical optimality; returns 1 if greedy optimal up to bound, else 0.
    If a counterexample is found and ex_amount!=NULL it is stored there. */
@@ -88,6 +107,10 @@ typedef enum {
   OPT_MODE_COUNT    /**< Sentinel (number of modes). */
 } OptimizeMode;
 
+/** \brief Objective weight of one coin under mode (1 for OPT_COUNT, and as
+ * fallback when the coin lacks the needed metadata). */
+double coin_weight(const CoinSpec *coin, OptimizeMode mode);
+
 /* DP with optimization mode (count, mass, diameter). Returns 0 success. */
 /** \brief DP minimizing selected objective; ties resolved by fewer coins. */
 int dp_make_change_opt(const CoinSystem *sys, int amount, int *counts,
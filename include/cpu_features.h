@@ -0,0 +1,45 @@
+/** \file cpu_features.h
+ *  \brief Runtime detection of the x86 SIMD extensions used by the kernels.
+ *
+ *  SIMD kernels are compiled into every x86 build with per-function target
+ *  attributes (CPU_TARGET) and picked at run time from cpu_features(), so
+ *  a portable build still runs AVX2 / VNNI code on machines that have it.
+ *  Other architectures and compilers get the scalar paths only.
+ *
+ *  Environment: COINSORTER_SIMD=off runs every kernel on its scalar path.
+ */
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+/** \brief Defined when x86 SIMD kernels are compiled in. */
+#define CPU_X86 1
+/** \brief Compile one function for the given extensions ("avx2,fma"). */
+#define CPU_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+/** \brief Extensions a kernel can dispatch on. */
+enum {
+  CPU_AVX2 = 1u << 0,       /**< AVX2. */
+  CPU_FMA = 1u << 1,        /**< FMA3. */
+  CPU_AVX_VNNI = 1u << 2,   /**< AVX-VNNI (VEX vpdpbusd). */
+  CPU_AVX512_VNNI = 1u << 3 /**< AVX512-VNNI with AVX512VL (256-bit). */
+};
+
+/** \brief Extensions that are both present and enabled (CPU_* bits). */
+unsigned cpu_features(void);
+
+/** \brief Enable only the present extensions in mask (all by default, none
+ *  with COINSORTER_SIMD=off); tests use it to compare SIMD and scalar
+ *  paths. Returns the previously enabled set. */
+unsigned cpu_features_limit(unsigned mask);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CPU_FEATURES_H */
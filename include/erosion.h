@@ -0,0 +1,71 @@
+/**
+ * \file erosion.h
+ * \brief Particle hydraulic erosion and grid thermal erosion of heightfields.
+ *
+ * Hydraulic erosion follows droplets downhill: each droplet samples the
+ * height and gradient bilinearly, carries sediment up to a capacity that
+ * grows with slope, speed and water volume, erodes through a radial brush
+ * while under capacity and deposits bilinearly when over it or climbing.
+ * When a droplet stops (out of steps, stalled or leaving the grid) it drops
+ * the rest of its sediment at its last position, so mass is conserved.
+ *
+ * Droplets run in parallel without locks. The grid is cut into square tiles
+ * at least twice as wide as the farthest a droplet (plus its brush) can reach,
+ * and the tiles are processed in four colour phases of a 2x2 checkerboard, so
+ * tiles of one phase never touch the same cells. Every tile draws from its
+ * own seeded stream, so results do not depend on the thread count.
+ *
+ * Thermal erosion moves material from cells steeper than a talus slope to
+ * their lower 8-neighbours in two gather passes (outflow, then inflow), which
+ * is likewise race-free and deterministic.
+ */
+#ifndef EROSION_H
+#define EROSION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Hydraulic erosion settings (see erosion_default_params). */
+typedef struct {
+  long droplets;         /**< Droplets to simulate. */
+  int max_steps;         /**< Lifetime of a droplet in cell-sized steps. */
+  int radius;            /**< Erosion brush radius (cells). */
+  double inertia;        /**< Share of the previous direction kept [0,1). */
+  double capacity;       /**< Sediment capacity factor. */
+  double min_capacity;   /**< Capacity floor on flat ground. */
+  double erode_rate;     /**< Fraction of free capacity eroded per step. */
+  double deposit_rate;   /**< Fraction of excess sediment dropped per step. */
+  double evaporation;    /**< Fraction of water lost per step. */
+  double gravity;        /**< Speed gained per unit of height lost. */
+  unsigned seed;         /**< Seed of the per-tile droplet streams. */
+  int threads;           /**< Worker threads (<= 0: default). */
+} ErosionParams;
+
+/** \brief Totals reported by erosion_hydraulic. */
+typedef struct {
+  double eroded;    /**< Height removed, summed over cells. */
+  double deposited; /**< Height added, summed over cells. */
+  long steps;       /**< Droplet steps simulated. */
+} ErosionStats;
+
+/** \brief Fill p with defaults suited to heights of order one over the grid. */
+void erosion_default_params(ErosionParams *p);
+
+/** \brief Run p->droplets droplets over the nx*ny row-major heightfield h in
+ * place. stats may be NULL. Returns 0, or -1 on bad input or no memory. */
+int erosion_hydraulic(double *h, int nx, int ny, const ErosionParams *p,
+                      ErosionStats *stats);
+
+/** \brief iters thermal relaxation sweeps: wherever the drop to a neighbour
+ * exceeds talus per cell of distance, rate/2 of the largest excess is shared
+ * among the lower neighbours in proportion to their excess. Mass is
+ * conserved. Returns 0, or -1 on bad input or no memory. */
+int erosion_thermal(double *h, int nx, int ny, double talus, double rate,
+                    int iters, int threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EROSION_H */
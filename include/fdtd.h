@@ -0,0 +1,91 @@
+/**
+ * \file fdtd.h
+ * \brief 2D TMz finite-difference time-domain solver for fields around coins.
+ *
+ * Ez lives on the integer nodes of a square Yee grid, Hx and Hy half a cell
+ * away. Each cell carries a material from the observables database (vacuum
+ * by default). Conductors use the exponential update, so metals with
+ * sigma*dt/eps >> 1 stay stable. The outermost cells form a convolutional
+ * PML (CPML) backed by a PEC wall.
+ *
+ * A time step is a single ascending sweep over rows that updates the H row
+ * and then the Ez row below it, so every row is touched once while it is in
+ * cache. Threads own contiguous row bands. Only each band's last H row is
+ * updated in a separate phase, which costs two barriers per step. The row
+ * kernels are unit-stride float loops over per-cell coefficients, which the
+ * compiler vectorizes.
+ */
+#ifndef FDTD_H
+#define FDTD_H
+
+#include "observables.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Most distinct materials on one grid (vacuum included). */
+#define FDTD_MAX_MATERIALS 32
+/** \brief Most soft sources on one grid. */
+#define FDTD_MAX_SOURCES 8
+/** \brief Most probes on one grid. */
+#define FDTD_MAX_PROBES 16
+
+/** \brief Opaque simulation grid. */
+typedef struct FdtdGrid FdtdGrid;
+
+/** \brief Vacuum grid of nx*ny nodes spaced dx metres, with a pml-cell
+ * absorbing frame (0 = bare PEC box). dt is 0.99 of the 2D Courant limit.
+ * Returns NULL on bad sizes (nx, ny < 2*pml + 3) or no memory. */
+FdtdGrid *fdtd_create(int nx, int ny, double dx, int pml);
+/** \brief Free a grid (NULL is ignored). */
+void fdtd_destroy(FdtdGrid *g);
+
+/** \brief Time step (s). */
+double fdtd_dt(const FdtdGrid *g);
+/** \brief Steps run so far. */
+long fdtd_steps(const FdtdGrid *g);
+/** \brief Ez node values, row-major nx*ny (V/m). */
+const float *fdtd_ez(const FdtdGrid *g);
+
+/** \brief Give material m to every node within radius metres of (cx, cy)
+ * (metres from node (0,0)). Returns 0, or -1 on bad input or if the
+ * material table is full. */
+int fdtd_paint_disc(FdtdGrid *g, double cx, double cy, double radius,
+                    const MaterialProperties *m);
+/** \brief Paint the cross-section of coin (diameter, and material from
+ * get_material_properties) centred at (cx, cy) metres. Returns 0, or -1 if
+ * the coin has no diameter or known material. */
+int fdtd_add_coin(FdtdGrid *g, const CoinSpec *coin, double cx, double cy);
+
+/** \brief Soft Ez source at node (x, y): a Gaussian-modulated sine of
+ * centre frequency f0 (Hz), width 1/f0 and peak amplitude (V/m) added after
+ * every E update. Returns 0 or -1. */
+int fdtd_add_source(FdtdGrid *g, int x, int y, double f0, double amplitude);
+/** \brief Record Ez at node (x, y) after every step. Returns the probe
+ * index, or -1. */
+int fdtd_add_probe(FdtdGrid *g, int x, int y);
+/** \brief Samples recorded by probe (one per step); *samples may be NULL. */
+size_t fdtd_probe_samples(const FdtdGrid *g, int probe,
+                          const double **samples);
+/** \brief Amplitude spectrum of a probe's record through
+ * fft_amplitude_spectrum. Returns the bins written, or 0. */
+size_t fdtd_probe_spectrum(const FdtdGrid *g, int probe, double *freq,
+                           double *amp, size_t max_bins);
+
+/** \brief Advance steps time steps on threads worker threads (<= 0:
+ * default). Returns 0, or -1 on bad input or no memory. */
+int fdtd_run(FdtdGrid *g, int steps, int threads);
+
+/** \brief EM energy per unit length (J/m): the sum over nodes of
+ * observable_em_energy_density(|E|, |B|, material) * dx^2, with H averaged
+ * onto the nodes. If density is non-NULL it receives the nx*ny per-node
+ * values (J/m^3). */
+double fdtd_energy(const FdtdGrid *g, double *density);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FDTD_H */
@@ -0,0 +1,62 @@
+/**
+ * \file fft.h
+ * \brief In-place radix-2 complex FFT and one-sided amplitude spectra of
+ * sampled signals.
+ *
+ * Repeated transforms of one length should go through an FftPlan, which
+ * holds the twiddles stage by stage (unit stride in the butterfly loop) and
+ * the bit-reversal swap list. fft_real_pair transforms two real signals
+ * with one complex FFT.
+ */
+#ifndef FFT_H
+#define FFT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Smallest power of two >= n (1 for n == 0). */
+size_t fft_next_pow2(size_t n);
+
+/** \brief Transform (re, im) of length n in place: X_k = sum x_j e^{-2 pi i
+ * jk/n}, or the inverse (scaled by 1/n) when inverse is non-zero. Returns 0,
+ * or -1 if n is not a power of two or memory runs out. */
+int fft_radix2(double *re, double *im, size_t n, int inverse);
+
+/** \brief Precomputed tables for transforms of one power-of-two length. */
+typedef struct FftPlan FftPlan;
+
+/** \brief Plan transforms of length n. Returns NULL if n is not a power of
+ * two or memory runs out. */
+FftPlan *fft_plan_create(size_t n);
+/** \brief Free a plan (NULL is ignored). */
+void fft_plan_destroy(FftPlan *plan);
+/** \brief Transform length of a plan. */
+size_t fft_plan_size(const FftPlan *plan);
+/** \brief fft_radix2 on the plan's length without allocating. A plan may
+ * be shared by threads. Returns 0, or -1 on NULL arguments. */
+int fft_execute(const FftPlan *plan, double *re, double *im, int inverse);
+
+/** \brief Spectra of two real signals from one complex FFT. On entry re
+ * and im hold the two signals (plan length n each); they are overwritten.
+ * mag1[k] and mag2[k] receive |X1_k| and |X2_k| for k = 0..n/2, split with
+ * X1_k = (Z_k + conj Z_{n-k})/2 and X2_k = (Z_k - conj Z_{n-k})/2i. mag2
+ * may be NULL. Returns 0 or -1. */
+int fft_real_pair(const FftPlan *plan, double *re, double *im, double *mag1,
+                  double *mag2);
+
+/** \brief One-sided amplitude spectrum of n real samples taken every dt
+ * seconds, zero-padded to a power of two N. Writes up to max_bins bins:
+ * freq[k] = k / (N dt) and amp[k] = |X_k| * dt, the continuous Fourier
+ * transform estimate of a transient. freq may be NULL. Returns the number
+ * of bins written (min(N/2+1, max_bins)), or 0 on bad input. */
+size_t fft_amplitude_spectrum(const double *x, size_t n, double dt,
+                              double *freq, double *amp, size_t max_bins);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FFT_H */
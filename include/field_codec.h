@@ -0,0 +1,67 @@
+/** \file field_codec.h
+ *  \brief Compression of double-precision 2D fields for caches and exports.
+ *
+ *  Each cell is predicted from its already decoded west, north and
+ *  north-west neighbours (p = W + N - NW). Lossless mode stores the
+ *  difference of the order-preserving integer images of value and
+ *  prediction; lossy mode stores the prediction error quantized to a power
+ *  of two step no larger than twice the error bound, so every decoded value
+ *  is within the bound (values the quantizer cannot hit are stored
+ *  verbatim). Codes are zigzag mapped and split into eight byte planes,
+ *  each stored as all-zero, 4-bit packed, sparse (bitmap plus non-zero
+ *  bytes) or raw, whichever is smallest.
+ *
+ *  Fields are cut into bands of whole rows that are coded independently and
+ *  located through an offset table, so compression and decompression run
+ *  one band per task in parallel.
+ */
+#ifndef FIELD_CODEC_H
+#define FIELD_CODEC_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Target cells per independently coded band of rows. */
+#define FIELD_CODEC_TILE_CELLS 65536
+
+/** \brief Compress an nx*ny row-major field.
+ *  \param error_bound Largest absolute error per cell (0 => lossless).
+ *  \param threads Worker threads (<= 0 => default).
+ *  \param out Receives a malloc'd buffer (free with free()).
+ *  \param out_bytes Receives its length.
+ *  \return 0, or -1 on bad arguments or allocation failure.
+ */
+int field_codec_compress(const double *field, int nx, int ny,
+                         double error_bound, int threads, unsigned char **out,
+                         size_t *out_bytes);
+
+/** \brief Validate a compressed buffer (header, offsets, checksum) and read
+ *  its shape and error bound (any output may be NULL). Returns 0 or -1. */
+int field_codec_info(const unsigned char *buf, size_t bytes, int *nx,
+                     int *ny, double *error_bound);
+
+/** \brief Decompress into field (nx*ny, which must match the buffer).
+ *  Returns 0, or -1 on a malformed buffer, shape mismatch or allocation
+ *  failure. */
+int field_codec_decompress(const unsigned char *buf, size_t bytes,
+                           double *field, int nx, int ny, int threads);
+
+/** \brief Compress field to path (written beside it and renamed into
+ *  place). Returns 0 on success. */
+int field_codec_write(const char *path, const double *field, int nx, int ny,
+                      double error_bound, int threads);
+
+/** \brief Read a file written by field_codec_write into a malloc'd field.
+ *  nx, ny and error_bound (may be NULL) receive its header values. Returns
+ *  NULL on failure. */
+double *field_codec_read(const char *path, int *nx, int *ny,
+                         double *error_bound, int threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FIELD_CODEC_H */
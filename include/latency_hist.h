@@ -0,0 +1,125 @@
+/**
+ * \file latency_hist.h
+ * \brief Log-linear (HDR-style) latency histograms and solver probes.
+ *
+ * Values (nanoseconds) below 2^LATENCY_SUB_BITS get one bucket each; above
+ * that every power of two is split into 2^LATENCY_SUB_BITS equal buckets, so
+ * any recorded value is reported within 1/64 (1.6%) of its true value over
+ * the full 64-bit range. Recording is a few relaxed atomic adds, so a
+ * histogram may be read or merged while other threads record into it.
+ * LatencyHistSet hands each thread its own histogram to keep hot counters
+ * unshared; the sets are merged on demand.
+ */
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief log2 of the buckets per power of two. */
+#define LATENCY_SUB_BITS 6
+/** \brief Total buckets per histogram. */
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+/** \brief Per-thread slots in a LatencyHistSet (extra threads share). */
+#define LATENCY_MAX_THREADS 64
+
+/** \brief One histogram of nanosecond values. */
+typedef struct {
+  uint64_t counts[LATENCY_BUCKETS]; /**< Samples per bucket. */
+  uint64_t total;                   /**< Samples recorded. */
+  uint64_t sum;                     /**< Sum of values (ns). */
+  uint64_t min;                     /**< Smallest value (UINT64_MAX if none). */
+  uint64_t max;                     /**< Largest value. */
+} LatencyHist;
+
+/** \brief Lazily allocated per-thread histograms (zero-initialize). */
+typedef struct {
+  LatencyHist *slots[LATENCY_MAX_THREADS]; /**< Per-thread histograms. */
+} LatencyHistSet;
+
+/** \brief Monotonic clock in nanoseconds. */
+uint64_t latency_now_ns(void);
+
+/** \brief Empty the histogram. */
+void latency_hist_reset(LatencyHist *h);
+/** \brief Record one value (ns). Safe against concurrent recorders. */
+void latency_hist_record(LatencyHist *h, uint64_t ns);
+/** \brief Add src's samples into dst. */
+void latency_hist_merge(LatencyHist *dst, const LatencyHist *src);
+/** \brief Value at percentile p in [0,100] (highest value equivalent to the
+ * bucket, clamped to the recorded max); 0 if empty. */
+uint64_t latency_hist_percentile(const LatencyHist *h, double p);
+/** \brief Samples in buckets lying entirely at or below ns (cumulative
+ * "le" counts; exact to bucket resolution). */
+uint64_t latency_hist_count_le(const LatencyHist *h, uint64_t ns);
+/** \brief Mean value (ns); 0 if empty. */
+double latency_hist_mean(const LatencyHist *h);
+/** \brief Summary plus a percentile distribution table. */
+void latency_hist_print(const LatencyHist *h, const char *label, FILE *fp);
+/** \brief JSON object with summary, percentiles and non-empty buckets as
+ * [low, high, count]. Returns 0, or -1 if buf is too small. */
+int latency_hist_to_json(const LatencyHist *h, char *buf, size_t buflen);
+
+/** \brief The calling thread's histogram in set (NULL if out of memory). */
+LatencyHist *latency_set_local(LatencyHistSet *set);
+/** \brief Merge every thread's histogram of set into out (reset first). */
+void latency_set_snapshot(const LatencyHistSet *set, LatencyHist *out);
+/** \brief Free all per-thread histograms of set. */
+void latency_set_free(LatencyHistSet *set);
+
+/** \brief Public solver entry points that can be probed. */
+typedef enum {
+  LAT_SOLVER_GREEDY = 0,   /**< greedy_make_change */
+  LAT_SOLVER_DP,           /**< dp_make_change */
+  LAT_SOLVER_DP_OPT,       /**< dp_make_change_opt */
+  LAT_SOLVER_BATCH,        /**< greedy_make_change_batch (whole batch) */
+  LAT_SOLVER_TABLE,        /**< change_table_make_change */
+  LAT_SOLVER_MIXED,        /**< mixed_change_pay */
+  LAT_SOLVER_COUNT
+} LatencySolver;
+
+/** \brief Non-zero while solver probes are enabled (read via
+ * latency_probes_enabled). */
+extern int latency_probes_on;
+
+/** \brief Cheap check used by instrumented solvers. */
+static inline int latency_probes_enabled(void) {
+  return __atomic_load_n(&latency_probes_on, __ATOMIC_RELAXED);
+}
+
+/** \brief Turn solver probes on or off (off by default; setting the
+ * environment variable COINSORTER_LATENCY=1 turns them on at startup). */
+void latency_probes_enable(int on);
+/** \brief Record one call of solver id into the calling thread's slot. */
+void latency_probe_record(LatencySolver id, uint64_t ns);
+/** \brief Merged histogram of solver id over all threads. */
+void latency_probe_snapshot(LatencySolver id, LatencyHist *out);
+/** \brief Clear every solver histogram. */
+void latency_probes_reset(void);
+/** \brief Short solver name ("dp", "greedy", ...). */
+const char *latency_solver_name(LatencySolver id);
+/** \brief Print each probed solver with samples (text, or JSON lines). */
+void latency_probes_report(FILE *fp, int json);
+
+/** \brief Return the int result of call from the enclosing function,
+ * recording its latency under solver id when probes are enabled. */
+#define LATENCY_PROBED_RETURN(id, call)                                        \
+  do {                                                                         \
+    if (!latency_probes_enabled())                                             \
+      return (call);                                                           \
+    uint64_t latency_t0_ = latency_now_ns();                                   \
+    int latency_rc_ = (call);                                                  \
+    latency_probe_record((id), latency_now_ns() - latency_t0_);                \
+    return latency_rc_;                                                        \
+  } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LATENCY_HIST_H */
@@ -0,0 +1,73 @@
+/** \file lifshitz.h
+ *  \brief Lifshitz-theory Casimir interaction between metallic bodies.
+ *
+ *  Finite-temperature Matsubara sum with Gauss–Laguerre quadrature over the
+ *  transverse wave vector. Metals follow the Drude or plasma permittivity
+ *  with the plasma frequency derived from the DC conductivity; the
+ *  sphere–plate force uses the proximity-force approximation on the
+ *  plate–plate free energy. Signed results: negative means attraction.
+ */
+#ifndef LIFSHITZ_H
+#define LIFSHITZ_H
+
+#include "observables.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Dielectric response along the imaginary frequency axis. */
+typedef enum {
+  LIFSHITZ_DRUDE = 0, /**< ε = 1 + ωp²/(ξ(ξ+γ)); no TE zero-frequency term. */
+  LIFSHITZ_PLASMA,    /**< ε = 1 + ωp²/ξ² (dissipationless). */
+  LIFSHITZ_IDEAL      /**< Perfect reflector (|r| = 1), reference limit. */
+} LifshitzModel;
+
+/** \brief Interaction geometry. */
+typedef enum {
+  LIFSHITZ_PLATE_PLATE = 0, /**< Two half-spaces; force is pressure (Pa). */
+  LIFSHITZ_SPHERE_PLATE     /**< Sphere above plate via PFA; force in N. */
+} LifshitzGeometry;
+
+/** \brief Evaluation settings (zero fields select defaults). */
+typedef struct {
+  LifshitzModel model;       /**< Permittivity model. */
+  LifshitzGeometry geometry; /**< Plate–plate or sphere–plate. */
+  double plasma_freq;        /**< Plasma frequency ωp (rad/s). */
+  double damping;            /**< Drude relaxation γ (rad/s). */
+  double temperature;        /**< Temperature (K, > 0). */
+  double radius;             /**< Sphere radius (m), sphere–plate only. */
+  int quad_nodes;            /**< Gauss–Laguerre nodes (0 => 40, max 64). */
+  double rel_tol;            /**< Matsubara truncation tolerance (0 => 1e-6). */
+} LifshitzConfig;
+
+/** \brief Default Drude relaxation rate used when deriving ωp (rad/s). */
+#define LIFSHITZ_DEFAULT_DAMPING 5.3e13
+
+/** \brief Fill cfg for a metal of given DC conductivity (S/m): ωp =
+ * sqrt(σγ/ε0) with γ = LIFSHITZ_DEFAULT_DAMPING. Returns 0, or -1 for
+ * non-conducting input. */
+int lifshitz_config_from_conductivity(LifshitzConfig *cfg, double conductivity,
+                                      double temperature, LifshitzModel model);
+/** \brief As above, reading electrical_conductivity from a material. */
+int lifshitz_config_from_material(LifshitzConfig *cfg,
+                                  const MaterialProperties *material,
+                                  double temperature, LifshitzModel model);
+
+/** \brief Plate–plate free energy per unit area at separation a (J/m²). */
+double lifshitz_free_energy(const LifshitzConfig *cfg, double a);
+/** \brief Plate–plate pressure at separation a (Pa). */
+double lifshitz_pressure(const LifshitzConfig *cfg, double a);
+/** \brief Force for cfg->geometry: pressure for plates, 2πR·E(a) (N) for
+ * sphere–plate. */
+double lifshitz_force(const LifshitzConfig *cfg, double a);
+/** \brief Force–distance curve: out[i] = lifshitz_force(cfg, a[i]), with the
+ * separations spread over nthreads (<=0 => default). Returns 0 on success. */
+int lifshitz_force_curve(const LifshitzConfig *cfg, const double *a, int n,
+                         double *out, int nthreads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIFSHITZ_H */
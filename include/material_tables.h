@@ -0,0 +1,62 @@
+/** \file material_tables.h
+ *  \brief Temperature-dependent material property tables.
+ *
+ *  Each property is tabulated per material on a uniform temperature grid
+ *  (MATERIAL_TABLE_T_MIN..MATERIAL_TABLE_T_MAX) in structure-of-arrays form
+ *  and read back with clamped linear interpolation. The tables are built once
+ *  from the room-temperature entries of the material database; lookups do no
+ *  physics, only index arithmetic and one lerp.
+ */
+#ifndef MATERIAL_TABLES_H
+#define MATERIAL_TABLES_H
+
+#include "observables.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Lowest tabulated temperature (K); lookups below clamp here. */
+#define MATERIAL_TABLE_T_MIN 150.0
+/** \brief Highest tabulated temperature (K); lookups above clamp here. */
+#define MATERIAL_TABLE_T_MAX 450.0
+/** \brief Grid spacing (K). */
+#define MATERIAL_TABLE_T_STEP 5.0
+/** \brief Number of grid points per material and property. */
+#define MATERIAL_TABLE_POINTS 61
+
+/** \brief Tabulated properties. */
+typedef enum {
+  MT_ELECTRICAL_CONDUCTIVITY = 0, /**< S/m */
+  MT_THERMAL_CONDUCTIVITY,        /**< W/(m·K) */
+  MT_THERMAL_EXPANSION,           /**< 1/K (linear) */
+  MT_SPECIFIC_HEAT,               /**< J/(kg·K) */
+  MT_PROPERTY_COUNT
+} MaterialTableProperty;
+
+/** \brief Interpolated property of database material `material` at T (K).
+ * Returns 0 for an out-of-range material or property. */
+double material_table_lookup(size_t material, MaterialTableProperty prop,
+                             double T);
+
+/** \brief Batch lookup for one material: out[i] = property at T[i]. */
+void material_table_lookup_batch(size_t material, MaterialTableProperty prop,
+                                 const double *T, double *out, size_t n);
+
+/** \brief Batch lookup across materials: out[i] = property of materials[i]
+ * at T[i] (invalid material indices yield 0). */
+void material_table_lookup_mixed(const size_t *materials,
+                                 MaterialTableProperty prop, const double *T,
+                                 double *out, size_t n);
+
+/** \brief Copy base and replace its temperature-dependent fields with table
+ * values at T. Returns out, or NULL if base is not a database material. */
+MaterialProperties *material_properties_at(const MaterialProperties *base,
+                                           double T, MaterialProperties *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MATERIAL_TABLES_H */
@@ -0,0 +1,118 @@
+/**
+ * \file metrics.h
+ * \brief Process-wide counters, gauges and histograms with Prometheus text
+ * exposition.
+ *
+ * Metrics are registered once by name and label set and then updated through
+ * their handle. Counters are sharded per thread over cache-line padded slots
+ * and histograms are per-thread LatencyHist sets, so an update is one or two
+ * relaxed atomic adds on a line no other thread writes. Shards are summed only
+ * when the registry is rendered: by metrics_render, by the optional serving
+ * thread (Unix or TCP socket, plain text or HTTP GET), or on SIGUSR1.
+ */
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Most metrics (name + label combinations) in the registry. */
+#define METRICS_MAX 256
+/** \brief Counter shards (threads beyond this share slots). */
+#define METRICS_SHARDS 16
+
+/** \brief Kind of a registered metric. */
+typedef enum {
+  METRIC_COUNTER = 0, /**< Monotonic unsigned total. */
+  METRIC_GAUGE,       /**< Signed value that can be set, added or raised. */
+  METRIC_HISTOGRAM    /**< Nanosecond samples, exported in seconds. */
+} MetricType;
+
+/** \brief Opaque registered metric. */
+typedef struct Metric Metric;
+
+/** \brief Get or create a metric. name must match [a-zA-Z_:][a-zA-Z0-9_:]*;
+ * labels is a preformatted Prometheus label list without braces (e.g.
+ * "system=\"usd\"", or NULL). Returns NULL if the name is invalid, the
+ * registry is full, or the name exists with another type. */
+Metric *metrics_register(MetricType type, const char *name, const char *labels,
+                         const char *help);
+/** \brief metrics_register cached in *slot (thread-safe, for static slots). */
+Metric *metrics_lazy(Metric **slot, MetricType type, const char *name,
+                     const char *labels, const char *help);
+
+/** \brief Add n to a counter (NULL is ignored). */
+void metrics_counter_add(Metric *m, uint64_t n);
+/** \brief Set a gauge. */
+void metrics_gauge_set(Metric *m, int64_t v);
+/** \brief Add d (may be negative) to a gauge. */
+void metrics_gauge_add(Metric *m, int64_t d);
+/** \brief Raise a gauge to v if v is larger (high-water marks). */
+void metrics_gauge_max(Metric *m, int64_t v);
+/** \brief Record one histogram sample in nanoseconds. */
+void metrics_observe_ns(Metric *m, uint64_t ns);
+/** \brief Current counter total or gauge value (histograms: sample count). */
+int64_t metrics_value(const Metric *m);
+
+/** \brief Render every metric in Prometheus text format (0.0.4). Returns a
+ * malloc'd string (length in *len if non-NULL), or NULL on failure. */
+char *metrics_render(size_t *len);
+/** \brief Render to fp; returns 0 or -1. */
+int metrics_write(FILE *fp);
+
+/** \brief Non-zero while library instrumentation is enabled. */
+extern int metrics_on;
+/** \brief Cheap check guarding instrumentation in library code. */
+static inline int metrics_enabled(void) {
+  return __atomic_load_n(&metrics_on, __ATOMIC_RELAXED);
+}
+/** \brief Turn library instrumentation on or off (off by default). */
+void metrics_enable(int on);
+
+/** \brief Serve the registry on addr ("unix:PATH", "HOST:PORT" or ":PORT" for
+ * 127.0.0.1) from a background thread. Each connection gets one rendering:
+ * an HTTP response if the client sends a GET, plain text otherwise. The
+ * thread also honours SIGUSR1 dumps. Returns 0, or -1 (bad address, socket
+ * error, already serving, or no thread support). */
+int metrics_serve(const char *addr);
+/** \brief Stop the serving thread and remove its Unix socket, if any. */
+void metrics_serve_stop(void);
+
+/** \brief Install a SIGUSR1 handler requesting a dump (no SA_RESTART, so
+ * blocking reads return EINTR). Returns 0 or -1. */
+int metrics_install_dump_signal(void);
+/** \brief Consume a pending SIGUSR1 request: returns 1 once per signal. */
+int metrics_dump_pending(void);
+
+/** \brief Add n to a lazily registered counter when metrics are enabled. */
+#define METRICS_COUNT(name, labels, help, n)                                   \
+  do {                                                                         \
+    if (metrics_enabled()) {                                                   \
+      static Metric *metrics_slot_;                                            \
+      metrics_counter_add(                                                     \
+          metrics_lazy(&metrics_slot_, METRIC_COUNTER, name, labels, help),    \
+          (uint64_t)(n));                                                      \
+    }                                                                          \
+  } while (0)
+
+/** \brief Raise a lazily registered gauge when metrics are enabled. */
+#define METRICS_HIGH_WATER(name, labels, help, v)                              \
+  do {                                                                         \
+    if (metrics_enabled()) {                                                   \
+      static Metric *metrics_slot_;                                            \
+      metrics_gauge_max(                                                       \
+          metrics_lazy(&metrics_slot_, METRIC_GAUGE, name, labels, help),      \
+          (int64_t)(v));                                                       \
+    }                                                                          \
+  } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METRICS_H */
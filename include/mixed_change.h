@@ -0,0 +1,80 @@
+/**
+ * \file mixed_change.h
+ * \brief Change making from several currencies at fixed exchange rates.
+ *
+ * Every source system's coins are converted to a common smallest unit (the
+ * target currency's smallest unit divided by an automatically chosen integer
+ * scale, so every rate becomes an integer), merged into one combined
+ * denomination list, and solved by a single bounded DP pass over all amounts
+ * up to a limit. The pass records which bundle improved each amount, so a
+ * query only walks the bundles back: O(bundles + coins paid).
+ */
+#ifndef MIXED_CHANGE_H
+#define MIXED_CHANGE_H
+
+#include "coins.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Largest common-unit scale tried when making rates integral: any
+ * rate with at most six decimal places is representable. */
+#define MIXED_MAX_SCALE 1000000
+
+/** \brief One currency available in the till. */
+typedef struct {
+  const CoinSystem *sys; /**< Coin system. */
+  double rate;           /**< Target smallest units per smallest unit of sys
+                              (1.0 for the target currency itself). */
+  const int *inventory;  /**< Coins on hand per denomination (system order);
+                              NULL or negative entries mean unlimited. */
+} MixedSource;
+
+/** \brief One denomination of the merged system. */
+typedef struct {
+  int value;     /**< Value in common units. */
+  int source;    /**< Index into the sources passed at init. */
+  int coin;      /**< Index within that source's system. */
+  double weight; /**< Objective weight of one coin. */
+} MixedCoin;
+
+/** \brief Precomputed solver for one set of sources, inventories and mode. */
+typedef struct {
+  int scale;          /**< Common units per target smallest unit. */
+  int max_amount;     /**< Largest payable amount (target units). */
+  OptimizeMode mode;  /**< Objective (ties broken by fewer coins). */
+  MixedCoin *coins;   /**< Merged denominations, source by source. */
+  size_t ncoins;      /**< Entries in coins (and in pay() counts). */
+  int *item_coin;     /**< Bundle -> merged coin index. */
+  int *item_mult;     /**< Coins per bundle (0 = unlimited item). */
+  size_t nitems;      /**< Bundles in the DP. */
+  size_t span;        /**< Common-unit amounts tabulated (max * scale + 1). */
+  double *primary;    /**< Objective per common amount (INFINITY = none). */
+  int *ncoins_used;   /**< Coin count per common amount. */
+  uint64_t *take;     /**< Bit [item * span + a]: bundle improved a. */
+} MixedChangeSolver;
+
+/** \brief Merge sources and run the DP for amounts 0..max_amount (target
+ * units). Inventories are copied, so re-init after the till changes.
+ * Returns 0, or -1 on invalid input, rates needing a scale above
+ * MIXED_MAX_SCALE, max_amount * scale >= INT_MAX or no memory. */
+int mixed_change_init(MixedChangeSolver *m, const MixedSource *sources,
+                      size_t nsources, int max_amount, OptimizeMode mode);
+
+/** \brief Release solver memory. */
+void mixed_change_free(MixedChangeSolver *m);
+
+/** \brief Pay amount (target units) exactly. counts receives m->ncoins
+ * entries ordered like m->coins; objective (optional) the objective value.
+ * Returns 0, or -1 if the amount cannot be paid from the inventories. */
+int mixed_change_pay(const MixedChangeSolver *m, int amount, int *counts,
+                     double *objective);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MIXED_CHANGE_H */
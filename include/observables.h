@@ -117,6 +117,33 @@ const MaterialProperties *get_material_properties(const CoinSpec *coin);
  */
 const MaterialProperties *get_material_properties_by_composition(const char *composition);
 
+/** \brief Number of entries in the material database. */
+size_t material_count(void);
+
+/** \brief Material database entry by index (NULL if out of range). */
+const MaterialProperties *get_material_by_index(size_t index);
+
+/** \brief Database index of a material pointer, or -1 if it is not one of
+ * the database entries. */
+long material_index(const MaterialProperties *properties);
+
+/** \brief Skin depth at temperature T (K) using tabulated conductivity.
+ * \param frequency Frequency, as for observable_skin_depth.
+ * \param properties Database material (others use their stored value).
+ * \param T Temperature (K).
+ * \return Skin depth (m).
+ */
+double observable_skin_depth_at(double frequency,
+                                const MaterialProperties *properties,
+                                double T);
+
+/** \brief Thermal diffusivity at temperature T (K) from tabulated thermal
+ * conductivity and specific heat.
+ * \return Thermal diffusivity (m²/s).
+ */
+double observable_thermal_diffusivity_at(const MaterialProperties *properties,
+                                         double T);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,52 @@
+/** \file parallel.h
+ *  \brief Minimal fork-join helpers over POSIX threads.
+ *
+ *  Tasks are split into contiguous static ranges per thread so a given
+ *  (ntasks, nthreads) pair always maps each task to the same thread. Builds
+ *  without thread support (COINSORTER_NO_THREADS) run everything inline.
+ */
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Task callback: ctx is caller data, task in [0,ntasks), thread in
+ * [0,nthreads). */
+typedef void (*ParallelTaskFn)(void *ctx, int task, int thread);
+
+/** \brief Default worker count: COINSORTER_THREADS env var if set, otherwise
+ * the number of online CPUs (at least 1). */
+int parallel_default_threads(void);
+
+/** \brief Run fn over ntasks using up to nthreads threads (<=0 => default).
+ *  The calling thread acts as thread 0. A slice whose thread cannot be
+ *  spawned runs inline after slice 0, so slices must not wait on each other
+ *  (use parallel_for_team for that). Returns the thread count used.
+ */
+int parallel_for(int ntasks, int nthreads, ParallelTaskFn fn, void *ctx);
+
+/** \brief parallel_for whose slices all run at once, for slices that meet
+ *  at a ParallelBarrier sized to the returned count. Workers are held at a
+ *  start gate until every one is spawned; if one cannot be, none of fn runs
+ *  and -1 is returned. Builds without threads run a team of one inline and
+ *  return -1 for larger teams, so callers need a serial fallback.
+ */
+int parallel_for_team(int ntasks, int nthreads, ParallelTaskFn fn, void *ctx);
+
+/** \brief Reusable barrier for code running inside a parallel_for region. */
+typedef struct ParallelBarrier ParallelBarrier;
+
+/** \brief Create a barrier for nthreads participants (NULL on failure). */
+ParallelBarrier *parallel_barrier_create(int nthreads);
+/** \brief Block until all participants arrive. */
+void parallel_barrier_wait(ParallelBarrier *b);
+/** \brief Destroy barrier. */
+void parallel_barrier_destroy(ParallelBarrier *b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PARALLEL_H */
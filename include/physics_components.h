@@ -11,8 +11,10 @@
 #include "physics_framework.h"
 #include "beta.h"
 #include "casimir.h"
+#include "lifshitz.h"
 #include "env.h"
 #include "simulation.h"
+#include "erosion.h"
 #include "observables.h"
 
 #ifdef __cplusplus
@@ -38,6 +40,9 @@ extern const PhysicsComponent physics_casimir_base_component;
 /** \brief Casimir thermal correction component. */
 extern const PhysicsComponent physics_casimir_thermal_component;
 
+/** \brief Lifshitz-theory sphere-plate force from material conductivity. */
+extern const PhysicsComponent physics_casimir_lifshitz_component;
+
 /** \brief Casimir modulated force component. */
 extern const PhysicsComponent physics_casimir_modulated_component;
 
@@ -57,6 +62,9 @@ extern const PhysicsComponent physics_inverse_retrieve_component;
 /** \brief Poisson solver component. */
 extern const PhysicsComponent physics_poisson_solver_component;
 
+/** \brief Hydraulic + thermal erosion of a (generated or supplied) terrain. */
+extern const PhysicsComponent physics_erosion_component;
+
 /* === Material Properties Components === */
 
 /** \brief Energy density observable component. */
@@ -0,0 +1,99 @@
+/** \file physics_expr.h
+ *  \brief Expression components: physics formulas compiled at runtime into
+ *  register bytecode and evaluated over whole parameter columns.
+ *
+ *  A formula is written with + - * / ^ (or **), parentheses, numbers,
+ *  parameter names, constants from physics_constants.h (by macro name, e.g.
+ *  PHYSICS_HBAR, or short alias: pi, hbar, c, kB, eps0, mu0, qe, me, mp,
+ *  alpha, NA, R; parameters shadow aliases) and the functions sqrt, exp,
+ *  log, log10, sin, cos, tan, tanh, abs, min, max and pow.
+ *
+ *  Compilation checks dimensions: every operand carries exponents of mass,
+ *  length, time, temperature, current and amount (half-integers allowed).
+ *  Sums, min and max need equal dimensions, transcendental functions need
+ *  dimensionless arguments, powers of dimensioned values need a constant
+ *  exponent, and the result must have the declared dimension. Constant
+ *  subexpressions are folded and small integer powers become multiplies.
+ *
+ *  The bytecode is register based: each instruction applies one operation
+ *  to a block of up to PHYSICS_EXPR_BLOCK elements, reading parameter
+ *  columns in place, so dispatch costs one switch per instruction per block.
+ */
+#ifndef PHYSICS_EXPR_H
+#define PHYSICS_EXPR_H
+
+#include "physics_framework.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Elements processed per instruction dispatch. */
+#define PHYSICS_EXPR_BLOCK 256
+
+/** \brief Compiled expression (opaque). */
+typedef struct PhysicsExpr PhysicsExpr;
+
+/** \brief Compile source over the parameters params[0..num_params), which
+ *  must be PHYSICS_PARAM_DOUBLE. The result must have result_dimension.
+ *  Returns NULL on a syntax, name or dimension error (described in
+ *  error_buffer, which may be NULL) or on allocation failure. */
+PhysicsExpr *physics_expr_compile(const char *source,
+                                  const PhysicsParamDesc *params,
+                                  size_t num_params,
+                                  PhysicsDimension result_dimension,
+                                  char *error_buffer,
+                                  size_t buffer_size);
+
+/** \brief Free a compiled expression (NULL is ignored). */
+void physics_expr_destroy(PhysicsExpr *expr);
+
+/** \brief Number of bytecode instructions. */
+size_t physics_expr_num_instructions(const PhysicsExpr *expr);
+
+/** \brief Number of scratch registers (blocks) used. */
+size_t physics_expr_num_registers(const PhysicsExpr *expr);
+
+/** \brief Evaluate n rows: columns[i] holds n values of parameter i in
+ *  compile order (SoA), out receives n results. Returns 0, or -1 on bad
+ *  input or allocation failure. */
+int physics_expr_eval_batch(const PhysicsExpr *expr,
+                            const double *const *columns,
+                            size_t n,
+                            double *out);
+
+/** \brief Evaluate one row; values[i] is parameter i. */
+double physics_expr_eval(const PhysicsExpr *expr, const double *values);
+
+/** \brief Create a component that evaluates source. Parameter descriptors
+ *  and strings are copied. Its calculate function matches context
+ *  parameters by name and fails if one is missing or the result is not
+ *  finite. The component can be registered with
+ *  physics_framework_register_component and added to contexts like a
+ *  built-in. Returns NULL on compile error (see physics_expr_compile) or
+ *  allocation failure. */
+PhysicsComponent *physics_expr_component_create(const char *name,
+                                                const char *description,
+                                                const char *source,
+                                                const PhysicsParamDesc *params,
+                                                size_t num_params,
+                                                PhysicsDimension result_dimension,
+                                                const char *result_units,
+                                                char *error_buffer,
+                                                size_t buffer_size);
+
+/** \brief Compiled expression of an expression component, or NULL if comp
+ *  was not created by physics_expr_component_create. */
+const PhysicsExpr *physics_expr_component_expr(const PhysicsComponent *comp);
+
+/** \brief Free an expression component (NULL is ignored). The registry
+ *  has no removal, so registered components must never be freed, and
+ *  contexts using it must be destroyed first. */
+void physics_expr_component_destroy(PhysicsComponent *comp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PHYSICS_EXPR_H */
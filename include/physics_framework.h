@@ -99,6 +99,17 @@ typedef bool (*PhysicsValidationFunc)(const PhysicsComponent *comp,
                                        char *error_buffer,
                                        size_t buffer_size);
 
+/** \brief Function pointer for calculations built on upstream results.
+ *
+ *  upstream holds the latest result of each dependency, in the order of the
+ *  component's dependencies array.
+ */
+typedef PhysicsResult (*PhysicsComposeFunc)(const PhysicsComponent *comp,
+                                            const PhysicsParam *params,
+                                            size_t num_params,
+                                            const PhysicsResult *upstream,
+                                            size_t num_upstream);
+
 /** \brief Physics component descriptor. */
 struct PhysicsComponent {
     const char *name;                        /**< Component name */
@@ -112,6 +123,9 @@ struct PhysicsComponent {
     size_t num_dependencies;                 /**< Number of dependencies */
     PhysicsDimension result_dimension;       /**< Expected result dimension */
     const char *result_units;                /**< Expected result units */
+    PhysicsComposeFunc compose;              /**< Optional: used instead of calculate
+                                                  when every dependency runs in the
+                                                  same context */
 };
 
 /** \brief Physics calculation context for composing multiple components. */
@@ -122,6 +136,12 @@ typedef struct {
     size_t *param_counts;                    /**< Parameter count for each component */
     bool enable_validation;                  /**< Whether to perform validation */
     bool enable_dimensional_check;           /**< Whether to check dimensions */
+    PhysicsResult *results;                  /**< Latest result per component */
+    bool *dirty;                             /**< Inputs changed since the last run */
+    size_t *exec_counts;                     /**< Calculations run per component */
+    size_t **upstream;                       /**< Context indices of the results each
+                                                  component consumed on its last run */
+    size_t *num_upstream;                    /**< Entries in upstream[i] */
 } PhysicsContext;
 
 /* === Framework Core Functions === */
@@ -138,9 +158,30 @@ int physics_context_add_component(PhysicsContext *context,
                                    PhysicsParam *params,
                                    size_t num_params);
 
-/** \brief Execute all components in dependency order. */
+/** \brief Execute all components in dependency order into a new results
+ *  array (caller frees). */
 int physics_context_execute(PhysicsContext *context, PhysicsResult **results);
 
+/** \brief Set parameter name to value in every component that takes it.
+ *
+ *  Components whose value actually changes are marked dirty, and so is every
+ *  component downstream of them (one that consumed their results).
+ *  \return Number of components newly marked dirty, or -1 if no component
+ *  takes the parameter.
+ */
+int physics_context_set_param(PhysicsContext *context, const char *name,
+                              PhysicsParamValue value);
+
+/** \brief Recompute only the dirty components, in dependency order.
+ *
+ *  Components are dirty when added. *results points to the context's result
+ *  array (num_components entries), valid until the next add or destroy.
+ *  \return Number of components recomputed, or -1 on validation failure or
+ *  a dependency cycle.
+ */
+int physics_context_execute_incremental(PhysicsContext *context,
+                                        const PhysicsResult **results);
+
 /** \brief Validate all components and their parameter sets. */
 bool physics_context_validate(const PhysicsContext *context, 
                                char *error_buffer, 
@@ -0,0 +1,71 @@
+/** \file reduce.h
+ *  \brief Reproducible parallel reductions over fixed-size chunks.
+ *
+ *  Input is cut into chunks whose size depends only on the caller's chunk
+ *  length, never on the thread count. Each chunk is reduced serially into
+ *  its own partial, and partials are combined by a pairwise tree whose shape
+ *  depends only on the number of chunks. Threads merely decide who computes
+ *  which chunk, so results are bitwise identical for any thread count.
+ */
+#ifndef REDUCE_H
+#define REDUCE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Default chunk length in elements. */
+#define REDUCE_CHUNK 4096
+/** \brief Most values one reduce_chunks call may produce. */
+#define REDUCE_MAX_VALUES 8
+
+/** \brief How partials of one reduced value are combined. */
+typedef enum {
+  REDUCE_SUM = 0, /**< Partials start at 0 and are added. */
+  REDUCE_MIN = 1, /**< Partials start at +inf; the smaller is kept. */
+  REDUCE_MAX = 2  /**< Partials start at -inf; the larger is kept. */
+} ReduceOp;
+
+/** \brief Chunk callback: reduce items [begin, end) into partial, which
+ *  holds one identity-initialized slot per value. */
+typedef void (*ReduceChunkFn)(void *ctx, size_t begin, size_t end,
+                              double *partial);
+
+/** \brief Reduce n items into nvalues results.
+ *  \param chunk Items per chunk (0 => REDUCE_CHUNK); only the last chunk
+ *         may be shorter.
+ *  \param ops Combine operation per value (NULL => all REDUCE_SUM).
+ *  \param threads Worker threads (<= 0 => inline for small inputs,
+ *         parallel_default_threads() otherwise).
+ *  \param out Receives nvalues results (identities when n is 0).
+ *  \return 0, or -1 on bad arguments or allocation failure.
+ */
+int reduce_chunks(size_t n, size_t chunk, int nvalues, const ReduceOp *ops,
+                  int threads, ReduceChunkFn fn, void *ctx, double *out);
+
+/** \brief Sum of x[0..n). */
+double reduce_sum(const double *x, size_t n, int threads);
+
+/** \brief Dot product of x[0..n) and y[0..n). */
+double reduce_dot(const double *x, const double *y, size_t n, int threads);
+
+/** \brief Summary statistics of an array. */
+typedef struct {
+  double sum;    /**< Sum of values. */
+  double sum_sq; /**< Sum of squared values. */
+  double min;    /**< Smallest value (+inf when empty). */
+  double max;    /**< Largest value (-inf when empty). */
+  size_t count;  /**< Number of values. */
+} ReduceStats;
+
+/** \brief Sum, sum of squares, min and max of x[0..n) in one pass.
+ *  Returns 0, or -1 on bad arguments or allocation failure. */
+int reduce_stats(const double *x, size_t n, int threads, ReduceStats *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REDUCE_H */
@@ -0,0 +1,70 @@
+/**
+ * \file relief.h
+ * \brief Shaded-relief rendering of heightfields: hillshade, horizon-based
+ * ambient occlusion and hypsometric tinting.
+ *
+ * Hillshade is Lambertian lighting of the surface normals built from
+ * compute_deflection gradients, evaluated in row bands so no full-size
+ * gradient grids are needed.
+ *
+ * Ambient occlusion sweeps the grid in K evenly spaced azimuths. Each sweep
+ * walks rasterized lines across the grid while keeping the upper convex hull
+ * of the profile behind every line on a monotone stack. The top of the stack
+ * after popping is the exact horizon, so each direction costs O(nx*ny)
+ * whatever the horizon distance. The lines of one direction cover every cell
+ * exactly once, so they run on threads without sharing cells and the image
+ * does not depend on the thread count.
+ */
+#ifndef RELIEF_H
+#define RELIEF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Rendering settings (see relief_default_params). */
+typedef struct {
+  double azimuth;     /**< Sun azimuth, degrees clockwise from north (-y). */
+  double altitude;    /**< Sun elevation above the horizon, degrees. */
+  double z_scale;     /**< Cells per height unit (<= 0: 10% of the grid side
+                           over the height range). */
+  int ao_directions;  /**< Horizon sweep directions (0 disables occlusion). */
+  double ao_strength; /**< Darkening of fully occluded cells [0,1]. */
+  double ambient;     /**< Light reaching cells facing away from the sun. */
+  int hypsometric;    /**< Non-zero: tint by height, zero: grayscale. */
+  int threads;        /**< Worker threads (<= 0: default). */
+} ReliefParams;
+
+/** \brief Fill p with a north-west sun at 45 degrees, 8 occlusion
+ * directions and hypsometric tinting. */
+void relief_default_params(ReliefParams *p);
+
+/** \brief Hillshade in [0,1] for each cell of the nx*ny row-major field h.
+ * Returns 0, or -1 on bad input or no memory. */
+int relief_hillshade(const double *h, int nx, int ny, const ReliefParams *p,
+                     float *shade);
+
+/** \brief Sky visibility in [0,1] (1 - mean sine of the horizon elevation
+ * over p->ao_directions azimuths). Returns 0, or -1 on bad input (including
+ * ao_directions < 1) or no memory. */
+int relief_ambient_occlusion(const double *h, int nx, int ny,
+                             const ReliefParams *p, float *vis);
+
+/** \brief Hypsometric colour of a normalized height t in [0,1]. */
+void relief_hypsometric(double t, unsigned char rgb[3]);
+
+/** \brief Render h to nx*ny*3 bytes of RGB. Returns 0 or -1. */
+int relief_render(const double *h, int nx, int ny, const ReliefParams *p,
+                  unsigned char *rgb);
+
+/** \brief Render h and write it as a binary PPM via write_rgb_ppm (p may be
+ * NULL for defaults). Returns 1 on success, 0 on failure, like the other
+ * PPM writers. */
+int write_relief_ppm(const char *filename, const double *h, int nx, int ny,
+                     const ReliefParams *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RELIEF_H */
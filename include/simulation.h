@@ -5,6 +5,10 @@
  * field, simple MLP.
  */
 
+#include "checkpoint.h"
+#include <stddef.h>
+#include <stdint.h>
+
 /** \brief Generate fallback fBm-like noise (simple) in range roughly
  * [-0.5,0.5]. */
 void generate_fbm(double *field, int nx, int ny, double hurst);
@@ -29,6 +33,58 @@ void inverse_retrieve(const double *obs, int n, double *recon);
  * retained). */
 double poisson_jacobi(double *phi, const double *rhs, int nx, int ny,
                       int iters);
+/** \brief poisson_jacobi with checkpoint/restart: if ck's file holds a
+ * snapshot of the same grid, rhs and starting phi taken after at most iters
+ * iterations, phi is restored from it and only the remaining iterations run.
+ * Snapshots (phi, iteration count, last residual) are submitted whenever
+ * checkpoint_due says so and once at the end. Returns the same value and
+ * phi as an uninterrupted poisson_jacobi (ck NULL: plain poisson_jacobi). */
+double poisson_jacobi_resume(double *phi, const double *rhs, int nx, int ny,
+                             int iters, Checkpointer *ck);
+
+/** \brief Problems per interleaved group of the batched Poisson solver. */
+#define POISSON_BATCH_LANES 8
+
+/** \brief Doubles needed for count interleaved nx*ny problems (count rounded
+ * up to whole groups of POISSON_BATCH_LANES). */
+size_t poisson_batch_size(int nx, int ny, int count);
+/** \brief Offset of cell (x, y) of problem p in the interleaved layout:
+ * groups of POISSON_BATCH_LANES problems, each group stored cell by cell
+ * (row-major) with the group's problems adjacent, so SIMD lanes span
+ * problems. */
+size_t poisson_batch_index(int nx, int ny, int p, int x, int y);
+/** \brief Interleave count contiguous nx*ny fields into batch; padding lanes
+ * of the last group are zeroed. */
+void poisson_batch_pack(double *batch, const double *fields, int nx, int ny,
+                        int count);
+/** \brief De-interleave count problems from batch into contiguous fields. */
+void poisson_batch_unpack(double *fields, const double *batch, int nx, int ny,
+                          int count);
+
+/** \brief Settings of poisson_batch_solve. */
+typedef struct {
+  double omega;     /**< SOR factor in (0, 2) (<= 0: optimal for the grid). */
+  double tolerance; /**< Stop once max |Laplacian(phi) - rhs| <= tolerance. */
+  int max_iters;    /**< Sweep limit per group. */
+  int threads;      /**< Worker threads (<= 0: default). */
+} PoissonBatchConfig;
+
+/** \brief Fill c with optimal omega, tolerance 1e-8, 10000 sweeps and the
+ * default thread count. */
+void poisson_batch_default_config(PoissonBatchConfig *c);
+
+/** \brief Solve count independent problems Laplacian(phi) = rhs (unit grid
+ * spacing, Dirichlet boundary retained, as poisson_jacobi) stored
+ * interleaved (see poisson_batch_index). Each group runs lexicographic SOR
+ * with all lanes in lockstep until every problem in it meets the tolerance;
+ * groups are spread over threads and the result does not depend on the
+ * thread count. iters and residual (either may be NULL) receive per problem
+ * the sweeps of its group and its final max residual. Returns 0 if every
+ * problem converged, 1 if some hit max_iters, -1 on bad input (c may be NULL
+ * for defaults). */
+int poisson_batch_solve(double *phi, const double *rhs, int nx, int ny,
+                        int count, const PoissonBatchConfig *c, int *iters,
+                        double *residual);
 
 /** \brief Compute central-difference gradient (deflection) of scalar field. */
 void compute_deflection(const double *field, int nx, int ny, double *out_dx,
@@ -48,6 +104,8 @@ typedef struct {
   double *b1;  /**< Bias hidden (hid_dim). */
   double *w2;  /**< Weights hidden->output (hid_dim*out_dim). */
   double *b2;  /**< Bias output (out_dim). */
+  void *mapping;       /**< File mapping backing weights (mlp_load_mmap). */
+  size_t mapping_size; /**< Length of mapping in bytes. */
 } MLP;
 
 /** \brief Initialize MLP parameter buffers with small random weights. */
@@ -61,10 +119,101 @@ void mlp_forward(const MLP *m, const double *x, double *y);
 void mlp_train_epoch(MLP *m, const double *xs, const double *ys, int n_samples,
                      double lr);
 
+/** \brief Parallel training strategy. */
+typedef enum {
+  MLP_TRAIN_HOGWILD = 0, /**< Lock-free per-sample SGD on shared weights. */
+  MLP_TRAIN_SYNC = 1     /**< Data-parallel mini-batches, tree-reduced
+                              gradients; bitwise reproducible for a fixed
+                              seed and thread count. */
+} MLPTrainMode;
+
+/** \brief Opaque multithreaded trainer (per-thread RNG streams and scratch
+ * buffers allocated once). */
+typedef struct MLPTrainer MLPTrainer;
+
+/** \brief Create a trainer for networks shaped like m.
+ *  \param nthreads Worker count (<=0 => parallel_default_threads()).
+ *  \param batch_size Mini-batch size for MLP_TRAIN_SYNC (ignored otherwise).
+ *  \param seed Seed for the per-thread shuffle streams.
+ */
+MLPTrainer *mlp_trainer_create(const MLP *m, int nthreads, MLPTrainMode mode,
+                               int batch_size, unsigned seed);
+/** \brief One epoch over n samples; returns mean squared error seen during
+ * the epoch (negative on failure). A synchronous trainer that cannot start
+ * all of its threads (or a build without threads) runs its slices in turn on
+ * the calling thread, with the same result. */
+double mlp_trainer_epoch(MLPTrainer *t, MLP *m, const double *xs,
+                         const double *ys, int n_samples, double lr);
+/** \brief Release trainer resources. */
+void mlp_trainer_destroy(MLPTrainer *t);
+
+/** \brief Train for epochs epochs with checkpoint/restart: one
+ * mlp_trainer_epoch per epoch (mlp_train_epoch when t is NULL). If ck's file
+ * holds a snapshot of the same shape, data, lr, trainer setup and starting
+ * weights taken after at most epochs epochs, weights and trainer RNG streams
+ * are restored from it and only the remaining epochs run. Snapshots
+ * (weights, RNG streams, epoch count, last error) are submitted whenever
+ * checkpoint_due says so and once at the end; the weights match an
+ * uninterrupted run bitwise (SYNC mode or t NULL). mse (may be NULL)
+ * receives the last trainer epoch error (0 without a trainer). Returns 0,
+ * or -1 on bad input or failure. ck may be NULL. */
+int mlp_train_resume(MLP *m, MLPTrainer *t, const double *xs,
+                     const double *ys, int n_samples, double lr, int epochs,
+                     Checkpointer *ck, double *mse);
+
+/** \brief Int8 post-training quantized copy of an MLP.
+ *
+ *  Weights are stored transposed (one contiguous row per output channel) with
+ *  a symmetric per-channel float scale; activations are quantized per sample
+ *  at inference time and dot products accumulate in int32.
+ */
+typedef struct {
+  int in_dim;  /**< Input dimension. */
+  int hid_dim; /**< Hidden layer size. */
+  int out_dim; /**< Output dimension. */
+  int8_t *w1q; /**< Quantized input->hidden weights (hid_dim rows x in_dim). */
+  float *s1;   /**< Per-hidden-unit weight scale (hid_dim). */
+  float *b1;   /**< Hidden bias (hid_dim). */
+  int32_t *r1; /**< Row sums of w1q over the SIMD-width prefix (hid_dim). */
+  int8_t *w2q; /**< Quantized hidden->output weights (out_dim rows x hid_dim). */
+  float *s2;   /**< Per-output weight scale (out_dim). */
+  float *b2;   /**< Output bias (out_dim). */
+  int32_t *r2; /**< Row sums of w2q over the SIMD-width prefix (out_dim). */
+  void *storage; /**< Single allocation backing all arrays above. */
+  void *mapping;       /**< File mapping backing arrays (mlp_q8_load_mmap). */
+  size_t mapping_size; /**< Length of mapping in bytes. */
+} MLPQ8;
+
+/** \brief Quantize MLP weights to int8 with per-channel scales (0 success). */
+int mlp_quantize_q8(const MLP *m, MLPQ8 *q);
+/** \brief Release quantized buffers and zero struct. */
+void mlp_q8_free(MLPQ8 *q);
+/** \brief Batched int8 inference: xs is n*in_dim, ys receives n*out_dim. */
+int mlp_forward_q8_batch(const MLPQ8 *q, const double *xs, int n, double *ys);
+/** \brief Bytes held by quantized weights plus their scales. */
+size_t mlp_q8_weight_bytes(const MLPQ8 *q);
+
+/** \brief Write MLP weights to a versioned binary file (64-byte aligned
+ * sections, checkpoint_hash checksum). Returns 0 on success. */
+int mlp_save(const MLP *m, const char *path);
+/** \brief Map a file written by mlp_save; w1/b1/w2/b2 point into the private
+ * (copy-on-write) mapping, so loading copies nothing and unmodified pages are
+ * shared between processes. Release with mlp_free. Returns 0 on success. */
+int mlp_load_mmap(MLP *m, const char *path);
+/** \brief Write quantized weights and per-channel scales (same format, int8
+ * dtype). Returns 0 on success. */
+int mlp_q8_save(const MLPQ8 *q, const char *path);
+/** \brief Zero-copy load of a file written by mlp_q8_save; release with
+ * mlp_q8_free. Returns 0 on success. */
+int mlp_q8_load_mmap(MLPQ8 *q, const char *path);
+
 /** \brief Diamond-square fractal heightfield generator (N must be 2^k+1). */
 int fbm_diamond_square(double *field, int N, double hurst, unsigned seed);
 
 /** \brief Write grayscale height map (auto-normalized if needed) to PPM. */
 int write_field_ppm(const char *filename, const double *field, int nx, int ny);
+/** \brief Write nx*ny packed RGB bytes as a binary PPM (1 ok, 0 failure). */
+int write_rgb_ppm(const char *filename, const unsigned char *rgb, int nx,
+                  int ny);
 
 #endif /* SIMULATION_H */
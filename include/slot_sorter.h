@@ -0,0 +1,95 @@
+/**
+ * \file slot_sorter.h
+ * \brief Slot widths for mechanical coin sorters under manufacturing
+ * tolerance and wear.
+ *
+ * A sorter rolls every coin past slots of increasing width, and the coin
+ * falls through the first slot wider than it. Coin c passes with diameter
+ *
+ *   D = X * sqrt(M / mass_g),   X ~ N(diameter_mm, diameter_sd_mm),
+ *                               M ~ N(mass_mean_g, mass_sd_g),
+ *
+ * i.e. mint tolerance on the blank plus rim wear, which removes diameter in
+ * proportion to the square root of the mass lost at constant thickness.
+ * P(D < w) is evaluated exactly up to quadrature error: the mass is
+ * integrated numerically and the normal CDF is taken in closed form.
+ *
+ * With widths w_0 < ... < w_{K-2} and a final tray for everything wider,
+ * P(c lands in slot s) = F_c(w_s) - F_c(w_{s-1}). The expected misrouting
+ * rate is therefore a sum of independent terms, one per width w_s, each
+ * involving only the coins designated to slots s and s+1. For a given
+ * designation every width is optimized on its own by a scan plus a golden
+ * section search. The optimizer enumerates all designations that group the
+ * coins, in order of size, into K contiguous runs, and evaluates them on
+ * threads.
+ */
+#ifndef SLOT_SORTER_H
+#define SLOT_SORTER_H
+
+#include "coins.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Circulating population of one denomination. */
+typedef struct {
+  double diameter_mm;    /**< Mean mint diameter. */
+  double diameter_sd_mm; /**< Mint diameter spread (standard deviation). */
+  double mass_g;         /**< Nominal mint mass. */
+  double mass_mean_g;    /**< Mean circulating mass (below mass_g when
+                              worn). */
+  double mass_sd_g;      /**< Circulating mass spread (0: no wear spread). */
+  double weight;         /**< Relative share of the coin flow. */
+} SlotCoinDist;
+
+/** \brief Fill dists[0..sys->ncoins) from the system's CoinSpecs: mint
+ * spread 0.05 mm, circulating mass 99 +- 1% of nominal, equal flow. Coins
+ * without a mass get no wear. Returns 0, or -1 if a coin has no diameter. */
+int slot_default_dists(const CoinSystem *sys, SlotCoinDist *dists);
+
+/** \brief P(D < width) for one coin (see the file comment). */
+double slot_pass_cdf(const SlotCoinDist *d, double width);
+
+/** \brief Optimized slot layout for one system. */
+typedef struct {
+  size_t ncoins;     /**< Coins (system order). */
+  int nslots;        /**< Slots, the last being the tray for the widest. */
+  double *width;     /**< nslots widths (mm), ascending; width[nslots-1] is
+                          INFINITY. */
+  int *target;       /**< Designated slot per coin. */
+  double *error;     /**< ncoins * nslots: P(coin c lands in slot s). */
+  double misroute;   /**< Flow-weighted expected misrouting rate. */
+  size_t candidates; /**< Designations evaluated. */
+} SlotPlan;
+
+/** \brief Error matrix of widths (nslots - 1 finite widths followed by the
+ * tray) for n coins: error[c * nslots + s] = P(coin c lands in slot s).
+ * Returns 0, or -1 on bad input (including non-ascending widths). */
+int slot_error_matrix(const SlotCoinDist *dists, size_t n,
+                      const double *width, int nslots, double *error);
+
+/** \brief Monte Carlo estimate of slot_error_matrix from samples draws per
+ * coin, generated and classified in blocks of unit-stride arrays. Returns
+ * 0 or -1. */
+int slot_error_matrix_mc(const SlotCoinDist *dists, size_t n,
+                         const double *width, int nslots, long samples,
+                         unsigned seed, double *error);
+
+/** \brief Find the designation and widths minimizing the expected
+ * misrouting rate of sys over nslots slots (<= 0: one per coin; at most
+ * sys->ncoins). dists may be NULL for slot_default_dists. Candidates run
+ * on threads worker threads (<= 0: default). Returns 0, or -1 on bad input
+ * or no memory; free the plan with slot_plan_free. */
+int slot_plan_optimize(const CoinSystem *sys, const SlotCoinDist *dists,
+                       int nslots, int threads, SlotPlan *plan);
+
+/** \brief Release plan memory. */
+void slot_plan_free(SlotPlan *plan);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SLOT_SORTER_H */
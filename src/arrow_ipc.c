@@ -0,0 +1,562 @@
+/** \file arrow_ipc.c
+ *  \brief Arrow IPC stream messages with a minimal forward flatbuffer
+ *  encoder.
+ *
+ *  Flatbuffer offsets are unsigned and point forward, so the encoder lays
+ *  objects out parent first: a table reserves 4-byte slots for its children
+ *  and fb_link fills them in once a child has been appended. Each vtable is
+ *  written just before its table. Scalars are stored little-endian as the
+ *  flatbuffer format requires; column data stays in host order, which the
+ *  schema's endianness field declares.
+ */
+#define _DEFAULT_SOURCE
+#include "arrow_ipc.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/* Message header union and Type union members (Message.fbs, Schema.fbs). */
+enum { MSG_SCHEMA = 1, MSG_RECORD_BATCH = 3 };
+enum { TYPE_INT = 2, TYPE_FLOAT = 3, TYPE_UTF8 = 5, TYPE_LIST = 12 };
+#define METADATA_V5 4
+#define PRECISION_DOUBLE 2
+
+/* ---------------- flatbuffer encoder ---------------- */
+
+typedef struct {
+  unsigned char *p;
+  size_t len, cap;
+  int oom;
+} FbBuf;
+
+/** \brief Append n zero bytes; returns their position. */
+static size_t fb_grow(FbBuf *b, size_t n) {
+  size_t at = b->len;
+  if (b->oom)
+    return at;
+  if (b->len + n > b->cap) {
+    size_t cap = b->cap ? b->cap : 1024;
+    while (cap < b->len + n)
+      cap *= 2;
+    unsigned char *p = (unsigned char *)realloc(b->p, cap);
+    if (!p) {
+      b->oom = 1;
+      return at;
+    }
+    b->p = p;
+    b->cap = cap;
+  }
+  memset(b->p + at, 0, n);
+  b->len += n;
+  return at;
+}
+
+/** \brief Pad with zeros until len + extra is a multiple of align. */
+static void fb_pad(FbBuf *b, size_t align, size_t extra) {
+  size_t mis = (b->len + extra) & (align - 1);
+  if (mis)
+    fb_grow(b, align - mis);
+}
+
+/** \brief Store the low size bytes of v little-endian at pos. */
+static void fb_put(FbBuf *b, size_t pos, uint64_t v, unsigned size) {
+  if (b->oom || pos + size > b->len)
+    return;
+  for (unsigned i = 0; i < size; ++i)
+    b->p[pos + i] = (unsigned char)(v >> (8 * i));
+}
+
+/** \brief Point the offset slot at target (which must follow it). */
+static void fb_link(FbBuf *b, size_t slot, size_t target) {
+  fb_put(b, slot, (uint64_t)(target - slot), 4);
+}
+
+/** \brief Table field: size 0 (absent), 1, 2, 4 or 8 bytes. Offset fields
+ * are 4-byte slots for fb_link. */
+typedef struct {
+  unsigned size;
+  uint64_t value;
+} FbField;
+
+#define FB_MAX_FIELDS 8
+
+/** \brief Append a table of fields f[0..n) (field ids are the indices)
+ * preceded by its vtable. pos[i] receives the position of field i. Returns
+ * the table position. */
+static size_t fb_table(FbBuf *b, const FbField *f, int n, size_t *pos) {
+  unsigned at[FB_MAX_FIELDS] = {0};
+  size_t off = 4; /* soffset to the vtable */
+  for (unsigned sz = 8; sz >= 1; sz /= 2) /* largest first: no gaps */
+    for (int i = 0; i < n; ++i)
+      if (f[i].size == sz) {
+        off = (off + sz - 1) & ~(size_t)(sz - 1);
+        at[i] = (unsigned)off;
+        off += sz;
+      }
+  fb_pad(b, 2, 0);
+  size_t vt = fb_grow(b, 4 + 2 * (size_t)n);
+  fb_put(b, vt, 4 + 2 * (uint64_t)n, 2);
+  fb_put(b, vt + 2, off, 2);
+  for (int i = 0; i < n; ++i)
+    fb_put(b, vt + 4 + 2 * (size_t)i, at[i], 2);
+  fb_pad(b, 8, 0);
+  size_t t = fb_grow(b, off);
+  fb_put(b, t, (uint64_t)(t - vt), 4);
+  for (int i = 0; i < n; ++i) {
+    if (f[i].size)
+      fb_put(b, t + at[i], f[i].value, f[i].size);
+    if (pos)
+      pos[i] = t + at[i];
+  }
+  return t;
+}
+
+/** \brief Append a vector header of count elements whose data starts
+ * align-aligned, followed by bytes zero bytes. Returns its position. */
+static size_t fb_vector(FbBuf *b, size_t count, size_t align, size_t bytes) {
+  fb_pad(b, align < 4 ? 4 : align, 4);
+  size_t v = fb_grow(b, 4 + bytes);
+  fb_put(b, v, count, 4);
+  return v;
+}
+
+static size_t fb_string(FbBuf *b, const char *s) {
+  size_t n = strlen(s);
+  size_t v = fb_vector(b, n, 4, n + 1);
+  if (!b->oom)
+    memcpy(b->p + v + 4, s, n);
+  return v;
+}
+
+/** \brief Append a Field table (name, nullable, type, children). */
+static size_t fb_field(FbBuf *b, const char *name, ArrowType type,
+                       int nullable) {
+  unsigned type_id = type == ARROW_FLOAT64 ? TYPE_FLOAT
+                     : type == ARROW_UTF8  ? TYPE_UTF8
+                     : type == ARROW_LIST_INT32 ? TYPE_LIST
+                                                : TYPE_INT;
+  FbField f[6] = {{4, 0}, {1, nullable != 0}, {1, type_id}, {4, 0}, {0, 0},
+                  {4, 0}};
+  size_t pos[6];
+  size_t t = fb_table(b, f, 6, pos);
+  fb_link(b, pos[0], fb_string(b, name));
+  FbField tf[2] = {{0, 0}, {0, 0}};
+  int ntf = 0;
+  if (type == ARROW_INT32 || type == ARROW_INT64) {
+    tf[0].size = 4; /* bitWidth */
+    tf[0].value = type == ARROW_INT32 ? 32 : 64;
+    tf[1].size = 1; /* is_signed */
+    tf[1].value = 1;
+    ntf = 2;
+  } else if (type == ARROW_FLOAT64) {
+    tf[0].size = 2; /* precision */
+    tf[0].value = PRECISION_DOUBLE;
+    ntf = 1;
+  }
+  fb_link(b, pos[3], fb_table(b, tf, ntf, NULL));
+  /* readers expect a children vector even when it is empty */
+  size_t kids = fb_vector(b, type == ARROW_LIST_INT32, 4,
+                          type == ARROW_LIST_INT32 ? 4 : 0);
+  fb_link(b, pos[5], kids);
+  if (type == ARROW_LIST_INT32)
+    fb_link(b, kids + 4, fb_field(b, "item", ARROW_INT32, 0));
+  return t;
+}
+
+/** \brief Start a Message table; *header receives the header slot. */
+static void fb_message(FbBuf *b, unsigned header_type, int64_t body_length,
+                       size_t *header) {
+  b->len = 0;
+  b->oom = 0;
+  size_t root = fb_grow(b, 4);
+  FbField f[4] = {{2, METADATA_V5},
+                  {1, header_type},
+                  {4, 0},
+                  {8, (uint64_t)body_length}};
+  size_t pos[4];
+  fb_link(b, root, fb_table(b, f, 4, pos));
+  *header = pos[2];
+}
+
+/* ---------------- stream writer ---------------- */
+
+struct ArrowWriter {
+  int fd;
+  int nfields;
+  ArrowType *types;
+  FbBuf fb;
+  unsigned char prefix[8]; /* continuation marker and metadata length */
+  struct iovec *iov;
+  int64_t *words; /* FieldNode and Buffer structs of a batch */
+  uint64_t bytes;
+  int failed;
+};
+
+static const unsigned char zeros[8];
+
+static int host_little_endian(void) {
+  const uint16_t one = 1;
+  return *(const unsigned char *)&one == 1;
+}
+
+/** \brief writev all of iov[0..n), resuming after short writes. */
+static int write_iov(ArrowWriter *w, struct iovec *iov, int n) {
+  while (n > 0) {
+    int chunk = n < 512 ? n : 512;
+    ssize_t k = writev(w->fd, iov, chunk);
+    if (k < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    w->bytes += (uint64_t)k;
+    while (n > 0 && (size_t)k >= iov->iov_len) {
+      k -= (ssize_t)iov->iov_len;
+      ++iov;
+      --n;
+    }
+    if (n > 0) {
+      iov->iov_base = (char *)iov->iov_base + k;
+      iov->iov_len -= (size_t)k;
+    }
+  }
+  return 0;
+}
+
+/** \brief Emit the encapsulated message in w->fb followed by nbody body
+ * iovecs already stored from w->iov[2]. */
+static int send_message(ArrowWriter *w, int nbody) {
+  if (w->fb.oom)
+    return -1;
+  fb_pad(&w->fb, 8, 0);
+  if (w->fb.oom || w->fb.len > INT32_MAX)
+    return -1;
+  memset(w->prefix, 0xFF, 4);
+  for (int i = 0; i < 4; ++i)
+    w->prefix[4 + i] = (unsigned char)(w->fb.len >> (8 * i));
+  w->iov[0].iov_base = w->prefix;
+  w->iov[0].iov_len = 8;
+  w->iov[1].iov_base = w->fb.p;
+  w->iov[1].iov_len = w->fb.len;
+  return write_iov(w, w->iov, 2 + nbody);
+}
+
+/* Field nodes per column type (lists add their item column). */
+static int type_nodes(ArrowType t) { return t == ARROW_LIST_INT32 ? 2 : 1; }
+
+ArrowWriter *arrow_writer_open(int fd, const ArrowField *fields, int nfields) {
+  if (fd < 0 || !fields || nfields <= 0)
+    return NULL;
+  for (int i = 0; i < nfields; ++i)
+    if (!fields[i].name || (unsigned)fields[i].type > ARROW_LIST_INT32)
+      return NULL;
+  ArrowWriter *w = (ArrowWriter *)calloc(1, sizeof(*w));
+  if (!w)
+    return NULL;
+  w->fd = fd;
+  w->nfields = nfields;
+  w->types = (ArrowType *)malloc(sizeof(ArrowType) * (size_t)nfields);
+  /* two words per node and per buffer */
+  w->words = (int64_t *)malloc(sizeof(int64_t) * 12 * (size_t)nfields);
+  w->iov = (struct iovec *)malloc(sizeof(struct iovec) *
+                                  (2 + 8 * (size_t)nfields));
+  if (!w->types || !w->words || !w->iov) {
+    free(w->types);
+    free(w->words);
+    free(w->iov);
+    free(w);
+    return NULL;
+  }
+  size_t header;
+  fb_message(&w->fb, MSG_SCHEMA, 0, &header);
+  FbField sf[2] = {{2, host_little_endian() ? 0 : 1}, {4, 0}};
+  size_t spos[2];
+  fb_link(&w->fb, header, fb_table(&w->fb, sf, 2, spos));
+  size_t vec = fb_vector(&w->fb, (size_t)nfields, 4, 4 * (size_t)nfields);
+  fb_link(&w->fb, spos[1], vec);
+  for (int i = 0; i < nfields; ++i) {
+    w->types[i] = fields[i].type;
+    fb_link(&w->fb, vec + 4 + 4 * (size_t)i,
+            fb_field(&w->fb, fields[i].name, fields[i].type,
+                     fields[i].nullable));
+  }
+  if (send_message(w, 0) != 0) {
+    arrow_writer_close(w);
+    return NULL;
+  }
+  return w;
+}
+
+/** \brief Nulls among the first n bits of validity (0 if NULL). */
+static int64_t count_nulls(const uint8_t *validity, int64_t n) {
+  if (!validity)
+    return 0;
+  int64_t set = 0, i = 0;
+  for (; i + 8 <= n; i += 8)
+    set += __builtin_popcount(validity[i / 8]);
+  if (i < n)
+    set += __builtin_popcount(validity[i / 8] & ((1u << (n - i)) - 1));
+  return n - set;
+}
+
+int arrow_writer_batch(ArrowWriter *w, int64_t nrows, const ArrowColumn *cols) {
+  if (!w || w->failed || nrows < 0 || nrows > INT32_MAX || (!cols && nrows))
+    return -1;
+  int nnodes = 0;
+  for (int i = 0; i < w->nfields; ++i)
+    nnodes += type_nodes(w->types[i]);
+  int64_t *node = w->words, *buf = node + 2 * nnodes;
+  int nb = 0, nn = 0, niov = 0;
+  struct iovec *body = w->iov + 2;
+  int64_t at = 0;
+#define ADD_BUFFER(ptr, len)                                                   \
+  do {                                                                         \
+    size_t len_ = (size_t)(len);                                               \
+    buf[2 * nb] = at;                                                          \
+    buf[2 * nb + 1] = (int64_t)len_;                                           \
+    ++nb;                                                                      \
+    if (len_) {                                                                \
+      body[niov].iov_base = (void *)(ptr);                                     \
+      body[niov++].iov_len = len_;                                             \
+      if (len_ & 7) {                                                          \
+        body[niov].iov_base = (void *)zeros;                                   \
+        body[niov++].iov_len = 8 - (len_ & 7);                                 \
+      }                                                                        \
+      at += (int64_t)((len_ + 7) & ~(size_t)7);                                \
+    }                                                                          \
+  } while (0)
+  for (int i = 0; i < w->nfields; ++i) {
+    const ArrowColumn *c = &cols[i];
+    ArrowType t = w->types[i];
+    if ((nrows && !c->values && !(t == ARROW_UTF8 || t == ARROW_LIST_INT32)) ||
+        ((t == ARROW_UTF8 || t == ARROW_LIST_INT32) && !c->offsets))
+      return -1;
+    int64_t nulls = count_nulls(c->validity, nrows);
+    node[2 * nn] = nrows;
+    node[2 * nn + 1] = nulls;
+    ++nn;
+    ADD_BUFFER(c->validity, nulls ? (nrows + 7) / 8 : 0);
+    if (t == ARROW_UTF8 || t == ARROW_LIST_INT32) {
+      int64_t items = c->offsets[nrows];
+      if (items < 0 || (items && !c->values))
+        return -1;
+      ADD_BUFFER(c->offsets, 4 * (nrows + 1));
+      if (t == ARROW_LIST_INT32) {
+        node[2 * nn] = items;
+        node[2 * nn + 1] = 0;
+        ++nn;
+        ADD_BUFFER(NULL, 0); /* item validity */
+        ADD_BUFFER(c->values, 4 * items);
+      } else {
+        ADD_BUFFER(c->values, items);
+      }
+    } else {
+      ADD_BUFFER(c->values, (t == ARROW_INT32 ? 4 : 8) * nrows);
+    }
+  }
+#undef ADD_BUFFER
+  size_t header;
+  fb_message(&w->fb, MSG_RECORD_BATCH, at, &header);
+  FbField rf[3] = {{8, (uint64_t)nrows}, {4, 0}, {4, 0}};
+  size_t rpos[3];
+  fb_link(&w->fb, header, fb_table(&w->fb, rf, 3, rpos));
+  size_t v = fb_vector(&w->fb, (size_t)nn, 8, 16 * (size_t)nn);
+  for (int k = 0; k < 2 * nn; ++k)
+    fb_put(&w->fb, v + 4 + 8 * (size_t)k, (uint64_t)node[k], 8);
+  fb_link(&w->fb, rpos[1], v);
+  v = fb_vector(&w->fb, (size_t)nb, 8, 16 * (size_t)nb);
+  for (int k = 0; k < 2 * nb; ++k)
+    fb_put(&w->fb, v + 4 + 8 * (size_t)k, (uint64_t)buf[k], 8);
+  fb_link(&w->fb, rpos[2], v);
+  if (send_message(w, niov) != 0) {
+    w->failed = 1;
+    return -1;
+  }
+  return 0;
+}
+
+int arrow_writer_close(ArrowWriter *w) {
+  if (!w)
+    return -1;
+  int rc = w->failed ? -1 : 0;
+  if (rc == 0) {
+    /* end of stream: continuation marker and a zero length */
+    static const unsigned char eos[8] = {0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0};
+    struct iovec iov = {(void *)eos, sizeof(eos)};
+    rc = write_iov(w, &iov, 1);
+  }
+  free(w->fb.p);
+  free(w->types);
+  free(w->words);
+  free(w->iov);
+  free(w);
+  return rc;
+}
+
+uint64_t arrow_writer_bytes(const ArrowWriter *w) { return w ? w->bytes : 0; }
+
+/* ---------------- change results ---------------- */
+
+static const ArrowField change_fields[ARROW_CHANGE_COLUMNS] = {
+    {"amount", ARROW_INT32, 0},      {"system", ARROW_UTF8, 0},
+    {"strategy", ARROW_UTF8, 0},     {"counts", ARROW_LIST_INT32, 0},
+    {"total_coins", ARROW_INT32, 0}, {"mass_g", ARROW_FLOAT64, 1},
+    {"diameter_mm", ARROW_FLOAT64, 1}, {"area_mm2", ARROW_FLOAT64, 1}};
+
+const ArrowField *arrow_change_fields(void) { return change_fields; }
+
+void arrow_change_init(ArrowChangeBatch *b) {
+  if (b)
+    memset(b, 0, sizeof(*b));
+}
+
+/** \brief Grow *p to hold want elements of size bytes (doubling). */
+static int grow_array(void **p, size_t *cap, size_t want, size_t size) {
+  if (want <= *cap)
+    return 0;
+  size_t c = *cap ? *cap : 256;
+  while (c < want)
+    c *= 2;
+  void *q = realloc(*p, c * size);
+  if (!q)
+    return -1;
+  *p = q;
+  *cap = c;
+  return 0;
+}
+
+/** \brief Grow the per-row arrays to at least want rows. */
+static int grow_rows(ArrowChangeBatch *b, size_t want) {
+  if (want <= b->cap)
+    return 0;
+  size_t c = b->cap ? 2 * b->cap : 256;
+  while (c < want)
+    c *= 2;
+#define GROW(field, count)                                                     \
+  do {                                                                         \
+    void *q_ = realloc(b->field, (count) * sizeof(*b->field));                 \
+    if (!q_)                                                                   \
+      return -1;                                                               \
+    b->field = q_;                                                             \
+  } while (0)
+  GROW(amount, c);
+  GROW(system_offsets, c + 1);
+  GROW(strategy_offsets, c + 1);
+  GROW(count_offsets, c + 1);
+  GROW(total_coins, c);
+  GROW(mass_g, c);
+  GROW(diameter_mm, c);
+  GROW(area_mm2, c);
+  GROW(valid_mass, (c + 7) / 8);
+  GROW(valid_diameter, (c + 7) / 8);
+  GROW(valid_area, (c + 7) / 8);
+#undef GROW
+  if (b->cap == 0)
+    b->system_offsets[0] = b->strategy_offsets[0] = b->count_offsets[0] = 0;
+  b->cap = c;
+  return 0;
+}
+
+/** \brief Append s to a string column ending at row n. */
+static int append_string(int32_t *offsets, char **bytes, size_t *cap,
+                         size_t n, const char *s) {
+  size_t len = strlen(s), used = (size_t)offsets[n];
+  if (used + len > INT32_MAX ||
+      grow_array((void **)bytes, cap, used + len, 1) != 0)
+    return -1;
+  memcpy(*bytes + used, s, len);
+  offsets[n + 1] = (int32_t)(used + len);
+  return 0;
+}
+
+static void set_valid(uint8_t *bits, size_t i, int valid) {
+  if (valid)
+    bits[i / 8] |= (uint8_t)(1u << (i & 7));
+  else
+    bits[i / 8] &= (uint8_t)~(1u << (i & 7));
+}
+
+int arrow_change_append(ArrowChangeBatch *b, const CoinSystem *sys,
+                        int amount, const int *counts, const char *strategy) {
+  if (!b || !sys || !counts || b->n >= INT32_MAX || grow_rows(b, b->n + 1))
+    return -1;
+  size_t n = b->n, items = (size_t)b->count_offsets[n];
+  if (items + sys->ncoins > INT32_MAX ||
+      grow_array((void **)&b->count_items, &b->count_cap,
+                 items + sys->ncoins, sizeof(int32_t)) != 0 ||
+      append_string(b->system_offsets, &b->system_bytes, &b->system_cap, n,
+                    sys->system_name) != 0 ||
+      append_string(b->strategy_offsets, &b->strategy_bytes,
+                    &b->strategy_cap, n, strategy ? strategy : "") != 0)
+    return -1;
+  int32_t total = 0;
+  for (size_t c = 0; c < sys->ncoins; ++c) {
+    b->count_items[items + c] = counts[c];
+    total += counts[c];
+  }
+  b->count_offsets[n + 1] = (int32_t)(items + sys->ncoins);
+  b->amount[n] = amount;
+  b->total_coins[n] = total;
+  double m = total_mass(sys, counts), d = total_diameter(sys, counts);
+  double a = total_area(sys, counts);
+  b->mass_g[n] = m >= 0 ? m : 0.0;
+  b->diameter_mm[n] = d >= 0 ? d : 0.0;
+  b->area_mm2[n] = a >= 0 ? a : 0.0;
+  set_valid(b->valid_mass, n, m >= 0);
+  set_valid(b->valid_diameter, n, d >= 0);
+  set_valid(b->valid_area, n, a >= 0);
+  b->n = n + 1;
+  return 0;
+}
+
+void arrow_change_columns(const ArrowChangeBatch *b, ArrowColumn *cols) {
+  static const int32_t empty_offsets[1] = {0};
+  const int32_t *so = b->cap ? b->system_offsets : empty_offsets;
+  const int32_t *to = b->cap ? b->strategy_offsets : empty_offsets;
+  const int32_t *co = b->cap ? b->count_offsets : empty_offsets;
+  ArrowColumn c[ARROW_CHANGE_COLUMNS] = {
+      {b->amount, NULL, NULL},
+      {b->system_bytes, so, NULL},
+      {b->strategy_bytes, to, NULL},
+      {b->count_items, co, NULL},
+      {b->total_coins, NULL, NULL},
+      {b->mass_g, NULL, b->valid_mass},
+      {b->diameter_mm, NULL, b->valid_diameter},
+      {b->area_mm2, NULL, b->valid_area}};
+  memcpy(cols, c, sizeof(c));
+}
+
+int arrow_change_flush(ArrowWriter *w, ArrowChangeBatch *b) {
+  if (!w || !b)
+    return -1;
+  if (b->n == 0)
+    return 0;
+  ArrowColumn cols[ARROW_CHANGE_COLUMNS];
+  arrow_change_columns(b, cols);
+  int rc = arrow_writer_batch(w, (int64_t)b->n, cols);
+  b->n = 0;
+  return rc;
+}
+
+void arrow_change_free(ArrowChangeBatch *b) {
+  if (!b)
+    return;
+  free(b->amount);
+  free(b->system_offsets);
+  free(b->system_bytes);
+  free(b->strategy_offsets);
+  free(b->strategy_bytes);
+  free(b->count_offsets);
+  free(b->count_items);
+  free(b->total_coins);
+  free(b->mass_g);
+  free(b->diameter_mm);
+  free(b->area_mm2);
+  free(b->valid_mass);
+  free(b->valid_diameter);
+  free(b->valid_area);
+  memset(b, 0, sizeof(*b));
+}
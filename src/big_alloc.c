@@ -0,0 +1,259 @@
+/** \file big_alloc.c
+ *  \brief Huge-page backed mappings with parallel first-touch placement.
+ *
+ *  Mappings are over-allocated by one huge page and trimmed to a 2 MiB
+ *  aligned start, and their length is rounded up to whole huge pages, so
+ *  the kernel can back every part of the block with huge pages. The
+ *  rounding depends only on the requested size, which lets big_free
+ *  recover the mapping length without a header.
+ */
+#define _DEFAULT_SOURCE
+#include "big_alloc.h"
+#include "metrics.h"
+#include "parallel.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#if defined(MAP_ANONYMOUS)
+#define BIG_ALLOC_MMAP 1
+#endif
+#endif
+
+static uint64_t stat_allocs[BIG_ALLOC_KINDS];
+static uint64_t stat_bytes[BIG_ALLOC_KINDS];
+static uint64_t stat_hugetlb_fallbacks;
+static uint64_t stat_first_touched;
+
+const char *big_alloc_kind_name(BigAllocKind kind) {
+  switch (kind) {
+  case BIG_ALLOC_HEAP:
+    return "heap";
+  case BIG_ALLOC_PAGES:
+    return "pages";
+  case BIG_ALLOC_THP:
+    return "thp";
+  case BIG_ALLOC_HUGETLB:
+    return "hugetlb";
+  default:
+    return "unknown";
+  }
+}
+
+int big_alloc_numa_nodes(void) {
+  static int cached;
+  int n = __atomic_load_n(&cached, __ATOMIC_RELAXED);
+  if (n > 0)
+    return n;
+  n = 0;
+  DIR *d = opendir("/sys/devices/system/node");
+  if (d) {
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL)
+      if (strncmp(e->d_name, "node", 4) == 0 && e->d_name[4] >= '0' &&
+          e->d_name[4] <= '9')
+        ++n;
+    closedir(d);
+  }
+  if (n < 1)
+    n = 1;
+  __atomic_store_n(&cached, n, __ATOMIC_RELAXED);
+  return n;
+}
+
+void big_alloc_stats(BigAllocStats *s) {
+  if (!s)
+    return;
+  for (int k = 0; k < BIG_ALLOC_KINDS; ++k) {
+    s->allocs[k] = __atomic_load_n(&stat_allocs[k], __ATOMIC_RELAXED);
+    s->bytes[k] = __atomic_load_n(&stat_bytes[k], __ATOMIC_RELAXED);
+  }
+  s->hugetlb_fallbacks =
+      __atomic_load_n(&stat_hugetlb_fallbacks, __ATOMIC_RELAXED);
+  s->first_touched = __atomic_load_n(&stat_first_touched, __ATOMIC_RELAXED);
+  s->numa_nodes = big_alloc_numa_nodes();
+}
+
+/** \brief Count one block in the process counters and the metrics. */
+static void note_alloc(BigAllocKind kind, size_t bytes) {
+  __atomic_fetch_add(&stat_allocs[kind], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&stat_bytes[kind], (uint64_t)bytes, __ATOMIC_RELAXED);
+  switch (kind) {
+  case BIG_ALLOC_PAGES:
+    METRICS_COUNT("coinsorter_big_alloc_bytes_total", "kind=\"pages\"",
+                  "Bytes of large blocks by page backing", bytes);
+    break;
+  case BIG_ALLOC_THP:
+    METRICS_COUNT("coinsorter_big_alloc_bytes_total", "kind=\"thp\"",
+                  "Bytes of large blocks by page backing", bytes);
+    break;
+  case BIG_ALLOC_HUGETLB:
+    METRICS_COUNT("coinsorter_big_alloc_bytes_total", "kind=\"hugetlb\"",
+                  "Bytes of large blocks by page backing", bytes);
+    break;
+  default:
+    break;
+  }
+}
+
+/* requested page policy */
+enum { WANT_OFF, WANT_THP, WANT_HUGETLB };
+
+static int wanted_pages(void) {
+  const char *env = getenv("COINSORTER_HUGEPAGES");
+  if (env && (strcmp(env, "off") == 0 || strcmp(env, "0") == 0))
+    return WANT_OFF;
+  if (env && strcmp(env, "hugetlb") == 0)
+    return WANT_HUGETLB;
+  return WANT_THP;
+}
+
+static int first_touch_enabled(void) {
+  const char *env = getenv("COINSORTER_FIRST_TOUCH");
+  if (env && *env)
+    return atoi(env) != 0;
+  return big_alloc_numa_nodes() > 1;
+}
+
+#ifdef BIG_ALLOC_MMAP
+/** \brief Whether the kernel honours MADV_HUGEPAGE (THP not "never"). */
+static int thp_available(void) {
+  static int cached = -1;
+  int v = __atomic_load_n(&cached, __ATOMIC_RELAXED);
+  if (v >= 0)
+    return v;
+  v = 0;
+#ifdef MADV_HUGEPAGE
+  FILE *f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+  if (f) {
+    char line[128] = {0};
+    v = fgets(line, sizeof(line), f) && !strstr(line, "[never]");
+    fclose(f);
+  }
+#endif
+  __atomic_store_n(&cached, v, __ATOMIC_RELAXED);
+  return v;
+}
+
+static size_t mapped_length(size_t bytes) {
+  return (bytes + BIG_ALLOC_HUGE_PAGE - 1) & ~(BIG_ALLOC_HUGE_PAGE - 1);
+}
+
+/** \brief Anonymous mapping of len bytes starting on a huge page boundary. */
+static void *map_aligned(size_t len) {
+  size_t span = len + BIG_ALLOC_HUGE_PAGE;
+  void *raw = mmap(NULL, span, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED)
+    return NULL;
+  uintptr_t base = (uintptr_t)raw;
+  uintptr_t start = (base + BIG_ALLOC_HUGE_PAGE - 1) &
+                    ~(uintptr_t)(BIG_ALLOC_HUGE_PAGE - 1);
+  size_t head = start - base, tail = span - head - len;
+  if (head)
+    munmap(raw, head);
+  if (tail)
+    munmap((void *)(start + len), tail);
+  return (void *)start;
+}
+#endif
+
+typedef struct {
+  unsigned char *base;
+  size_t plane_bytes;
+  int planes;
+  int threads;
+} TouchCtx;
+
+/** \brief Zero thread task's share of every plane, faulting it in locally. */
+static void touch_range(void *ctx, int task, int thread) {
+  (void)thread;
+  const TouchCtx *t = (const TouchCtx *)ctx;
+  size_t lo = t->plane_bytes * (size_t)task / (size_t)t->threads;
+  size_t hi = t->plane_bytes * (size_t)(task + 1) / (size_t)t->threads;
+  for (int p = 0; p < t->planes; ++p)
+    memset(t->base + (size_t)p * t->plane_bytes + lo, 0, hi - lo);
+}
+
+void *big_alloc(size_t bytes, int threads, int planes, BigAllocInfo *info) {
+  BigAllocInfo tmp;
+  if (!info)
+    info = &tmp;
+  memset(info, 0, sizeof(*info));
+  info->numa_nodes = big_alloc_numa_nodes();
+  if (bytes == 0)
+    return NULL;
+#ifdef BIG_ALLOC_MMAP
+  if (bytes >= BIG_ALLOC_MIN_BYTES) {
+    size_t len = mapped_length(bytes);
+    int want = wanted_pages();
+    void *p = NULL;
+    BigAllocKind kind = BIG_ALLOC_PAGES;
+#ifdef MAP_HUGETLB
+    if (want == WANT_HUGETLB) {
+      /* hugetlb mappings come out huge page aligned */
+      p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (p == MAP_FAILED)
+        p = NULL;
+      else
+        kind = BIG_ALLOC_HUGETLB;
+    }
+#endif
+    if (!p && want == WANT_HUGETLB)
+      __atomic_fetch_add(&stat_hugetlb_fallbacks, 1, __ATOMIC_RELAXED);
+    if (!p) {
+      p = map_aligned(len);
+      if (!p)
+        return NULL;
+#ifdef MADV_HUGEPAGE
+      if (want != WANT_OFF && thp_available() &&
+          madvise(p, len, MADV_HUGEPAGE) == 0)
+        kind = BIG_ALLOC_THP;
+#endif
+    }
+    info->kind = kind;
+    info->mapped_bytes = len;
+    if (first_touch_enabled()) {
+      if (threads <= 0)
+        threads = parallel_default_threads();
+      if (planes <= 0)
+        planes = 1;
+      TouchCtx t = {(unsigned char *)p, bytes / (size_t)planes, planes,
+                    threads};
+      /* bytes beyond planes * plane_bytes are left to fault in lazily */
+      if (t.plane_bytes > 0) {
+        info->touch_threads = parallel_for(threads, threads, touch_range, &t);
+        __atomic_fetch_add(&stat_first_touched, 1, __ATOMIC_RELAXED);
+      }
+    }
+    note_alloc(kind, bytes);
+    return p;
+  }
+#else
+  (void)threads;
+  (void)planes;
+#endif
+  void *p = calloc(1, bytes);
+  if (!p)
+    return NULL;
+  info->kind = BIG_ALLOC_HEAP;
+  info->mapped_bytes = bytes;
+  note_alloc(BIG_ALLOC_HEAP, bytes);
+  return p;
+}
+
+void big_free(void *p, size_t bytes) {
+  if (!p)
+    return;
+#ifdef BIG_ALLOC_MMAP
+  if (bytes >= BIG_ALLOC_MIN_BYTES) {
+    munmap(p, mapped_length(bytes));
+    return;
+  }
+#endif
+  free(p);
+}
@@ -0,0 +1,615 @@
+/**
+ * \file change_table.c
+ * \brief Streaming construction, queries and mmap files for compressed
+ * change tables.
+ *
+ * Bit streams are arrays of 64-bit words followed by one zero padding word,
+ * so a field that straddles a word boundary is read with two loads and
+ * no branch. File layout: a 64-byte header, the coin values, then the block
+ * directory, count stream and predecessor stream, each 64-byte aligned. The
+ * header checksum (checkpoint_hash) covers the coin values and the
+ * directory; the bit streams are not hashed so that mapping a 10^9-amount
+ * table stays O(1) in I/O, but every directory entry is bounds-checked
+ * against them on load.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "change_table.h"
+#include "big_alloc.h"
+#include "checkpoint.h"
+#include "latency_hist.h"
+#include "metrics.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CT_FILE_MAGIC "CSCHGTB"
+#define CT_FILE_VERSION 1u
+#define CT_FILE_ENDIAN 0x01020304u
+#define CT_FILE_ALIGN 64u
+#define CT_UNREACHABLE UINT32_MAX
+#define CT_FLAG_UNREACHABLE 1u
+
+typedef struct {
+  char magic[8];       /* "CSCHGTB\0" */
+  uint32_t version;    /* CT_FILE_VERSION */
+  uint32_t endian;     /* CT_FILE_ENDIAN as written by the host */
+  uint32_t ncoins;
+  uint32_t last_bits;
+  uint32_t max_amount;
+  uint32_t nblocks;
+  uint64_t counts_words;
+  uint64_t last_words;
+  uint64_t file_bytes;  /* total length including header */
+  uint64_t checksum;    /* checkpoint_hash of coin values and directory */
+} ChangeTableHeader;
+
+typedef char ct_header_is_64_bytes[sizeof(ChangeTableHeader) == 64 ? 1 : -1];
+typedef char ct_block_is_16_bytes[sizeof(ChangeTableBlock) == 16 ? 1 : -1];
+
+/* Directory entry fields packed into ChangeTableBlock.bits. */
+static inline uint64_t blk_offset(const ChangeTableBlock *b) {
+  return b->bits >> 8;
+}
+static inline unsigned blk_width(const ChangeTableBlock *b) {
+  return (unsigned)(b->bits >> 1) & 0x7Fu;
+}
+static inline int blk_unreachable(const ChangeTableBlock *b) {
+  return (int)(b->bits & CT_FLAG_UNREACHABLE);
+}
+
+/** \brief Read a width-bit field (width <= 32) at bit position pos. The
+ * second load hits the padding word for fields ending in the last word. */
+static inline uint32_t bits_get(const uint64_t *w, uint64_t pos,
+                                unsigned width) {
+  uint64_t i = pos >> 6;
+  unsigned off = (unsigned)(pos & 63);
+  uint64_t v = (w[i] >> off) | ((w[i + 1] << 1) << (63 - off));
+  return (uint32_t)(v & ((1ull << width) - 1));
+}
+
+/** \brief OR a width-bit value into a zeroed stream at bit position pos. */
+static inline void bits_put(uint64_t *w, uint64_t pos, unsigned width,
+                            uint32_t v) {
+  if (width == 0)
+    return;
+  uint64_t i = pos >> 6;
+  unsigned off = (unsigned)(pos & 63);
+  w[i] |= (uint64_t)v << off;
+  if (off + width > 64)
+    w[i + 1] |= (uint64_t)v >> (64 - off);
+}
+
+/** \brief Words for a stream of nbits, including the padding word (so the
+ * word after any field start is always in bounds). */
+static inline size_t stream_words(uint64_t nbits) {
+  return (size_t)(nbits >> 6) + 2;
+}
+
+/** \brief Bits needed to represent v (0 for v == 0). */
+static unsigned bit_width(uint32_t v) {
+  return v ? 32u - (unsigned)__builtin_clz(v) : 0u;
+}
+
+/** \brief Amounts stored in block b. */
+static inline unsigned block_len(const ChangeTable *t, size_t b) {
+  size_t rest = (size_t)t->max_amount + 1 - b * CHANGE_TABLE_BLOCK;
+  return rest < CHANGE_TABLE_BLOCK ? (unsigned)rest : CHANGE_TABLE_BLOCK;
+}
+
+/** \brief Encode one block of trend offsets; appends to the count stream. */
+static int encode_block(const uint32_t *vals, unsigned n, uint32_t rank,
+                        uint64_t **counts, size_t *cap_words, uint64_t *nbits,
+                        ChangeTableBlock *out) {
+  uint32_t lo = CT_UNREACHABLE, hi = 0;
+  int unreachable = 0;
+  for (unsigned i = 0; i < n; ++i) {
+    if (vals[i] == CT_UNREACHABLE) {
+      unreachable = 1;
+      continue;
+    }
+    if (vals[i] < lo)
+      lo = vals[i];
+    if (vals[i] > hi)
+      hi = vals[i];
+  }
+  if (lo == CT_UNREACHABLE)
+    lo = hi = 0;
+  /* unreachable amounts use the all-ones code, one above the largest delta */
+  uint32_t span = hi - lo + (uint32_t)unreachable;
+  unsigned width = bit_width(span);
+  uint32_t sentinel = width ? (uint32_t)((1ull << width) - 1) : 0;
+  size_t need = stream_words(*nbits + (uint64_t)width * n);
+  if (need > *cap_words) {
+    size_t cap = *cap_words ? *cap_words : 1024;
+    while (cap < need)
+      cap *= 2;
+    uint64_t *p = (uint64_t *)realloc(*counts, cap * sizeof(uint64_t));
+    if (!p)
+      return -1;
+    memset(p + *cap_words, 0, (cap - *cap_words) * sizeof(uint64_t));
+    *counts = p;
+    *cap_words = cap;
+  }
+  for (unsigned i = 0; i < n; ++i) {
+    uint32_t d = vals[i] == CT_UNREACHABLE ? sentinel : vals[i] - lo;
+    bits_put(*counts, *nbits + (uint64_t)width * i, width, d);
+  }
+  out->bits = *nbits << 8 | (uint64_t)width << 1 |
+              (unreachable ? CT_FLAG_UNREACHABLE : 0u);
+  out->base = lo;
+  out->rank = rank;
+  *nbits += (uint64_t)width * n;
+  return 0;
+}
+
+/** \brief Carve coins, directory and link stream out of one block. */
+static int alloc_storage(ChangeTable *t, size_t ncoins, size_t nblocks,
+                         size_t last_words) {
+  size_t coins_bytes = (ncoins * sizeof(uint32_t) + 15) & ~(size_t)15;
+  size_t bytes = coins_bytes + nblocks * sizeof(ChangeTableBlock) +
+                 last_words * sizeof(uint64_t);
+  unsigned char *p = (unsigned char *)big_alloc(bytes, 1, 1, NULL);
+  if (!p)
+    return -1;
+  METRICS_COUNT("coinsorter_alloc_bytes_total", "site=\"change_table\"",
+                "Bytes allocated by solver tables", bytes);
+  t->storage = p;
+  t->storage_size = bytes;
+  t->coins = (const uint32_t *)p;
+  t->blocks = (const ChangeTableBlock *)(p + coins_bytes);
+  t->last = (const uint64_t *)(p + coins_bytes +
+                               nblocks * sizeof(ChangeTableBlock));
+  return 0;
+}
+
+#define TAG_STATE CHECKPOINT_TAG('S', 'T', 'A', 'T')
+#define TAG_RING CHECKPOINT_TAG('R', 'I', 'N', 'G')
+#define TAG_DIR CHECKPOINT_TAG('D', 'I', 'R', ' ')
+#define TAG_LAST CHECKPOINT_TAG('L', 'A', 'S', 'T')
+#define TAG_COUNTS CHECKPOINT_TAG('C', 'N', 'T', 'S')
+
+/** \brief Build progress at a block boundary. */
+typedef struct {
+  uint64_t block; /* blocks done */
+  uint64_t nbits; /* count stream length */
+  uint64_t rank;  /* reachable amounts so far */
+  uint64_t ring_len;
+} BuildState;
+
+/** \brief Link stream words holding the first nblocks blocks (the last
+ * block may be partial, so this is capped at the stream length). */
+static size_t last_words_done(const ChangeTable *t, size_t nblocks) {
+  uint64_t bits = (uint64_t)nblocks * CHANGE_TABLE_BLOCK * (unsigned)t->last_bits;
+  size_t words = (size_t)((bits + 63) >> 6);
+  return words < t->last_words ? words : t->last_words;
+}
+
+/** \brief Snapshot key: max_amount and the coin values. */
+static uint64_t build_key(const ChangeTable *t) {
+  uint32_t head[2] = {(uint32_t)t->max_amount, (uint32_t)t->ncoins};
+  uint64_t key = checkpoint_hash(CHECKPOINT_HASH_INIT, head, sizeof(head));
+  return checkpoint_hash(key, t->coins, sizeof(uint32_t) * (size_t)t->ncoins);
+}
+
+/** \brief Snapshot the streams written so far. */
+static void build_snapshot(Checkpointer *ck, const ChangeTable *t,
+                           const BuildState *st, const uint32_t *ring,
+                           const uint64_t *counts) {
+  uint64_t key = build_key(t);
+  CheckpointSection sec[6] = {
+      {CHECKPOINT_TAG_KEY, &key, sizeof(key)},
+      {TAG_STATE, st, sizeof(*st)},
+      {TAG_RING, ring, sizeof(uint32_t) * (size_t)st->ring_len},
+      {TAG_DIR, t->blocks, sizeof(ChangeTableBlock) * (size_t)st->block},
+      {TAG_LAST, t->last, sizeof(uint64_t) * last_words_done(t, st->block)},
+      {TAG_COUNTS, counts, counts ? sizeof(uint64_t) * stream_words(st->nbits)
+                                  : 0}};
+  checkpoint_submit(ck, CHECKPOINT_KIND_CHANGE_TABLE, (long)st->block, sec,
+                    6);
+}
+
+/** \brief Restore build progress from ck's snapshot (0 on success). */
+static int build_restore(const Checkpointer *ck, ChangeTable *t,
+                         BuildState *st, uint32_t *ring, size_t ring_len,
+                         uint64_t **counts, size_t *cap_words) {
+  uint64_t key = build_key(t);
+  CheckpointImage img;
+  if (checkpoint_resume(ck, CHECKPOINT_KIND_CHANGE_TABLE, &key, sizeof(key),
+                        &img) != 0)
+    return -1;
+  size_t n[5] = {0};
+  const BuildState *s = (const BuildState *)checkpoint_image_section(
+      &img, TAG_STATE, &n[0]);
+  const void *r = checkpoint_image_section(&img, TAG_RING, &n[1]);
+  const void *d = checkpoint_image_section(&img, TAG_DIR, &n[2]);
+  const void *l = checkpoint_image_section(&img, TAG_LAST, &n[3]);
+  const void *c = checkpoint_image_section(&img, TAG_COUNTS, &n[4]);
+  int ok = s && n[0] == sizeof(*s) && r && d && l && c &&
+           s->block <= t->nblocks && s->ring_len == ring_len &&
+           n[1] == sizeof(uint32_t) * ring_len &&
+           n[2] == sizeof(ChangeTableBlock) * s->block &&
+           n[3] == sizeof(uint64_t) * last_words_done(t, s->block) &&
+           n[4] == (s->block ? sizeof(uint64_t) * stream_words(s->nbits) : 0);
+  if (ok && n[4]) {
+    size_t words = n[4] / sizeof(uint64_t);
+    uint64_t *p = (uint64_t *)calloc(words, sizeof(uint64_t));
+    ok = p != NULL;
+    if (ok) {
+      memcpy(p, c, n[4]);
+      *counts = p;
+      *cap_words = words;
+    }
+  }
+  if (ok) {
+    *st = *s;
+    memcpy(ring, r, n[1]);
+    memcpy((void *)t->blocks, d, n[2]);
+    memcpy((void *)t->last, l, n[3]);
+  }
+  checkpoint_image_free(&img);
+  return ok ? 0 : -1;
+}
+
+/** \brief Streaming DP build, optionally checkpointed at block boundaries. */
+static int build_impl(const CoinSystem *sys, int max_amount, ChangeTable *t,
+                      Checkpointer *ck) {
+  if (!t)
+    return -1;
+  memset(t, 0, sizeof(*t));
+  if (!sys || !sys->coins || sys->ncoins == 0 ||
+      sys->ncoins > CHANGE_TABLE_MAX_COINS || max_amount < 0)
+    return -1;
+  const size_t nc = sys->ncoins;
+  uint32_t vmax = 0;
+  for (size_t c = 0; c < nc; ++c) {
+    if (sys->coins[c].value <= 0)
+      return -1;
+    if ((uint32_t)sys->coins[c].value > vmax)
+      vmax = (uint32_t)sys->coins[c].value;
+  }
+  const uint64_t n = (uint64_t)max_amount + 1;
+  t->max_amount = max_amount;
+  t->ncoins = (int)nc;
+  t->max_coin = (int)vmax;
+  t->last_bits = (int)bit_width((uint32_t)nc - 1);
+  t->nblocks = (size_t)((n + CHANGE_TABLE_BLOCK - 1) / CHANGE_TABLE_BLOCK);
+  t->last_words = stream_words(n * (uint64_t)t->last_bits);
+  if (alloc_storage(t, nc, t->nblocks, t->last_words) != 0)
+    return -1;
+  uint32_t *coins = (uint32_t *)t->storage;
+  ChangeTableBlock *blocks = (ChangeTableBlock *)t->blocks;
+  uint64_t *last = (uint64_t *)t->last;
+  for (size_t c = 0; c < nc; ++c)
+    coins[c] = (uint32_t)sys->coins[c].value;
+
+  /* ring of the most recent counts: best[a - v] for every coin v */
+  size_t ring_len = 1;
+  while (ring_len <= vmax)
+    ring_len <<= 1;
+  const size_t mask = ring_len - 1;
+  uint32_t *ring = (uint32_t *)calloc(ring_len, sizeof(uint32_t));
+  uint64_t *counts = NULL;
+  size_t cap_words = 0;
+  uint64_t nbits = 0;
+  uint32_t vals[CHANGE_TABLE_BLOCK];
+  uint32_t rank = 0;
+  int rc = ring ? 0 : -1;
+  size_t first = 0;
+  BuildState st = {0, 0, 0, ring_len};
+  if (rc == 0 && ck &&
+      build_restore(ck, t, &st, ring, ring_len, &counts, &cap_words) == 0) {
+    first = (size_t)st.block;
+    nbits = st.nbits;
+    rank = (uint32_t)st.rank;
+  }
+  for (size_t b = first; rc == 0 && b < t->nblocks; ++b) {
+    unsigned len = block_len(t, b);
+    uint32_t reached = 0;
+    for (unsigned j = 0; j < len; ++j) {
+      uint32_t a = (uint32_t)(b * CHANGE_TABLE_BLOCK + j);
+      uint32_t best = a == 0 ? 0 : CT_UNREACHABLE;
+      uint32_t li = 0;
+      for (size_t c = 0; c < nc && a; ++c) {
+        uint32_t v = coins[c];
+        if (v > a)
+          continue;
+        uint32_t prev = ring[(a - v) & mask];
+        if (prev != CT_UNREACHABLE && prev + 1 < best) {
+          best = prev + 1;
+          li = (uint32_t)c;
+        }
+      }
+      ring[a & mask] = best;
+      /* offsets from the a / max_coin trend stay small for every block */
+      vals[j] = best == CT_UNREACHABLE ? best : best - a / vmax;
+      reached += best != CT_UNREACHABLE;
+      bits_put(last, (uint64_t)a * (unsigned)t->last_bits,
+               (unsigned)t->last_bits, li);
+    }
+    rc = encode_block(vals, len, rank, &counts, &cap_words, &nbits,
+                      &blocks[b]);
+    rank += reached;
+    if (rc == 0 && ck && b + 1 < t->nblocks &&
+        checkpoint_due(ck, (long)(b + 1))) {
+      BuildState now = {b + 1, nbits, rank, ring_len};
+      build_snapshot(ck, t, &now, ring, counts);
+    }
+  }
+  if (rc == 0 && ck) {
+    BuildState now = {t->nblocks, nbits, rank, ring_len};
+    build_snapshot(ck, t, &now, ring, counts);
+    checkpoint_flush(ck);
+  }
+  free(ring);
+  if (rc != 0) {
+    free(counts);
+    big_free(t->storage, t->storage_size);
+    memset(t, 0, sizeof(*t));
+    return -1;
+  }
+  /* trim to the used words plus the padding word */
+  t->counts_words = stream_words(nbits);
+  uint64_t *trimmed =
+      (uint64_t *)realloc(counts, t->counts_words * sizeof(uint64_t));
+  t->counts = trimmed ? trimmed : counts;
+  return 0;
+}
+
+/** Streaming DP build. */
+int change_table_build(const CoinSystem *sys, int max_amount, ChangeTable *t) {
+  return build_impl(sys, max_amount, t, NULL);
+}
+
+/** Streaming DP build resumable from ck's snapshots. */
+int change_table_build_resume(const CoinSystem *sys, int max_amount,
+                              ChangeTable *t, Checkpointer *ck) {
+  return build_impl(sys, max_amount, t, ck);
+}
+
+void change_table_free(ChangeTable *t) {
+  if (!t)
+    return;
+  if (t->mapping) {
+    munmap(t->mapping, t->mapping_size);
+  } else {
+    big_free(t->storage, t->storage_size);
+    free((void *)t->counts);
+  }
+  memset(t, 0, sizeof(*t));
+}
+
+/** \brief Stored count code of amount a within its block. */
+static inline uint32_t count_code(const ChangeTable *t,
+                                  const ChangeTableBlock *b, uint32_t a) {
+  unsigned w = blk_width(b);
+  return bits_get(t->counts,
+                  blk_offset(b) + (uint64_t)w * (a % CHANGE_TABLE_BLOCK), w);
+}
+
+/** \brief Whether a stored code marks an unreachable amount. */
+static inline int code_unreachable(const ChangeTableBlock *b, uint32_t code) {
+  return blk_unreachable(b) && code == (uint32_t)((1ull << blk_width(b)) - 1);
+}
+
+int change_table_count(const ChangeTable *t, int amount) {
+  if (!t || !t->blocks || amount < 0 || amount > t->max_amount)
+    return -1;
+  const ChangeTableBlock *b = &t->blocks[(uint32_t)amount / CHANGE_TABLE_BLOCK];
+  uint32_t code = count_code(t, b, (uint32_t)amount);
+  return code_unreachable(b, code)
+             ? -1
+             : (int)(b->base + code + (uint32_t)amount / (uint32_t)t->max_coin);
+}
+
+int change_table_last(const ChangeTable *t, int amount) {
+  if (amount == 0 || change_table_count(t, amount) < 0)
+    return -1;
+  unsigned lb = (unsigned)t->last_bits;
+  return (int)bits_get(t->last, (uint64_t)amount * lb, lb);
+}
+
+static int make_change_impl(const ChangeTable *t, int amount, int *counts) {
+  if (!counts || change_table_count(t, amount) < 0)
+    return -1;
+  memset(counts, 0, (size_t)t->ncoins * sizeof(int));
+  unsigned lb = (unsigned)t->last_bits;
+  for (uint32_t a = (uint32_t)amount; a > 0;) {
+    uint32_t idx = bits_get(t->last, (uint64_t)a * lb, lb);
+    if (idx >= (uint32_t)t->ncoins || t->coins[idx] > a)
+      return -1; /* corrupt link stream */
+    counts[idx]++;
+    a -= t->coins[idx];
+  }
+  return 0;
+}
+
+int change_table_make_change(const ChangeTable *t, int amount, int *counts) {
+  LATENCY_PROBED_RETURN(LAT_SOLVER_TABLE, make_change_impl(t, amount, counts));
+}
+
+long change_table_rank(const ChangeTable *t, int amount) {
+  if (!t || !t->blocks || amount < 0)
+    return 0;
+  if (amount > t->max_amount)
+    amount = t->max_amount;
+  uint32_t a = (uint32_t)amount;
+  const ChangeTableBlock *b = &t->blocks[a / CHANGE_TABLE_BLOCK];
+  uint32_t j = a % CHANGE_TABLE_BLOCK;
+  if (!blk_unreachable(b))
+    return (long)b->rank + j + 1;
+  long r = b->rank;
+  for (uint32_t x = a - j; x <= a; ++x)
+    r += !code_unreachable(b, count_code(t, b, x));
+  return r;
+}
+
+int change_table_select(const ChangeTable *t, long k) {
+  if (!t || !t->blocks || k < 0)
+    return -1;
+  /* last block whose rank is <= k */
+  size_t lo = 0, hi = t->nblocks;
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+    if ((long)t->blocks[mid].rank <= k)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  const ChangeTableBlock *b = &t->blocks[lo];
+  uint32_t first = (uint32_t)(lo * CHANGE_TABLE_BLOCK);
+  unsigned len = block_len(t, lo);
+  long want = k - (long)b->rank;
+  if (!blk_unreachable(b))
+    return want < (long)len ? (int)(first + (uint32_t)want) : -1;
+  for (unsigned j = 0; j < len; ++j)
+    if (!code_unreachable(b, count_code(t, b, first + j)) && want-- == 0)
+      return (int)(first + j);
+  return -1;
+}
+
+size_t change_table_bytes(const ChangeTable *t) {
+  if (!t)
+    return 0;
+  return t->nblocks * sizeof(ChangeTableBlock) +
+         (t->counts_words + t->last_words) * sizeof(uint64_t);
+}
+
+/* ---------------- Files ---------------- */
+
+static uint64_t align_up(uint64_t v) {
+  return (v + CT_FILE_ALIGN - 1) & ~(uint64_t)(CT_FILE_ALIGN - 1);
+}
+
+/** \brief Section offsets (coins, directory, counts, links) and file size. */
+static uint64_t file_layout(uint64_t ncoins, uint64_t nblocks,
+                            uint64_t counts_words, uint64_t last_words,
+                            uint64_t off[4]) {
+  off[0] = sizeof(ChangeTableHeader);
+  off[1] = align_up(off[0] + ncoins * sizeof(uint32_t));
+  off[2] = align_up(off[1] + nblocks * sizeof(ChangeTableBlock));
+  off[3] = align_up(off[2] + counts_words * sizeof(uint64_t));
+  return off[3] + last_words * sizeof(uint64_t);
+}
+
+int change_table_save(const ChangeTable *t, const char *path) {
+  if (!t || !t->blocks || !path)
+    return -1;
+  ChangeTableHeader hd;
+  memset(&hd, 0, sizeof(hd));
+  memcpy(hd.magic, CT_FILE_MAGIC, sizeof(CT_FILE_MAGIC));
+  hd.version = CT_FILE_VERSION;
+  hd.endian = CT_FILE_ENDIAN;
+  hd.ncoins = (uint32_t)t->ncoins;
+  hd.last_bits = (uint32_t)t->last_bits;
+  hd.max_amount = (uint32_t)t->max_amount;
+  hd.nblocks = (uint32_t)t->nblocks;
+  hd.counts_words = t->counts_words;
+  hd.last_words = t->last_words;
+  uint64_t off[4];
+  hd.file_bytes = file_layout(hd.ncoins, hd.nblocks, hd.counts_words,
+                              hd.last_words, off);
+  const void *data[4] = {t->coins, t->blocks, t->counts, t->last};
+  const size_t bytes[4] = {t->ncoins * sizeof(uint32_t),
+                           t->nblocks * sizeof(ChangeTableBlock),
+                           t->counts_words * sizeof(uint64_t),
+                           t->last_words * sizeof(uint64_t)};
+  hd.checksum = checkpoint_hash(
+      checkpoint_hash(CHECKPOINT_HASH_INIT, data[0], bytes[0]), data[1],
+      bytes[1]);
+
+  /* header, then each section preceded by its alignment padding */
+  static const unsigned char zeros[CT_FILE_ALIGN] = {0};
+  const void *parts[9] = {&hd};
+  size_t part_bytes[9] = {sizeof(hd)};
+  uint64_t pos = sizeof(hd);
+  for (int s = 0; s < 4; ++s) {
+    parts[1 + 2 * s] = zeros;
+    part_bytes[1 + 2 * s] = (size_t)(off[s] - pos);
+    parts[2 + 2 * s] = data[s];
+    part_bytes[2 + 2 * s] = bytes[s];
+    pos = off[s] + bytes[s];
+  }
+  return checkpoint_write_file(path, parts, part_bytes, 9);
+}
+
+int change_table_load_mmap(ChangeTable *t, const char *path) {
+  if (!t || !path)
+    return -1;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ChangeTableHeader)) {
+    close(fd);
+    return -1;
+  }
+  size_t n = (size_t)st.st_size;
+  void *p = mmap(NULL, n, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return -1;
+  const unsigned char *base = (const unsigned char *)p;
+  ChangeTableHeader hd;
+  memcpy(&hd, base, sizeof(hd));
+  uint64_t off[4] = {0};
+  int ok = memcmp(hd.magic, CT_FILE_MAGIC, sizeof(hd.magic)) == 0 &&
+           hd.version == CT_FILE_VERSION && hd.endian == CT_FILE_ENDIAN &&
+           hd.ncoins > 0 && hd.ncoins <= CHANGE_TABLE_MAX_COINS &&
+           hd.max_amount <= (uint32_t)INT32_MAX &&
+           hd.last_bits == bit_width(hd.ncoins - 1) &&
+           hd.nblocks == ((uint64_t)hd.max_amount + CHANGE_TABLE_BLOCK) /
+                             CHANGE_TABLE_BLOCK &&
+           hd.last_words == stream_words(((uint64_t)hd.max_amount + 1) *
+                                         hd.last_bits) &&
+           hd.counts_words >= 2 && hd.counts_words <= n / 8 &&
+           hd.file_bytes == n &&
+           file_layout(hd.ncoins, hd.nblocks, hd.counts_words, hd.last_words,
+                       off) == n;
+  if (ok) {
+    uint64_t h = checkpoint_hash(CHECKPOINT_HASH_INIT, base + off[0],
+                                 hd.ncoins * sizeof(uint32_t));
+    h = checkpoint_hash(h, base + off[1],
+                        hd.nblocks * sizeof(ChangeTableBlock));
+    ok = h == hd.checksum;
+  }
+  const uint32_t *coins = (const uint32_t *)(base + off[0]);
+  uint32_t vmax = 0;
+  for (uint32_t c = 0; ok && c < hd.ncoins; ++c) {
+    ok = coins[c] > 0;
+    vmax = coins[c] > vmax ? coins[c] : vmax;
+  }
+  /* every block's fields must lie inside the count stream (before padding) */
+  const ChangeTableBlock *blocks = (const ChangeTableBlock *)(base + off[1]);
+  const uint64_t stream_bits = (hd.counts_words - 1) * 64;
+  for (uint32_t b = 0; ok && b < hd.nblocks; ++b) {
+    uint64_t len = (uint64_t)hd.max_amount + 1 - (uint64_t)b * CHANGE_TABLE_BLOCK;
+    if (len > CHANGE_TABLE_BLOCK)
+      len = CHANGE_TABLE_BLOCK;
+    unsigned w = blk_width(&blocks[b]);
+    ok = w <= 32 && blk_offset(&blocks[b]) < stream_bits &&
+         w * len <= stream_bits - blk_offset(&blocks[b]);
+  }
+  if (!ok) {
+    munmap(p, n);
+    return -1;
+  }
+  memset(t, 0, sizeof(*t));
+  t->max_amount = (int)hd.max_amount;
+  t->ncoins = (int)hd.ncoins;
+  t->max_coin = (int)vmax;
+  t->last_bits = (int)hd.last_bits;
+  t->nblocks = hd.nblocks;
+  t->coins = coins;
+  t->blocks = blocks;
+  t->counts = (const uint64_t *)(base + off[2]);
+  t->last = (const uint64_t *)(base + off[3]);
+  t->counts_words = (size_t)hd.counts_words;
+  t->last_words = (size_t)hd.last_words;
+  t->mapping = p;
+  t->mapping_size = n;
+  return 0;
+}
@@ -0,0 +1,422 @@
+/** \file checkpoint.c
+ *  \brief Snapshot files and the background thread that writes them.
+ *
+ *  checkpoint_submit lays the whole file out in one buffer (header and
+ *  sections copied in), so the caller pays one copy of its state; the writer
+ *  thread checksums the buffer and hands it to checkpoint_write_file, which
+ *  writes a temporary file beside path, syncs and renames it over path. Only the newest waiting buffer is kept.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "checkpoint.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef COINSORTER_NO_THREADS
+#include <pthread.h>
+#endif
+
+#define CKPT_MAGIC "CSCKPT"
+#define CKPT_VERSION 1u
+#define CKPT_ENDIAN 0x01020304u
+
+typedef struct {
+  char magic[8];       /* "CSCKPT\0\0" */
+  uint32_t version;    /* CKPT_VERSION */
+  uint32_t endian;     /* CKPT_ENDIAN as written by the host */
+  uint32_t kind;       /* CheckpointKind */
+  uint32_t nsections;
+  int64_t step;
+  uint64_t file_bytes; /* total length including header */
+  uint64_t checksum;   /* checkpoint_hash over bytes [64, file_bytes) */
+  uint64_t reserved[2];
+} CheckpointHeader;
+
+typedef struct {
+  uint32_t tag;
+  uint32_t reserved;
+  uint64_t bytes; /* payload length before padding */
+} CheckpointEntry;
+
+typedef char ckpt_header_is_64_bytes[sizeof(CheckpointHeader) == 64 ? 1 : -1];
+typedef char ckpt_entry_is_16_bytes[sizeof(CheckpointEntry) == 16 ? 1 : -1];
+
+struct Checkpointer {
+  char *path;
+  double interval_s;
+  long every;
+  double last_submit;
+  unsigned char *pending; /* newest snapshot not yet taken by the writer */
+  size_t pending_bytes;
+  int busy;    /* writer is working on a snapshot */
+  int stop;    /* close requested */
+  int last_rc; /* result of the most recent write */
+  CheckpointStats stats;
+#ifndef COINSORTER_NO_THREADS
+  pthread_mutex_t mu;
+  pthread_cond_t wake; /* work or stop for the writer */
+  pthread_cond_t idle; /* writer finished a snapshot */
+  pthread_t thread;
+  int started;
+#endif
+};
+
+uint64_t checkpoint_hash(uint64_t h, const void *data, size_t bytes) {
+  const unsigned char *p = (const unsigned char *)data;
+  size_t i = 0;
+  for (; i + 8 <= bytes; i += 8) {
+    uint64_t w;
+    memcpy(&w, p + i, 8);
+    h ^= w;
+    h *= 1099511628211ull;
+  }
+  for (; i < bytes; ++i) {
+    h ^= p[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static size_t pad8(size_t v) { return (v + 7) & ~(size_t)7; }
+
+int checkpoint_write_file(const char *path, const void *const *parts,
+                          const size_t *bytes, int nparts) {
+  if (!path || nparts < 0 || (nparts > 0 && (!parts || !bytes)))
+    return -1;
+  /* a unique name per writer, so concurrent saves to one path never share
+   * (and truncate) each other's temporary file */
+  size_t plen = strlen(path);
+  char *tmp = (char *)malloc(plen + 8);
+  if (!tmp)
+    return -1;
+  memcpy(tmp, path, plen);
+  memcpy(tmp + plen, ".XXXXXX", 8);
+  int fd = mkstemp(tmp);
+  if (fd < 0) {
+    free(tmp);
+    return -1;
+  }
+  /* mkstemp creates the file 0600; give it the mode a plain create would */
+  int ok = fchmod(fd, 0644) == 0;
+  for (int i = 0; ok && i < nparts; ++i) {
+    const unsigned char *p = (const unsigned char *)parts[i];
+    for (size_t off = 0; ok && off < bytes[i];) {
+      ssize_t w = write(fd, p + off, bytes[i] - off);
+      if (w <= 0)
+        ok = 0;
+      else
+        off += (size_t)w;
+    }
+  }
+  if (ok && fsync(fd) != 0)
+    ok = 0;
+  if (close(fd) != 0)
+    ok = 0;
+  if (ok && rename(tmp, path) != 0)
+    ok = 0;
+  if (!ok)
+    remove(tmp);
+  free(tmp);
+  return ok ? 0 : -1;
+}
+
+/** \brief Checksum the snapshot and write it durably over the target. */
+static int write_snapshot(Checkpointer *ck, unsigned char *buf, size_t n) {
+  CheckpointHeader *hd = (CheckpointHeader *)buf;
+  hd->checksum = checkpoint_hash(CHECKPOINT_HASH_INIT, buf + sizeof(*hd),
+                                 n - sizeof(*hd));
+  const void *part = buf;
+  return checkpoint_write_file(ck->path, &part, &n, 1);
+}
+
+/** \brief Write one snapshot and account for it (called unlocked). */
+static int write_and_count(Checkpointer *ck, unsigned char *buf, size_t n,
+                           double *seconds) {
+  double t0 = now_seconds();
+  int rc = write_snapshot(ck, buf, n);
+  *seconds = now_seconds() - t0;
+  free(buf);
+  return rc;
+}
+
+static void account(Checkpointer *ck, int rc, size_t n, double seconds) {
+  ck->last_rc = rc;
+  ck->stats.write_seconds += seconds;
+  if (rc == 0) {
+    ck->stats.written++;
+    ck->stats.bytes += n;
+  } else {
+    ck->stats.failed++;
+  }
+}
+
+#ifndef COINSORTER_NO_THREADS
+static void *writer_main(void *arg) {
+  Checkpointer *ck = (Checkpointer *)arg;
+  pthread_mutex_lock(&ck->mu);
+  for (;;) {
+    while (!ck->pending && !ck->stop)
+      pthread_cond_wait(&ck->wake, &ck->mu);
+    if (!ck->pending)
+      break; /* stop with nothing left */
+    unsigned char *buf = ck->pending;
+    size_t n = ck->pending_bytes;
+    ck->pending = NULL;
+    ck->busy = 1;
+    pthread_mutex_unlock(&ck->mu);
+    double seconds;
+    int rc = write_and_count(ck, buf, n, &seconds);
+    pthread_mutex_lock(&ck->mu);
+    account(ck, rc, n, seconds);
+    ck->busy = 0;
+    pthread_cond_broadcast(&ck->idle);
+  }
+  pthread_mutex_unlock(&ck->mu);
+  return NULL;
+}
+#endif
+
+Checkpointer *checkpoint_open(const char *path, double interval_s,
+                              long every) {
+  if (!path || !*path)
+    return NULL;
+  Checkpointer *ck = (Checkpointer *)calloc(1, sizeof(*ck));
+  if (!ck)
+    return NULL;
+  size_t plen = strlen(path);
+  ck->path = (char *)malloc(plen + 1);
+  if (!ck->path) {
+    free(ck);
+    return NULL;
+  }
+  memcpy(ck->path, path, plen + 1);
+  ck->interval_s = interval_s;
+  ck->every = every;
+  ck->last_submit = now_seconds();
+#ifndef COINSORTER_NO_THREADS
+  pthread_mutex_init(&ck->mu, NULL);
+  pthread_cond_init(&ck->wake, NULL);
+  pthread_cond_init(&ck->idle, NULL);
+  /* without a writer thread, snapshots are written by the submitter */
+  ck->started = pthread_create(&ck->thread, NULL, writer_main, ck) == 0;
+#endif
+  return ck;
+}
+
+void checkpoint_close(Checkpointer *ck) {
+  if (!ck)
+    return;
+#ifndef COINSORTER_NO_THREADS
+  pthread_mutex_lock(&ck->mu);
+  ck->stop = 1;
+  pthread_cond_signal(&ck->wake);
+  pthread_mutex_unlock(&ck->mu);
+  if (ck->started)
+    pthread_join(ck->thread, NULL);
+  pthread_mutex_destroy(&ck->mu);
+  pthread_cond_destroy(&ck->wake);
+  pthread_cond_destroy(&ck->idle);
+#endif
+  free(ck->pending);
+  free(ck->path);
+  free(ck);
+}
+
+const char *checkpoint_path(const Checkpointer *ck) {
+  return ck ? ck->path : NULL;
+}
+
+int checkpoint_due(Checkpointer *ck, long step) {
+  if (!ck)
+    return 0;
+  if (ck->every > 0 && step % ck->every == 0)
+    return 1;
+  return ck->interval_s > 0 && now_seconds() - ck->last_submit >= ck->interval_s;
+}
+
+int checkpoint_submit(Checkpointer *ck, uint32_t kind, long step,
+                      const CheckpointSection *sections, int n) {
+  if (!ck || n < 0 || (n > 0 && !sections))
+    return -1;
+  size_t total = sizeof(CheckpointHeader);
+  for (int s = 0; s < n; ++s) {
+    if (sections[s].bytes && !sections[s].data)
+      return -1;
+    total += sizeof(CheckpointEntry) + pad8(sections[s].bytes);
+  }
+  unsigned char *buf = (unsigned char *)calloc(1, total);
+  if (!buf)
+    return -1;
+  CheckpointHeader *hd = (CheckpointHeader *)buf;
+  memcpy(hd->magic, CKPT_MAGIC, sizeof(CKPT_MAGIC));
+  hd->version = CKPT_VERSION;
+  hd->endian = CKPT_ENDIAN;
+  hd->kind = kind;
+  hd->nsections = (uint32_t)n;
+  hd->step = step;
+  hd->file_bytes = total;
+  size_t pos = sizeof(*hd);
+  for (int s = 0; s < n; ++s) {
+    CheckpointEntry e = {sections[s].tag, 0, sections[s].bytes};
+    memcpy(buf + pos, &e, sizeof(e));
+    pos += sizeof(e);
+    if (sections[s].bytes)
+      memcpy(buf + pos, sections[s].data, sections[s].bytes);
+    pos += pad8(sections[s].bytes);
+  }
+  ck->last_submit = now_seconds();
+#ifndef COINSORTER_NO_THREADS
+  if (ck->started) {
+    pthread_mutex_lock(&ck->mu);
+    ck->stats.submitted++;
+    if (ck->pending) {
+      free(ck->pending);
+      ck->stats.superseded++;
+    }
+    ck->pending = buf;
+    ck->pending_bytes = total;
+    pthread_cond_signal(&ck->wake);
+    pthread_mutex_unlock(&ck->mu);
+    return 0;
+  }
+#endif
+  ck->stats.submitted++;
+  double seconds;
+  int rc = write_and_count(ck, buf, total, &seconds);
+  account(ck, rc, total, seconds);
+  return rc;
+}
+
+int checkpoint_flush(Checkpointer *ck) {
+  if (!ck)
+    return -1;
+#ifndef COINSORTER_NO_THREADS
+  pthread_mutex_lock(&ck->mu);
+  while (ck->pending || ck->busy)
+    pthread_cond_wait(&ck->idle, &ck->mu);
+  int rc = ck->last_rc;
+  pthread_mutex_unlock(&ck->mu);
+  return rc;
+#else
+  return ck->last_rc;
+#endif
+}
+
+void checkpoint_stats(const Checkpointer *ck, CheckpointStats *s) {
+  if (!ck || !s)
+    return;
+#ifndef COINSORTER_NO_THREADS
+  Checkpointer *w = (Checkpointer *)ck;
+  pthread_mutex_lock(&w->mu);
+  *s = w->stats;
+  pthread_mutex_unlock(&w->mu);
+#else
+  *s = ck->stats;
+#endif
+}
+
+int checkpoint_load(const char *path, CheckpointImage *img) {
+  if (!img)
+    return -1;
+  memset(img, 0, sizeof(*img));
+  if (!path)
+    return -1;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CheckpointHeader)) {
+    close(fd);
+    return -1;
+  }
+  size_t n = (size_t)st.st_size;
+  void *p = mmap(NULL, n, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return -1;
+  const unsigned char *b = (const unsigned char *)p;
+  CheckpointHeader hd;
+  memcpy(&hd, b, sizeof(hd));
+  int ok = memcmp(hd.magic, CKPT_MAGIC, sizeof(CKPT_MAGIC)) == 0 &&
+           hd.version == CKPT_VERSION && hd.endian == CKPT_ENDIAN &&
+           hd.file_bytes == n && hd.step >= 0;
+  /* every entry and payload must lie inside the file */
+  size_t pos = sizeof(hd);
+  for (uint32_t s = 0; ok && s < hd.nsections; ++s) {
+    CheckpointEntry e;
+    ok = n - pos >= sizeof(e);
+    if (ok) {
+      memcpy(&e, b + pos, sizeof(e));
+      pos += sizeof(e);
+      ok = e.bytes <= n - pos && pad8((size_t)e.bytes) <= n - pos;
+      if (ok)
+        pos += pad8((size_t)e.bytes);
+    }
+  }
+  ok = ok && pos == n &&
+       checkpoint_hash(CHECKPOINT_HASH_INIT, b + sizeof(hd),
+                       n - sizeof(hd)) == hd.checksum;
+  if (!ok) {
+    munmap(p, n);
+    return -1;
+  }
+  img->kind = hd.kind;
+  img->step = (long)hd.step;
+  img->nsections = (int)hd.nsections;
+  img->mapping = p;
+  img->mapping_size = n;
+  return 0;
+}
+
+const void *checkpoint_image_section(const CheckpointImage *img, uint32_t tag,
+                                     size_t *bytes) {
+  if (!img || !img->mapping)
+    return NULL;
+  const unsigned char *b = (const unsigned char *)img->mapping;
+  size_t pos = sizeof(CheckpointHeader);
+  for (int s = 0; s < img->nsections; ++s) {
+    CheckpointEntry e;
+    memcpy(&e, b + pos, sizeof(e));
+    pos += sizeof(e);
+    if (e.tag == tag) {
+      if (bytes)
+        *bytes = (size_t)e.bytes;
+      return b + pos;
+    }
+    pos += pad8((size_t)e.bytes);
+  }
+  return NULL;
+}
+
+int checkpoint_resume(const Checkpointer *ck, uint32_t kind, const void *key,
+                      size_t key_bytes, CheckpointImage *img) {
+  if (!ck || !img || checkpoint_load(ck->path, img) != 0)
+    return -1;
+  size_t n = 0;
+  const void *k = checkpoint_image_section(img, CHECKPOINT_TAG_KEY, &n);
+  if (img->kind != kind || !k || n != key_bytes ||
+      (key_bytes && memcmp(k, key, key_bytes) != 0)) {
+    checkpoint_image_free(img);
+    return -1;
+  }
+  return 0;
+}
+
+void checkpoint_image_free(CheckpointImage *img) {
+  if (!img)
+    return;
+  if (img->mapping)
+    munmap(img->mapping, img->mapping_size);
+  memset(img, 0, sizeof(*img));
+}
@@ -0,0 +1,565 @@
+/**
+ * \file coin_acoustics.c
+ * \brief Free-plate modal frequencies, reference ring spectra and batched
+ * spectral matching of drop recordings.
+ */
+#include "coin_acoustics.h"
+#include "fft.h"
+#include "observables.h"
+#include "parallel.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------------------------------------------------------------------- */
+/* Free circular plate                                                      */
+/* ---------------------------------------------------------------------- */
+
+#define LAMBDA_MAX 40.0
+#define LAMBDA_STEP 0.05 /* roots are about pi apart */
+
+/** \brief Modified Bessel function I_n(x) by its power series (all terms
+ * positive, so no cancellation for the x <= LAMBDA_MAX used here). */
+static double bessel_i(int n, double x) {
+  double q = 0.25 * x * x, t = 1.0;
+  for (int k = 1; k <= n; ++k)
+    t *= 0.5 * x / k;
+  double s = t;
+  for (int k = 1; k < 200; ++k) {
+    t *= q / (k * (double)(k + n));
+    s += t;
+    if (t < 1e-17 * s)
+      break;
+  }
+  return s;
+}
+
+/** \brief Free-edge frequency determinant (Leissa, Vibration of Plates,
+ * eq. 2.14) divided by I_n(l), which keeps it O(1) without moving roots:
+ * zero bending moment and zero Kirchhoff shear at the rim. */
+static double free_plate_det(int n, double nu, double l) {
+  double J = jn(n, l), Jp = 0.5 * (jn(n - 1, l) - jn(n + 1, l));
+  double I = bessel_i(n, l);
+  double Ip = 0.5 * (bessel_i(n > 0 ? n - 1 : 1, l) + bessel_i(n + 1, l));
+  double w = 1.0 - nu, nn = (double)n * n;
+  double mj = l * l * J + w * (l * Jp - nn * J);
+  double mi = l * l * I - w * (l * Ip - nn * I);
+  double vj = l * l * l * Jp + w * nn * (l * Jp - J);
+  double vi = l * l * l * Ip - w * nn * (l * Ip - I);
+  return (mj * vi - vj * mi) / I;
+}
+
+/** \brief Up to max elastic roots lambda of order n below lambda_max, in
+ * ascending order. Returns the number found. */
+static int plate_roots(int n, double nu, double lambda_max, double *roots,
+                       int max) {
+  int found = 0;
+  double a = 0.5, fa = free_plate_det(n, nu, a);
+  while (found < max && a < lambda_max) {
+    double b = a + LAMBDA_STEP, fb = free_plate_det(n, nu, b);
+    if ((fa < 0.0) != (fb < 0.0)) {
+      double lo = a, hi = b, flo = fa;
+      for (int it = 0; it < 50; ++it) {
+        double mid = 0.5 * (lo + hi), fm = free_plate_det(n, nu, mid);
+        if ((fm < 0.0) == (flo < 0.0)) {
+          lo = mid;
+          flo = fm;
+        } else {
+          hi = mid;
+        }
+      }
+      roots[found++] = 0.5 * (lo + hi);
+    }
+    a = b;
+    fa = fb;
+  }
+  return found;
+}
+
+/* n = 0 and n = 1 lose their first root to the rigid-body modes */
+static int first_circles(int n) { return n < 2 ? 1 : 0; }
+
+double coin_plate_lambda2(int n, int s, double nu) {
+  if (n < 0 || s < first_circles(n) || !(nu >= 0.0 && nu < 0.5))
+    return -1.0;
+  int idx = s - first_circles(n);
+  double roots[16];
+  if (idx >= 16 || plate_roots(n, nu, LAMBDA_MAX, roots, idx + 1) <= idx)
+    return -1.0;
+  return roots[idx] * roots[idx];
+}
+
+double coin_plate_thickness_mm(const CoinSpec *coin) {
+  const MaterialProperties *mat = coin ? get_material_properties(coin) : NULL;
+  if (!mat || !(coin->diameter_mm > 0.0) || !(mat->density > 0.0))
+    return 0.0;
+  double d = coin->diameter_mm, t = 0.07 * d;
+  if (coin->mass_g > 0.0) {
+    double a = 0.5 * d * 1e-3;
+    t = coin->mass_g * 1e-3 / (mat->density * M_PI * a * a) * 1e3;
+  }
+  return t < 0.04 * d ? 0.04 * d : t > 0.12 * d ? 0.12 * d : t;
+}
+
+static int cmp_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+int coin_ring_modes(const CoinSpec *coin, double thickness_mm,
+                    int n_axisymmetric, int n_asymmetric, CoinMode *modes) {
+  const MaterialProperties *mat = coin ? get_material_properties(coin) : NULL;
+  if (!mat || !modes || n_axisymmetric < 0 || n_asymmetric < 0 ||
+      n_axisymmetric > 16 || n_asymmetric > 16 ||
+      !(coin->diameter_mm > 0.0) || !(mat->density > 0.0) ||
+      !(mat->youngs_modulus > 0.0))
+    return -1;
+  double nu = mat->poissons_ratio;
+  if (!(nu >= 0.0 && nu < 0.5))
+    return -1;
+  double h = (thickness_mm > 0.0 ? thickness_mm
+                                  : coin_plate_thickness_mm(coin)) * 1e-3;
+  double a = 0.5 * coin->diameter_mm * 1e-3;
+  double E = mat->youngs_modulus * 1e9;
+  double D = E * h * h * h / (12.0 * (1.0 - nu * nu));
+  double k = sqrt(D / (mat->density * h)) / (2.0 * M_PI * a * a);
+
+  double roots[16];
+  int got = plate_roots(0, nu, LAMBDA_MAX, roots, n_axisymmetric);
+  if (got < n_axisymmetric)
+    return -1;
+  int count = 0;
+  for (int s = 0; s < got; ++s, ++count) {
+    modes[count].nodal_diameters = 0;
+    modes[count].nodal_circles = s + first_circles(0);
+    modes[count].lambda2 = roots[s] * roots[s];
+  }
+
+  /* asymmetric: lowest roots over n >= 1; stop raising n once its first
+   * root lies above the n_asymmetric-th candidate */
+  double cand[64 * 3];
+  int nc = 0;
+  for (int n = 1; n < 64 && n_asymmetric > 0; ++n) {
+    double r[16];
+    int m = plate_roots(n, nu, LAMBDA_MAX, r, n_asymmetric);
+    if (m == 0)
+      break;
+    if (nc >= n_asymmetric) {
+      double tmp[64 * 3];
+      memcpy(tmp, cand, (size_t)nc * 3 * sizeof(double));
+      qsort(tmp, (size_t)nc, 3 * sizeof(double), cmp_double);
+      if (r[0] > tmp[3 * (n_asymmetric - 1)])
+        break;
+    }
+    for (int s = 0; s < m && nc < 64; ++s, ++nc) {
+      cand[3 * nc] = r[s];
+      cand[3 * nc + 1] = n;
+      cand[3 * nc + 2] = s + first_circles(n);
+    }
+  }
+  qsort(cand, (size_t)nc, 3 * sizeof(double), cmp_double);
+  if (nc < n_asymmetric)
+    return -1;
+  for (int i = 0; i < n_asymmetric; ++i, ++count) {
+    modes[count].nodal_diameters = (int)cand[3 * i + 1];
+    modes[count].nodal_circles = (int)cand[3 * i + 2];
+    modes[count].lambda2 = cand[3 * i] * cand[3 * i];
+  }
+  for (int i = 0; i < count; ++i)
+    modes[i].freq_hz = modes[i].lambda2 * k;
+  return count;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Matcher                                                                  */
+/* ---------------------------------------------------------------------- */
+
+struct AcousticMatcher {
+  AcousticConfig c;
+  int nfreq;           /* fft_size/2 + 1 linear bins */
+  int shifts;          /* searched shifts are -shifts..shifts */
+  double log_step;     /* ln ratio between neighbouring log bins */
+  int *pool_lo;        /* log bin b pools linear bins [pool_lo, pool_hi] */
+  int *pool_hi;
+  FftPlan *plan;
+  size_t nref;
+  int modes_per_ref;
+  const CoinSpec **coin;
+  const CoinSystem **sys;
+  CoinMode *modes;     /* nref * modes_per_ref */
+  float *spec;         /* nref * log_bins, zero mean, unit norm */
+};
+
+void acoustic_default_config(AcousticConfig *c) {
+  if (!c)
+    return;
+  c->sample_rate = 96000.0;
+  c->fft_size = 4096;
+  c->log_bins = 512;
+  c->f_min = 2000.0;
+  c->max_scale = 1.02;
+  c->axisymmetric_modes = 3;
+  c->asymmetric_modes = 5;
+  c->q_factor = 500.0;
+  c->thickness_mm = 0.0;
+  c->threads = 0;
+}
+
+static int valid_config(const AcousticConfig *c) {
+  return c->sample_rate > 0.0 && c->fft_size >= 64 &&
+         (c->fft_size & (c->fft_size - 1)) == 0 && c->log_bins >= 8 &&
+         c->f_min > 0.0 && c->f_min < 0.25 * c->sample_rate &&
+         c->max_scale >= 1.0 && c->max_scale < 2.0 &&
+         c->axisymmetric_modes >= 0 && c->axisymmetric_modes <= 16 &&
+         c->asymmetric_modes >= 0 && c->asymmetric_modes <= 16 &&
+         c->axisymmetric_modes + c->asymmetric_modes > 0 &&
+         c->q_factor > 0.0;
+}
+
+/** \brief Pool a linear magnitude spectrum onto the log axis, compress and
+ * normalize into out[0..log_bins). Returns 0, or -1 if the result is flat. */
+static int log_spectrum(const AcousticMatcher *m, const double *mag,
+                        float *out) {
+  int B = m->c.log_bins;
+  double mean = 0.0;
+  for (int b = 0; b < B; ++b) {
+    double v = 0.0;
+    for (int k = m->pool_lo[b]; k <= m->pool_hi[b]; ++k)
+      v = mag[k] > v ? mag[k] : v;
+    v = sqrt(v);
+    out[b] = (float)v;
+    mean += v;
+  }
+  mean /= B;
+  double norm = 0.0;
+  for (int b = 0; b < B; ++b) {
+    double v = out[b] - mean;
+    norm += v * v;
+  }
+  if (!(norm > 0.0))
+    return -1;
+  double inv = 1.0 / sqrt(norm);
+  for (int b = 0; b < B; ++b)
+    out[b] = (float)((out[b] - mean) * inv);
+  return 0;
+}
+
+/** \brief Linear magnitude spectrum of a ring with the given modes: one
+ * Lorentzian per mode of half-width f/(2Q), widened to the frame's bin
+ * spacing, with height 1/width like a long decay seen through the FFT. */
+static void reference_magnitude(const AcousticMatcher *m, const CoinMode *md,
+                                int nmodes, double *mag) {
+  double df = m->c.sample_rate / m->c.fft_size;
+  for (int k = 0; k < m->nfreq; ++k)
+    mag[k] = 0.0;
+  for (int i = 0; i < nmodes; ++i) {
+    double f = md[i].freq_hz;
+    if (!(f < 0.5 * m->c.sample_rate))
+      continue;
+    double g = hypot(f / (2.0 * m->c.q_factor), df);
+    for (int k = 0; k < m->nfreq; ++k) {
+      double u = (k * df - f) / g;
+      mag[k] += 1.0 / (g * sqrt(1.0 + u * u));
+    }
+  }
+}
+
+static int build_axis(AcousticMatcher *m) {
+  int B = m->c.log_bins, N = m->c.fft_size;
+  double nyq = 0.5 * m->c.sample_rate, df = m->c.sample_rate / N;
+  m->log_step = log(nyq / m->c.f_min) / B;
+  m->shifts = (int)ceil(log(m->c.max_scale) / m->log_step - 1e-9);
+  if (m->shifts > 64)
+    return -1;
+  m->pool_lo = (int *)malloc(2 * (size_t)B * sizeof(int));
+  if (!m->pool_lo)
+    return -1;
+  m->pool_hi = m->pool_lo + B;
+  for (int b = 0; b < B; ++b) {
+    double lo = m->c.f_min * exp(b * m->log_step);
+    double hi = m->c.f_min * exp((b + 1) * m->log_step);
+    int klo = (int)ceil(lo / df), khi = (int)ceil(hi / df) - 1;
+    if (khi < klo) /* narrower than a linear bin: nearest one */
+      klo = khi = (int)floor(sqrt(lo * hi) / df + 0.5);
+    m->pool_lo[b] = klo < m->nfreq - 1 ? klo : m->nfreq - 1;
+    m->pool_hi[b] = khi < m->nfreq - 1 ? khi : m->nfreq - 1;
+  }
+  return 0;
+}
+
+AcousticMatcher *acoustic_matcher_create(const AcousticConfig *c) {
+  AcousticConfig def;
+  if (!c) {
+    acoustic_default_config(&def);
+    c = &def;
+  }
+  if (!valid_config(c))
+    return NULL;
+  AcousticMatcher *m = (AcousticMatcher *)calloc(1, sizeof(AcousticMatcher));
+  if (!m)
+    return NULL;
+  m->c = *c;
+  m->nfreq = c->fft_size / 2 + 1;
+  m->modes_per_ref = c->axisymmetric_modes + c->asymmetric_modes;
+  size_t total = 0;
+  for (size_t s = 0; s < coin_system_count(); ++s)
+    total += get_coin_system_by_index(s)->ncoins;
+  m->coin = (const CoinSpec **)malloc(total * sizeof(*m->coin));
+  m->sys = (const CoinSystem **)malloc(total * sizeof(*m->sys));
+  m->modes = (CoinMode *)malloc(total * m->modes_per_ref * sizeof(CoinMode));
+  m->spec = (float *)malloc(total * c->log_bins * sizeof(float));
+  double *mag = (double *)malloc((size_t)m->nfreq * sizeof(double));
+  m->plan = fft_plan_create((size_t)c->fft_size);
+  if (!m->coin || !m->sys || !m->modes || !m->spec || !mag || !m->plan ||
+      build_axis(m) != 0) {
+    free(mag);
+    acoustic_matcher_destroy(m);
+    return NULL;
+  }
+  for (size_t s = 0; s < coin_system_count(); ++s) {
+    const CoinSystem *sys = get_coin_system_by_index(s);
+    for (size_t i = 0; i < sys->ncoins; ++i) {
+      CoinMode *md = m->modes + m->nref * m->modes_per_ref;
+      if (coin_ring_modes(&sys->coins[i], c->thickness_mm,
+                          c->axisymmetric_modes, c->asymmetric_modes,
+                          md) != m->modes_per_ref)
+        continue;
+      reference_magnitude(m, md, m->modes_per_ref, mag);
+      if (log_spectrum(m, mag, m->spec + m->nref * c->log_bins) != 0)
+        continue; /* no mode inside the band */
+      m->coin[m->nref] = &sys->coins[i];
+      m->sys[m->nref] = sys;
+      m->nref++;
+    }
+  }
+  free(mag);
+  return m;
+}
+
+void acoustic_matcher_destroy(AcousticMatcher *m) {
+  if (!m)
+    return;
+  free(m->pool_lo);
+  fft_plan_destroy(m->plan);
+  free(m->coin);
+  free(m->sys);
+  free(m->modes);
+  free(m->spec);
+  free(m);
+}
+
+size_t acoustic_reference_count(const AcousticMatcher *m) {
+  return m ? m->nref : 0;
+}
+
+const CoinSpec *acoustic_reference_coin(const AcousticMatcher *m, size_t i,
+                                        const CoinSystem **sys) {
+  if (!m || i >= m->nref)
+    return NULL;
+  if (sys)
+    *sys = m->sys[i];
+  return m->coin[i];
+}
+
+int acoustic_reference_modes(const AcousticMatcher *m, size_t i,
+                             const CoinMode **modes) {
+  if (!m || i >= m->nref)
+    return 0;
+  if (modes)
+    *modes = m->modes + i * m->modes_per_ref;
+  return m->modes_per_ref;
+}
+
+const float *acoustic_reference_spectrum(const AcousticMatcher *m, size_t i) {
+  return m && i < m->nref ? m->spec + i * m->c.log_bins : NULL;
+}
+
+double acoustic_bin_frequency(const AcousticMatcher *m, int b) {
+  return m ? m->c.f_min * exp((b + 0.5) * m->log_step) : 0.0;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Synthesis                                                                */
+/* ---------------------------------------------------------------------- */
+
+static inline uint64_t splitmix64(uint64_t *s) {
+  uint64_t z = (*s += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+static inline double unit(uint64_t *s) {
+  return (double)(splitmix64(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+int acoustic_synthesize(const AcousticMatcher *m, size_t ref, double scale,
+                        double noise, unsigned seed, double *signal,
+                        size_t n) {
+  if (!m || ref >= m->nref || !signal || !(scale > 0.0) || !(noise >= 0.0))
+    return -1;
+  uint64_t s = ((uint64_t)seed << 32) ^ (uint64_t)ref;
+  double dt = 1.0 / m->c.sample_rate;
+  memset(signal, 0, n * sizeof(double));
+  const CoinMode *md = m->modes + ref * m->modes_per_ref;
+  for (int i = 0; i < m->modes_per_ref; ++i) {
+    double f = md[i].freq_hz * scale;
+    double amp = 0.5 + 0.5 * unit(&s), phase = 2.0 * M_PI * unit(&s);
+    if (!(f < 0.5 * m->c.sample_rate))
+      continue;
+    /* rotate amp e^{i phase} by e^{(-alpha + i w) dt} each sample */
+    double decay = exp(-M_PI * f / m->c.q_factor * dt);
+    double cr = decay * cos(2.0 * M_PI * f * dt);
+    double ci = decay * sin(2.0 * M_PI * f * dt);
+    double zr = amp * cos(phase), zi = amp * sin(phase);
+    for (size_t t = 0; t < n; ++t) {
+      signal[t] += zi;
+      double r = zr * cr - zi * ci;
+      zi = zr * ci + zi * cr;
+      zr = r;
+    }
+  }
+  if (noise > 0.0)
+    for (size_t t = 0; t < n; t += 2) {
+      double u1 = unit(&s), u2 = unit(&s);
+      double r = noise * sqrt(-2.0 * log(u1 > 0.0 ? u1 : 1e-300));
+      signal[t] += r * cos(2.0 * M_PI * u2);
+      if (t + 1 < n)
+        signal[t + 1] += r * sin(2.0 * M_PI * u2);
+    }
+  return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Batched matching                                                         */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+  const AcousticMatcher *m;
+  const double *signals;
+  size_t count, stride, len;
+  AcousticMatch *out;
+  double *work; /* per thread: re, im (fft_size each), mag1, mag2 (nfreq) */
+  float *obs;   /* per thread: log_bins + 2*shifts, zero-padded */
+} MatchCtx;
+
+static void load_frame(const MatchCtx *c, size_t i, double *dst) {
+  size_t N = (size_t)c->m->c.fft_size, len = c->len < N ? c->len : N;
+  if (i < c->count) {
+    memcpy(dst, c->signals + i * c->stride, len * sizeof(double));
+    memset(dst + len, 0, (N - len) * sizeof(double));
+  } else {
+    memset(dst, 0, N * sizeof(double));
+  }
+}
+
+/* ranking discount per bin of shift: near-ties go to the smaller scaling,
+ * as a drop is more likely the nominal coin than a scaled neighbour */
+#define SHIFT_DISCOUNT 0.002
+
+/** \brief Score one log spectrum (in obs + shifts) against every
+ * reference at every shift. */
+static void score_frame(const AcousticMatcher *m, const float *obs,
+                        AcousticMatch *out) {
+  int B = m->c.log_bins, S = m->shifts, W = 2 * S + 1;
+  long best = -1, second = -1;
+  double bs = -2.0, ss = -2.0, braw = 0.0, sraw = 0.0;
+  int bshift = 0;
+  float acc[2 * 64 + 1];
+  for (size_t r = 0; r < m->nref; ++r) {
+    const float *ref = m->spec + r * B;
+    /* all shifts at once: the inner loop runs along the shifts, so it
+     * vectorizes without reassociating a sum */
+    for (int w = 0; w < W; ++w)
+      acc[w] = 0.0f;
+    for (int b = 0; b < B; ++b) {
+      float v = ref[b];
+      const float *o = obs + b;
+      for (int w = 0; w < W; ++w)
+        acc[w] += v * o[w];
+    }
+    double rbest = -2.0, rraw = 0.0;
+    int rshift = 0;
+    for (int w = 0; w < W; ++w) {
+      int sh = w - S;
+      double ranked = acc[w] * (1.0 - SHIFT_DISCOUNT * abs(sh));
+      if (ranked > rbest) {
+        rbest = ranked;
+        rraw = acc[w];
+        rshift = sh;
+      }
+    }
+    if (rbest > bs) {
+      second = best;
+      ss = bs;
+      sraw = braw;
+      best = (long)r;
+      bs = rbest;
+      braw = rraw;
+      bshift = rshift;
+    } else if (rbest > ss) {
+      second = (long)r;
+      ss = rbest;
+      sraw = rraw;
+    }
+  }
+  out->ref = best;
+  out->score = best >= 0 ? braw : 0.0;
+  out->scale = exp(bshift * m->log_step);
+  out->runner_up = second;
+  out->runner_score = second >= 0 ? sraw : 0.0;
+}
+
+static void match_pair(void *ctx, int task, int thread) {
+  MatchCtx *c = (MatchCtx *)ctx;
+  const AcousticMatcher *m = c->m;
+  size_t N = (size_t)m->c.fft_size, nf = (size_t)m->nfreq;
+  int B = m->c.log_bins, S = m->shifts;
+  double *re = c->work + (size_t)thread * (2 * N + 2 * nf);
+  double *im = re + N, *mag1 = im + N, *mag2 = mag1 + nf;
+  float *obs = c->obs + (size_t)thread * (B + 2 * S);
+  size_t i = 2 * (size_t)task;
+  load_frame(c, i, re);
+  load_frame(c, i + 1, im);
+  fft_real_pair(m->plan, re, im, mag1, i + 1 < c->count ? mag2 : NULL);
+  for (size_t j = i; j < i + 2 && j < c->count; ++j) {
+    if (log_spectrum(m, j == i ? mag1 : mag2, obs + S) != 0 || m->nref == 0) {
+      memset(&c->out[j], 0, sizeof(AcousticMatch));
+      c->out[j].ref = c->out[j].runner_up = -1;
+      c->out[j].scale = 1.0;
+      continue;
+    }
+    score_frame(m, obs, &c->out[j]);
+  }
+}
+
+int acoustic_match_batch(const AcousticMatcher *m, const double *signals,
+                         size_t count, size_t stride, size_t len,
+                         AcousticMatch *out) {
+  if (!m || !out || (count > 0 && (!signals || len == 0)) ||
+      (count > 1 && stride < len))
+    return -1;
+  if (count == 0)
+    return 0;
+  size_t pairs = (count + 1) / 2;
+  if (pairs > (size_t)2147483647)
+    return -1;
+  int nt = m->c.threads > 0 ? m->c.threads : parallel_default_threads();
+  nt = nt > 256 ? 256 : nt;
+  nt = (size_t)nt > pairs ? (int)pairs : nt;
+  size_t N = (size_t)m->c.fft_size, nf = (size_t)m->nfreq;
+  size_t olen = (size_t)m->c.log_bins + 2 * (size_t)m->shifts;
+  MatchCtx c = {m, signals, count, stride, len, out, NULL, NULL};
+  c.work = (double *)malloc((size_t)nt * (2 * N + 2 * nf) * sizeof(double));
+  c.obs = (float *)calloc((size_t)nt * olen, sizeof(float));
+  if (!c.work || !c.obs) {
+    free(c.work);
+    free(c.obs);
+    return -1;
+  }
+  parallel_for((int)pairs, nt, match_pair, &c);
+  free(c.work);
+  free(c.obs);
+  return 0;
+}
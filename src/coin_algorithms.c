@@ -3,7 +3,10 @@
  * \brief Implementations for coin change algorithms, objective-weighted DP,
  * canonical audit, and JSON formatting.
  */
+#include "big_alloc.h"
 #include "coins.h"
+#include "latency_hist.h"
+#include "metrics.h"
 #include <limits.h>
 #include <math.h>
 #include <stdio.h>
@@ -13,7 +16,8 @@
 /* ---------------- Algorithms Implementation ---------------- */
 
 /** \brief Greedy change-making (descending coin order). */
-int greedy_make_change(const CoinSystem *sys, int amount, int *counts) {
+static int greedy_make_change_impl(const CoinSystem *sys, int amount,
+                                   int *counts) {
   for (size_t i = 0; i < sys->ncoins; ++i) {
     counts[i] = amount / sys->coins[i].value;
     amount -= counts[i] * sys->coins[i].value;
@@ -21,17 +25,41 @@ int greedy_make_change(const CoinSystem *sys, int amount, int *counts) {
   return amount == 0 ? 0 : -1;
 }
 
+int greedy_make_change(const CoinSystem *sys, int amount, int *counts) {
+  LATENCY_PROBED_RETURN(LAT_SOLVER_GREEDY,
+                        greedy_make_change_impl(sys, amount, counts));
+}
+
+/** \brief Count one DP table (bytes, cells visited) in the metrics. */
+static void note_dp_table(int weighted, size_t bytes, size_t cells) {
+  if (!metrics_enabled())
+    return;
+  if (weighted)
+    METRICS_COUNT("coinsorter_alloc_bytes_total", "site=\"dp_opt\"",
+                  "Bytes allocated by solver tables", bytes);
+  else
+    METRICS_COUNT("coinsorter_alloc_bytes_total", "site=\"dp\"",
+                  "Bytes allocated by solver tables", bytes);
+  METRICS_COUNT("coinsorter_dp_cells_total", NULL,
+                "DP cells (amount x coin) evaluated", cells);
+  METRICS_HIGH_WATER("coinsorter_dp_table_max_bytes", NULL,
+                     "Largest single DP table", bytes);
+}
+
 /** \brief Optimal (minimum coin count) dynamic programming solver. */
-int dp_make_change(const CoinSystem *sys, int amount, int *counts) {
+static int dp_make_change_impl(const CoinSystem *sys, int amount,
+                               int *counts) {
   if (amount < 0)
     return -1;
   int maxC = amount + 1;
-  int *best = (int *)malloc((amount + 1) * sizeof(int));
-  unsigned short *last =
-      (unsigned short *)malloc((amount + 1) * sizeof(unsigned short));
+  /* the sweep is serial, so the tables are placed for one thread */
+  size_t best_bytes = (size_t)(amount + 1) * sizeof(int);
+  size_t last_bytes = (size_t)(amount + 1) * sizeof(unsigned short);
+  int *best = (int *)big_alloc(best_bytes, 1, 1, NULL);
+  unsigned short *last = (unsigned short *)big_alloc(last_bytes, 1, 1, NULL);
   if (!best || !last) {
-    free(best);
-    free(last);
+    big_free(best, best_bytes);
+    big_free(last, last_bytes);
     return -1;
   }
   for (int a = 0; a <= amount; ++a) {
@@ -39,6 +67,8 @@ int dp_make_change(const CoinSystem *sys, int amount, int *counts) {
     last[a] = USHRT_MAX;
   }
   best[0] = 0;
+  note_dp_table(0, (size_t)(amount + 1) * (sizeof(int) + sizeof(short)),
+                (size_t)amount * sys->ncoins);
   for (int a = 1; a <= amount; ++a) {
     for (size_t i = 0; i < sys->ncoins; ++i) {
       int v = sys->coins[i].value;
@@ -49,8 +79,8 @@ int dp_make_change(const CoinSystem *sys, int amount, int *counts) {
     }
   }
   if (best[amount] >= maxC) {
-    free(best);
-    free(last);
+    big_free(best, best_bytes);
+    big_free(last, last_bytes);
     return -1;
   }
   memset(counts, 0, sys->ncoins * sizeof(int));
@@ -61,11 +91,16 @@ int dp_make_change(const CoinSystem *sys, int amount, int *counts) {
     counts[idx]++;
     a -= sys->coins[idx].value;
   }
-  free(best);
-  free(last);
+  big_free(best, best_bytes);
+  big_free(last, last_bytes);
   return 0;
 }
 
+int dp_make_change(const CoinSystem *sys, int amount, int *counts) {
+  LATENCY_PROBED_RETURN(LAT_SOLVER_DP,
+                        dp_make_change_impl(sys, amount, counts));
+}
+
 /** \brief Test if system is canonical (greedy == optimal up to bound).
  *  \param search_limit Optional limit; if 0 derive from product of top two
  * values.
@@ -202,19 +237,35 @@ double total_area(const CoinSystem *sys, const int *counts) {
   return have ? sum : -1.0;
 }
 
+/** \brief Per-coin objective weight with fallback of 1. */
+double coin_weight(const CoinSpec *coin, OptimizeMode mode) {
+  double w;
+  if (mode == OPT_MASS)
+    w = coin->mass_g;
+  else if (mode == OPT_DIAMETER)
+    w = coin->diameter_mm;
+  else if (mode == OPT_AREA) {
+    double d = coin->diameter_mm;
+    w = (d > 0) ? (M_PI * 0.25 * d * d) : 0; /* area */
+  } else
+    w = 1.0;
+  return w > 0 ? w : 1.0; /* fallback weight */
+}
+
 /** \brief Multi-objective DP optimizing weighted sum (mass or diameter) with
  * coin-count tie break. Fallback weights of 1 if metadata missing.
  */
-int dp_make_change_opt(const CoinSystem *sys, int amount, int *counts,
-                       OptimizeMode mode) {
+static int dp_make_change_opt_impl(const CoinSystem *sys, int amount,
+                                   int *counts, OptimizeMode mode) {
   if (mode == OPT_COUNT)
-    return dp_make_change(sys, amount, counts);
+    return dp_make_change_impl(sys, amount, counts);
   typedef struct {
     double primary;
     int coins;
     int last;
   } Cell;
-  Cell *dp = (Cell *)malloc((amount + 1) * sizeof(Cell));
+  size_t dp_bytes = (size_t)(amount + 1) * sizeof(Cell);
+  Cell *dp = (Cell *)big_alloc(dp_bytes, 1, 1, NULL);
   if (!dp)
     return -1;
   for (int a = 0; a <= amount; ++a) {
@@ -225,21 +276,13 @@ int dp_make_change_opt(const CoinSystem *sys, int amount, int *counts,
   dp[0].primary = 0;
   dp[0].coins = 0;
   dp[0].last = -2;
+  note_dp_table(1, (size_t)(amount + 1) * sizeof(Cell),
+                (size_t)amount * sys->ncoins);
   for (int a = 1; a <= amount; ++a) {
     for (size_t i = 0; i < sys->ncoins; ++i) {
       int v = sys->coins[i].value;
       if (v <= a && dp[a - v].last != -3) {
-        double w;
-        if (mode == OPT_MASS)
-          w = sys->coins[i].mass_g;
-        else if (mode == OPT_DIAMETER)
-          w = sys->coins[i].diameter_mm;
-        else /* OPT_AREA */ {
-          double d = sys->coins[i].diameter_mm;
-          w = (d > 0) ? (M_PI * 0.25 * d * d) : 0; /* area */
-        }
-        if (w <= 0)
-          w = 1.0; /* fallback weight */
+        double w = coin_weight(&sys->coins[i], mode);
         double cand_p = dp[a - v].primary + w;
         int cand_c = dp[a - v].coins + 1;
         int better = 0;
@@ -258,7 +301,7 @@ int dp_make_change_opt(const CoinSystem *sys, int amount, int *counts,
       dp[a].last = -3; /* unreachable */
   }
   if (dp[amount].last < 0) {
-    free(dp);
+    big_free(dp, dp_bytes);
     return -1;
   }
   memset(counts, 0, sys->ncoins * sizeof(int));
@@ -267,6 +310,12 @@ int dp_make_change_opt(const CoinSystem *sys, int amount, int *counts,
     counts[idx]++;
     a -= sys->coins[idx].value;
   }
-  free(dp);
+  big_free(dp, dp_bytes);
   return 0;
 }
+
+int dp_make_change_opt(const CoinSystem *sys, int amount, int *counts,
+                       OptimizeMode mode) {
+  LATENCY_PROBED_RETURN(LAT_SOLVER_DP_OPT,
+                        dp_make_change_opt_impl(sys, amount, counts, mode));
+}
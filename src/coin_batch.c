@@ -0,0 +1,185 @@
+/** \file coin_batch.c
+ *  \brief Batched greedy change making with multiply-shift division.
+ *
+ *  Every denomination d gets a Granlund–Montgomery reciprocal: for amounts
+ *  below 2^31, floor(x / d) == (x * m) >> s with l = ceil(log2 d),
+ *  m = ceil(2^(31+l) / d) and s = 31 + l, so the per-coin division becomes a
+ *  32x32->64 multiply and a shift. The AVX2 path (picked at run time) keeps
+ *  64 amounts in flight (eight 8-lane vectors), using vpmuludq on even and
+ *  odd lanes separately.
+ */
+#include "coins.h"
+#include "cpu_features.h"
+#include "latency_hist.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
+
+/* Independent 8-lane vectors per iteration: the quotient/remainder chain is
+ * latency bound, so several amounts groups are interleaved to fill the
+ * pipeline. */
+#define BATCH_VECS 8
+#define BATCH_LANES (8 * BATCH_VECS)
+/* Outputs at least this large are written with non-temporal stores. */
+#define BATCH_STREAM_BYTES ((size_t)8 << 20)
+
+typedef struct {
+  uint32_t d; /* divisor */
+  uint32_t m; /* multiplier */
+  uint32_t s; /* shift (31 + ceil(log2 d)) */
+} Reciprocal;
+
+/** \brief Precompute the reciprocal of d (> 0). */
+static void reciprocal_init(uint32_t d, Reciprocal *r) {
+  uint32_t l = 0;
+  while (l < 31 && (1u << l) < d)
+    ++l;
+  r->d = d;
+  r->s = 31 + l;
+  r->m = (uint32_t)(((1ull << r->s) + d - 1) / d);
+}
+
+/** \brief floor(x / r->d) for x < 2^31. */
+static inline uint32_t reciprocal_div(uint32_t x, const Reciprocal *r) {
+  return (uint32_t)(((uint64_t)x * r->m) >> r->s);
+}
+
+#if defined(CPU_X86)
+/** \brief Eight lane-wise quotients: even and odd 32-bit lanes are widened
+ * separately by vpmuludq and recombined with a blend. */
+CPU_TARGET("avx2")
+static inline __m256i div8(__m256i x, __m256i m, __m128i sh) {
+  __m256i even = _mm256_srl_epi64(_mm256_mul_epu32(x, m), sh);
+  __m256i odd =
+      _mm256_srl_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), m), sh);
+  return _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+}
+
+/** \brief Count lanes of x that are non-zero. */
+CPU_TARGET("avx2")
+static inline int nonzero_lanes(__m256i x) {
+  __m256i z = _mm256_cmpeq_epi32(x, _mm256_setzero_si256());
+  return 8 - __builtin_popcount(
+                 (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(z)));
+}
+
+/** \brief Store eight counts, bypassing the caches when stream is set. */
+CPU_TARGET("avx2")
+static inline void store8(int *out, __m256i v, int stream) {
+  if (stream)
+    _mm256_stream_si256((__m256i *)out, v);
+  else
+    _mm256_storeu_si256((__m256i *)out, v);
+}
+
+/** \brief AVX2 part of the batch: whole groups of BATCH_LANES amounts.
+ *  Adds unpayable amounts to *inexact; returns the amounts done. */
+CPU_TARGET("avx2")
+static size_t greedy_batch_avx2(const Reciprocal *rc, size_t nc,
+                                const int *amounts, size_t n, int *counts_out,
+                                int *inexact) {
+  size_t i = 0;
+  const __m256i zero = _mm256_setzero_si256();
+  /* outputs far larger than the caches skip the read-for-ownership of
+   * their lines when every row is 32-byte aligned */
+  const int stream = n * nc * sizeof(int) >= BATCH_STREAM_BYTES &&
+                     ((uintptr_t)counts_out & 31) == 0 && (n & 7) == 0;
+  for (; i + BATCH_LANES <= n; i += BATCH_LANES) {
+    __m256i x[BATCH_VECS], neg[BATCH_VECS];
+    for (int v = 0; v < BATCH_VECS; ++v) {
+      x[v] = _mm256_loadu_si256((const __m256i *)(amounts + i + 8 * v));
+      /* negative amounts are unpayable: zero counts, flagged below */
+      neg[v] = _mm256_cmpgt_epi32(zero, x[v]);
+      x[v] = _mm256_andnot_si256(neg[v], x[v]);
+    }
+    for (size_t c = 0; c < nc; ++c) {
+      int *out = counts_out + c * n + i;
+      if (rc[c].d == 1) { /* unit coin takes the whole remainder */
+        for (int v = 0; v < BATCH_VECS; ++v) {
+          store8(out + 8 * v, x[v], stream);
+          x[v] = zero;
+        }
+        continue;
+      }
+      const __m256i m = _mm256_set1_epi32((int)rc[c].m);
+      const __m256i d = _mm256_set1_epi32((int)rc[c].d);
+      const __m128i sh = _mm_cvtsi32_si128((int)rc[c].s);
+      for (int v = 0; v < BATCH_VECS; ++v) {
+        __m256i q = div8(x[v], m, sh);
+        store8(out + 8 * v, q, stream);
+        x[v] = _mm256_sub_epi32(x[v], _mm256_mullo_epi32(q, d));
+      }
+    }
+    for (int v = 0; v < BATCH_VECS; ++v)
+      *inexact += nonzero_lanes(_mm256_or_si256(x[v], neg[v]));
+  }
+  if (stream)
+    _mm_sfence();
+  return i;
+}
+#endif
+
+/** Greedy change for many amounts; counts_out[c * n + i] (transposed). */
+static int greedy_batch_impl(const CoinSystem *sys, const int *amounts,
+                             size_t n, int *counts_out) {
+  if (!sys || !sys->coins || sys->ncoins == 0 || (n && (!amounts || !counts_out)))
+    return -1;
+  const size_t nc = sys->ncoins;
+  Reciprocal stack_rc[16];
+  Reciprocal *rc = nc <= 16 ? stack_rc : (Reciprocal *)malloc(nc * sizeof(*rc));
+  if (!rc)
+    return -1;
+  for (size_t c = 0; c < nc; ++c) {
+    if (sys->coins[c].value <= 0) {
+      if (rc != stack_rc)
+        free(rc);
+      return -1;
+    }
+    reciprocal_init((uint32_t)sys->coins[c].value, &rc[c]);
+  }
+  int inexact = 0;
+  size_t i = 0;
+#if defined(CPU_X86)
+  if (cpu_features() & CPU_AVX2)
+    i = greedy_batch_avx2(rc, nc, amounts, n, counts_out, &inexact);
+#endif
+  for (; i < n; ++i) {
+    int neg = amounts[i] < 0;
+    uint32_t x = neg ? 0u : (uint32_t)amounts[i];
+    for (size_t c = 0; c < nc; ++c) {
+      uint32_t q = reciprocal_div(x, &rc[c]);
+      counts_out[c * n + i] = (int)q;
+      x -= q * rc[c].d;
+    }
+    inexact += (x != 0) | neg;
+  }
+  if (rc != stack_rc)
+    free(rc);
+  return inexact;
+}
+
+int greedy_make_change_batch(const CoinSystem *sys, const int *amounts,
+                             size_t n, int *counts_out) {
+  LATENCY_PROBED_RETURN(LAT_SOLVER_BATCH,
+                        greedy_batch_impl(sys, amounts, n, counts_out));
+}
+
+/** Convert transposed batch counts to one row of ncoins per amount. */
+void change_counts_transpose(const int *transposed, size_t n, size_t ncoins,
+                             int *counts) {
+  if (!transposed || !counts)
+    return;
+  /* blocks of amounts keep every source row's slice in cache */
+  const size_t block = 256;
+  for (size_t i0 = 0; i0 < n; i0 += block) {
+    size_t i1 = i0 + block < n ? i0 + block : n;
+    for (size_t c = 0; c < ncoins; ++c) {
+      const int *src = transposed + c * n;
+      for (size_t i = i0; i < i1; ++i)
+        counts[i * ncoins + c] = src[i];
+    }
+  }
+}
@@ -0,0 +1,300 @@
+/**
+ * \file coin_bitset.c
+ * \brief Shift-OR kernels and reachability engines over amount bitsets.
+ *
+ * Two passes cover every engine:
+ *  - shift_or: dst |= src << v, run from the top word down so it is also a
+ *    correct in-place 0/1 step (every source word is read before it is
+ *    overwritten); AVX2 (picked at run time) handles four words per step;
+ *  - close_unbounded: w |= w << v repeatedly, in one ascending pass. For
+ *    v >= 64 every source word is already final; for v < 64 the word is
+ *    closed in place by doubling shifts (v, 2v, 4v, ...) until the result
+ *    turns periodic, after which words are copied from the pattern.
+ */
+#include "coin_bitset.h"
+#include "cpu_features.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
+
+int coin_bitset_init(CoinBitset *b, int max_amount) {
+  if (!b || max_amount < 0)
+    return -1;
+  b->nwords = ((size_t)max_amount >> 6) + 1;
+  b->words = (uint64_t *)calloc(b->nwords, sizeof(uint64_t));
+  b->max_amount = b->words ? max_amount : -1;
+  return b->words ? 0 : -1;
+}
+
+void coin_bitset_free(CoinBitset *b) {
+  if (!b)
+    return;
+  free(b->words);
+  b->words = NULL;
+  b->nwords = 0;
+  b->max_amount = -1;
+}
+
+size_t coin_bitset_count(const CoinBitset *b) {
+  size_t n = 0;
+  if (!b || !b->words)
+    return 0;
+  for (size_t i = 0; i < b->nwords; ++i)
+    n += (size_t)__builtin_popcountll(b->words[i]);
+  return n;
+}
+
+/** \brief Clear bits above max_amount in the last word. */
+static void mask_tail(uint64_t *w, size_t nwords, int max_amount) {
+  unsigned used = ((unsigned)max_amount & 63) + 1;
+  if (used < 64)
+    w[nwords - 1] &= (1ull << used) - 1;
+}
+
+#if defined(CPU_X86)
+/** \brief AVX2 part of shift_or: four words per step downwards from word
+ *  i while every source word exists. Returns where the scalar tail resumes. */
+CPU_TARGET("avx2")
+static size_t shift_or_avx2(uint64_t *dst, const uint64_t *src, size_t q,
+                            unsigned r, size_t i) {
+  if (r) {
+    const __m128i sl = _mm_cvtsi32_si128((int)r);
+    const __m128i sr = _mm_cvtsi32_si128((int)(64 - r));
+    while (i >= q + 5) {
+      i -= 4;
+      __m256i hi = _mm256_loadu_si256((const __m256i *)(src + i - q));
+      __m256i lo = _mm256_loadu_si256((const __m256i *)(src + i - q - 1));
+      __m256i v = _mm256_or_si256(_mm256_sll_epi64(hi, sl),
+                                  _mm256_srl_epi64(lo, sr));
+      __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+      _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(d, v));
+    }
+  } else {
+    while (i >= q + 4) {
+      i -= 4;
+      __m256i v = _mm256_loadu_si256((const __m256i *)(src + i - q));
+      __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+      _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(d, v));
+    }
+  }
+  return i;
+}
+
+/** \brief AVX2 part of close_unbounded for v >= 64: four words at a time
+ *  once their sources all lie below the chunk (q >= 4). Returns where the
+ *  scalar tail resumes. */
+CPU_TARGET("avx2")
+static size_t close_unbounded_avx2(uint64_t *w, size_t nwords, size_t q,
+                                   unsigned r) {
+  size_t i = q;
+  if (q >= 4 && r) {
+    const __m128i sl = _mm_cvtsi32_si128((int)r);
+    const __m128i sr = _mm_cvtsi32_si128((int)(64 - r));
+    w[i++] |= w[0] << r; /* first word has no lower source word */
+    for (; i + 4 <= nwords; i += 4) {
+      __m256i hi = _mm256_loadu_si256((const __m256i *)(w + i - q));
+      __m256i lo = _mm256_loadu_si256((const __m256i *)(w + i - q - 1));
+      __m256i x = _mm256_or_si256(_mm256_sll_epi64(hi, sl),
+                                  _mm256_srl_epi64(lo, sr));
+      __m256i d = _mm256_loadu_si256((const __m256i *)(w + i));
+      _mm256_storeu_si256((__m256i *)(w + i), _mm256_or_si256(d, x));
+    }
+  } else if (q >= 4) {
+    for (; i + 4 <= nwords; i += 4) {
+      __m256i x = _mm256_loadu_si256((const __m256i *)(w + i - q));
+      __m256i d = _mm256_loadu_si256((const __m256i *)(w + i));
+      _mm256_storeu_si256((__m256i *)(w + i), _mm256_or_si256(d, x));
+    }
+  }
+  return i;
+}
+#endif
+
+/** \brief dst[0..nwords) |= src << shift (descending; in-place safe). */
+static void shift_or(uint64_t *dst, const uint64_t *src, size_t nwords,
+                     uint64_t shift) {
+  const uint64_t q64 = shift >> 6;
+  if (q64 >= nwords)
+    return;
+  const size_t q = (size_t)q64;
+  const unsigned r = (unsigned)(shift & 63);
+  size_t i = nwords;
+#if defined(CPU_X86)
+  if (cpu_features() & CPU_AVX2)
+    i = shift_or_avx2(dst, src, q, r, i);
+#endif
+  while (i > q) {
+    --i;
+    uint64_t v = src[i - q] << r;
+    if (r && i > q)
+      v |= src[i - q - 1] >> (64 - r);
+    dst[i] |= v;
+  }
+}
+
+/** \brief Close w under adding v any number of times (ascending pass). */
+static void close_unbounded(uint64_t *w, size_t nwords, uint64_t v) {
+  const uint64_t q64 = v >> 6;
+  const unsigned r = (unsigned)(v & 63);
+  if (q64 == 0) {
+    /* closed words repeat with period L = lcm(v, 64) / 64 once every residue
+     * class mod v has started; from then on a word whose own bits are
+     * already in the pattern is a copy, which breaks the serial chain */
+    const size_t L = (size_t)(v >> __builtin_ctzll(v | 64));
+    uint64_t prev = 0;
+    size_t same = 0;
+    size_t i = 0;
+    while (i < nwords) {
+      if (same >= L) {
+        const uint64_t *pat = w + i - L;
+        for (size_t j = 0; i < nwords; ++i) {
+          if (w[i] & ~pat[j])
+            break;
+          w[i] = pat[j];
+          j = j + 1 == L ? 0 : j + 1;
+        }
+        if (i == nwords)
+          break;
+        same = 0;
+        prev = w[i - 1];
+      }
+      uint64_t x = w[i] | (prev >> (64 - r));
+      for (unsigned s = r; s < 64; s <<= 1)
+        x |= x << s;
+      same = i >= L && x == w[i - L] ? same + 1 : 0;
+      w[i++] = prev = x;
+    }
+    return;
+  }
+  if (q64 >= nwords)
+    return;
+  const size_t q = (size_t)q64;
+  size_t i = q;
+#if defined(CPU_X86)
+  if (cpu_features() & CPU_AVX2)
+    i = close_unbounded_avx2(w, nwords, q, r);
+#endif
+  for (; i < nwords; ++i) {
+    uint64_t x = w[i - q] << r;
+    if (r && i > q)
+      x |= w[i - q - 1] >> (64 - r);
+    w[i] |= x;
+  }
+}
+
+/** \brief Coin values must all be positive. */
+static int system_ok(const CoinSystem *sys) {
+  if (!sys || !sys->coins || sys->ncoins == 0)
+    return 0;
+  for (size_t c = 0; c < sys->ncoins; ++c)
+    if (sys->coins[c].value <= 0)
+      return 0;
+  return 1;
+}
+
+int coin_bitset_reachable(const CoinSystem *sys, CoinBitset *out) {
+  if (!system_ok(sys) || !out || !out->words)
+    return -1;
+  memset(out->words, 0, out->nwords * sizeof(uint64_t));
+  out->words[0] = 1;
+  for (size_t c = 0; c < sys->ncoins; ++c)
+    close_unbounded(out->words, out->nwords, (uint64_t)sys->coins[c].value);
+  mask_tail(out->words, out->nwords, out->max_amount);
+  return 0;
+}
+
+int coin_bitset_reachable_bounded(const CoinSystem *sys, const int *supply,
+                                  CoinBitset *out) {
+  if (!system_ok(sys) || !supply || !out || !out->words)
+    return -1;
+  memset(out->words, 0, out->nwords * sizeof(uint64_t));
+  out->words[0] = 1;
+  for (size_t c = 0; c < sys->ncoins; ++c) {
+    uint64_t v = (uint64_t)sys->coins[c].value;
+    if (supply[c] < 0) {
+      close_unbounded(out->words, out->nwords, v);
+      continue;
+    }
+    /* bundles 1, 2, 4, ..., rest: any count 0..supply is a bundle subset */
+    uint64_t left = (uint64_t)supply[c];
+    for (uint64_t p = 1; left > 0; p <<= 1) {
+      uint64_t take = p < left ? p : left;
+      shift_or(out->words, out->words, out->nwords, take * v);
+      left -= take;
+    }
+  }
+  mask_tail(out->words, out->nwords, out->max_amount);
+  return 0;
+}
+
+/** \brief Layered engine: cur ends as the <= layers-coin set; min_k (if set)
+ * gets the layer at which each amount first appears. Returns layers run. */
+static int run_layers(const CoinSystem *sys, int max_amount, int max_k,
+                      uint64_t *cur, size_t nwords, int *min_k) {
+  uint64_t *next = (uint64_t *)malloc(nwords * sizeof(uint64_t));
+  if (!next)
+    return -1;
+  uint64_t vmax = 0;
+  for (size_t c = 0; c < sys->ncoins; ++c)
+    if ((uint64_t)sys->coins[c].value > vmax)
+      vmax = (uint64_t)sys->coins[c].value;
+  memset(cur, 0, nwords * sizeof(uint64_t));
+  cur[0] = 1;
+  int k = 0;
+  while (max_k <= 0 || k < max_k) {
+    /* after k + 1 coins nothing lies above (k + 1) * vmax */
+    uint64_t top = ((uint64_t)(k + 1) * vmax >> 6) + 1;
+    size_t hi = top < nwords ? (size_t)top : nwords;
+    memcpy(next, cur, hi * sizeof(uint64_t));
+    for (size_t c = 0; c < sys->ncoins; ++c)
+      shift_or(next, cur, hi, (uint64_t)sys->coins[c].value);
+    if (hi == nwords)
+      mask_tail(next, nwords, max_amount);
+    ++k;
+    uint64_t grew = 0;
+    for (size_t i = 0; i < hi; ++i) {
+      uint64_t fresh = next[i] & ~cur[i];
+      grew |= fresh;
+      while (min_k && fresh) {
+        min_k[i * 64 + (size_t)__builtin_ctzll(fresh)] = k;
+        fresh &= fresh - 1;
+      }
+      cur[i] = next[i];
+    }
+    if (!grew)
+      break;
+  }
+  free(next);
+  return k;
+}
+
+int coin_bitset_reachable_k(const CoinSystem *sys, int k, CoinBitset *out) {
+  if (!system_ok(sys) || !out || !out->words || k < 0)
+    return -1;
+  if (k == 0) {
+    memset(out->words, 0, out->nwords * sizeof(uint64_t));
+    out->words[0] = 1;
+    return 0;
+  }
+  return run_layers(sys, out->max_amount, k, out->words, out->nwords, NULL) < 0
+             ? -1
+             : 0;
+}
+
+int coin_bitset_min_coins(const CoinSystem *sys, int max_amount, int max_k,
+                          int *min_k) {
+  if (!system_ok(sys) || max_amount < 0 || !min_k)
+    return -1;
+  CoinBitset set;
+  if (coin_bitset_init(&set, max_amount) != 0)
+    return -1;
+  for (int a = 0; a <= max_amount; ++a)
+    min_k[a] = -1;
+  min_k[0] = 0;
+  int layers = run_layers(sys, max_amount, max_k, set.words, set.nwords, min_k);
+  coin_bitset_free(&set);
+  return layers;
+}
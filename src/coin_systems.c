@@ -65,6 +65,12 @@ const CoinSystem *get_coin_system(const char *name) {
   return NULL;
 }
 
+size_t coin_system_count(void) { return sizeof(SYSTEMS) / sizeof(SYSTEMS[0]); }
+
+const CoinSystem *get_coin_system_by_index(size_t i) {
+  return i < coin_system_count() ? &SYSTEMS[i] : NULL;
+}
+
 void list_systems(void) {
   printf("Available systems:\n");
   for (size_t i = 0; i < sizeof(SYSTEMS) / sizeof(SYSTEMS[0]); ++i) {
@@ -1,16 +1,24 @@
 /** \file coinsorter.c
  *  \brief Command-line interface for coin change algorithms and audits.
  */
+#include "arrow_ipc.h"
+#include "change_table.h"
 #include "coins.h"
+#include "latency_hist.h"
+#include "metrics.h"
+#include "mixed_change.h"
+#include "slot_sorter.h"
 #include "color.h"
 #include "version.h"
 #include <ctype.h>
+#include <errno.h>
 #include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 /* Coin system definitions moved to coin_systems.c */
 
@@ -29,11 +37,212 @@ static int parse_int(const char *s) {
 /** Print usage summary. */
 static void print_usage(const char *prog) {
   printf("Usage: %s [amount] [system] [--json] [--audit] [--selftest] "
-         "[--version] [--opt=count|mass|diam|area]\n",
+         "[--format=text|json|arrow] [--version] [--opt=count|mass|diam|area] "
+         "[--bench-change amt iters] "
+         "[--bench-greedy n] [--change-table max file] [--mix sys:rate] "
+         "[--latency[=json]] [--worker] [--metrics unix:path|host:port] "
+         "[--slots k]\n",
          prog);
   list_systems();
 }
 
+/** atexit hook printing solver latency histograms (--latency). */
+static int latency_json;
+static void report_latency(void) { latency_probes_report(stderr, latency_json); }
+
+/** Canonical spot-check result per system, reused across worker queries. */
+typedef struct {
+  const CoinSystem *sys; /**< System audited. */
+  int limit;             /**< Amounts 1..limit were checked. */
+  int ex;                /**< First counterexample, or -1. */
+} AuditCacheEntry;
+
+static AuditCacheEntry audit_cache[16];
+static size_t audit_cache_len;
+
+/** audit_canonical, answered from the cache when an earlier audit of the same
+ * system covered at least limit amounts. */
+static int audit_cached(const CoinSystem *sys, int limit, int *ex) {
+  if (limit <= 0) /* derived bound: not worth caching */
+    return audit_canonical(sys, limit, ex);
+  size_t i = 0;
+  while (i < audit_cache_len && audit_cache[i].sys != sys)
+    ++i;
+  if (i < audit_cache_len && audit_cache[i].limit >= limit) {
+    METRICS_COUNT("coinsorter_audit_cache_hits_total", NULL,
+                  "Canonical audits answered from the cache", 1);
+    if (audit_cache[i].ex >= 0 && audit_cache[i].ex <= limit) {
+      *ex = audit_cache[i].ex;
+      return 0;
+    }
+    return 1;
+  }
+  METRICS_COUNT("coinsorter_audit_cache_misses_total", NULL,
+                "Canonical audits computed", 1);
+  int found = -1;
+  int ok = audit_canonical(sys, limit, &found);
+  if (i == audit_cache_len && i < sizeof(audit_cache) / sizeof(audit_cache[0]))
+    ++audit_cache_len;
+  if (i < audit_cache_len) {
+    audit_cache[i].sys = sys;
+    audit_cache[i].limit = limit;
+    audit_cache[i].ex = ok ? -1 : found;
+  }
+  if (!ok)
+    *ex = found;
+  return ok;
+}
+
+/** Solve one query: greedy when the system is hinted canonical and passes a
+ * spot audit up to min(amount, 500), DP otherwise (always DP for --opt). */
+static int solve_query(const CoinSystem *sys, int amount, OptimizeMode mode,
+                       int *counts, int *used_greedy, int *ex) {
+  *ex = -1;
+  *used_greedy = sys->canonical_hint;
+  if (*used_greedy && !audit_cached(sys, amount > 500 ? 500 : amount, ex))
+    *used_greedy = 0;
+  if (mode != OPT_COUNT) {
+    *used_greedy = 0;
+    return dp_make_change_opt(sys, amount, counts, mode);
+  }
+  return *used_greedy ? greedy_make_change(sys, amount, counts)
+                      : dp_make_change(sys, amount, counts);
+}
+
+/** Strategy label for output and metrics. */
+static const char *strategy_name(OptimizeMode mode, int used_greedy) {
+  if (mode == OPT_MASS)
+    return "dp-mass";
+  if (mode == OPT_DIAMETER)
+    return "dp-diam";
+  if (mode == OPT_AREA)
+    return "dp-area";
+  return used_greedy ? "greedy" : "dp";
+}
+
+/** Per (system, strategy) query counter, registered on first use. */
+typedef struct {
+  const CoinSystem *sys; /**< Query system. */
+  const char *strategy;  /**< strategy_name() result (static string). */
+  Metric *counter;       /**< coinsorter_queries_total series. */
+} QuerySeries;
+
+static Metric *query_counter(QuerySeries *tab, size_t *n, size_t cap,
+                             const CoinSystem *sys, const char *strategy) {
+  for (size_t i = 0; i < *n; ++i)
+    if (tab[i].sys == sys && tab[i].strategy == strategy)
+      return tab[i].counter;
+  char labels[96];
+  snprintf(labels, sizeof(labels), "system=\"%s\",strategy=\"%s\"",
+           sys->system_name, strategy);
+  Metric *m = metrics_register(METRIC_COUNTER, "coinsorter_queries_total",
+                               labels, "Change queries answered");
+  if (*n < cap) {
+    tab[*n].sys = sys;
+    tab[*n].strategy = strategy;
+    tab[(*n)++].counter = m;
+  }
+  return m;
+}
+
+/** Rows per Arrow record batch in worker mode. */
+#define WORKER_ARROW_ROWS 1024
+
+/** Long-running mode: answer one "AMOUNT [SYSTEM]" query per stdin line,
+ * one output line each ("ERR ..." on failure). With arrow set, results go to
+ * stdout as an Arrow IPC stream in batches of WORKER_ARROW_ROWS rows (the
+ * last one at end of input) and failures to stderr. SIGUSR1 dumps metrics to
+ * stderr. */
+static int run_worker(const CoinSystem *def, OptimizeMode mode, int json,
+                      int arrow) {
+  Metric *latency = metrics_register(
+      METRIC_HISTOGRAM, "coinsorter_request_duration_seconds", NULL,
+      "Per-request latency (parse, solve and format)");
+  Metric *errors = metrics_register(METRIC_COUNTER,
+                                    "coinsorter_query_errors_total", NULL,
+                                    "Queries rejected or without a solution");
+  QuerySeries series[64];
+  size_t nseries = 0;
+  int counts[64];
+  char line[256], buf[768];
+  ArrowChangeBatch rows;
+  ArrowWriter *aw = NULL;
+  arrow_change_init(&rows);
+  if (arrow) {
+    fflush(stdout);
+    aw = arrow_writer_open(STDOUT_FILENO, arrow_change_fields(),
+                           ARROW_CHANGE_COLUMNS);
+    if (!aw) {
+      fprintf(stderr, "cannot start Arrow stream\n");
+      return 1;
+    }
+  }
+  metrics_install_dump_signal();
+  for (;;) {
+    if (metrics_dump_pending())
+      metrics_write(stderr);
+    errno = 0;
+    if (!fgets(line, sizeof(line), stdin)) {
+      if (ferror(stdin) && errno == EINTR) {
+        clearerr(stdin);
+        continue;
+      }
+      break;
+    }
+    uint64_t t0 = latency_now_ns();
+    char amt_s[32], name[32];
+    int nf = sscanf(line, "%31s %31s", amt_s, name);
+    if (nf < 1)
+      continue;
+    int amount = parse_int(amt_s);
+    const CoinSystem *sys = nf > 1 ? get_coin_system(name) : def;
+    int used_greedy = 0, ex = -1;
+    if (amount < 0 || !sys || sys->ncoins > sizeof(counts) / sizeof(int) ||
+        solve_query(sys, amount, mode, counts, &used_greedy, &ex) != 0) {
+      metrics_counter_add(errors, 1);
+      line[strcspn(line, "\r\n")] = '\0';
+      fprintf(aw ? stderr : stdout, "ERR %s\n", line);
+      fflush(aw ? stderr : stdout);
+      continue;
+    }
+    const char *strategy = strategy_name(mode, used_greedy);
+    if (aw) {
+      if (arrow_change_append(&rows, sys, amount, counts, strategy) != 0 ||
+          (rows.n == WORKER_ARROW_ROWS && arrow_change_flush(aw, &rows) != 0))
+        break;
+    } else if (json && format_change_json(sys, amount, counts, strategy,
+                                   COINSORTER_VERSION_STR, buf,
+                                   sizeof(buf)) == 0) {
+      puts(buf);
+    } else {
+      int total = 0;
+      printf("%s %d %s", sys->system_name, amount, strategy);
+      for (size_t c = 0; c < sys->ncoins; ++c) {
+        total += counts[c];
+        if (counts[c])
+          printf(" %s:%d", sys->coins[c].code, counts[c]);
+      }
+      printf(" total=%d\n", total);
+    }
+    fflush(stdout);
+    metrics_counter_add(query_counter(series, &nseries,
+                                      sizeof(series) / sizeof(series[0]), sys,
+                                      strategy),
+                        1);
+    metrics_observe_ns(latency, latency_now_ns() - t0);
+  }
+  int rc = 0;
+  if (aw) {
+    int fl = arrow_change_flush(aw, &rows);
+    if (arrow_writer_close(aw) != 0 || fl != 0) {
+      fprintf(stderr, "Arrow stream write failed\n");
+      rc = 1;
+    }
+  }
+  arrow_change_free(&rows);
+  return rc;
+}
+
 /* Self tests: verify greedy vs DP for predefined systems and sample amounts */
 /** Internal self test (greedy vs DP and canonical audit). */
 static int selftest(void) {
@@ -60,22 +269,66 @@ static int selftest(void) {
   return 1;
 }
 
+/** Print the optimized sorter slot widths and error matrix (--slots). */
+static int print_slot_plan(const CoinSystem *sys, int nslots) {
+  SlotPlan p;
+  if (slot_plan_optimize(sys, NULL, nslots, 0, &p) != 0) {
+    fprintf(stderr, "no slot plan for %d slots\n", nslots);
+    return 0;
+  }
+  printf("Slots for %s: %d slots, %zu designations searched, "
+         "expected misrouting %.3g\n",
+         sys->system_name, p.nslots, p.candidates, p.misroute);
+  for (int s = 0; s < p.nslots; ++s)
+    if (s + 1 < p.nslots)
+      printf("  slot %d: < %.3f mm\n", s, p.width[s]);
+    else
+      printf("  slot %d: tray\n", s);
+  printf("  coin  target  P(slot 0..%d)\n", p.nslots - 1);
+  for (size_t c = 0; c < p.ncoins; ++c) {
+    printf("  %-5s %6d ", sys->coins[c].code, p.target[c]);
+    for (int s = 0; s < p.nslots; ++s)
+      printf(" %.2e", p.error[c * p.nslots + s]);
+    printf("\n");
+  }
+  slot_plan_free(&p);
+  return 1;
+}
+
 /** Program entry point handling argument parsing and dispatch. */
 int main(int argc, char **argv) {
   const CoinSystem *sys = get_coin_system("usd");
   int amount = -1;
   int json = 0;
+  int arrow = 0;
   int audit = 0;
   int show_version = 0;
   OptimizeMode opt_mode = OPT_COUNT;
   int bench = 0;
   int bench_amt = 0;
   int bench_iters = 0;
+  int bench_greedy = 0;
+  int slots = -1;
+  int table_max = -1;
+  const char *table_path = NULL;
+  MixedSource mix[8];
+  size_t nmix = 1; /* mix[0] is the target system */
+  int worker = 0;
+  const char *metrics_addr = NULL;
 
   int force_no_color = 0;
   for (int i = 1; i < argc; ++i) {
     if (strcmp(argv[i], "--json") == 0)
       json = 1;
+    else if (strncmp(argv[i], "--format=", 9) == 0) {
+      const char *f = argv[i] + 9;
+      json = strcmp(f, "json") == 0;
+      arrow = strcmp(f, "arrow") == 0;
+      if (!json && !arrow && strcmp(f, "text") != 0) {
+        fprintf(stderr, "Unknown format %s\n", f);
+        return 1;
+      }
+    }
     else if (strcmp(argv[i], "--audit") == 0)
       audit = 1;
     else if (strcmp(argv[i], "--selftest") == 0) {
@@ -91,6 +344,58 @@ int main(int argc, char **argv) {
         fprintf(stderr, "--bench-change requires amt iters\n");
         return 1;
       }
+    } else if (strcmp(argv[i], "--bench-greedy") == 0) {
+      if (i + 1 < argc && (bench_greedy = parse_int(argv[++i])) > 0) {
+      } else {
+        fprintf(stderr, "--bench-greedy requires a positive amount count\n");
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--slots") == 0) {
+      if (i + 1 < argc && (slots = parse_int(argv[++i])) >= 0) {
+      } else {
+        fprintf(stderr, "--slots requires a slot count (0: one per coin)\n");
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--change-table") == 0) {
+      if (i + 2 < argc && (table_max = parse_int(argv[i + 1])) >= 0) {
+        table_path = argv[i + 2];
+        i += 2;
+      } else {
+        fprintf(stderr, "--change-table requires max amount and file\n");
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--latency") == 0 ||
+               strcmp(argv[i], "--latency=json") == 0) {
+      latency_json = argv[i][9] == '=';
+      latency_probes_enable(1);
+      atexit(report_latency);
+    } else if (strcmp(argv[i], "--worker") == 0) {
+      worker = 1;
+    } else if (strcmp(argv[i], "--metrics") == 0) {
+      if (i + 1 < argc) {
+        metrics_addr = argv[++i];
+      } else {
+        fprintf(stderr, "--metrics requires unix:path or host:port\n");
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--mix") == 0) {
+      const char *colon = i + 1 < argc ? strchr(argv[i + 1], ':') : NULL;
+      char name[16];
+      size_t len = colon ? (size_t)(colon - argv[i + 1]) : 0;
+      if (!colon || len >= sizeof(name) || nmix == sizeof(mix) / sizeof(mix[0])) {
+        fprintf(stderr, "--mix requires sys:rate (target units per unit)\n");
+        return 1;
+      }
+      memcpy(name, argv[++i], len);
+      name[len] = '\0';
+      mix[nmix].sys = get_coin_system(name);
+      mix[nmix].rate = strtod(colon + 1, NULL);
+      mix[nmix].inventory = NULL;
+      if (!mix[nmix].sys || !(mix[nmix].rate > 0)) {
+        fprintf(stderr, "Bad --mix %s\n", argv[i]);
+        return 1;
+      }
+      ++nmix;
     } else if (strncmp(argv[i], "--opt=", 6) == 0) {
       const char *m = argv[i] + 6;
       if (strcmp(m, "count") == 0)
@@ -124,6 +429,18 @@ int main(int argc, char **argv) {
     }
   }
 
+  if (worker || metrics_addr)
+    metrics_enable(1);
+  if (metrics_addr && metrics_serve(metrics_addr) != 0) {
+    fprintf(stderr, "cannot serve metrics on %s\n", metrics_addr);
+    return 1;
+  }
+  if (worker) {
+    int rc = run_worker(sys, opt_mode, json, arrow);
+    metrics_serve_stop();
+    return rc;
+  }
+
   if (audit) {
     int ex = -1;
     int ok = audit_canonical(sys, 0, &ex);
@@ -136,6 +453,68 @@ int main(int argc, char **argv) {
     return ok ? 0 : 2;
   }
 
+  if (slots >= 0)
+    return print_slot_plan(sys, slots) ? 0 : 1;
+
+  if (bench_greedy > 0) {
+    size_t n = (size_t)bench_greedy;
+    int *amts = (int *)malloc(n * sizeof(int));
+    int *scalar = (int *)malloc(n * sys->ncoins * sizeof(int));
+    int *batch = (int *)malloc(n * sys->ncoins * sizeof(int));
+    if (!amts || !scalar || !batch) {
+      perror("alloc");
+      free(amts);
+      free(scalar);
+      free(batch);
+      return 1;
+    }
+    unsigned x = 2463534242u;
+    for (size_t i = 0; i < n; ++i) {
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      amts[i] = (int)(x % 1000000u);
+    }
+    /* fault the outputs in first so both timings measure the solver */
+    memset(scalar, 0, n * sys->ncoins * sizeof(int));
+    memset(batch, 0, n * sys->ncoins * sizeof(int));
+    clock_t t0 = clock();
+    for (size_t i = 0; i < n; ++i)
+      greedy_make_change(sys, amts[i], scalar + i * sys->ncoins);
+    clock_t t1 = clock();
+    greedy_make_change_batch(sys, amts, n, batch);
+    clock_t t2 = clock();
+    double ts = (double)(t1 - t0) / CLOCKS_PER_SEC;
+    double tb = (double)(t2 - t1) / CLOCKS_PER_SEC;
+    printf("BENCH greedy n=%zu scalar=%.3g ns/amt batch=%.3g ns/amt "
+           "speedup=%.1fx\n",
+           n, 1e9 * ts / n, 1e9 * tb / n, tb > 0 ? ts / tb : 0.0);
+    free(amts);
+    free(scalar);
+    free(batch);
+    return 0;
+  }
+
+  if (table_path) {
+    ChangeTable table;
+    clock_t t0 = clock();
+    if (change_table_build(sys, table_max, &table) != 0) {
+      fprintf(stderr, "change table build failed\n");
+      return 1;
+    }
+    double secs = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    int rc = change_table_save(&table, table_path);
+    if (rc == 0)
+      printf("TABLE %s max=%d bytes=%zu bytes/amount=%.3f build=%.3gs -> %s\n",
+             sys->system_name, table_max, change_table_bytes(&table),
+             (double)change_table_bytes(&table) / ((double)table_max + 1),
+             secs, table_path);
+    else
+      fprintf(stderr, "cannot write %s\n", table_path);
+    change_table_free(&table);
+    return rc == 0 ? 0 : 1;
+  }
+
   if (amount < 0) {
     char line[64];
     printf("Enter amount in %s smallest units: ", sys->system_name);
@@ -148,6 +527,39 @@ int main(int argc, char **argv) {
     }
   }
 
+  if (nmix > 1) {
+    MixedChangeSolver ms;
+    mix[0].sys = sys;
+    mix[0].rate = 1.0;
+    mix[0].inventory = NULL;
+    if (mixed_change_init(&ms, mix, nmix, amount, opt_mode) != 0) {
+      fprintf(stderr,
+              "Cannot combine these rates: each needs at most 6 decimal "
+              "places, and amount times their common scale must stay "
+              "below 2^31\n");
+      return 1;
+    }
+    int *mc = (int *)calloc(ms.ncoins, sizeof(int));
+    double objective = 0.0;
+    int rc = mc ? mixed_change_pay(&ms, amount, mc, &objective) : -1;
+    if (rc == 0) {
+      printf("Mixed payment of %d %s (objective %.6g):\n", amount,
+             sys->system_name, objective);
+      for (size_t k = 0; k < ms.ncoins; ++k) {
+        const MixedCoin *c = &ms.coins[k];
+        const CoinSystem *cs = mix[c->source].sys;
+        if (mc[k])
+          printf("  %s %-4s x %d\n", cs->system_name, cs->coins[c->coin].code,
+                 mc[k]);
+      }
+    } else {
+      fprintf(stderr, "Failed to make mixed change for %d\n", amount);
+    }
+    free(mc);
+    mixed_change_free(&ms);
+    return rc == 0 ? 0 : 1;
+  }
+
   color_init();
   if (force_no_color)
     color_enabled = 0;
@@ -156,24 +568,9 @@ int main(int argc, char **argv) {
     perror("alloc");
     return 1;
   }
-  int status = 0;
   int ex = -1;
-
-  int do_greedy = sys->canonical_hint; /* start with hint */
-  if (do_greedy) {                     /* spot-check audit small */
-    if (!audit_canonical(sys, amount > 500 ? 500 : amount, &ex))
-      do_greedy = 0;
-  }
-
-  if (opt_mode != OPT_COUNT) {
-    /* force DP with optimization */
-    do_greedy = 0;
-    status = dp_make_change_opt(sys, amount, counts, opt_mode);
-  } else if (do_greedy) {
-    status = greedy_make_change(sys, amount, counts);
-  } else {
-    status = dp_make_change(sys, amount, counts);
-  }
+  int do_greedy = 0;
+  int status = solve_query(sys, amount, opt_mode, counts, &do_greedy, &ex);
 
   if (status != 0) {
     fprintf(stderr, "Failed to make change for %d\n", amount);
@@ -181,17 +578,28 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  if (json) {
+  if (arrow) {
+    ArrowChangeBatch row;
+    arrow_change_init(&row);
+    fflush(stdout);
+    ArrowWriter *aw = arrow_writer_open(STDOUT_FILENO, arrow_change_fields(),
+                                        ARROW_CHANGE_COLUMNS);
+    int rc = aw ? 0 : -1;
+    if (aw && (arrow_change_append(&row, sys, amount, counts,
+                                   strategy_name(opt_mode, do_greedy)) != 0 ||
+               arrow_change_flush(aw, &row) != 0))
+      rc = -1;
+    if (aw && arrow_writer_close(aw) != 0)
+      rc = -1;
+    arrow_change_free(&row);
+    if (rc != 0) {
+      fprintf(stderr, "Arrow stream write failed\n");
+      free(counts);
+      return 1;
+    }
+  } else if (json) {
     char buf[768];
-    const char *strategy = NULL;
-    if (opt_mode == OPT_MASS)
-      strategy = "dp-mass";
-    else if (opt_mode == OPT_DIAMETER)
-      strategy = "dp-diam";
-    else if (opt_mode == OPT_AREA)
-      strategy = "dp-area";
-    else
-      strategy = (do_greedy ? "greedy" : "dp");
+    const char *strategy = strategy_name(opt_mode, do_greedy);
     if (format_change_json(sys, amount, counts, strategy,
                            COINSORTER_VERSION_STR, buf, sizeof(buf)) == 0)
       puts(buf);
@@ -203,13 +611,7 @@ int main(int argc, char **argv) {
     int total_coins = 0;
     for (size_t i = 0; i < sys->ncoins; ++i)
       total_coins += counts[i];
-    const char *mode_str =
-        (opt_mode == OPT_MASS
-             ? "dp-mass"
-             : (opt_mode == OPT_DIAMETER
-                    ? "dp-diam"
-                    : (opt_mode == OPT_AREA ? "dp-area"
-                                            : (do_greedy ? "greedy" : "dp"))));
+    const char *mode_str = strategy_name(opt_mode, do_greedy);
     printf("Strategy: %s%s%s\n", (opt_mode == OPT_COUNT ? C_GREEN : C_MAGENTA),
            mode_str, C_RESET);
     for (size_t i = 0; i < sys->ncoins; ++i) {
@@ -239,20 +641,21 @@ int main(int argc, char **argv) {
       perror("alloc");
       return 1;
     }
-    clock_t t0, t1;
-    double best = 1e9, tot = 0;
+    LatencyHist *hist = (LatencyHist *)malloc(sizeof(LatencyHist));
+    if (!hist) {
+      perror("alloc");
+      free(tmp);
+      return 1;
+    }
+    latency_hist_reset(hist);
     for (int it = 0; it < bench_iters; ++it) {
       memset(tmp, 0, sys->ncoins * sizeof(int));
-      t0 = clock();
+      uint64_t t0 = latency_now_ns();
       if (opt_mode == OPT_COUNT)
         dp_make_change(sys, bench_amt, tmp);
       else
         dp_make_change_opt(sys, bench_amt, tmp, opt_mode);
-      t1 = clock();
-      double dt = (double)(t1 - t0) / CLOCKS_PER_SEC;
-      tot += dt;
-      if (dt < best)
-        best = dt;
+      latency_hist_record(hist, latency_now_ns() - t0);
     }
     const char *bench_mode =
         (opt_mode == OPT_COUNT
@@ -260,8 +663,23 @@ int main(int argc, char **argv) {
              : (opt_mode == OPT_MASS
                     ? "mass"
                     : (opt_mode == OPT_DIAMETER ? "diam" : "area")));
-    printf("BENCH amount=%d mode=%s iters=%d avg=%.6g s best=%.6g s\n",
-           bench_amt, bench_mode, bench_iters, tot / bench_iters, best);
+    if (json) {
+      char *buf = (char *)malloc(1u << 18);
+      if (buf && latency_hist_to_json(hist, buf, 1u << 18) == 0)
+        printf("{\"bench\":\"dp\",\"amount\":%d,\"mode\":\"%s\","
+               "\"iters\":%d,\"latency\":%s}\n",
+               bench_amt, bench_mode, bench_iters, buf);
+      free(buf);
+    } else {
+      printf("BENCH amount=%d mode=%s iters=%d avg=%.6g s best=%.6g s "
+             "p50=%.6g s p99=%.6g s p999=%.6g s max=%.6g s\n",
+             bench_amt, bench_mode, bench_iters,
+             latency_hist_mean(hist) * 1e-9, hist->min * 1e-9,
+             latency_hist_percentile(hist, 50.0) * 1e-9,
+             latency_hist_percentile(hist, 99.0) * 1e-9,
+             latency_hist_percentile(hist, 99.9) * 1e-9, hist->max * 1e-9);
+    }
+    free(hist);
     free(tmp);
     return 0;
   }
@@ -0,0 +1,48 @@
+/** \file cpu_features.c
+ *  \brief CPUID-based feature detection, cached on first use.
+ */
+#include "cpu_features.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Enabled set plus one, so zero means "not detected yet". */
+static unsigned enabled_plus1;
+
+/** \brief Extensions the CPU and OS support. */
+static unsigned detect(void) {
+  unsigned f = 0;
+#if defined(CPU_X86)
+  /* __builtin_cpu_supports also checks that the OS saves the wide
+   * registers */
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    f |= CPU_AVX2;
+  if (__builtin_cpu_supports("fma"))
+    f |= CPU_FMA;
+  if (__builtin_cpu_supports("avxvnni"))
+    f |= CPU_AVX_VNNI;
+  if (__builtin_cpu_supports("avx512vnni") &&
+      __builtin_cpu_supports("avx512vl"))
+    f |= CPU_AVX512_VNNI;
+#endif
+  return f;
+}
+
+unsigned cpu_features(void) {
+  unsigned e = __atomic_load_n(&enabled_plus1, __ATOMIC_RELAXED);
+  if (e)
+    return e - 1;
+  unsigned f = detect();
+  const char *env = getenv("COINSORTER_SIMD");
+  if (env && (!strcmp(env, "off") || !strcmp(env, "0")))
+    f = 0;
+  /* racing first calls compute the same value */
+  __atomic_store_n(&enabled_plus1, f + 1, __ATOMIC_RELAXED);
+  return f;
+}
+
+unsigned cpu_features_limit(unsigned mask) {
+  unsigned prev = cpu_features();
+  __atomic_store_n(&enabled_plus1, (detect() & mask) + 1, __ATOMIC_RELAXED);
+  return prev;
+}
@@ -0,0 +1,400 @@
+/**
+ * \file erosion.c
+ * \brief Tiled parallel droplet erosion and two-pass thermal erosion.
+ */
+#include "erosion.h"
+#include "parallel.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** \brief Largest supported brush radius. */
+#define BRUSH_MAX_RADIUS 8
+#define BRUSH_CELLS ((2 * BRUSH_MAX_RADIUS + 1) * (2 * BRUSH_MAX_RADIUS + 1))
+/** \brief Droplets advanced in lockstep within one tile. */
+#define DROPLET_LANES 4
+
+void erosion_default_params(ErosionParams *p) {
+  if (!p)
+    return;
+  p->droplets = 100000;
+  p->max_steps = 48;
+  p->radius = 3;
+  p->inertia = 0.05;
+  p->capacity = 4.0;
+  p->min_capacity = 0.0005;
+  p->erode_rate = 0.3;
+  p->deposit_rate = 0.3;
+  p->evaporation = 0.02;
+  p->gravity = 4.0;
+  p->seed = 1u;
+  p->threads = 0;
+}
+
+/** \brief Normalized radial weights max(0, r - dist) around a node. */
+typedef struct {
+  int n, radius;
+  int dx[BRUSH_CELLS], dy[BRUSH_CELLS];
+  long off[BRUSH_CELLS]; /* dy * nx + dx */
+  double w[BRUSH_CELLS];
+} Brush;
+
+static void brush_init(Brush *b, int radius, int nx) {
+  double sum = 0.0;
+  b->n = 0;
+  b->radius = radius;
+  for (int y = -radius; y <= radius; ++y)
+    for (int x = -radius; x <= radius; ++x) {
+      double w = radius - sqrt((double)(x * x + y * y));
+      if (w <= 0.0)
+        continue;
+      b->dx[b->n] = x;
+      b->dy[b->n] = y;
+      b->off[b->n] = (long)y * nx + x;
+      b->w[b->n++] = w;
+      sum += w;
+    }
+  for (int k = 0; k < b->n; ++k)
+    b->w[k] /= sum;
+}
+
+/** \brief splitmix64 step: independent stream per (seed, tile, batch). */
+static inline uint64_t splitmix64(uint64_t *s) {
+  uint64_t z = (*s += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+static inline double unit(uint64_t *s) {
+  return (double)(splitmix64(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/** \brief In-flight droplet. */
+typedef struct {
+  double x, y, dx, dy, speed, water, sed;
+  int steps;
+} Droplet;
+
+static inline void droplet_start(Droplet *d, double x, double y) {
+  d->x = x;
+  d->y = y;
+  d->dx = d->dy = 0.0;
+  d->speed = d->water = 1.0;
+  d->sed = 0.0;
+  d->steps = 0;
+}
+
+/** \brief Add dep bilinearly around node i at fractions (fx, fy). */
+static inline void deposit(double *h, int nx, size_t i, double fx, double fy,
+                           double dep, ErosionStats *st) {
+  h[i] += dep * (1 - fx) * (1 - fy);
+  h[i + 1] += dep * fx * (1 - fy);
+  h[i + nx] += dep * (1 - fx) * fy;
+  h[i + nx + 1] += dep * fx * fy;
+  st->deposited += dep;
+}
+
+/** \brief Advance a droplet one cell; returns 0 once it has finished. A
+ * finishing droplet (out of steps, stalled or leaving the grid) drops what
+ * it carries at its last position inside the grid, so mass is conserved. */
+static inline int droplet_step(Droplet *d, double *h, int nx, int ny,
+                               const ErosionParams *p, const Brush *brush,
+                               ErosionStats *st) {
+  int ix = (int)d->x, iy = (int)d->y;
+  double fx = d->x - ix, fy = d->y - iy;
+  size_t i = (size_t)iy * nx + ix;
+  if (d->steps++ >= p->max_steps) {
+    deposit(h, nx, i, fx, fy, d->sed, st);
+    return 0;
+  }
+  double h00 = h[i], h10 = h[i + 1], h01 = h[i + nx], h11 = h[i + nx + 1];
+  double gx = (h10 - h00) * (1 - fy) + (h11 - h01) * fy;
+  double gy = (h01 - h00) * (1 - fx) + (h11 - h10) * fx;
+  double hh = h00 * (1 - fx) * (1 - fy) + h10 * fx * (1 - fy) +
+              h01 * (1 - fx) * fy + h11 * fx * fy;
+  double dx = d->dx * p->inertia - gx * (1 - p->inertia);
+  double dy = d->dy * p->inertia - gy * (1 - p->inertia);
+  double len2 = dx * dx + dy * dy;
+  if (len2 < 1e-24) { /* flat: the droplet stalls */
+    deposit(h, nx, i, fx, fy, d->sed, st);
+    return 0;
+  }
+  double inv = 1.0 / sqrt(len2);
+  d->dx = dx *= inv;
+  d->dy = dy *= inv;
+  double x = d->x += dx, y = d->y += dy;
+  st->steps++;
+  if (x < 0.0 || y < 0.0 || x >= nx - 1 || y >= ny - 1) {
+    deposit(h, nx, i, fx, fy, d->sed, st);
+    return 0;
+  }
+  int jx = (int)x, jy = (int)y;
+  double gxn = x - jx, gyn = y - jy;
+  size_t j = (size_t)jy * nx + jx;
+  double hn = h[j] * (1 - gxn) * (1 - gyn) + h[j + 1] * gxn * (1 - gyn) +
+              h[j + nx] * (1 - gxn) * gyn + h[j + nx + 1] * gxn * gyn;
+  double dh = hn - hh;
+  double cap = -dh * d->speed * d->water * p->capacity;
+  if (cap < p->min_capacity)
+    cap = p->min_capacity;
+  if (d->sed > cap || dh > 0.0) {
+    double dep = dh > 0.0 ? (dh < d->sed ? dh : d->sed)
+                          : (d->sed - cap) * p->deposit_rate;
+    d->sed -= dep;
+    deposit(h, nx, i, fx, fy, dep, st);
+  } else {
+    double amount = (cap - d->sed) * p->erode_rate;
+    if (amount > -dh)
+      amount = -dh;
+    double removed = 0.0;
+    const int r = brush->radius;
+    if (ix >= r && iy >= r && ix + r < nx && iy + r < ny) {
+      double *c = h + i;
+      for (int k = 0; k < brush->n; ++k)
+        c[brush->off[k]] -= amount * brush->w[k];
+      removed = amount;
+    } else {
+      for (int k = 0; k < brush->n; ++k) {
+        int cx = ix + brush->dx[k], cy = iy + brush->dy[k];
+        if (cx < 0 || cy < 0 || cx >= nx || cy >= ny)
+          continue;
+        double a = amount * brush->w[k];
+        h[(size_t)cy * nx + cx] -= a;
+        removed += a;
+      }
+    }
+    d->sed += removed;
+    st->eroded += removed;
+  }
+  double v2 = d->speed * d->speed - dh * p->gravity;
+  d->speed = v2 > 0.0 ? sqrt(v2) : 0.0;
+  d->water *= 1.0 - p->evaporation;
+  return 1;
+}
+
+/** \brief Shared state of one hydraulic run. */
+typedef struct {
+  double *h;
+  int nx, ny;
+  const ErosionParams *p;
+  Brush brush;
+  int tile, tiles_x;
+  const int *phase_tiles; /* tiles of the current colour */
+  long *quota;            /* droplets per tile over the whole run */
+  ErosionStats *stats;    /* per tile */
+  int batch, nbatches;
+} HydroCtx;
+
+static void hydro_tile(void *ctx, int task, int thread) {
+  (void)thread;
+  HydroCtx *c = (HydroCtx *)ctx;
+  int t = c->phase_tiles[task];
+  int x0 = (t % c->tiles_x) * c->tile, y0 = (t / c->tiles_x) * c->tile;
+  int x1 = x0 + c->tile < c->nx - 1 ? x0 + c->tile : c->nx - 1;
+  int y1 = y0 + c->tile < c->ny - 1 ? y0 + c->tile : c->ny - 1;
+  long q = c->quota[t];
+  long n = q * (c->batch + 1) / c->nbatches - q * c->batch / c->nbatches;
+  uint64_t s = ((uint64_t)c->p->seed << 32) ^
+               ((uint64_t)t * 0x9e3779b1u + (uint64_t)c->batch * 0x85ebca6bu);
+  /* a few droplets in flight at once: their dependency chains overlap */
+  Droplet lane[DROPLET_LANES];
+  int live = 0;
+  long spawned = 0;
+  ErosionStats st = c->stats[t];
+  while (live < DROPLET_LANES && spawned < n) {
+    double x = x0 + unit(&s) * (x1 - x0);
+    droplet_start(&lane[live++], x, y0 + unit(&s) * (y1 - y0));
+    ++spawned;
+  }
+  while (live > 0) {
+    for (int k = 0; k < live;) {
+      if (droplet_step(&lane[k], c->h, c->nx, c->ny, c->p, &c->brush, &st)) {
+        ++k;
+      } else if (spawned < n) {
+        double x = x0 + unit(&s) * (x1 - x0);
+        droplet_start(&lane[k++], x, y0 + unit(&s) * (y1 - y0));
+        ++spawned;
+      } else {
+        lane[k] = lane[--live];
+      }
+    }
+  }
+  c->stats[t] = st;
+}
+
+int erosion_hydraulic(double *h, int nx, int ny, const ErosionParams *p,
+                      ErosionStats *stats) {
+  if (!h || !p || nx < 2 || ny < 2 || p->droplets < 0 || p->max_steps < 1 ||
+      p->radius < 1 || p->radius > BRUSH_MAX_RADIUS)
+    return -1;
+  HydroCtx *c = (HydroCtx *)calloc(1, sizeof(HydroCtx));
+  if (!c)
+    return -1;
+  c->h = h;
+  c->nx = nx;
+  c->ny = ny;
+  c->p = p;
+  brush_init(&c->brush, p->radius, nx);
+  /* a droplet moves at most one cell per step; same-colour tiles are one
+   * tile apart, so reach <= tile / 2 keeps them disjoint */
+  int reach = p->max_steps + p->radius + 2;
+  c->tile = 2 * reach;
+  c->tiles_x = (nx - 1 + c->tile - 1) / c->tile;
+  int tiles_y = (ny - 1 + c->tile - 1) / c->tile;
+  int ntiles = c->tiles_x * tiles_y;
+  c->quota = (long *)calloc((size_t)ntiles, sizeof(long));
+  c->stats = (ErosionStats *)calloc((size_t)ntiles, sizeof(ErosionStats));
+  int *order = (int *)malloc((size_t)ntiles * sizeof(int));
+  if (!c->quota || !c->stats || !order) {
+    free(c->quota);
+    free(c->stats);
+    free(order);
+    free(c);
+    return -1;
+  }
+  /* droplets per tile in proportion to its area (exact total) */
+  double area = (double)(nx - 1) * (ny - 1);
+  long given = 0;
+  double acc = 0.0;
+  for (int t = 0; t < ntiles; ++t) {
+    int x0 = (t % c->tiles_x) * c->tile, y0 = (t / c->tiles_x) * c->tile;
+    int w = (x0 + c->tile < nx - 1 ? c->tile : nx - 1 - x0);
+    int hgt = (y0 + c->tile < ny - 1 ? c->tile : ny - 1 - y0);
+    acc += (double)p->droplets * w * hgt / area;
+    long upto = t == ntiles - 1 ? p->droplets : (long)(acc + 0.5);
+    c->quota[t] = upto - given;
+    given = upto;
+  }
+  /* interleave the colours in batches so no region is eroded all at once */
+  long per_tile = p->droplets / (ntiles ? ntiles : 1);
+  c->nbatches = (int)(per_tile / 256);
+  if (c->nbatches < 1)
+    c->nbatches = 1;
+  if (c->nbatches > 32)
+    c->nbatches = 32;
+  for (c->batch = 0; c->batch < c->nbatches; ++c->batch) {
+    for (int colour = 0; colour < 4; ++colour) {
+      int m = 0;
+      for (int t = 0; t < ntiles; ++t) {
+        int tx = t % c->tiles_x, ty = t / c->tiles_x;
+        if ((tx & 1) + 2 * (ty & 1) == colour)
+          order[m++] = t;
+      }
+      c->phase_tiles = order;
+      parallel_for(m, p->threads, hydro_tile, c);
+    }
+  }
+  if (stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int t = 0; t < ntiles; ++t) {
+      stats->eroded += c->stats[t].eroded;
+      stats->deposited += c->stats[t].deposited;
+      stats->steps += c->stats[t].steps;
+    }
+  }
+  free(c->quota);
+  free(c->stats);
+  free(order);
+  free(c);
+  return 0;
+}
+
+/* ---------------- Thermal erosion ---------------- */
+
+static const int NB_DX[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+static const int NB_DY[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+static const double NB_DIST[8] = {M_SQRT2, 1.0, M_SQRT2, 1.0,
+                                  1.0,     M_SQRT2, 1.0, M_SQRT2};
+
+/** \brief Shared state of one thermal sweep. */
+typedef struct {
+  const double *h;
+  double *out;  /* height leaving each cell */
+  double *norm; /* out / (sum of excess), 0 if none */
+  double *next;
+  int nx, ny;
+  double talus, rate;
+  double drop[8]; /* talus * neighbour distance */
+} ThermalCtx;
+
+/** \brief Whether neighbour k of (x, y) lies on the grid. */
+static inline int on_grid(const ThermalCtx *c, int x, int y, int k) {
+  int qx = x + NB_DX[k], qy = y + NB_DY[k];
+  return qx >= 0 && qy >= 0 && qx < c->nx && qy < c->ny;
+}
+
+/** \brief Outflow of cell (x, y); interior cells skip the bounds tests. */
+static inline void outflow_cell(ThermalCtx *c, int x, int y, int interior) {
+  size_t i = (size_t)y * c->nx + x;
+  double sum = 0.0, maxe = 0.0;
+  for (int k = 0; k < 8; ++k) {
+    if (!interior && !on_grid(c, x, y, k))
+      continue;
+    double e = c->h[i] - c->h[i + NB_DY[k] * c->nx + NB_DX[k]] - c->drop[k];
+    e = e > 0.0 ? e : 0.0;
+    sum += e;
+    maxe = e > maxe ? e : maxe;
+  }
+  c->out[i] = 0.5 * c->rate * maxe;
+  c->norm[i] = sum > 0.0 ? c->out[i] / sum : 0.0;
+}
+
+/** \brief New height of (x, y): own outflow plus neighbours' inflow. */
+static inline void gather_cell(ThermalCtx *c, int x, int y, int interior) {
+  size_t i = (size_t)y * c->nx + x;
+  double v = c->h[i] - c->out[i];
+  for (int k = 0; k < 8; ++k) {
+    if (!interior && !on_grid(c, x, y, k))
+      continue;
+    size_t j = i + NB_DY[k] * c->nx + NB_DX[k];
+    double e = c->h[j] - c->h[i] - c->drop[k];
+    v += e > 0.0 ? c->norm[j] * e : 0.0;
+  }
+  c->next[i] = v;
+}
+
+/** \brief Pass 1 over row y. */
+static void thermal_outflow(void *ctx, int y, int thread) {
+  (void)thread;
+  ThermalCtx *c = (ThermalCtx *)ctx;
+  int edge_row = y == 0 || y == c->ny - 1;
+  for (int x = 0; x < c->nx; ++x)
+    outflow_cell(c, x, y, !edge_row && x > 0 && x < c->nx - 1);
+}
+
+/** \brief Pass 2 over row y. */
+static void thermal_gather(void *ctx, int y, int thread) {
+  (void)thread;
+  ThermalCtx *c = (ThermalCtx *)ctx;
+  int edge_row = y == 0 || y == c->ny - 1;
+  for (int x = 0; x < c->nx; ++x)
+    gather_cell(c, x, y, !edge_row && x > 0 && x < c->nx - 1);
+}
+
+int erosion_thermal(double *h, int nx, int ny, double talus, double rate,
+                    int iters, int threads) {
+  if (!h || nx < 1 || ny < 1 || iters < 0 || talus < 0.0 || rate < 0.0 ||
+      rate > 1.0)
+    return -1;
+  size_t n = (size_t)nx * ny;
+  double *buf = (double *)malloc(3 * n * sizeof(double));
+  if (!buf)
+    return -1;
+  ThermalCtx c = {h, buf, buf + n, buf + 2 * n, nx, ny, talus, rate, {0}};
+  for (int k = 0; k < 8; ++k)
+    c.drop[k] = talus * NB_DIST[k];
+  /* ping-pong between h and the scratch grid, ending in h */
+  for (int it = 0; it < iters; ++it) {
+    parallel_for(ny, threads, thermal_outflow, &c);
+    parallel_for(ny, threads, thermal_gather, &c);
+    double *prev = (double *)c.h;
+    c.h = c.next;
+    c.next = prev;
+  }
+  if (c.h != h)
+    memcpy(h, c.h, n * sizeof(double));
+  free(buf);
+  return 0;
+}
@@ -0,0 +1,445 @@
+/**
+ * \file fdtd.c
+ * \brief TMz Yee-grid FDTD with CPML, fused row sweeps and row-band threads.
+ */
+#include "fdtd.h"
+#include "big_alloc.h"
+#include "fft.h"
+#include "parallel.h"
+#include "physics_constants.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** \brief Update coefficients of one material at the grid's dt and dx. */
+typedef struct {
+  const MaterialProperties *props;
+  float ca, cb, db;
+} FdtdMaterial;
+
+typedef struct {
+  int x, y;
+  double f0, amplitude;
+} FdtdSource;
+
+typedef struct {
+  int x, y;
+  double *v;
+  size_t n, cap;
+} FdtdProbe;
+
+struct FdtdGrid {
+  int nx, ny, pml;
+  double dx, dt;
+  long step;
+  float *ez, *hx, *hy; /* Hx(i, j+1/2), Hy(i+1/2, j) share node indices */
+  float *ca, *cb, *db; /* per-node copies of the material coefficients */
+  unsigned char *mat;
+  FdtdMaterial mats[FDTD_MAX_MATERIALS];
+  int nmats;
+  /* CPML recursion coefficients along each axis at E nodes and H half-nodes */
+  float *bex, *cex, *bhx, *chx, *bey, *cey, *bhy, *chy;
+  /* CPML memory: x strips are ny rows of 2*pml, y strips 2*pml rows of nx */
+  float *psi_ezx, *psi_hyx, *psi_ezy, *psi_hxy;
+  FdtdSource src[FDTD_MAX_SOURCES];
+  int nsrc;
+  FdtdProbe probe[FDTD_MAX_PROBES];
+  int nprobe;
+};
+
+/** \brief Properties used for nodes no material was painted on. */
+static const MaterialProperties FDTD_VACUUM = {
+    .relative_permittivity = 1.0,
+    .electrical_conductivity = 0.0,
+    .relative_permeability = 1.0,
+    .material_class = "Vacuum"};
+
+static FdtdMaterial material_coefficients(const FdtdGrid *g,
+                                          const MaterialProperties *m) {
+  FdtdMaterial c;
+  double eps = PHYSICS_EPSILON0 * (m->relative_permittivity > 0.0
+                                       ? m->relative_permittivity
+                                       : 1.0);
+  double mu = PHYSICS_MU0 * (m->relative_permeability > 0.0
+                                 ? m->relative_permeability
+                                 : 1.0);
+  double sigma = m->electrical_conductivity;
+  c.props = m;
+  if (sigma > 0.0) {
+    /* exponential update: exact decay for sigma*dt/eps >> 1 (metals) */
+    double r = sigma * g->dt / eps;
+    c.ca = (float)exp(-r);
+    c.cb = (float)(-expm1(-r) / (sigma * g->dx));
+  } else {
+    c.ca = 1.0f;
+    c.cb = (float)(g->dt / (eps * g->dx));
+  }
+  c.db = (float)(g->dt / (mu * g->dx));
+  return c;
+}
+
+/** \brief CPML b and c at position p (cells, may be a half-node) on an axis
+ * of n nodes: cubic conductivity grading, linear CFS alpha, kappa = 1. */
+static void cpml_coefficients(const FdtdGrid *g, int n, double p, float *b,
+                              float *c) {
+  double depth = g->pml - p;
+  double far = p - (n - 1 - g->pml);
+  depth = far > depth ? far : depth;
+  if (g->pml == 0 || depth <= 0.0) {
+    *b = 1.0f;
+    *c = 0.0f;
+    return;
+  }
+  double d = depth / g->pml;
+  double eta0 = sqrt(PHYSICS_MU0 / PHYSICS_EPSILON0);
+  double sigma_max = 0.8 * 4.0 / (eta0 * g->dx);
+  double sigma = sigma_max * d * d * d;
+  double alpha = 0.05 * sigma_max * (1.0 - d);
+  double bb = exp(-(sigma + alpha) * g->dt / PHYSICS_EPSILON0);
+  *b = (float)bb;
+  *c = (float)(sigma + alpha > 0.0 ? sigma / (sigma + alpha) * (bb - 1.0)
+                                   : 0.0);
+}
+
+FdtdGrid *fdtd_create(int nx, int ny, double dx, int pml) {
+  if (pml < 0 || nx < 2 * pml + 3 || ny < 2 * pml + 3 || !(dx > 0.0))
+    return NULL;
+  FdtdGrid *g = (FdtdGrid *)calloc(1, sizeof(*g));
+  if (!g)
+    return NULL;
+  size_t n = (size_t)nx * ny;
+  size_t strip = (size_t)2 * pml * (nx > ny ? nx : ny);
+  g->nx = nx;
+  g->ny = ny;
+  g->pml = pml;
+  g->dx = dx;
+  g->dt = 0.99 * dx / (PHYSICS_C * sqrt(2.0));
+  /* six planes (ez, hx, hy, ca, cb, db), each touched by its row bands */
+  g->ez = (float *)big_alloc(6 * n * sizeof(float), 0, 6, NULL);
+  g->mat = (unsigned char *)calloc(n, 1);
+  g->bex = (float *)malloc((size_t)4 * (nx + ny) * sizeof(float));
+  g->psi_ezx = (float *)calloc(4 * strip + 1, sizeof(float));
+  if (!g->ez || !g->mat || !g->bex || !g->psi_ezx) {
+    fdtd_destroy(g);
+    return NULL;
+  }
+  g->hx = g->ez + n;
+  g->hy = g->hx + n;
+  g->ca = g->hy + n;
+  g->cb = g->ca + n;
+  g->db = g->cb + n;
+  g->cex = g->bex + nx;
+  g->bhx = g->cex + nx;
+  g->chx = g->bhx + nx;
+  g->bey = g->chx + nx;
+  g->cey = g->bey + ny;
+  g->bhy = g->cey + ny;
+  g->chy = g->bhy + ny;
+  g->psi_hyx = g->psi_ezx + strip;
+  g->psi_ezy = g->psi_hyx + strip;
+  g->psi_hxy = g->psi_ezy + strip;
+  for (int i = 0; i < nx; ++i) {
+    cpml_coefficients(g, nx, i, &g->bex[i], &g->cex[i]);
+    cpml_coefficients(g, nx, i + 0.5, &g->bhx[i], &g->chx[i]);
+  }
+  for (int j = 0; j < ny; ++j) {
+    cpml_coefficients(g, ny, j, &g->bey[j], &g->cey[j]);
+    cpml_coefficients(g, ny, j + 0.5, &g->bhy[j], &g->chy[j]);
+  }
+  g->mats[0] = material_coefficients(g, &FDTD_VACUUM);
+  g->nmats = 1;
+  for (size_t i = 0; i < n; ++i) {
+    g->ca[i] = g->mats[0].ca;
+    g->cb[i] = g->mats[0].cb;
+    g->db[i] = g->mats[0].db;
+  }
+  return g;
+}
+
+void fdtd_destroy(FdtdGrid *g) {
+  if (!g)
+    return;
+  for (int p = 0; p < g->nprobe; ++p)
+    free(g->probe[p].v);
+  big_free(g->ez, (size_t)6 * g->nx * g->ny * sizeof(float));
+  free(g->mat);
+  free(g->bex);
+  free(g->psi_ezx);
+  free(g);
+}
+
+double fdtd_dt(const FdtdGrid *g) { return g ? g->dt : 0.0; }
+
+long fdtd_steps(const FdtdGrid *g) { return g ? g->step : 0; }
+
+const float *fdtd_ez(const FdtdGrid *g) { return g ? g->ez : NULL; }
+
+int fdtd_paint_disc(FdtdGrid *g, double cx, double cy, double radius,
+                    const MaterialProperties *m) {
+  if (!g || !m || !(radius > 0.0))
+    return -1;
+  int id = 0;
+  while (id < g->nmats && g->mats[id].props != m)
+    ++id;
+  if (id == g->nmats) {
+    if (g->nmats == FDTD_MAX_MATERIALS)
+      return -1;
+    g->mats[g->nmats++] = material_coefficients(g, m);
+  }
+  const FdtdMaterial *c = &g->mats[id];
+  double r = radius / g->dx, x0 = cx / g->dx, y0 = cy / g->dx;
+  int ylo = (int)ceil(y0 - r), yhi = (int)floor(y0 + r);
+  ylo = ylo < 0 ? 0 : ylo;
+  yhi = yhi >= g->ny ? g->ny - 1 : yhi;
+  for (int y = ylo; y <= yhi; ++y)
+    for (int x = 0; x < g->nx; ++x) {
+      double ddx = x - x0, ddy = y - y0;
+      if (ddx * ddx + ddy * ddy > r * r)
+        continue;
+      size_t i = (size_t)y * g->nx + x;
+      g->mat[i] = (unsigned char)id;
+      g->ca[i] = c->ca;
+      g->cb[i] = c->cb;
+      g->db[i] = c->db;
+    }
+  return 0;
+}
+
+int fdtd_add_coin(FdtdGrid *g, const CoinSpec *coin, double cx, double cy) {
+  if (!coin || !(coin->diameter_mm > 0.0))
+    return -1;
+  const MaterialProperties *m = get_material_properties(coin);
+  if (!m)
+    return -1;
+  return fdtd_paint_disc(g, cx, cy, 0.5e-3 * coin->diameter_mm, m);
+}
+
+int fdtd_add_source(FdtdGrid *g, int x, int y, double f0, double amplitude) {
+  if (!g || g->nsrc == FDTD_MAX_SOURCES || x < 1 || y < 1 ||
+      x > g->nx - 2 || y > g->ny - 2 || !(f0 > 0.0))
+    return -1;
+  FdtdSource *s = &g->src[g->nsrc++];
+  s->x = x;
+  s->y = y;
+  s->f0 = f0;
+  s->amplitude = amplitude;
+  return 0;
+}
+
+int fdtd_add_probe(FdtdGrid *g, int x, int y) {
+  if (!g || g->nprobe == FDTD_MAX_PROBES || x < 0 || y < 0 || x >= g->nx ||
+      y >= g->ny)
+    return -1;
+  FdtdProbe *p = &g->probe[g->nprobe];
+  memset(p, 0, sizeof(*p));
+  p->x = x;
+  p->y = y;
+  return g->nprobe++;
+}
+
+size_t fdtd_probe_samples(const FdtdGrid *g, int probe,
+                          const double **samples) {
+  if (!g || probe < 0 || probe >= g->nprobe)
+    return 0;
+  if (samples)
+    *samples = g->probe[probe].v;
+  return g->probe[probe].n;
+}
+
+size_t fdtd_probe_spectrum(const FdtdGrid *g, int probe, double *freq,
+                           double *amp, size_t max_bins) {
+  const double *v;
+  size_t n = fdtd_probe_samples(g, probe, &v);
+  return n ? fft_amplitude_spectrum(v, n, g->dt, freq, amp, max_bins) : 0;
+}
+
+/* ---------------- Row kernels ---------------- */
+
+/** \brief Slot of an x position inside the 2*pml wide CPML strips, given
+ * the first position of the far layer. */
+static inline int strip_slot(int p, int pml, int far_start) {
+  return p < pml ? p : p - far_start + pml;
+}
+
+/** \brief Hx row j (between Ez rows j and j+1) and Hy row j. */
+static void update_h_row(FdtdGrid *g, int j) {
+  int nx = g->nx, ny = g->ny, pml = g->pml;
+  const float *restrict ez = g->ez + (size_t)j * nx;
+  const float *restrict db = g->db + (size_t)j * nx;
+  float *restrict hy = g->hy + (size_t)j * nx;
+  for (int i = 0; i < nx - 1; ++i)
+    hy[i] += db[i] * (ez[i + 1] - ez[i]);
+  if (pml) {
+    float *psi = g->psi_hyx + (size_t)j * 2 * pml;
+    for (int i = 0; i < nx - 1; ++i) {
+      if (i == pml)
+        i = nx - 1 - pml; /* skip to the far layer */
+      int k = strip_slot(i, pml, nx - 1 - pml);
+      psi[k] = g->bhx[i] * psi[k] + g->chx[i] * (ez[i + 1] - ez[i]);
+      hy[i] += db[i] * psi[k];
+    }
+  }
+  if (j >= ny - 1)
+    return;
+  const float *restrict en = ez + nx;
+  float *restrict hx = g->hx + (size_t)j * nx;
+  for (int i = 0; i < nx; ++i)
+    hx[i] -= db[i] * (en[i] - ez[i]);
+  if (pml && (j < pml || j >= ny - 1 - pml)) {
+    float *restrict psi =
+        g->psi_hxy + (size_t)strip_slot(j, pml, ny - 1 - pml) * nx;
+    float b = g->bhy[j], c = g->chy[j];
+    for (int i = 0; i < nx; ++i) {
+      psi[i] = b * psi[i] + c * (en[i] - ez[i]);
+      hx[i] -= db[i] * psi[i];
+    }
+  }
+}
+
+/** \brief Ez row j from Hx rows j-1, j and Hy row j; then sources and
+ * probes on the row (sample index s of this run). */
+static void update_e_row(FdtdGrid *g, int j, long s) {
+  int nx = g->nx, ny = g->ny, pml = g->pml;
+  if (j >= 1 && j <= ny - 2) {
+    float *restrict ez = g->ez + (size_t)j * nx;
+    const float *restrict hy = g->hy + (size_t)j * nx;
+    const float *restrict hx = g->hx + (size_t)j * nx;
+    const float *restrict hp = hx - nx;
+    const float *restrict ca = g->ca + (size_t)j * nx;
+    const float *restrict cb = g->cb + (size_t)j * nx;
+    for (int i = 1; i < nx - 1; ++i)
+      ez[i] = ca[i] * ez[i] + cb[i] * ((hy[i] - hy[i - 1]) - (hx[i] - hp[i]));
+    if (pml) {
+      float *psi = g->psi_ezx + (size_t)j * 2 * pml;
+      for (int i = 1; i < nx - 1; ++i) {
+        if (i == pml)
+          i = nx - pml;
+        int k = strip_slot(i, pml, nx - pml);
+        psi[k] = g->bex[i] * psi[k] + g->cex[i] * (hy[i] - hy[i - 1]);
+        ez[i] += cb[i] * psi[k];
+      }
+      if (j < pml || j >= ny - pml) {
+        float *restrict py =
+            g->psi_ezy + (size_t)strip_slot(j, pml, ny - pml) * nx;
+        float b = g->bey[j], c = g->cey[j];
+        for (int i = 1; i < nx - 1; ++i) {
+          py[i] = b * py[i] + c * (hx[i] - hp[i]);
+          ez[i] -= cb[i] * py[i];
+        }
+      }
+    }
+  }
+  double t = (g->step + s + 1) * g->dt;
+  for (int k = 0; k < g->nsrc; ++k) {
+    const FdtdSource *src = &g->src[k];
+    if (src->y != j)
+      continue;
+    double tau = 1.0 / src->f0, u = t - 4.0 * tau;
+    g->ez[(size_t)j * nx + src->x] +=
+        (float)(src->amplitude * exp(-(u / tau) * (u / tau)) *
+                sin(2.0 * M_PI * src->f0 * u));
+  }
+  for (int k = 0; k < g->nprobe; ++k) {
+    FdtdProbe *p = &g->probe[k];
+    if (p->y == j)
+      p->v[p->n + s] = g->ez[(size_t)j * nx + p->x];
+  }
+}
+
+typedef struct {
+  FdtdGrid *g;
+  int steps, bands;
+  ParallelBarrier *barrier;
+} FdtdRun;
+
+/** \brief One row band for all steps. H of the band's last row goes first
+ * (it reads Ez of the next band before that band updates it). Then one
+ * ascending sweep does H row j then Ez row j, whose inputs are the finished
+ * H rows j-1 and j. */
+static void fdtd_band(void *ctx, int band, int thread) {
+  (void)thread;
+  FdtdRun *r = (FdtdRun *)ctx;
+  FdtdGrid *g = r->g;
+  int j0 = (int)((long)band * g->ny / r->bands);
+  int j1 = (int)((long)(band + 1) * g->ny / r->bands);
+  for (long s = 0; s < r->steps; ++s) {
+    update_h_row(g, j1 - 1);
+    parallel_barrier_wait(r->barrier);
+    for (int j = j0; j < j1 - 1; ++j) {
+      update_h_row(g, j);
+      update_e_row(g, j, s);
+    }
+    update_e_row(g, j1 - 1, s);
+    parallel_barrier_wait(r->barrier);
+  }
+}
+
+int fdtd_run(FdtdGrid *g, int steps, int threads) {
+  if (!g || steps < 0)
+    return -1;
+  for (int k = 0; k < g->nprobe; ++k) {
+    FdtdProbe *p = &g->probe[k];
+    if (p->n + steps > p->cap) {
+      size_t cap = p->cap ? p->cap : 256;
+      while (cap < p->n + steps)
+        cap *= 2;
+      double *v = (double *)realloc(p->v, cap * sizeof(double));
+      if (!v)
+        return -1;
+      p->v = v;
+      p->cap = cap;
+    }
+  }
+  int bands = threads > 0 ? threads : parallel_default_threads();
+#ifdef COINSORTER_NO_THREADS
+  bands = 1; /* bands would run one after another and never meet */
+#endif
+  if (bands > 256)
+    bands = 256;
+  if (bands > g->ny / 4)
+    bands = g->ny / 4 > 0 ? g->ny / 4 : 1;
+  FdtdRun r = {g, steps, bands, parallel_barrier_create(bands)};
+  if (!r.barrier)
+    return -1;
+  if (parallel_for_team(bands, bands, fdtd_band, &r) < 0) {
+    /* not enough threads for the bands: one band (no barrier) gives the
+     * same fields */
+    parallel_barrier_destroy(r.barrier);
+    r.barrier = NULL;
+    r.bands = 1;
+    fdtd_band(&r, 0, 0);
+  }
+  parallel_barrier_destroy(r.barrier);
+  for (int k = 0; k < g->nprobe; ++k)
+    g->probe[k].n += steps;
+  g->step += steps;
+  return 0;
+}
+
+double fdtd_energy(const FdtdGrid *g, double *density) {
+  if (!g)
+    return 0.0;
+  int nx = g->nx, ny = g->ny;
+  double total = 0.0;
+  for (int j = 0; j < ny; ++j)
+    for (int i = 0; i < nx; ++i) {
+      size_t k = (size_t)j * nx + i;
+      const MaterialProperties *m = g->mats[g->mat[k]].props;
+      /* H from the two neighbouring half-nodes (one at the edges) */
+      double hx = j == 0 ? g->hx[k]
+                  : j == ny - 1 ? g->hx[k - nx]
+                                : 0.5 * (g->hx[k] + g->hx[k - nx]);
+      double hy = i == 0 ? g->hy[k]
+                  : i == nx - 1 ? g->hy[k - 1]
+                                : 0.5 * (g->hy[k] + g->hy[k - 1]);
+      double mu = PHYSICS_MU0 * (m->relative_permeability > 0.0
+                                     ? m->relative_permeability
+                                     : 1.0);
+      double u = observable_em_energy_density(fabs(g->ez[k]),
+                                              mu * sqrt(hx * hx + hy * hy), m);
+      if (density)
+        density[k] = u;
+      total += u;
+    }
+  return total * g->dx * g->dx;
+}
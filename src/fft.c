@@ -0,0 +1,159 @@
+/**
+ * \file fft.c
+ * \brief Iterative radix-2 FFT (bit reversal + butterflies), plans and
+ * spectra.
+ */
+#include "fft.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+size_t fft_next_pow2(size_t n) {
+  size_t p = 1;
+  while (p < n)
+    p <<= 1;
+  return p;
+}
+
+struct FftPlan {
+  size_t n;
+  size_t nswaps;
+  size_t *swaps; /* bit-reversal pairs (i, j), i < j */
+  double *twr;   /* stage with half-size h starts at h - 1: cos(pi k/h) */
+  double *twi;   /* -sin(pi k/h), the forward twiddles */
+};
+
+FftPlan *fft_plan_create(size_t n) {
+  if (n == 0 || (n & (n - 1)) != 0)
+    return NULL;
+  FftPlan *p = (FftPlan *)calloc(1, sizeof(FftPlan));
+  if (!p)
+    return NULL;
+  p->n = n;
+  p->swaps = (size_t *)malloc(n * sizeof(size_t));
+  p->twr = (double *)malloc(2 * n * sizeof(double));
+  if (!p->swaps || !p->twr) {
+    fft_plan_destroy(p);
+    return NULL;
+  }
+  p->twi = p->twr + n;
+  for (size_t i = 1, j = 0; i < n; ++i) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1)
+      j ^= bit;
+    j |= bit;
+    if (i < j) {
+      p->swaps[2 * p->nswaps] = i;
+      p->swaps[2 * p->nswaps + 1] = j;
+      p->nswaps++;
+    }
+  }
+  /* twiddles computed directly (no recurrence drift on long transforms) */
+  for (size_t half = 1; half < n; half <<= 1)
+    for (size_t k = 0; k < half; ++k) {
+      double a = M_PI * (double)k / (double)half;
+      p->twr[half - 1 + k] = cos(a);
+      p->twi[half - 1 + k] = -sin(a);
+    }
+  return p;
+}
+
+void fft_plan_destroy(FftPlan *plan) {
+  if (!plan)
+    return;
+  free(plan->swaps);
+  free(plan->twr);
+  free(plan);
+}
+
+size_t fft_plan_size(const FftPlan *plan) { return plan ? plan->n : 0; }
+
+int fft_execute(const FftPlan *plan, double *re, double *im, int inverse) {
+  if (!plan || !re || !im)
+    return -1;
+  size_t n = plan->n;
+  for (size_t s = 0; s < plan->nswaps; ++s) {
+    size_t i = plan->swaps[2 * s], j = plan->swaps[2 * s + 1];
+    double t = re[i];
+    re[i] = re[j];
+    re[j] = t;
+    t = im[i];
+    im[i] = im[j];
+    im[j] = t;
+  }
+  /* the inverse runs the forward butterflies on the conjugate */
+  if (inverse)
+    for (size_t i = 0; i < n; ++i)
+      im[i] = -im[i];
+  for (size_t half = 1; half < n; half <<= 1) {
+    const double *twr = plan->twr + half - 1, *twi = plan->twi + half - 1;
+    for (size_t s = 0; s < n; s += 2 * half) {
+      double *ar = re + s, *ai = im + s, *br = ar + half, *bi = ai + half;
+      for (size_t k = 0; k < half; ++k) {
+        double xr = br[k] * twr[k] - bi[k] * twi[k];
+        double xi = br[k] * twi[k] + bi[k] * twr[k];
+        br[k] = ar[k] - xr;
+        bi[k] = ai[k] - xi;
+        ar[k] += xr;
+        ai[k] += xi;
+      }
+    }
+  }
+  if (inverse)
+    for (size_t i = 0; i < n; ++i) {
+      re[i] /= (double)n;
+      im[i] = -im[i] / (double)n;
+    }
+  return 0;
+}
+
+int fft_real_pair(const FftPlan *plan, double *re, double *im, double *mag1,
+                  double *mag2) {
+  if (!plan || !re || !im || !mag1)
+    return -1;
+  fft_execute(plan, re, im, 0);
+  size_t n = plan->n;
+  for (size_t k = 0; k <= n / 2; ++k) {
+    size_t m = (n - k) & (n - 1);
+    double ar = re[k], ai = im[k], br = re[m], bi = -im[m];
+    mag1[k] = 0.5 * hypot(ar + br, ai + bi);
+    if (mag2)
+      mag2[k] = 0.5 * hypot(ar - br, ai - bi);
+  }
+  return 0;
+}
+
+int fft_radix2(double *re, double *im, size_t n, int inverse) {
+  if (!re || !im || n == 0 || (n & (n - 1)) != 0)
+    return -1;
+  FftPlan *p = fft_plan_create(n);
+  if (!p)
+    return -1;
+  fft_execute(p, re, im, inverse);
+  fft_plan_destroy(p);
+  return 0;
+}
+
+size_t fft_amplitude_spectrum(const double *x, size_t n, double dt,
+                              double *freq, double *amp, size_t max_bins) {
+  if (!x || !amp || n == 0 || !(dt > 0.0) || max_bins == 0)
+    return 0;
+  size_t N = fft_next_pow2(n);
+  double *re = (double *)calloc(2 * N, sizeof(double));
+  if (!re)
+    return 0;
+  double *im = re + N;
+  memcpy(re, x, n * sizeof(double));
+  if (fft_radix2(re, im, N, 0) != 0) {
+    free(re);
+    return 0;
+  }
+  size_t bins = N / 2 + 1 < max_bins ? N / 2 + 1 : max_bins;
+  for (size_t k = 0; k < bins; ++k) {
+    amp[k] = hypot(re[k], im[k]) * dt;
+    if (freq)
+      freq[k] = (double)k / ((double)N * dt);
+  }
+  free(re);
+  return bins;
+}
@@ -0,0 +1,525 @@
+/** \file field_codec.c
+ *  \brief Predictive byte-plane codec for double fields, coded by row band.
+ *
+ *  Layout: a 64-byte header, ntiles + 1 band offsets (relative to the end of
+ *  the offset table), then the bands. A band is a 32-bit escape count, the
+ *  escaped values, and eight byte planes of the zigzag codes, least
+ *  significant first, each a mode byte followed by its payload. All fields
+ *  are host-endian; the header carries an endian tag and a checksum
+ *  (checkpoint_hash) of everything after it.
+ *
+ *  The lossy quantization step is a power of two, so step * q is exact and
+ *  the reconstruction p + step * q rounds the same whether or not the
+ *  compiler fuses it into a multiply-add; encoder and decoder always agree.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "field_codec.h"
+#include "checkpoint.h"
+#include "parallel.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FC_MAGIC "CSFIELD"
+#define FC_VERSION 1u
+#define FC_ENDIAN 0x01020304u
+
+typedef struct {
+  char magic[8];      /* "CSFIELD\0" */
+  uint32_t version;   /* FC_VERSION */
+  uint32_t endian;    /* FC_ENDIAN as written by the host */
+  uint32_t nx, ny;
+  uint32_t tile_rows; /* rows per band (the last may be shorter) */
+  uint32_t ntiles;
+  double error_bound; /* 0 for lossless */
+  double step;        /* quantization step (0 for lossless) */
+  uint64_t bytes;     /* total length including header */
+  uint64_t checksum;  /* checkpoint_hash over bytes [64, bytes) */
+} FieldHeader;
+
+typedef char fc_header_is_64_bytes[sizeof(FieldHeader) == 64 ? 1 : -1];
+
+/* Byte plane storage modes. */
+enum { PLANE_ZERO = 0, PLANE_NIBBLE = 1, PLANE_SPARSE = 2, PLANE_RAW = 3 };
+
+/** \brief Order-preserving map of a double's bits to an unsigned integer. */
+static inline uint64_t ordered(double v) {
+  uint64_t u;
+  memcpy(&u, &v, 8);
+  uint64_t neg = (uint64_t)0 - (u >> 63);
+  return u ^ (neg | 1ull << 63);
+}
+
+static inline double from_ordered(uint64_t u) {
+  uint64_t neg = (u >> 63) - 1; /* all ones for negative values */
+  u ^= neg | 1ull << 63;
+  double v;
+  memcpy(&v, &u, 8);
+  return v;
+}
+
+static inline uint64_t zigzag(int64_t r) {
+  return ((uint64_t)r << 1) ^ (uint64_t)(r >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t z) {
+  return (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+}
+
+/** \brief Lorenzo prediction of row[x]; up is NULL on a band's first row. */
+static inline double predict(const double *row, const double *up, int x) {
+  if (!up)
+    return x ? row[x - 1] : 0.0;
+  return x ? row[x - 1] + up[x] - up[x - 1] : up[0];
+}
+
+/** \brief Store byte plane k of codes[0..n) at dst; returns bytes used. */
+static size_t put_plane(unsigned char *dst, const uint64_t *codes, size_t n,
+                        unsigned k, unsigned char *tmp) {
+  unsigned char max = 0;
+  size_t nz = 0;
+  for (size_t i = 0; i < n; ++i) {
+    unsigned char b = (unsigned char)(codes[i] >> (8 * k));
+    tmp[i] = b;
+    max = b > max ? b : max;
+    nz += b != 0;
+  }
+  if (max == 0) {
+    dst[0] = PLANE_ZERO;
+    return 1;
+  }
+  size_t nibble = (n + 1) / 2, sparse = (n + 7) / 8 + nz;
+  if (max < 16 && nibble <= sparse) {
+    dst[0] = PLANE_NIBBLE;
+    memset(dst + 1, 0, nibble);
+    for (size_t i = 0; i < n; ++i)
+      dst[1 + i / 2] |= (unsigned char)(tmp[i] << (4 * (i & 1)));
+    return 1 + nibble;
+  }
+  if (sparse < n) {
+    dst[0] = PLANE_SPARSE;
+    unsigned char *bitmap = dst + 1, *bytes = dst + 1 + (n + 7) / 8;
+    memset(bitmap, 0, (n + 7) / 8);
+    for (size_t i = 0; i < n; ++i)
+      if (tmp[i]) {
+        bitmap[i / 8] |= (unsigned char)(1u << (i & 7));
+        *bytes++ = tmp[i];
+      }
+    return 1 + sparse;
+  }
+  dst[0] = PLANE_RAW;
+  memcpy(dst + 1, tmp, n);
+  return 1 + n;
+}
+
+/** \brief OR byte plane k from src into codes; returns the position after
+ * it, or NULL if it runs past end. */
+static const unsigned char *get_plane(const unsigned char *src,
+                                      const unsigned char *end,
+                                      uint64_t *codes, size_t n, unsigned k) {
+  if (src >= end)
+    return NULL;
+  unsigned mode = *src++;
+  unsigned sh = 8 * k;
+  size_t avail = (size_t)(end - src);
+  switch (mode) {
+  case PLANE_ZERO:
+    return src;
+  case PLANE_NIBBLE:
+    if (avail < (n + 1) / 2)
+      return NULL;
+    for (size_t i = 0; i + 1 < n; i += 2) {
+      codes[i] |= (uint64_t)(src[i / 2] & 15) << sh;
+      codes[i + 1] |= (uint64_t)(src[i / 2] >> 4) << sh;
+    }
+    if (n & 1)
+      codes[n - 1] |= (uint64_t)(src[n / 2] & 15) << sh;
+    return src + (n + 1) / 2;
+  case PLANE_SPARSE: {
+    size_t mb = (n + 7) / 8, nz = 0;
+    if (avail < mb)
+      return NULL;
+    /* bits past n would index past codes */
+    if ((n & 7) && (src[mb - 1] >> (n & 7)))
+      return NULL;
+    for (size_t j = 0; j < mb; ++j)
+      nz += (size_t)__builtin_popcount(src[j]);
+    if (avail - mb < nz)
+      return NULL;
+    const unsigned char *bytes = src + mb;
+    for (size_t j = 0; j < mb; ++j) {
+      unsigned bits = src[j];
+      while (bits) {
+        unsigned b = (unsigned)__builtin_ctz(bits);
+        bits &= bits - 1;
+        codes[j * 8 + b] |= (uint64_t)*bytes++ << sh;
+      }
+    }
+    return bytes;
+  }
+  case PLANE_RAW:
+    if (avail < n)
+      return NULL;
+    for (size_t i = 0; i < n; ++i)
+      codes[i] |= (uint64_t)src[i] << sh;
+    return src + n;
+  default:
+    return NULL;
+  }
+}
+
+typedef struct {
+  const double *field;
+  double *out;
+  int nx, ny, tile_rows;
+  double error_bound, step;
+  unsigned char **bufs; /* compress: per-band output */
+  size_t *sizes;
+  const unsigned char *data; /* decompress: band payloads */
+  const uint64_t *offsets;
+  int *failed;
+} CodecCtx;
+
+/** \brief Code one band into a fresh buffer. */
+static void encode_tile(void *ctx, int task, int thread) {
+  (void)thread;
+  CodecCtx *c = (CodecCtx *)ctx;
+  const int nx = c->nx, y0 = task * c->tile_rows;
+  const int y1 = y0 + c->tile_rows < c->ny ? y0 + c->tile_rows : c->ny;
+  const size_t n = (size_t)(y1 - y0) * nx;
+  const int lossy = c->step > 0.0;
+  /* worst case: every value escaped plus raw planes */
+  unsigned char *buf = (unsigned char *)malloc(4 + 8 * n + 8 * (1 + n) +
+                                               (lossy ? 8 * n : 0));
+  uint64_t *codes = (uint64_t *)malloc(n * sizeof(uint64_t));
+  unsigned char *tmp = (unsigned char *)malloc(n);
+  double *rec = lossy ? (double *)malloc(n * sizeof(double)) : NULL;
+  if (!buf || !codes || !tmp || (lossy && !rec)) {
+    free(buf);
+    free(codes);
+    free(tmp);
+    free(rec);
+    c->failed[task] = 1;
+    return;
+  }
+  uint32_t nesc = 0;
+  unsigned char *esc = buf + 4;
+  size_t i = 0;
+  if (!lossy) {
+    for (int y = y0; y < y1; ++y) {
+      const double *row = c->field + (size_t)y * nx;
+      const double *up = y > y0 ? row - nx : NULL;
+      for (int x = 0; x < nx; ++x, ++i)
+        codes[i] = zigzag((int64_t)(ordered(row[x]) -
+                                    ordered(predict(row, up, x))));
+    }
+  } else {
+    /* predict from reconstructed values, as the decoder will */
+    const double step = c->step, inv = 1.0 / step, eb = c->error_bound;
+    for (int y = y0; y < y1; ++y) {
+      const double *src = c->field + (size_t)y * nx;
+      double *row = rec + (size_t)(y - y0) * nx;
+      const double *up = y > y0 ? row - nx : NULL;
+      for (int x = 0; x < nx; ++x, ++i) {
+        double v = src[x], p = predict(row, up, x);
+        double q = nearbyint((v - p) * inv);
+        if (fabs(q) < 0x1p51) {
+          double r = p + step * q;
+          if (fabs(v - r) <= eb) {
+            codes[i] = zigzag((int64_t)q) + 1;
+            row[x] = r;
+            continue;
+          }
+        }
+        codes[i] = 0; /* escape: stored verbatim */
+        row[x] = v;
+        memcpy(esc + 8 * (size_t)nesc++, &v, 8);
+      }
+    }
+  }
+  memcpy(buf, &nesc, 4);
+  size_t pos = 4 + 8 * (size_t)nesc;
+  for (unsigned k = 0; k < 8; ++k)
+    pos += put_plane(buf + pos, codes, n, k, tmp);
+  free(codes);
+  free(tmp);
+  free(rec);
+  c->bufs[task] = buf;
+  c->sizes[task] = pos;
+}
+
+/** \brief Decode one band into its rows of the output field. */
+static void decode_tile(void *ctx, int task, int thread) {
+  (void)thread;
+  CodecCtx *c = (CodecCtx *)ctx;
+  const int nx = c->nx, y0 = task * c->tile_rows;
+  const int y1 = y0 + c->tile_rows < c->ny ? y0 + c->tile_rows : c->ny;
+  const size_t n = (size_t)(y1 - y0) * nx;
+  const unsigned char *src = c->data + c->offsets[task];
+  const unsigned char *end = c->data + c->offsets[task + 1];
+  uint64_t *codes = (uint64_t *)calloc(n, sizeof(uint64_t));
+  uint32_t nesc;
+  if (!codes || end - src < 4) {
+    free(codes);
+    c->failed[task] = 1;
+    return;
+  }
+  memcpy(&nesc, src, 4);
+  const unsigned char *esc = src + 4;
+  if ((size_t)(end - esc) / 8 < nesc) {
+    free(codes);
+    c->failed[task] = 1;
+    return;
+  }
+  const unsigned char *p = esc + 8 * (size_t)nesc;
+  for (unsigned k = 0; p && k < 8; ++k)
+    p = get_plane(p, end, codes, n, k);
+  if (!p || p != end) {
+    free(codes);
+    c->failed[task] = 1;
+    return;
+  }
+  size_t i = 0;
+  int bad = 0;
+  if (c->step <= 0.0) {
+    for (int y = y0; y < y1; ++y) {
+      double *row = c->out + (size_t)y * nx;
+      const double *up = y > y0 ? row - nx : NULL;
+      for (int x = 0; x < nx; ++x, ++i)
+        row[x] = from_ordered(ordered(predict(row, up, x)) +
+                              (uint64_t)unzigzag(codes[i]));
+    }
+  } else {
+    const double step = c->step;
+    uint32_t used = 0;
+    for (int y = y0; y < y1; ++y) {
+      double *row = c->out + (size_t)y * nx;
+      const double *up = y > y0 ? row - nx : NULL;
+      for (int x = 0; x < nx; ++x, ++i) {
+        double pr = predict(row, up, x);
+        if (codes[i]) {
+          row[x] = pr + step * (double)unzigzag(codes[i] - 1);
+        } else if (used < nesc) {
+          memcpy(&row[x], esc + 8 * (size_t)used++, 8);
+        } else {
+          row[x] = 0.0;
+          bad = 1;
+        }
+      }
+    }
+    bad |= used != nesc;
+  }
+  free(codes);
+  if (bad)
+    c->failed[task] = 1;
+}
+
+static int tile_rows_for(int nx) {
+  int r = FIELD_CODEC_TILE_CELLS / nx;
+  return r > 0 ? r : 1;
+}
+
+int field_codec_compress(const double *field, int nx, int ny,
+                         double error_bound, int threads, unsigned char **out,
+                         size_t *out_bytes) {
+  if (!field || !out || !out_bytes || nx <= 0 || ny <= 0 ||
+      !(error_bound >= 0.0) || isinf(error_bound))
+    return -1;
+  *out = NULL;
+  *out_bytes = 0;
+  double step = 0.0;
+  if (error_bound > 0.0) {
+    /* largest power of two not above twice the bound */
+    int e;
+    frexp(2.0 * error_bound, &e);
+    step = ldexp(1.0, e - 1);
+  }
+  int tile_rows = tile_rows_for(nx);
+  int ntiles = (ny + tile_rows - 1) / tile_rows;
+  unsigned char **bufs = (unsigned char **)calloc((size_t)ntiles, sizeof(*bufs));
+  size_t *sizes = (size_t *)calloc((size_t)ntiles, sizeof(size_t));
+  int *failed = (int *)calloc((size_t)ntiles, sizeof(int));
+  int rc = bufs && sizes && failed ? 0 : -1;
+  if (rc == 0) {
+    CodecCtx c = {field, NULL, nx, ny, tile_rows, error_bound, step,
+                  bufs, sizes, NULL, NULL, failed};
+    parallel_for(ntiles, threads, encode_tile, &c);
+    for (int t = 0; t < ntiles; ++t)
+      rc |= failed[t] ? -1 : 0;
+  }
+  size_t table = 8 * ((size_t)ntiles + 1), total = sizeof(FieldHeader) + table;
+  for (int t = 0; rc == 0 && t < ntiles; ++t)
+    total += sizes[t];
+  unsigned char *buf = rc == 0 ? (unsigned char *)malloc(total) : NULL;
+  if (buf) {
+    FieldHeader hd;
+    memset(&hd, 0, sizeof(hd));
+    memcpy(hd.magic, FC_MAGIC, sizeof(FC_MAGIC));
+    hd.version = FC_VERSION;
+    hd.endian = FC_ENDIAN;
+    hd.nx = (uint32_t)nx;
+    hd.ny = (uint32_t)ny;
+    hd.tile_rows = (uint32_t)tile_rows;
+    hd.ntiles = (uint32_t)ntiles;
+    hd.error_bound = error_bound;
+    hd.step = step;
+    hd.bytes = total;
+    unsigned char *data = buf + sizeof(hd) + table;
+    uint64_t off = 0;
+    for (int t = 0; t < ntiles; ++t) {
+      memcpy(buf + sizeof(hd) + 8 * (size_t)t, &off, 8);
+      memcpy(data + off, bufs[t], sizes[t]);
+      off += sizes[t];
+    }
+    memcpy(buf + sizeof(hd) + 8 * (size_t)ntiles, &off, 8);
+    hd.checksum = checkpoint_hash(CHECKPOINT_HASH_INIT, buf + sizeof(hd),
+                                  total - sizeof(hd));
+    memcpy(buf, &hd, sizeof(hd));
+    *out = buf;
+    *out_bytes = total;
+  } else {
+    rc = -1;
+  }
+  for (int t = 0; bufs && t < ntiles; ++t)
+    free(bufs[t]);
+  free(bufs);
+  free(sizes);
+  free(failed);
+  return rc;
+}
+
+/** \brief Validate header, offset table and checksum; fills hd. */
+static int parse_header(const unsigned char *buf, size_t bytes,
+                        FieldHeader *hd) {
+  if (!buf || bytes < sizeof(*hd))
+    return -1;
+  memcpy(hd, buf, sizeof(*hd));
+  if (memcmp(hd->magic, FC_MAGIC, sizeof(FC_MAGIC)) != 0 ||
+      hd->version != FC_VERSION || hd->endian != FC_ENDIAN ||
+      hd->bytes != bytes || hd->nx == 0 || hd->ny == 0 ||
+      hd->nx > INT32_MAX || hd->ny > INT32_MAX ||
+      hd->tile_rows != (uint32_t)tile_rows_for((int)hd->nx) ||
+      hd->ntiles != (hd->ny + hd->tile_rows - 1) / hd->tile_rows ||
+      !(hd->error_bound >= 0.0) || !(hd->step >= 0.0) ||
+      (hd->step > 0.0) != (hd->error_bound > 0.0))
+    return -1;
+  size_t table = 8 * ((size_t)hd->ntiles + 1);
+  if (bytes - sizeof(*hd) < table)
+    return -1;
+  size_t payload = bytes - sizeof(*hd) - table;
+  uint64_t prev = 0;
+  for (uint32_t t = 0; t <= hd->ntiles; ++t) {
+    uint64_t off;
+    memcpy(&off, buf + sizeof(*hd) + 8 * (size_t)t, 8);
+    if (off < prev || off > payload || (t == 0 && off != 0) ||
+        (t == hd->ntiles && off != payload))
+      return -1;
+    prev = off;
+  }
+  return checkpoint_hash(CHECKPOINT_HASH_INIT, buf + sizeof(*hd),
+                         bytes - sizeof(*hd)) == hd->checksum
+             ? 0
+             : -1;
+}
+
+int field_codec_info(const unsigned char *buf, size_t bytes, int *nx,
+                     int *ny, double *error_bound) {
+  FieldHeader hd;
+  if (parse_header(buf, bytes, &hd) != 0)
+    return -1;
+  if (nx)
+    *nx = (int)hd.nx;
+  if (ny)
+    *ny = (int)hd.ny;
+  if (error_bound)
+    *error_bound = hd.error_bound;
+  return 0;
+}
+
+int field_codec_decompress(const unsigned char *buf, size_t bytes,
+                           double *field, int nx, int ny, int threads) {
+  FieldHeader hd;
+  if (!field || parse_header(buf, bytes, &hd) != 0 || hd.nx != (uint32_t)nx ||
+      hd.ny != (uint32_t)ny)
+    return -1;
+  int ntiles = (int)hd.ntiles;
+  uint64_t *offsets = (uint64_t *)malloc(8 * ((size_t)ntiles + 1));
+  int *failed = (int *)calloc((size_t)ntiles, sizeof(int));
+  if (!offsets || !failed) {
+    free(offsets);
+    free(failed);
+    return -1;
+  }
+  memcpy(offsets, buf + sizeof(hd), 8 * ((size_t)ntiles + 1));
+  CodecCtx c = {NULL, field, nx, ny, (int)hd.tile_rows, hd.error_bound,
+                hd.step, NULL, NULL,
+                buf + sizeof(hd) + 8 * ((size_t)ntiles + 1), offsets, failed};
+  parallel_for(ntiles, threads, decode_tile, &c);
+  int rc = 0;
+  for (int t = 0; t < ntiles; ++t)
+    rc |= failed[t] ? -1 : 0;
+  free(offsets);
+  free(failed);
+  return rc;
+}
+
+int field_codec_write(const char *path, const double *field, int nx, int ny,
+                      double error_bound, int threads) {
+  if (!path)
+    return -1;
+  unsigned char *buf;
+  size_t n;
+  if (field_codec_compress(field, nx, ny, error_bound, threads, &buf, &n) !=
+      0)
+    return -1;
+  const void *part = buf;
+  int rc = checkpoint_write_file(path, &part, &n, 1);
+  free(buf);
+  return rc;
+}
+
+double *field_codec_read(const char *path, int *nx, int *ny,
+                         double *error_bound, int threads) {
+  if (!path)
+    return NULL;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(FieldHeader)) {
+    close(fd);
+    return NULL;
+  }
+  size_t n = (size_t)st.st_size;
+  void *p = mmap(NULL, n, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return NULL;
+  int w, h;
+  double eb;
+  double *field = NULL;
+  if (field_codec_info((const unsigned char *)p, n, &w, &h, &eb) == 0) {
+    field = (double *)malloc(sizeof(double) * (size_t)w * (size_t)h);
+    if (field && field_codec_decompress((const unsigned char *)p, n, field, w,
+                                        h, threads) != 0) {
+      free(field);
+      field = NULL;
+    }
+  }
+  munmap(p, n);
+  if (field) {
+    if (nx)
+      *nx = w;
+    if (ny)
+      *ny = h;
+    if (error_bound)
+      *error_bound = eb;
+  }
+  return field;
+}
@@ -0,0 +1,307 @@
+/**
+ * \file latency_hist.c
+ * \brief Log-linear latency histograms, per-thread sets and solver probes.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "latency_hist.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SUB_COUNT (1u << LATENCY_SUB_BITS)
+
+uint64_t latency_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/** \brief Bucket of v: exact below SUB_COUNT, then SUB_COUNT per octave. */
+static inline unsigned bucket_of(uint64_t v) {
+  if (v < SUB_COUNT)
+    return (unsigned)v;
+  unsigned e = 63u - (unsigned)__builtin_clzll(v); /* >= LATENCY_SUB_BITS */
+  unsigned sub = (unsigned)(v >> (e - LATENCY_SUB_BITS)) & (SUB_COUNT - 1);
+  return ((e - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS) + sub;
+}
+
+/** \brief Smallest value in bucket b. */
+static uint64_t bucket_low(unsigned b) {
+  if (b < SUB_COUNT)
+    return b;
+  unsigned e = (b >> LATENCY_SUB_BITS) + LATENCY_SUB_BITS - 1;
+  uint64_t sub = b & (SUB_COUNT - 1);
+  return (SUB_COUNT + sub) << (e - LATENCY_SUB_BITS);
+}
+
+/** \brief Largest value in bucket b. */
+static uint64_t bucket_high(unsigned b) {
+  if (b < SUB_COUNT)
+    return b;
+  unsigned e = (b >> LATENCY_SUB_BITS) + LATENCY_SUB_BITS - 1;
+  return bucket_low(b) + ((1ull << (e - LATENCY_SUB_BITS)) - 1);
+}
+
+static inline uint64_t load64(const uint64_t *p) {
+  return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+void latency_hist_reset(LatencyHist *h) {
+  if (!h)
+    return;
+  for (unsigned b = 0; b < LATENCY_BUCKETS; ++b)
+    __atomic_store_n(&h->counts[b], 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&h->total, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&h->sum, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&h->min, UINT64_MAX, __ATOMIC_RELAXED);
+  __atomic_store_n(&h->max, 0, __ATOMIC_RELAXED);
+}
+
+/** \brief Lower *p to v if smaller (CAS loop, rarely retried). */
+static inline void atomic_min64(uint64_t *p, uint64_t v) {
+  uint64_t cur = load64(p);
+  while (v < cur && !__atomic_compare_exchange_n(p, &cur, v, 1,
+                                                  __ATOMIC_RELAXED,
+                                                  __ATOMIC_RELAXED)) {
+  }
+}
+
+static inline void atomic_max64(uint64_t *p, uint64_t v) {
+  uint64_t cur = load64(p);
+  while (v > cur && !__atomic_compare_exchange_n(p, &cur, v, 1,
+                                                  __ATOMIC_RELAXED,
+                                                  __ATOMIC_RELAXED)) {
+  }
+}
+
+void latency_hist_record(LatencyHist *h, uint64_t ns) {
+  if (!h)
+    return;
+  __atomic_fetch_add(&h->counts[bucket_of(ns)], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&h->total, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&h->sum, ns, __ATOMIC_RELAXED);
+  atomic_min64(&h->min, ns);
+  atomic_max64(&h->max, ns);
+}
+
+void latency_hist_merge(LatencyHist *dst, const LatencyHist *src) {
+  if (!dst || !src)
+    return;
+  for (unsigned b = 0; b < LATENCY_BUCKETS; ++b) {
+    uint64_t c = load64(&src->counts[b]);
+    if (c)
+      __atomic_fetch_add(&dst->counts[b], c, __ATOMIC_RELAXED);
+  }
+  __atomic_fetch_add(&dst->total, load64(&src->total), __ATOMIC_RELAXED);
+  __atomic_fetch_add(&dst->sum, load64(&src->sum), __ATOMIC_RELAXED);
+  atomic_min64(&dst->min, load64(&src->min));
+  atomic_max64(&dst->max, load64(&src->max));
+}
+
+uint64_t latency_hist_percentile(const LatencyHist *h, double p) {
+  if (!h)
+    return 0;
+  uint64_t total = 0;
+  for (unsigned b = 0; b < LATENCY_BUCKETS; ++b)
+    total += load64(&h->counts[b]); /* consistent with the buckets walked */
+  if (total == 0)
+    return 0;
+  if (!(p > 0.0))
+    return load64(&h->min);
+  uint64_t rank = p >= 100.0 ? total : (uint64_t)((p / 100.0) * total + 0.5);
+  if (rank == 0)
+    rank = 1;
+  uint64_t seen = 0;
+  uint64_t max = load64(&h->max);
+  for (unsigned b = 0; b < LATENCY_BUCKETS; ++b) {
+    seen += load64(&h->counts[b]);
+    if (seen >= rank) {
+      uint64_t v = bucket_high(b);
+      return v < max ? v : max;
+    }
+  }
+  return max;
+}
+
+uint64_t latency_hist_count_le(const LatencyHist *h, uint64_t ns) {
+  if (!h)
+    return 0;
+  uint64_t n = 0;
+  for (unsigned b = 0; b < LATENCY_BUCKETS && bucket_high(b) <= ns; ++b)
+    n += load64(&h->counts[b]);
+  return n;
+}
+
+double latency_hist_mean(const LatencyHist *h) {
+  uint64_t n = h ? load64(&h->total) : 0;
+  return n ? (double)load64(&h->sum) / (double)n : 0.0;
+}
+
+static const double REPORT_PCTS[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+
+void latency_hist_print(const LatencyHist *h, const char *label, FILE *fp) {
+  if (!h || !fp)
+    return;
+  uint64_t n = load64(&h->total);
+  fprintf(fp, "%s: n=%llu", label ? label : "latency", (unsigned long long)n);
+  if (n == 0) {
+    fputc('\n', fp);
+    return;
+  }
+  fprintf(fp, " min=%llu mean=%.1f max=%llu ns\n",
+          (unsigned long long)load64(&h->min), latency_hist_mean(h),
+          (unsigned long long)load64(&h->max));
+  fprintf(fp, "  %12s %10s %12s\n", "value(ns)", "percentile", "count");
+  for (size_t i = 0; i < sizeof(REPORT_PCTS) / sizeof(REPORT_PCTS[0]); ++i) {
+    double p = REPORT_PCTS[i];
+    fprintf(fp, "  %12llu %10.3f %12llu\n",
+            (unsigned long long)latency_hist_percentile(h, p), p,
+            (unsigned long long)(p / 100.0 * (double)n + 0.5));
+  }
+}
+
+int latency_hist_to_json(const LatencyHist *h, char *buf, size_t buflen) {
+  if (!h || !buf || buflen == 0)
+    return -1;
+  uint64_t n = load64(&h->total);
+  int used = snprintf(
+      buf, buflen,
+      "{\"count\":%llu,\"min_ns\":%llu,\"mean_ns\":%.1f,\"max_ns\":%llu,"
+      "\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,"
+      "\"buckets\":[",
+      (unsigned long long)n, (unsigned long long)(n ? load64(&h->min) : 0),
+      latency_hist_mean(h), (unsigned long long)load64(&h->max),
+      (unsigned long long)latency_hist_percentile(h, 50.0),
+      (unsigned long long)latency_hist_percentile(h, 90.0),
+      (unsigned long long)latency_hist_percentile(h, 99.0),
+      (unsigned long long)latency_hist_percentile(h, 99.9));
+  if (used < 0 || (size_t)used >= buflen)
+    return -1;
+  size_t pos = (size_t)used;
+  int first = 1;
+  for (unsigned b = 0; b < LATENCY_BUCKETS; ++b) {
+    uint64_t c = load64(&h->counts[b]);
+    if (!c)
+      continue;
+    int k = snprintf(buf + pos, buflen - pos, "%s[%llu,%llu,%llu]",
+                     first ? "" : ",", (unsigned long long)bucket_low(b),
+                     (unsigned long long)bucket_high(b), (unsigned long long)c);
+    if (k < 0 || pos + (size_t)k >= buflen)
+      return -1;
+    pos += (size_t)k;
+    first = 0;
+  }
+  int k = snprintf(buf + pos, buflen - pos, "]}");
+  return k < 0 || pos + (size_t)k >= buflen ? -1 : 0;
+}
+
+/* ---------------- Per-thread sets ---------------- */
+
+static int next_thread_index;
+static __thread int thread_index = -1;
+
+LatencyHist *latency_set_local(LatencyHistSet *set) {
+  if (!set)
+    return NULL;
+  if (thread_index < 0)
+    thread_index = __atomic_fetch_add(&next_thread_index, 1, __ATOMIC_RELAXED);
+  LatencyHist **slot = &set->slots[thread_index % LATENCY_MAX_THREADS];
+  LatencyHist *h = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+  if (h)
+    return h;
+  LatencyHist *fresh = (LatencyHist *)malloc(sizeof(LatencyHist));
+  if (!fresh)
+    return NULL;
+  latency_hist_reset(fresh);
+  if (__atomic_compare_exchange_n(slot, &h, fresh, 0, __ATOMIC_ACQ_REL,
+                                  __ATOMIC_ACQUIRE))
+    return fresh;
+  free(fresh); /* another thread sharing this slot won */
+  return h;
+}
+
+void latency_set_snapshot(const LatencyHistSet *set, LatencyHist *out) {
+  if (!out)
+    return;
+  latency_hist_reset(out);
+  if (!set)
+    return;
+  for (int i = 0; i < LATENCY_MAX_THREADS; ++i) {
+    LatencyHist *h = __atomic_load_n(&set->slots[i], __ATOMIC_ACQUIRE);
+    if (h)
+      latency_hist_merge(out, h);
+  }
+}
+
+void latency_set_free(LatencyHistSet *set) {
+  if (!set)
+    return;
+  for (int i = 0; i < LATENCY_MAX_THREADS; ++i) {
+    free(set->slots[i]);
+    set->slots[i] = NULL;
+  }
+}
+
+/* ---------------- Solver probes ---------------- */
+
+int latency_probes_on;
+static LatencyHistSet probe_sets[LAT_SOLVER_COUNT];
+
+static const char *const SOLVER_NAMES[LAT_SOLVER_COUNT] = {
+    "greedy", "dp", "dp_opt", "greedy_batch", "change_table", "mixed"};
+
+/** \brief Honour COINSORTER_LATENCY at load time. */
+__attribute__((constructor)) static void probes_from_env(void) {
+  const char *env = getenv("COINSORTER_LATENCY");
+  if (env && *env && *env != '0')
+    latency_probes_enable(1);
+}
+
+void latency_probes_enable(int on) {
+  __atomic_store_n(&latency_probes_on, on ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+void latency_probe_record(LatencySolver id, uint64_t ns) {
+  if ((unsigned)id < LAT_SOLVER_COUNT)
+    latency_hist_record(latency_set_local(&probe_sets[id]), ns);
+}
+
+void latency_probe_snapshot(LatencySolver id, LatencyHist *out) {
+  if ((unsigned)id < LAT_SOLVER_COUNT)
+    latency_set_snapshot(&probe_sets[id], out);
+  else if (out)
+    latency_hist_reset(out);
+}
+
+void latency_probes_reset(void) {
+  for (int s = 0; s < LAT_SOLVER_COUNT; ++s)
+    for (int i = 0; i < LATENCY_MAX_THREADS; ++i)
+      latency_hist_reset(
+          __atomic_load_n(&probe_sets[s].slots[i], __ATOMIC_ACQUIRE));
+}
+
+const char *latency_solver_name(LatencySolver id) {
+  return (unsigned)id < LAT_SOLVER_COUNT ? SOLVER_NAMES[id] : "unknown";
+}
+
+void latency_probes_report(FILE *fp, int json) {
+  LatencyHist *h = (LatencyHist *)malloc(sizeof(LatencyHist));
+  char *buf = json ? (char *)malloc(1u << 18) : NULL;
+  if (!h || (json && !buf)) {
+    free(h);
+    free(buf);
+    return;
+  }
+  for (int s = 0; s < LAT_SOLVER_COUNT; ++s) {
+    latency_probe_snapshot((LatencySolver)s, h);
+    if (h->total == 0)
+      continue;
+    if (json && latency_hist_to_json(h, buf, 1u << 18) == 0)
+      fprintf(fp, "{\"solver\":\"%s\",\"latency\":%s}\n",
+              SOLVER_NAMES[s], buf);
+    else if (!json)
+      latency_hist_print(h, SOLVER_NAMES[s], fp);
+  }
+  free(h);
+  free(buf);
+}
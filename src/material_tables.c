@@ -0,0 +1,188 @@
+/** \file material_tables.c
+ *  \brief Uniform-grid property tables built from the material database.
+ *
+ *  Models used when filling the tables (reference point 293.15 K):
+ *  - conductivity: linear resistivity ρ(T) = ρ0 (1 + α_R (T - T0));
+ *  - specific heat and expansion: scaled by the Debye heat capacity
+ *    (Grüneisen relation α ∝ C_V);
+ *  - thermal conductivity: Wiedemann–Franz electronic part L σ(T) T plus a
+ *    temperature-independent lattice remainder.
+ */
+#include "material_tables.h"
+#include <math.h>
+#include <string.h>
+
+#ifndef COINSORTER_NO_THREADS
+#include <pthread.h>
+#endif
+
+#define MT_T_REF 293.15
+#define MT_LORENZ 2.44e-8 /* W·Ω/K² */
+#define MT_MAX_MATERIALS 16
+
+/** \brief Per-material model coefficients, in MATERIAL_DATABASE order.
+ * α_R values are effective fits over the tabulated range, not the
+ * room-temperature slope (nickel and steel bend strongly below 293 K). */
+static const struct {
+  double resistivity_tc; /* α_R (1/K) */
+  double debye_temp;     /* θ_D (K) */
+} MT_COEFFS[] = {
+    {0.00393, 343.0}, /* copper */
+    {0.00450, 450.0}, /* nickel */
+    {0.00370, 327.0}, /* zinc */
+    {0.00429, 428.0}, /* aluminum */
+    {0.00350, 470.0}, /* steel */
+    {0.00040, 380.0}, /* cupronickel */
+    {0.00100, 340.0}, /* nordic gold */
+    {0.00150, 320.0}, /* brass */
+    {0.00350, 470.0}, /* nickel-plated steel */
+};
+
+#define MT_NUM_COEFFS (sizeof(MT_COEFFS) / sizeof(MT_COEFFS[0]))
+
+/* SoA storage: one contiguous row of grid values per (property, material). */
+static double mt_table[MT_PROPERTY_COUNT][MT_MAX_MATERIALS]
+                      [MATERIAL_TABLE_POINTS];
+static size_t mt_materials;
+
+/** \brief Debye heat capacity per 3Nk at T for Debye temperature theta. */
+static double debye_cv(double T, double theta) {
+  const int steps = 256; /* Simpson, even */
+  double xmax = theta / T;
+  double h = xmax / steps;
+  double sum = 0.0;
+  for (int i = 0; i <= steps; ++i) {
+    double x = i * h;
+    double f;
+    if (x < 1e-8) {
+      f = 0.0; /* x⁴eˣ/(eˣ-1)² ~ x² */
+    } else {
+      double ex = exp(x);
+      f = x * x * x * x * ex / ((ex - 1.0) * (ex - 1.0));
+    }
+    double w = (i == 0 || i == steps) ? 1.0 : (i & 1) ? 4.0 : 2.0;
+    sum += w * f;
+  }
+  double t = T / theta;
+  return 3.0 * t * t * t * (sum * h / 3.0);
+}
+
+/** \brief Fill every table row from the database and MT_COEFFS. */
+static void mt_build(void) {
+  size_t n = material_count();
+  if (n > MT_NUM_COEFFS)
+    n = MT_NUM_COEFFS;
+  if (n > MT_MAX_MATERIALS)
+    n = MT_MAX_MATERIALS;
+  for (size_t m = 0; m < n; ++m) {
+    const MaterialProperties *p = get_material_by_index(m);
+    double alpha_r = MT_COEFFS[m].resistivity_tc;
+    double theta = MT_COEFFS[m].debye_temp;
+    double cv_ref = debye_cv(MT_T_REF, theta);
+    double k_e_ref = MT_LORENZ * p->electrical_conductivity * MT_T_REF;
+    if (k_e_ref > p->thermal_conductivity)
+      k_e_ref = p->thermal_conductivity;
+    double k_lattice = p->thermal_conductivity - k_e_ref;
+    for (int i = 0; i < MATERIAL_TABLE_POINTS; ++i) {
+      double T = MATERIAL_TABLE_T_MIN + i * MATERIAL_TABLE_T_STEP;
+      double rho_ratio = 1.0 + alpha_r * (T - MT_T_REF);
+      double cv_ratio = debye_cv(T, theta) / cv_ref;
+      double sigma = p->electrical_conductivity / rho_ratio;
+      mt_table[MT_ELECTRICAL_CONDUCTIVITY][m][i] = sigma;
+      mt_table[MT_THERMAL_CONDUCTIVITY][m][i] =
+          k_e_ref * (T / MT_T_REF) / rho_ratio + k_lattice;
+      mt_table[MT_THERMAL_EXPANSION][m][i] =
+          p->thermal_expansion_coeff * cv_ratio;
+      mt_table[MT_SPECIFIC_HEAT][m][i] = p->specific_heat_capacity * cv_ratio;
+    }
+  }
+  mt_materials = n;
+}
+
+#ifndef COINSORTER_NO_THREADS
+static pthread_once_t mt_once = PTHREAD_ONCE_INIT;
+#define MT_ENSURE() pthread_once(&mt_once, mt_build)
+#else
+static int mt_ready;
+#define MT_ENSURE()                                                            \
+  do {                                                                         \
+    if (!mt_ready) {                                                           \
+      mt_build();                                                              \
+      mt_ready = 1;                                                            \
+    }                                                                          \
+  } while (0)
+#endif
+
+/** \brief Clamped linear interpolation on one grid row (no data-dependent
+ * branches: clamps and the edge fix-up compile to min/max and cmov). */
+static inline double mt_interp(const double *row, double T) {
+  double x = (T - MATERIAL_TABLE_T_MIN) * (1.0 / MATERIAL_TABLE_T_STEP);
+  x = x > 0.0 ? x : 0.0; /* also maps NaN to the first point */
+  x = x < (double)(MATERIAL_TABLE_POINTS - 1) ? x
+                                              : (double)(MATERIAL_TABLE_POINTS - 1);
+  int i = (int)x;
+  i -= i == MATERIAL_TABLE_POINTS - 1;
+  double f = x - i;
+  return row[i] + f * (row[i + 1] - row[i]);
+}
+
+double material_table_lookup(size_t material, MaterialTableProperty prop,
+                             double T) {
+  MT_ENSURE();
+  if (material >= mt_materials || (unsigned)prop >= MT_PROPERTY_COUNT)
+    return 0.0;
+  return mt_interp(mt_table[prop][material], T);
+}
+
+void material_table_lookup_batch(size_t material, MaterialTableProperty prop,
+                                 const double *T, double *out, size_t n) {
+  MT_ENSURE();
+  if (!T || !out)
+    return;
+  if (material >= mt_materials || (unsigned)prop >= MT_PROPERTY_COUNT) {
+    memset(out, 0, n * sizeof(*out));
+    return;
+  }
+  const double *row = mt_table[prop][material];
+  for (size_t i = 0; i < n; ++i)
+    out[i] = mt_interp(row, T[i]);
+}
+
+void material_table_lookup_mixed(const size_t *materials,
+                                 MaterialTableProperty prop, const double *T,
+                                 double *out, size_t n) {
+  MT_ENSURE();
+  if (!materials || !T || !out)
+    return;
+  if ((unsigned)prop >= MT_PROPERTY_COUNT) {
+    memset(out, 0, n * sizeof(*out));
+    return;
+  }
+  const double *base = &mt_table[prop][0][0];
+  for (size_t i = 0; i < n; ++i) {
+    size_t m = materials[i];
+    int ok = m < mt_materials;
+    /* invalid rows read material 0 and are zeroed by the mask */
+    double v = mt_interp(base + (ok ? m : 0) * MATERIAL_TABLE_POINTS, T[i]);
+    out[i] = ok ? v : 0.0;
+  }
+}
+
+MaterialProperties *material_properties_at(const MaterialProperties *base,
+                                           double T, MaterialProperties *out) {
+  if (!base || !out)
+    return NULL;
+  long m = material_index(base);
+  MT_ENSURE();
+  if (m < 0 || (size_t)m >= mt_materials)
+    return NULL;
+  *out = *base;
+  out->electrical_conductivity =
+      mt_interp(mt_table[MT_ELECTRICAL_CONDUCTIVITY][m], T);
+  out->thermal_conductivity =
+      mt_interp(mt_table[MT_THERMAL_CONDUCTIVITY][m], T);
+  out->thermal_expansion_coeff =
+      mt_interp(mt_table[MT_THERMAL_EXPANSION][m], T);
+  out->specific_heat_capacity = mt_interp(mt_table[MT_SPECIFIC_HEAT][m], T);
+  return out;
+}
@@ -0,0 +1,479 @@
+/**
+ * \file metrics.c
+ * \brief Sharded metric registry, Prometheus rendering and the socket server.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "metrics.h"
+#include "latency_hist.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef COINSORTER_NO_THREADS
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+/** \brief One counter shard on its own cache line. */
+typedef struct {
+  uint64_t v;
+  char pad[64 - sizeof(uint64_t)];
+} MetricShard;
+
+struct Metric {
+  MetricShard shards[METRICS_SHARDS]; /* counters; gauges use shards[0] */
+  MetricType type;
+  char name[64];
+  char labels[128];
+  char help[128];
+  LatencyHistSet *hist; /* histograms only */
+};
+
+static Metric *registry[METRICS_MAX];
+static int nmetrics;
+static int registry_lock;
+int metrics_on;
+
+static int next_shard;
+static __thread int shard_index = -1;
+
+/** \brief Shard owned by the calling thread (assigned round robin). */
+static inline int my_shard(void) {
+  if (shard_index < 0)
+    shard_index = __atomic_fetch_add(&next_shard, 1, __ATOMIC_RELAXED) %
+                  METRICS_SHARDS;
+  return shard_index;
+}
+
+static void lock_registry(void) {
+  while (__atomic_test_and_set(&registry_lock, __ATOMIC_ACQUIRE)) {
+  }
+}
+
+static void unlock_registry(void) {
+  __atomic_clear(&registry_lock, __ATOMIC_RELEASE);
+}
+
+static int valid_name(const char *s) {
+  if (!s || !*s || strlen(s) >= sizeof(((Metric *)0)->name))
+    return 0;
+  for (const char *p = s; *p; ++p) {
+    int alpha = (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+                *p == '_' || *p == ':';
+    if (!alpha && !(p > s && *p >= '0' && *p <= '9'))
+      return 0;
+  }
+  return 1;
+}
+
+Metric *metrics_register(MetricType type, const char *name, const char *labels,
+                         const char *help) {
+  if (!valid_name(name) || (unsigned)type > METRIC_HISTOGRAM)
+    return NULL;
+  if (!labels)
+    labels = "";
+  if (strlen(labels) >= sizeof(((Metric *)0)->labels))
+    return NULL;
+  Metric *found = NULL;
+  int clash = 0;
+  lock_registry();
+  for (int i = 0; i < nmetrics; ++i) {
+    if (strcmp(registry[i]->name, name) != 0)
+      continue;
+    if (registry[i]->type != type)
+      clash = 1;
+    else if (strcmp(registry[i]->labels, labels) == 0)
+      found = registry[i];
+  }
+  if (!found && !clash && nmetrics < METRICS_MAX) {
+    void *mem = NULL;
+    if (posix_memalign(&mem, 64, sizeof(Metric)) == 0) {
+      Metric *m = (Metric *)mem;
+      memset(m, 0, sizeof(*m));
+      m->type = type;
+      strcpy(m->name, name);
+      strcpy(m->labels, labels);
+      snprintf(m->help, sizeof(m->help), "%s", help ? help : "");
+      m->hist = type == METRIC_HISTOGRAM
+                    ? (LatencyHistSet *)calloc(1, sizeof(LatencyHistSet))
+                    : NULL;
+      if (type != METRIC_HISTOGRAM || m->hist) {
+        registry[nmetrics] = m;
+        __atomic_store_n(&nmetrics, nmetrics + 1, __ATOMIC_RELEASE);
+        found = m;
+      } else {
+        free(m);
+      }
+    }
+  }
+  unlock_registry();
+  return found;
+}
+
+Metric *metrics_lazy(Metric **slot, MetricType type, const char *name,
+                     const char *labels, const char *help) {
+  Metric *m = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+  if (!m) {
+    m = metrics_register(type, name, labels, help);
+    __atomic_store_n(slot, m, __ATOMIC_RELEASE);
+  }
+  return m;
+}
+
+void metrics_counter_add(Metric *m, uint64_t n) {
+  if (m && m->type == METRIC_COUNTER)
+    __atomic_fetch_add(&m->shards[my_shard()].v, n, __ATOMIC_RELAXED);
+}
+
+void metrics_gauge_set(Metric *m, int64_t v) {
+  if (m && m->type == METRIC_GAUGE)
+    __atomic_store_n(&m->shards[0].v, (uint64_t)v, __ATOMIC_RELAXED);
+}
+
+void metrics_gauge_add(Metric *m, int64_t d) {
+  if (m && m->type == METRIC_GAUGE)
+    __atomic_fetch_add(&m->shards[0].v, (uint64_t)d, __ATOMIC_RELAXED);
+}
+
+void metrics_gauge_max(Metric *m, int64_t v) {
+  if (!m || m->type != METRIC_GAUGE)
+    return;
+  uint64_t cur = __atomic_load_n(&m->shards[0].v, __ATOMIC_RELAXED);
+  while (v > (int64_t)cur &&
+         !__atomic_compare_exchange_n(&m->shards[0].v, &cur, (uint64_t)v, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+void metrics_observe_ns(Metric *m, uint64_t ns) {
+  if (m && m->type == METRIC_HISTOGRAM)
+    latency_hist_record(latency_set_local(m->hist), ns);
+}
+
+int64_t metrics_value(const Metric *m) {
+  if (!m)
+    return 0;
+  if (m->type == METRIC_GAUGE)
+    return (int64_t)__atomic_load_n(&m->shards[0].v, __ATOMIC_RELAXED);
+  if (m->type == METRIC_COUNTER) {
+    uint64_t sum = 0;
+    for (int s = 0; s < METRICS_SHARDS; ++s)
+      sum += __atomic_load_n(&m->shards[s].v, __ATOMIC_RELAXED);
+    return (int64_t)sum;
+  }
+  uint64_t n = 0;
+  for (int i = 0; i < LATENCY_MAX_THREADS; ++i) {
+    LatencyHist *h = __atomic_load_n(&m->hist->slots[i], __ATOMIC_ACQUIRE);
+    if (h)
+      n += __atomic_load_n(&h->total, __ATOMIC_RELAXED);
+  }
+  return (int64_t)n;
+}
+
+void metrics_enable(int on) {
+  __atomic_store_n(&metrics_on, on ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+/* ---------------- Prometheus text rendering ---------------- */
+
+/** \brief Growable output buffer; p is NULL after an allocation failure. */
+typedef struct {
+  char *p;
+  size_t len, cap;
+} TextBuf;
+
+static void tb_printf(TextBuf *b, const char *fmt, ...) {
+  if (!b->p)
+    return;
+  for (;;) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(b->p + b->len, b->cap - b->len, fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+      free(b->p);
+      b->p = NULL;
+      return;
+    }
+    if (b->len + (size_t)n < b->cap) {
+      b->len += (size_t)n;
+      return;
+    }
+    size_t cap = 2 * (b->cap + (size_t)n);
+    char *q = (char *)realloc(b->p, cap);
+    if (!q) {
+      free(b->p);
+      b->p = NULL;
+      return;
+    }
+    b->p = q;
+    b->cap = cap;
+  }
+}
+
+/* Histogram bucket bounds in seconds (upper "le" edges). */
+static const double HIST_LE[] = {1e-6, 5e-6, 1e-5, 5e-5, 1e-4, 5e-4, 1e-3,
+                                 5e-3, 1e-2, 5e-2, 0.1,  0.5,  1.0,  5.0};
+
+static const char *const TYPE_NAMES[] = {"counter", "gauge", "histogram"};
+
+/** \brief "{labels}" or "{labels,extra}" selector text for one sample. */
+static void label_set(char *out, size_t len, const char *labels,
+                      const char *extra) {
+  if (*labels && extra)
+    snprintf(out, len, "{%s,%s}", labels, extra);
+  else if (*labels || extra)
+    snprintf(out, len, "{%s}", *labels ? labels : extra);
+  else
+    out[0] = '\0';
+}
+
+static void render_histogram(TextBuf *b, const Metric *m, LatencyHist *h) {
+  char sel[192], le[32];
+  latency_set_snapshot(m->hist, h);
+  for (size_t i = 0; i < sizeof(HIST_LE) / sizeof(HIST_LE[0]); ++i) {
+    snprintf(le, sizeof(le), "le=\"%g\"", HIST_LE[i]);
+    label_set(sel, sizeof(sel), m->labels, le);
+    tb_printf(b, "%s_bucket%s %llu\n", m->name, sel,
+              (unsigned long long)latency_hist_count_le(
+                  h, (uint64_t)(HIST_LE[i] * 1e9 + 0.5)));
+  }
+  label_set(sel, sizeof(sel), m->labels, "le=\"+Inf\"");
+  tb_printf(b, "%s_bucket%s %llu\n", m->name, sel,
+            (unsigned long long)h->total);
+  label_set(sel, sizeof(sel), m->labels, NULL);
+  tb_printf(b, "%s_sum%s %.9g\n", m->name, sel, (double)h->sum * 1e-9);
+  tb_printf(b, "%s_count%s %llu\n", m->name, sel,
+            (unsigned long long)h->total);
+}
+
+char *metrics_render(size_t *len) {
+  TextBuf b = {(char *)malloc(4096), 0, 4096};
+  LatencyHist *h = (LatencyHist *)malloc(sizeof(LatencyHist));
+  if (!b.p || !h) {
+    free(b.p);
+    free(h);
+    return NULL;
+  }
+  b.p[0] = '\0';
+  int n = __atomic_load_n(&nmetrics, __ATOMIC_ACQUIRE);
+  for (int i = 0; i < n; ++i) {
+    int first = 1;
+    for (int j = 0; j < i && first; ++j)
+      first = strcmp(registry[j]->name, registry[i]->name) != 0;
+    if (!first)
+      continue; /* already emitted with its family */
+    const Metric *fam = registry[i];
+    tb_printf(&b, "# HELP %s %s\n# TYPE %s %s\n", fam->name, fam->help,
+              fam->name, TYPE_NAMES[fam->type]);
+    for (int j = i; j < n; ++j) {
+      const Metric *m = registry[j];
+      if (strcmp(m->name, fam->name) != 0)
+        continue;
+      if (m->type == METRIC_HISTOGRAM) {
+        render_histogram(&b, m, h);
+      } else {
+        char sel[160];
+        label_set(sel, sizeof(sel), m->labels, NULL);
+        tb_printf(&b, "%s%s %lld\n", m->name, sel,
+                  (long long)metrics_value(m));
+      }
+    }
+  }
+  free(h);
+  if (b.p && len)
+    *len = b.len;
+  return b.p;
+}
+
+int metrics_write(FILE *fp) {
+  size_t len = 0;
+  char *text = metrics_render(&len);
+  if (!text)
+    return -1;
+  int rc = fwrite(text, 1, len, fp) == len ? 0 : -1;
+  fflush(fp);
+  free(text);
+  return rc;
+}
+
+/* ---------------- SIGUSR1 dumps ---------------- */
+
+static volatile sig_atomic_t dump_requested;
+
+static void on_sigusr1(int sig) {
+  (void)sig;
+  dump_requested = 1;
+}
+
+int metrics_install_dump_signal(void) {
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_sigusr1;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = 0; /* no SA_RESTART: idle reads wake up to dump */
+  return sigaction(SIGUSR1, &sa, NULL) == 0 ? 0 : -1;
+}
+
+int metrics_dump_pending(void) {
+  return __atomic_exchange_n(&dump_requested, 0, __ATOMIC_ACQ_REL) != 0;
+}
+
+/* ---------------- Socket server ---------------- */
+
+#ifdef COINSORTER_NO_THREADS
+
+int metrics_serve(const char *addr) {
+  (void)addr;
+  return -1;
+}
+
+void metrics_serve_stop(void) {}
+
+#else
+
+static int serve_fd = -1;
+static int serve_stop;
+static pthread_t serve_thread;
+static char serve_path[108];
+
+/** \brief Answer one client: HTTP if it sent a GET, raw text otherwise. */
+static void serve_client(int fd) {
+  char req[1024];
+  ssize_t got = 0;
+  struct pollfd pfd = {fd, POLLIN, 0};
+  if (poll(&pfd, 1, 200) > 0)
+    got = read(fd, req, sizeof(req) - 1);
+  size_t len = 0;
+  char *text = metrics_render(&len);
+  if (!text)
+    return;
+  if (got >= 3 && memcmp(req, "GET", 3) == 0) {
+    char head[160];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.0 200 OK\r\nContent-Type: text/plain; "
+                     "version=0.0.4\r\nContent-Length: %zu\r\n\r\n",
+                     len);
+    if (send(fd, head, (size_t)n, MSG_NOSIGNAL) != n) {
+      free(text);
+      return;
+    }
+  }
+  for (size_t off = 0; off < len;) {
+    ssize_t w = send(fd, text + off, len - off, MSG_NOSIGNAL);
+    if (w <= 0)
+      break;
+    off += (size_t)w;
+  }
+  free(text);
+}
+
+static void *serve_main(void *arg) {
+  (void)arg;
+  struct pollfd pfd = {serve_fd, POLLIN, 0};
+  while (!__atomic_load_n(&serve_stop, __ATOMIC_ACQUIRE)) {
+    if (metrics_dump_pending())
+      metrics_write(stderr);
+    if (poll(&pfd, 1, 100) <= 0)
+      continue;
+    int c = accept(serve_fd, NULL, NULL);
+    if (c < 0)
+      continue;
+    serve_client(c);
+    close(c);
+  }
+  return NULL;
+}
+
+/** \brief Bound, listening socket for addr, or -1. */
+static int open_listener(const char *addr) {
+  int fd = -1;
+  if (strncmp(addr, "unix:", 5) == 0) {
+    struct sockaddr_un sun;
+    const char *path = addr + 5;
+    if (!*path || strlen(path) >= sizeof(sun.sun_path) ||
+        strlen(path) >= sizeof(serve_path))
+      return -1;
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strcpy(sun.sun_path, path);
+    unlink(path); /* stale socket from an earlier run */
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&sun, sizeof(sun)) != 0) {
+      if (fd >= 0)
+        close(fd);
+      return -1;
+    }
+    strcpy(serve_path, path);
+  } else {
+    const char *colon = strrchr(addr, ':');
+    char host[64];
+    size_t hl = colon ? (size_t)(colon - addr) : 0;
+    if (!colon || hl >= sizeof(host) || !colon[1])
+      return -1;
+    memcpy(host, addr, hl);
+    host[hl] = '\0';
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(hl ? host : "127.0.0.1", colon + 1, &hints, &res) != 0)
+      return -1;
+    fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    int one = 1;
+    if (fd >= 0)
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd >= 0 && bind(fd, res->ai_addr, res->ai_addrlen) != 0) {
+      close(fd);
+      fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0)
+      return -1;
+  }
+  if (listen(fd, 16) != 0) {
+    close(fd);
+    if (serve_path[0])
+      unlink(serve_path);
+    serve_path[0] = '\0';
+    return -1;
+  }
+  return fd;
+}
+
+int metrics_serve(const char *addr) {
+  if (!addr || serve_fd >= 0)
+    return -1;
+  serve_path[0] = '\0';
+  int fd = open_listener(addr);
+  if (fd < 0)
+    return -1;
+  serve_fd = fd;
+  serve_stop = 0;
+  if (pthread_create(&serve_thread, NULL, serve_main, NULL) != 0) {
+    close(fd);
+    serve_fd = -1;
+    return -1;
+  }
+  return 0;
+}
+
+void metrics_serve_stop(void) {
+  if (serve_fd < 0)
+    return;
+  __atomic_store_n(&serve_stop, 1, __ATOMIC_RELEASE);
+  pthread_join(serve_thread, NULL);
+  close(serve_fd);
+  serve_fd = -1;
+  if (serve_path[0])
+    unlink(serve_path);
+  serve_path[0] = '\0';
+}
+
+#endif
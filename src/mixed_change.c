@@ -0,0 +1,200 @@
+/**
+ * \file mixed_change.c
+ * \brief Merged multi-currency DP with per-bundle reconstruction bits.
+ *
+ * Coins with a finite inventory k are split into bundles of 1, 2, 4, ...,
+ * rest coins, each a 0/1 item (descending pass); unlimited coins are single
+ * unbounded items (ascending pass). Bit take[j][a] records that bundle j
+ * improved amount a, which is all a query needs to walk the solution back.
+ */
+#include "mixed_change.h"
+#include "latency_hist.h"
+#include "metrics.h"
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** \brief Smallest scale making every rate integral (0 if none). */
+static int common_scale(const MixedSource *src, size_t n) {
+  for (int s = 1; s <= MIXED_MAX_SCALE; ++s) {
+    int ok = 1;
+    for (size_t i = 0; ok && i < n; ++i) {
+      double x = src[i].rate * s;
+      /* relative to x, only decimal-to-binary rounding may remain; a looser
+       * bound would accept every large enough scale */
+      ok = fabs(x - floor(x + 0.5)) <= 1e-12 * (x > 1.0 ? x : 1.0);
+    }
+    if (ok)
+      return s;
+  }
+  return 0;
+}
+
+void mixed_change_free(MixedChangeSolver *m) {
+  if (!m)
+    return;
+  free(m->coins);
+  free(m->item_coin);
+  free(m->item_mult);
+  free(m->primary);
+  free(m->ncoins_used);
+  free(m->take);
+  memset(m, 0, sizeof(*m));
+}
+
+/** \brief Candidate (p, c) beats the stored cell (objective, then coins). */
+static inline int better(double p, int c, double cur_p, int cur_c) {
+  return p < cur_p - 1e-12 || (fabs(p - cur_p) < 1e-12 && c < cur_c);
+}
+
+int mixed_change_init(MixedChangeSolver *m, const MixedSource *sources,
+                      size_t nsources, int max_amount, OptimizeMode mode) {
+  if (!m)
+    return -1;
+  memset(m, 0, sizeof(*m));
+  if (!sources || nsources == 0 || max_amount < 0 || mode < 0 ||
+      mode >= OPT_MODE_COUNT)
+    return -1;
+  for (size_t s = 0; s < nsources; ++s)
+    if (!sources[s].sys || !sources[s].sys->coins || !(sources[s].rate > 0))
+      return -1;
+  int scale = common_scale(sources, nsources);
+  if (scale == 0 || (long long)max_amount * scale >= INT_MAX)
+    return -1;
+  m->scale = scale;
+  m->max_amount = max_amount;
+  m->mode = mode;
+  m->span = (size_t)max_amount * (size_t)scale + 1;
+
+  /* merged denominations and their bundles */
+  size_t total = 0, nitems = 0;
+  for (size_t s = 0; s < nsources; ++s)
+    total += sources[s].sys->ncoins;
+  m->coins = (MixedCoin *)malloc(total * sizeof(MixedCoin));
+  m->item_coin = (int *)malloc(total * 32 * sizeof(int));
+  m->item_mult = (int *)malloc(total * 32 * sizeof(int));
+  if (!m->coins || !m->item_coin || !m->item_mult) {
+    mixed_change_free(m);
+    return -1;
+  }
+  for (size_t s = 0; s < nsources; ++s) {
+    const MixedSource *src = &sources[s];
+    long long unit = llround(src->rate * scale);
+    for (size_t c = 0; c < src->sys->ncoins; ++c) {
+      long long v = unit * src->sys->coins[c].value;
+      if (src->sys->coins[c].value <= 0 || v <= 0 || v > INT_MAX) {
+        mixed_change_free(m);
+        return -1;
+      }
+      size_t k = m->ncoins++;
+      m->coins[k].value = (int)v;
+      m->coins[k].source = (int)s;
+      m->coins[k].coin = (int)c;
+      m->coins[k].weight = coin_weight(&src->sys->coins[c], mode);
+      if ((size_t)v >= m->span)
+        continue; /* never fits */
+      int inv = src->inventory ? src->inventory[c] : -1;
+      if (inv < 0) {
+        m->item_coin[nitems] = (int)k;
+        m->item_mult[nitems++] = 0;
+        continue;
+      }
+      for (int p = 1; inv > 0; p <<= 1) {
+        int take = p < inv ? p : inv;
+        m->item_coin[nitems] = (int)k;
+        m->item_mult[nitems++] = take;
+        inv -= take;
+      }
+    }
+  }
+  m->nitems = nitems;
+
+  const size_t span = m->span;
+  const size_t words = (nitems * span + 63) / 64;
+  m->primary = (double *)malloc(span * sizeof(double));
+  m->ncoins_used = (int *)malloc(span * sizeof(int));
+  m->take = (uint64_t *)calloc(words ? words : 1, sizeof(uint64_t));
+  if (!m->primary || !m->ncoins_used || !m->take) {
+    mixed_change_free(m);
+    return -1;
+  }
+  METRICS_COUNT("coinsorter_alloc_bytes_total", "site=\"mixed\"",
+                "Bytes allocated by solver tables",
+                span * (sizeof(double) + sizeof(int)) +
+                    words * sizeof(uint64_t));
+  double *P = m->primary;
+  int *C = m->ncoins_used;
+  for (size_t a = 0; a < span; ++a) {
+    P[a] = INFINITY;
+    C[a] = INT_MAX;
+  }
+  P[0] = 0.0;
+  C[0] = 0;
+  for (size_t j = 0; j < nitems; ++j) {
+    const MixedCoin *coin = &m->coins[m->item_coin[j]];
+    const int mult = m->item_mult[j];
+    uint64_t *bits = m->take;
+    const size_t base = j * span;
+    if (mult == 0) {
+      const size_t v = (size_t)coin->value;
+      for (size_t a = v; a < span; ++a) {
+        if (C[a - v] == INT_MAX)
+          continue;
+        double p = P[a - v] + coin->weight;
+        if (better(p, C[a - v] + 1, P[a], C[a])) {
+          P[a] = p;
+          C[a] = C[a - v] + 1;
+          bits[(base + a) >> 6] |= 1ull << ((base + a) & 63);
+        }
+      }
+    } else {
+      const size_t v = (size_t)coin->value * (size_t)mult;
+      const double w = coin->weight * mult;
+      for (size_t a = span; a-- > v;) {
+        if (C[a - v] == INT_MAX)
+          continue;
+        double p = P[a - v] + w;
+        if (better(p, C[a - v] + mult, P[a], C[a])) {
+          P[a] = p;
+          C[a] = C[a - v] + mult;
+          bits[(base + a) >> 6] |= 1ull << ((base + a) & 63);
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+static int pay_impl(const MixedChangeSolver *m, int amount, int *counts,
+                    double *objective) {
+  if (!m || !m->primary || !counts || amount < 0 || amount > m->max_amount)
+    return -1;
+  size_t a = (size_t)amount * (size_t)m->scale;
+  if (m->ncoins_used[a] == INT_MAX)
+    return -1;
+  if (objective)
+    *objective = m->primary[a];
+  memset(counts, 0, m->ncoins * sizeof(int));
+  for (size_t j = m->nitems; j-- > 0 && a > 0;) {
+    const size_t base = j * m->span;
+    const int k = m->item_coin[j];
+    const size_t v = (size_t)m->coins[k].value;
+    if (m->item_mult[j] == 0) {
+      while (a > 0 && (m->take[(base + a) >> 6] >> ((base + a) & 63) & 1)) {
+        counts[k]++;
+        a -= v;
+      }
+    } else if (m->take[(base + a) >> 6] >> ((base + a) & 63) & 1) {
+      counts[k] += m->item_mult[j];
+      a -= v * (size_t)m->item_mult[j];
+    }
+  }
+  return a == 0 ? 0 : -1;
+}
+
+int mixed_change_pay(const MixedChangeSolver *m, int amount, int *counts,
+                     double *objective) {
+  LATENCY_PROBED_RETURN(LAT_SOLVER_MIXED,
+                        pay_impl(m, amount, counts, objective));
+}
@@ -0,0 +1,264 @@
+/**
+ * \file mlp_io.c
+ * \brief Versioned binary weight files for the MLP and its int8 variant.
+ *
+ * Layout: a 64-byte header, a table of eight 64-bit section offsets, then the
+ * weight arrays, each starting on a 64-byte boundary so a mapped file can be
+ * used in place by the vectorized kernels. All fields are host-endian; the
+ * header carries an endian tag and loaders reject foreign files. A checksum
+ * (checkpoint_hash) covers everything after the header.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "simulation.h"
+#include "checkpoint.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MLP_FILE_MAGIC "CSMLPWT"
+#define MLP_FILE_VERSION 1u
+#define MLP_FILE_ENDIAN 0x01020304u
+#define MLP_FILE_ALIGN 64u
+#define MLP_FILE_SECTIONS 8
+#define MLP_FILE_DATA (64u + 8u * MLP_FILE_SECTIONS)
+#define MLP_FILE_MAX_DIM (1u << 24)
+
+/* Element type of the weight sections. */
+enum { MLP_DTYPE_F64 = 0, MLP_DTYPE_Q8 = 1 };
+/* Header flags. */
+enum { MLP_FLAG_QSCALE = 1u /* per-channel quantization scales present */ };
+
+typedef struct {
+  char magic[8];          /* "CSMLPWT\0" */
+  uint32_t version;       /* MLP_FILE_VERSION */
+  uint32_t endian;        /* MLP_FILE_ENDIAN as written by the host */
+  uint32_t dtype;         /* MLP_DTYPE_* */
+  uint32_t flags;         /* MLP_FLAG_* */
+  uint32_t in_dim;
+  uint32_t hid_dim;
+  uint32_t out_dim;
+  uint32_t nsections;     /* used entries of the offset table */
+  uint64_t file_bytes;    /* total length including header */
+  uint64_t checksum;      /* checkpoint_hash over [64, file_bytes) */
+  uint64_t reserved;
+} MLPFileHeader;
+
+typedef char mlp_header_is_64_bytes[sizeof(MLPFileHeader) == 64 ? 1 : -1];
+
+/** \brief Round up to the section alignment. */
+static uint64_t align_up(uint64_t v) {
+  return (v + MLP_FILE_ALIGN - 1) & ~(uint64_t)(MLP_FILE_ALIGN - 1);
+}
+
+/** \brief Write header, offset table and sections; fills in offsets and the
+ * checksum. The file is written beside path and renamed into place
+ * (checkpoint_write_file) so processes mapping the old file are
+ * unaffected. */
+static int write_sections(const char *path, MLPFileHeader *hd,
+                          const void *const *data, const size_t *bytes,
+                          int nsec) {
+  uint64_t off[MLP_FILE_SECTIONS] = {0};
+  uint64_t pos = MLP_FILE_DATA;
+  for (int s = 0; s < nsec; ++s) {
+    pos = align_up(pos);
+    off[s] = pos;
+    pos += bytes[s];
+  }
+  hd->nsections = (uint32_t)nsec;
+  hd->file_bytes = pos;
+  static const unsigned char zeros[MLP_FILE_ALIGN] = {0};
+  const void *parts[2 + 2 * MLP_FILE_SECTIONS] = {hd, off};
+  size_t part_bytes[2 + 2 * MLP_FILE_SECTIONS] = {sizeof(*hd), sizeof(off)};
+  /* checkpoint_hash works on 8-byte words, so each section's tail is hashed
+   * together with the padding that follows it to match the loader's single
+   * pass over the file */
+  unsigned char gap[2 * MLP_FILE_ALIGN];
+  size_t ngap = 0;
+  uint64_t h = checkpoint_hash(CHECKPOINT_HASH_INIT, off, sizeof(off));
+  pos = MLP_FILE_DATA;
+  for (int s = 0; s < nsec; ++s) {
+    size_t pad = (size_t)(off[s] - pos);
+    size_t body = bytes[s] & ~(size_t)7;
+    memset(gap + ngap, 0, pad);
+    h = checkpoint_hash(h, gap, ngap + pad);
+    h = checkpoint_hash(h, data[s], body);
+    ngap = bytes[s] - body;
+    memcpy(gap, (const unsigned char *)data[s] + body, ngap);
+    parts[2 + 2 * s] = zeros;
+    part_bytes[2 + 2 * s] = pad;
+    parts[3 + 2 * s] = data[s];
+    part_bytes[3 + 2 * s] = bytes[s];
+    pos = off[s] + bytes[s];
+  }
+  hd->checksum = checkpoint_hash(h, gap, ngap);
+  return checkpoint_write_file(path, parts, part_bytes, 2 + 2 * nsec);
+}
+
+/** \brief Section sizes of a double-precision model. */
+static void f64_sizes(int I, int H, int O, size_t *bytes) {
+  bytes[0] = sizeof(double) * (size_t)I * H;
+  bytes[1] = sizeof(double) * (size_t)H;
+  bytes[2] = sizeof(double) * (size_t)H * O;
+  bytes[3] = sizeof(double) * (size_t)O;
+}
+
+/** \brief Section sizes of an int8 model: s1,b1,s2,b2,r1,r2,w1q,w2q. */
+static void q8_sizes(int I, int H, int O, size_t *bytes) {
+  bytes[0] = bytes[1] = sizeof(float) * (size_t)H;
+  bytes[2] = bytes[3] = sizeof(float) * (size_t)O;
+  bytes[4] = sizeof(int32_t) * (size_t)H;
+  bytes[5] = sizeof(int32_t) * (size_t)O;
+  bytes[6] = (size_t)I * H;
+  bytes[7] = (size_t)H * O;
+}
+
+/* Computes section byte sizes from the model shape. */
+typedef void (*SectionSizesFn)(int in_dim, int hid_dim, int out_dim,
+                               size_t *bytes);
+
+/** \brief Map a weight file, validate header, checksum and section bounds.
+ * On success base and len describe the mapping and off[] the section starts. */
+static int map_sections(const char *path, uint32_t dtype, SectionSizesFn sizes,
+                        int nsec, MLPFileHeader *hd, void **base, size_t *len,
+                        uint64_t *off) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)MLP_FILE_DATA) {
+    close(fd);
+    return -1;
+  }
+  size_t n = (size_t)st.st_size;
+  /* private writable mapping: pages stay shared until a caller modifies them */
+  void *p = mmap(NULL, n, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return -1;
+  const unsigned char *bytes_in = (const unsigned char *)p;
+  memcpy(hd, bytes_in, sizeof(*hd));
+  memcpy(off, bytes_in + sizeof(*hd), 8u * MLP_FILE_SECTIONS);
+  int ok = memcmp(hd->magic, MLP_FILE_MAGIC, sizeof(hd->magic)) == 0 &&
+           hd->version == MLP_FILE_VERSION && hd->endian == MLP_FILE_ENDIAN &&
+           hd->dtype == dtype && hd->nsections == (uint32_t)nsec &&
+           hd->file_bytes == n && hd->in_dim > 0 && hd->hid_dim > 0 &&
+           hd->out_dim > 0 && hd->in_dim <= MLP_FILE_MAX_DIM &&
+           hd->hid_dim <= MLP_FILE_MAX_DIM && hd->out_dim <= MLP_FILE_MAX_DIM;
+  size_t bytes[MLP_FILE_SECTIONS] = {0};
+  if (ok)
+    sizes((int)hd->in_dim, (int)hd->hid_dim, (int)hd->out_dim, bytes);
+  for (int s = 0; ok && s < nsec; ++s)
+    ok = off[s] % MLP_FILE_ALIGN == 0 && off[s] >= MLP_FILE_DATA &&
+         off[s] <= n && bytes[s] <= n - off[s];
+  if (ok)
+    ok = checkpoint_hash(CHECKPOINT_HASH_INIT, bytes_in + sizeof(*hd),
+                         n - sizeof(*hd)) == hd->checksum;
+  if (!ok) {
+    munmap(p, n);
+    return -1;
+  }
+  *base = p;
+  *len = n;
+  return 0;
+}
+
+/** \brief Fill a header for the given shape and dtype. */
+static void header_init(MLPFileHeader *hd, uint32_t dtype, int in_dim,
+                        int hid_dim, int out_dim) {
+  memset(hd, 0, sizeof(*hd));
+  memcpy(hd->magic, MLP_FILE_MAGIC, sizeof(MLP_FILE_MAGIC));
+  hd->version = MLP_FILE_VERSION;
+  hd->endian = MLP_FILE_ENDIAN;
+  hd->dtype = dtype;
+  hd->flags = dtype == MLP_DTYPE_Q8 ? MLP_FLAG_QSCALE : 0;
+  hd->in_dim = (uint32_t)in_dim;
+  hd->hid_dim = (uint32_t)hid_dim;
+  hd->out_dim = (uint32_t)out_dim;
+}
+
+/** Save double-precision weights. */
+int mlp_save(const MLP *m, const char *path) {
+  if (!m || !path || !m->w1 || !m->b1 || !m->w2 || !m->b2)
+    return -1;
+  MLPFileHeader hd;
+  header_init(&hd, MLP_DTYPE_F64, m->in_dim, m->hid_dim, m->out_dim);
+  size_t bytes[4];
+  f64_sizes(m->in_dim, m->hid_dim, m->out_dim, bytes);
+  const void *data[4] = {m->w1, m->b1, m->w2, m->b2};
+  return write_sections(path, &hd, data, bytes, 4);
+}
+
+/** Zero-copy load of double-precision weights. */
+int mlp_load_mmap(MLP *m, const char *path) {
+  if (!m || !path)
+    return -1;
+  MLPFileHeader hd;
+  uint64_t off[MLP_FILE_SECTIONS];
+  void *base;
+  size_t len;
+  if (map_sections(path, MLP_DTYPE_F64, f64_sizes, 4, &hd, &base, &len,
+                   off) != 0)
+    return -1;
+  unsigned char *b = (unsigned char *)base;
+  memset(m, 0, sizeof(*m));
+  m->in_dim = (int)hd.in_dim;
+  m->hid_dim = (int)hd.hid_dim;
+  m->out_dim = (int)hd.out_dim;
+  m->w1 = (double *)(b + off[0]);
+  m->b1 = (double *)(b + off[1]);
+  m->w2 = (double *)(b + off[2]);
+  m->b2 = (double *)(b + off[3]);
+  m->mapping = base;
+  m->mapping_size = len;
+  return 0;
+}
+
+/** Save int8 weights with their per-channel scales. */
+int mlp_q8_save(const MLPQ8 *q, const char *path) {
+  if (!q || !path || !q->w1q)
+    return -1;
+  MLPFileHeader hd;
+  header_init(&hd, MLP_DTYPE_Q8, q->in_dim, q->hid_dim, q->out_dim);
+  size_t bytes[8];
+  q8_sizes(q->in_dim, q->hid_dim, q->out_dim, bytes);
+  const void *data[8] = {q->s1, q->b1, q->s2, q->b2,
+                         q->r1, q->r2, q->w1q, q->w2q};
+  return write_sections(path, &hd, data, bytes, 8);
+}
+
+/** Zero-copy load of int8 weights. */
+int mlp_q8_load_mmap(MLPQ8 *q, const char *path) {
+  if (!q || !path)
+    return -1;
+  MLPFileHeader hd;
+  uint64_t off[MLP_FILE_SECTIONS];
+  void *base;
+  size_t len;
+  if (map_sections(path, MLP_DTYPE_Q8, q8_sizes, 8, &hd, &base, &len,
+                   off) != 0)
+    return -1;
+  if (!(hd.flags & MLP_FLAG_QSCALE)) {
+    munmap(base, len);
+    return -1;
+  }
+  unsigned char *b = (unsigned char *)base;
+  memset(q, 0, sizeof(*q));
+  q->in_dim = (int)hd.in_dim;
+  q->hid_dim = (int)hd.hid_dim;
+  q->out_dim = (int)hd.out_dim;
+  q->s1 = (float *)(b + off[0]);
+  q->b1 = (float *)(b + off[1]);
+  q->s2 = (float *)(b + off[2]);
+  q->b2 = (float *)(b + off[3]);
+  q->r1 = (int32_t *)(b + off[4]);
+  q->r2 = (int32_t *)(b + off[5]);
+  q->w1q = (int8_t *)(b + off[6]);
+  q->w2q = (int8_t *)(b + off[7]);
+  q->mapping = base;
+  q->mapping_size = len;
+  return 0;
+}
@@ -0,0 +1,488 @@
+/**
+ * \file mlp_parallel.c
+ * \brief Multithreaded MLP training: Hogwild-style lock-free SGD and
+ * synchronous data-parallel mini-batches with tree-reduced gradients.
+ *
+ * Samples are sharded into contiguous per-thread ranges; each thread shuffles
+ * its own shard every epoch with a private xorshift stream, so the global
+ * simulation RNG is never touched. All scratch is allocated at trainer
+ * creation (shuffle orders grow on demand between epochs).
+ */
+#include "simulation.h"
+#include "checkpoint.h"
+#include "parallel.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** \brief Per-thread state: RNG stream, scratch, gradient slot. */
+typedef struct {
+  unsigned rng;         /**< xorshift32 state (never zero). */
+  double *h;            /**< Hidden activations (hid_dim). */
+  double *o;            /**< Outputs (out_dim). */
+  double *grad_o;       /**< Output error (out_dim). */
+  double *grad_h;       /**< Hidden error (hid_dim). */
+  unsigned char *mask;  /**< ReLU mask (hid_dim). */
+  double *grad;         /**< Flat gradient w1|b1|w2|b2 (SYNC only). */
+  int *order;           /**< Shuffled sample indices of this shard. */
+  int order_cap;        /**< Capacity of order. */
+  int count;            /**< Samples folded into grad this step. */
+  double loss;          /**< Squared error accumulated this epoch. */
+} MLPThreadState;
+
+struct MLPTrainer {
+  int nthreads;
+  MLPTrainMode mode;
+  int batch;
+  int in_dim, hid_dim, out_dim;
+  size_t nparams;
+  MLPThreadState *ts;
+  ParallelBarrier *barrier;
+  /* per-epoch arguments shared with workers */
+  MLP *m;
+  const double *xs, *ys;
+  int n;
+  double lr;
+};
+
+/** \brief Per-thread xorshift32 step. */
+static inline unsigned trainer_rand(unsigned *s) {
+  unsigned x = *s;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *s = x;
+  return x;
+}
+
+/** \brief Derive a non-zero stream seed for thread t (splitmix-style mix). */
+static unsigned trainer_stream_seed(unsigned seed, int t) {
+  unsigned z = seed + 0x9E3779B9u * (unsigned)(t + 1);
+  z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+  z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+  z ^= z >> 16;
+  return z ? z : 0x6D2B79F5u;
+}
+
+/** \brief Forward + backward for one sample.
+ *  With g non-NULL the gradient is accumulated into g; otherwise weights are
+ *  updated in place with step lr (Hogwild). Returns the squared error.
+ */
+static double mlp_sample_step(MLP *m, const double *x, const double *t,
+                              MLPThreadState *s, double *g, double lr) {
+  const int I = m->in_dim, H = m->hid_dim, O = m->out_dim;
+  for (int j = 0; j < H; ++j) {
+    double acc = m->b1[j];
+    for (int i = 0; i < I; ++i)
+      acc += x[i] * m->w1[i * H + j];
+    s->mask[j] = acc > 0;
+    s->h[j] = acc > 0 ? acc : 0;
+  }
+  double err = 0.0;
+  for (int k = 0; k < O; ++k) {
+    double acc = m->b2[k];
+    for (int j = 0; j < H; ++j)
+      acc += s->h[j] * m->w2[j * O + k];
+    s->o[k] = acc;
+    s->grad_o[k] = acc - t[k];
+    err += s->grad_o[k] * s->grad_o[k];
+  }
+  for (int j = 0; j < H; ++j) {
+    double sum = 0;
+    if (s->mask[j])
+      for (int k = 0; k < O; ++k)
+        sum += s->grad_o[k] * m->w2[j * O + k];
+    s->grad_h[j] = sum;
+  }
+  if (g) {
+    double *gw1 = g, *gb1 = gw1 + (size_t)I * H;
+    double *gw2 = gb1 + H, *gb2 = gw2 + (size_t)H * O;
+    for (int k = 0; k < O; ++k) {
+      gb2[k] += s->grad_o[k];
+      for (int j = 0; j < H; ++j)
+        gw2[j * O + k] += s->grad_o[k] * s->h[j];
+    }
+    for (int j = 0; j < H; ++j) {
+      gb1[j] += s->grad_h[j];
+      for (int i = 0; i < I; ++i)
+        gw1[i * H + j] += s->grad_h[j] * x[i];
+    }
+  } else {
+    for (int k = 0; k < O; ++k) {
+      m->b2[k] -= lr * s->grad_o[k];
+      for (int j = 0; j < H; ++j)
+        m->w2[j * O + k] -= lr * s->grad_o[k] * s->h[j];
+    }
+    for (int j = 0; j < H; ++j) {
+      m->b1[j] -= lr * s->grad_h[j];
+      for (int i = 0; i < I; ++i)
+        m->w1[i * H + j] -= lr * s->grad_h[j] * x[i];
+    }
+  }
+  return err;
+}
+
+/** \brief Apply flat gradient range [lo,hi) scaled by step to the weights. */
+static void mlp_apply_range(MLP *m, const double *g, size_t lo, size_t hi,
+                            double step) {
+  size_t n1 = (size_t)m->in_dim * m->hid_dim;
+  size_t n2 = (size_t)m->hid_dim * m->out_dim;
+  double *parts[4] = {m->w1, m->b1, m->w2, m->b2};
+  size_t lens[4] = {n1, (size_t)m->hid_dim, n2, (size_t)m->out_dim};
+  size_t base = 0;
+  for (int p = 0; p < 4; ++p) {
+    if (hi > base && lo < base + lens[p]) {
+      size_t a = lo > base ? lo - base : 0;
+      size_t b = hi - base < lens[p] ? hi - base : lens[p];
+      for (size_t i = a; i < b; ++i)
+        parts[p][i] -= step * g[base + i];
+    }
+    base += lens[p];
+  }
+}
+
+/** \brief Fisher-Yates shuffle of this thread's shard. */
+static void trainer_shuffle(MLPThreadState *s, int lo, int len) {
+  for (int p = 0; p < len; ++p)
+    s->order[p] = lo + p;
+  for (int p = len - 1; p > 0; --p) {
+    int q = (int)(trainer_rand(&s->rng) % (unsigned)(p + 1));
+    int tmp = s->order[p];
+    s->order[p] = s->order[q];
+    s->order[q] = tmp;
+  }
+}
+
+/** \brief Reset slice t for an epoch and shuffle its shard; returns the
+ *  shard length. */
+static int trainer_slice_begin(MLPTrainer *tr, int t) {
+  const int T = tr->nthreads;
+  int lo = (int)((long)tr->n * t / T);
+  int hi = (int)((long)tr->n * (t + 1) / T);
+  MLPThreadState *s = &tr->ts[t];
+  s->loss = 0.0;
+  trainer_shuffle(s, lo, hi - lo);
+  return hi - lo;
+}
+
+/** \brief Synchronous step count of an epoch; *bt receives the samples each
+ *  slice contributes per step. */
+static int trainer_sync_steps(const MLPTrainer *tr, int *bt) {
+  const int T = tr->nthreads;
+  *bt = (tr->batch + T - 1) / T;
+  int max_len = (tr->n + T - 1) / T;
+  return (max_len + *bt - 1) / *bt;
+}
+
+/** \brief Gradient of slice t's samples [st*bt, min((st+1)*bt, len)). */
+static void trainer_sync_gather(MLPTrainer *tr, int t, int st, int bt,
+                                int len) {
+  MLPThreadState *s = &tr->ts[t];
+  MLP *m = tr->m;
+  memset(s->grad, 0, sizeof(double) * tr->nparams);
+  int end = (st + 1) * bt < len ? (st + 1) * bt : len;
+  s->count = 0;
+  for (int p = st * bt; p < end; ++p) {
+    int idx = s->order[p];
+    s->loss += mlp_sample_step(m, tr->xs + (size_t)idx * m->in_dim,
+                               tr->ys + (size_t)idx * m->out_dim, s, s->grad,
+                               0.0);
+    s->count++;
+  }
+}
+
+/** \brief One level of the fixed-shape pairwise tree: slot t absorbs slot
+ *  t+stride. */
+static void trainer_sync_reduce(MLPTrainer *tr, int t, int stride) {
+  const int T = tr->nthreads;
+  if ((t % (2 * stride)) == 0 && t + stride < T) {
+    MLPThreadState *s = &tr->ts[t];
+    const MLPThreadState *o = &tr->ts[t + stride];
+    for (size_t i = 0; i < tr->nparams; ++i)
+      s->grad[i] += o->grad[i];
+    s->count += o->count;
+  }
+}
+
+/** \brief Apply slice t's share of the reduced gradient. */
+static void trainer_sync_apply(MLPTrainer *tr, int t) {
+  const int T = tr->nthreads;
+  size_t plo = tr->nparams * t / T, phi = tr->nparams * (t + 1) / T;
+  int total = tr->ts[0].count;
+  if (total > 0)
+    mlp_apply_range(tr->m, tr->ts[0].grad, plo, phi, tr->lr / total);
+}
+
+/** \brief Worker body for one epoch (task index == thread index). */
+static void trainer_worker(void *ctx, int task, int thread) {
+  (void)thread;
+  MLPTrainer *tr = (MLPTrainer *)ctx;
+  const int T = tr->nthreads, t = task;
+  MLPThreadState *s = &tr->ts[t];
+  MLP *m = tr->m;
+  int len = trainer_slice_begin(tr, t);
+  if (tr->mode == MLP_TRAIN_HOGWILD) {
+    for (int p = 0; p < len; ++p) {
+      int idx = s->order[p];
+      s->loss += mlp_sample_step(m, tr->xs + (size_t)idx * m->in_dim,
+                                 tr->ys + (size_t)idx * m->out_dim, s, NULL,
+                                 tr->lr);
+    }
+    return;
+  }
+  /* synchronous mini-batches: each thread contributes bt samples per step */
+  int bt, steps = trainer_sync_steps(tr, &bt);
+  for (int st = 0; st < steps; ++st) {
+    trainer_sync_gather(tr, t, st, bt, len);
+    parallel_barrier_wait(tr->barrier);
+    for (int stride = 1; stride < T; stride <<= 1) {
+      trainer_sync_reduce(tr, t, stride);
+      parallel_barrier_wait(tr->barrier);
+    }
+    trainer_sync_apply(tr, t);
+    parallel_barrier_wait(tr->barrier);
+  }
+}
+
+/** \brief Synchronous epoch on the calling thread: the slices' phases run
+ *  one after another in barrier order, so the weights match the team's. */
+static void trainer_sync_serial(MLPTrainer *tr) {
+  const int T = tr->nthreads;
+  int lens[256];
+  for (int t = 0; t < T; ++t)
+    lens[t] = trainer_slice_begin(tr, t);
+  int bt, steps = trainer_sync_steps(tr, &bt);
+  for (int st = 0; st < steps; ++st) {
+    for (int t = 0; t < T; ++t)
+      trainer_sync_gather(tr, t, st, bt, lens[t]);
+    for (int stride = 1; stride < T; stride <<= 1)
+      for (int t = 0; t < T; ++t)
+        trainer_sync_reduce(tr, t, stride);
+    for (int t = 0; t < T; ++t)
+      trainer_sync_apply(tr, t);
+  }
+}
+
+/** Create trainer with per-thread scratch. */
+MLPTrainer *mlp_trainer_create(const MLP *m, int nthreads, MLPTrainMode mode,
+                               int batch_size, unsigned seed) {
+  if (!m || m->in_dim <= 0 || m->hid_dim <= 0 || m->out_dim <= 0)
+    return NULL;
+  if (nthreads <= 0)
+    nthreads = parallel_default_threads();
+  if (nthreads > 256)
+    nthreads = 256; /* parallel_for team limit */
+  MLPTrainer *tr = (MLPTrainer *)calloc(1, sizeof(*tr));
+  if (!tr)
+    return NULL;
+  tr->nthreads = nthreads;
+  tr->mode = mode;
+  tr->batch = batch_size > 0 ? batch_size : 32;
+  tr->in_dim = m->in_dim;
+  tr->hid_dim = m->hid_dim;
+  tr->out_dim = m->out_dim;
+  tr->nparams = (size_t)m->in_dim * m->hid_dim + m->hid_dim +
+                (size_t)m->hid_dim * m->out_dim + m->out_dim;
+  tr->ts = (MLPThreadState *)calloc(nthreads, sizeof(MLPThreadState));
+  tr->barrier = parallel_barrier_create(nthreads);
+  if (!tr->ts || !tr->barrier) {
+    mlp_trainer_destroy(tr);
+    return NULL;
+  }
+  for (int t = 0; t < nthreads; ++t) {
+    MLPThreadState *s = &tr->ts[t];
+    s->rng = trainer_stream_seed(seed, t);
+    s->h = (double *)malloc(sizeof(double) * m->hid_dim);
+    s->grad_h = (double *)malloc(sizeof(double) * m->hid_dim);
+    s->o = (double *)malloc(sizeof(double) * m->out_dim);
+    s->grad_o = (double *)malloc(sizeof(double) * m->out_dim);
+    s->mask = (unsigned char *)malloc(m->hid_dim);
+    if (mode == MLP_TRAIN_SYNC)
+      s->grad = (double *)malloc(sizeof(double) * tr->nparams);
+    if (!s->h || !s->grad_h || !s->o || !s->grad_o || !s->mask ||
+        (mode == MLP_TRAIN_SYNC && !s->grad)) {
+      mlp_trainer_destroy(tr);
+      return NULL;
+    }
+  }
+  return tr;
+}
+
+/** Run one parallel epoch; returns mean squared error. */
+double mlp_trainer_epoch(MLPTrainer *t, MLP *m, const double *xs,
+                         const double *ys, int n_samples, double lr) {
+  if (!t || !m || !xs || !ys || n_samples <= 0 || m->in_dim != t->in_dim ||
+      m->hid_dim != t->hid_dim || m->out_dim != t->out_dim)
+    return -1.0;
+  int shard = (n_samples + t->nthreads - 1) / t->nthreads;
+  for (int i = 0; i < t->nthreads; ++i) {
+    MLPThreadState *s = &t->ts[i];
+    if (s->order_cap < shard) {
+      int *o = (int *)realloc(s->order, sizeof(int) * shard);
+      if (!o)
+        return -1.0;
+      s->order = o;
+      s->order_cap = shard;
+    }
+  }
+  t->m = m;
+  t->xs = xs;
+  t->ys = ys;
+  t->n = n_samples;
+  t->lr = lr;
+  /* synchronous slices meet at the barrier: they must all be running, or
+   * else take turns on this thread */
+  if (t->mode == MLP_TRAIN_SYNC) {
+    if (parallel_for_team(t->nthreads, t->nthreads, trainer_worker, t) < 0)
+      trainer_sync_serial(t);
+  } else {
+    parallel_for(t->nthreads, t->nthreads, trainer_worker, t);
+  }
+  double loss = 0.0;
+  for (int i = 0; i < t->nthreads; ++i)
+    loss += t->ts[i].loss;
+  return loss / n_samples;
+}
+
+/** Release trainer resources. */
+void mlp_trainer_destroy(MLPTrainer *t) {
+  if (!t)
+    return;
+  if (t->ts) {
+    for (int i = 0; i < t->nthreads; ++i) {
+      MLPThreadState *s = &t->ts[i];
+      free(s->h);
+      free(s->grad_h);
+      free(s->o);
+      free(s->grad_o);
+      free(s->mask);
+      free(s->grad);
+      free(s->order);
+    }
+    free(t->ts);
+  }
+  parallel_barrier_destroy(t->barrier);
+  free(t);
+}
+
+#define TAG_W1 CHECKPOINT_TAG('W', '1', ' ', ' ')
+#define TAG_B1 CHECKPOINT_TAG('B', '1', ' ', ' ')
+#define TAG_W2 CHECKPOINT_TAG('W', '2', ' ', ' ')
+#define TAG_B2 CHECKPOINT_TAG('B', '2', ' ', ' ')
+#define TAG_RNG CHECKPOINT_TAG('R', 'N', 'G', ' ')
+#define TAG_MSE CHECKPOINT_TAG('M', 'S', 'E', ' ')
+
+enum { MLP_KEY_WORDS = 10 };
+
+/** \brief Weights, trainer RNG streams and last error after done epochs. */
+static void train_snapshot(Checkpointer *ck, const uint64_t *key,
+                           const MLP *m, const MLPTrainer *t,
+                           const unsigned *rng, double mse, long done) {
+  const size_t H = (size_t)m->hid_dim, O = (size_t)m->out_dim;
+  CheckpointSection sec[7] = {
+      {CHECKPOINT_TAG_KEY, key, MLP_KEY_WORDS * sizeof(*key)},
+      {TAG_W1, m->w1, sizeof(double) * (size_t)m->in_dim * H},
+      {TAG_B1, m->b1, sizeof(double) * H},
+      {TAG_W2, m->w2, sizeof(double) * H * O},
+      {TAG_B2, m->b2, sizeof(double) * O},
+      {TAG_MSE, &mse, sizeof(mse)},
+      {TAG_RNG, rng, t ? sizeof(unsigned) * (size_t)t->nthreads : 0}};
+  checkpoint_submit(ck, CHECKPOINT_KIND_MLP, done, sec, 7);
+}
+
+/** \brief Copy a section of exactly bytes into dst; 0 on success. */
+static int restore_section(const CheckpointImage *img, uint32_t tag, void *dst,
+                           size_t bytes) {
+  size_t n = 0;
+  const void *src = checkpoint_image_section(img, tag, &n);
+  if (!src || n != bytes)
+    return -1;
+  if (bytes)
+    memcpy(dst, src, bytes);
+  return 0;
+}
+
+/** Training loop resumable from ck's snapshots. */
+int mlp_train_resume(MLP *m, MLPTrainer *t, const double *xs,
+                     const double *ys, int n_samples, double lr, int epochs,
+                     Checkpointer *ck, double *mse) {
+  if (!m || !xs || !ys || n_samples <= 0 || epochs < 0 ||
+      (t && (m->in_dim != t->in_dim || m->hid_dim != t->hid_dim ||
+             m->out_dim != t->out_dim)))
+    return -1;
+  const size_t I = (size_t)m->in_dim, H = (size_t)m->hid_dim,
+               O = (size_t)m->out_dim;
+  uint64_t lr_bits;
+  memcpy(&lr_bits, &lr, sizeof(lr_bits));
+  /* the problem: shape, data, step size, trainer setup, starting weights */
+  uint64_t w = checkpoint_hash(CHECKPOINT_HASH_INIT, m->w1,
+                               sizeof(double) * I * H);
+  w = checkpoint_hash(w, m->b1, sizeof(double) * H);
+  w = checkpoint_hash(w, m->w2, sizeof(double) * H * O);
+  w = checkpoint_hash(w, m->b2, sizeof(double) * O);
+  uint64_t key[MLP_KEY_WORDS] = {
+      (uint64_t)I << 42 | (uint64_t)H << 21 | (uint64_t)O,
+      (uint64_t)n_samples,
+      lr_bits,
+      t ? (uint64_t)t->nthreads : 0,
+      t ? (uint64_t)t->mode + 1 : 0,
+      t ? (uint64_t)t->batch : 0,
+      checkpoint_hash(CHECKPOINT_HASH_INIT, xs,
+                      sizeof(double) * I * (size_t)n_samples),
+      checkpoint_hash(CHECKPOINT_HASH_INIT, ys,
+                      sizeof(double) * O * (size_t)n_samples),
+      w,
+      0};
+  unsigned *rng = NULL;
+  if (t) {
+    rng = (unsigned *)malloc(sizeof(unsigned) * (size_t)t->nthreads);
+    if (!rng)
+      return -1;
+  }
+  long done = 0;
+  double err = 0.0;
+  CheckpointImage img;
+  if (ck && checkpoint_resume(ck, CHECKPOINT_KIND_MLP, key, sizeof(key),
+                              &img) == 0) {
+    size_t rng_bytes = t ? sizeof(unsigned) * (size_t)t->nthreads : 0;
+    if (img.step <= epochs &&
+        (!t || restore_section(&img, TAG_RNG, rng, rng_bytes) == 0) &&
+        restore_section(&img, TAG_W1, m->w1, sizeof(double) * I * H) == 0 &&
+        restore_section(&img, TAG_B1, m->b1, sizeof(double) * H) == 0 &&
+        restore_section(&img, TAG_W2, m->w2, sizeof(double) * H * O) == 0 &&
+        restore_section(&img, TAG_B2, m->b2, sizeof(double) * O) == 0 &&
+        restore_section(&img, TAG_MSE, &err, sizeof(err)) == 0) {
+      done = img.step;
+      for (int i = 0; t && i < t->nthreads; ++i)
+        t->ts[i].rng = rng[i];
+    }
+    checkpoint_image_free(&img);
+  }
+  int rc = 0;
+  while (done < epochs) {
+    if (t) {
+      err = mlp_trainer_epoch(t, m, xs, ys, n_samples, lr);
+      if (err < 0) {
+        rc = -1;
+        break;
+      }
+    } else {
+      mlp_train_epoch(m, xs, ys, n_samples, lr);
+    }
+    ++done;
+    if (ck && done < epochs && checkpoint_due(ck, done)) {
+      for (int i = 0; t && i < t->nthreads; ++i)
+        rng[i] = t->ts[i].rng;
+      train_snapshot(ck, key, m, t, rng, err, done);
+    }
+  }
+  if (ck && rc == 0) {
+    for (int i = 0; t && i < t->nthreads; ++i)
+      rng[i] = t->ts[i].rng;
+    train_snapshot(ck, key, m, t, rng, err, done);
+    checkpoint_flush(ck);
+  }
+  free(rng);
+  if (mse)
+    *mse = err;
+  return rc;
+}
@@ -0,0 +1,265 @@
+/**
+ * \file mlp_quant.c
+ * \brief Int8 post-training quantization and batched int8 inference for the
+ * single hidden-layer MLP.
+ *
+ * Weights are quantized symmetrically per output channel; activations are
+ * quantized per sample. Dot products accumulate in int32 using AVX512-VNNI /
+ * AVX-VNNI (vpdpbusd), AVX2 (vpmaddwd) or a portable scalar loop, whichever
+ * the CPU supports (chosen once per batch).
+ */
+#include "cpu_features.h"
+#include "simulation.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
+
+/* Elements consumed per SIMD step; row sums cover this prefix only. */
+#define Q8_BLOCK 32
+
+/** \brief int8 x int8 dot product with int32 accumulation.
+ *  \param rsum Sum of b over the first (n & ~31) elements; the VNNI paths
+ *  feed a+128 as unsigned bytes and subtract 128*rsum afterwards.
+ */
+typedef int32_t (*Q8DotFn)(const int8_t *a, const int8_t *b, int n,
+                           int32_t rsum);
+
+static int32_t q8_dot_scalar(const int8_t *a, const int8_t *b, int n,
+                             int32_t rsum) {
+  (void)rsum;
+  int32_t acc = 0;
+  for (int i = 0; i < n; ++i)
+    acc += (int32_t)a[i] * (int32_t)b[i];
+  return acc;
+}
+
+#if defined(CPU_X86)
+/** \brief Horizontal sum of eight int32 lanes. */
+CPU_TARGET("avx2")
+static inline int32_t q8_hsum(__m256i v) {
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v),
+                            _mm256_extracti128_si256(v, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+  return _mm_cvtsi128_si32(s);
+}
+
+CPU_TARGET("avx2")
+static int32_t q8_dot_avx2(const int8_t *a, const int8_t *b, int n,
+                           int32_t rsum) {
+  (void)rsum;
+  int i = 0;
+  __m256i vacc = _mm256_setzero_si256();
+  for (; i + Q8_BLOCK <= n; i += Q8_BLOCK) {
+    __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+    __m256i alo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(va));
+    __m256i ahi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(va, 1));
+    __m256i blo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(vb));
+    __m256i bhi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(vb, 1));
+    vacc = _mm256_add_epi32(vacc, _mm256_madd_epi16(alo, blo));
+    vacc = _mm256_add_epi32(vacc, _mm256_madd_epi16(ahi, bhi));
+  }
+  int32_t acc = q8_hsum(vacc);
+  for (; i < n; ++i)
+    acc += (int32_t)a[i] * (int32_t)b[i];
+  return acc;
+}
+
+/* vpdpbusd body shared by the VEX (AVX-VNNI) and EVEX (AVX512-VNNI)
+ * encodings */
+#define Q8_DOT_VNNI(DPBUSD)                                                   \
+  int i = 0;                                                                  \
+  int32_t acc = 0;                                                            \
+  int nb = n & ~(Q8_BLOCK - 1);                                               \
+  if (nb) {                                                                   \
+    const __m256i flip = _mm256_set1_epi8((char)0x80);                       \
+    __m256i vacc = _mm256_setzero_si256();                                    \
+    for (; i < nb; i += Q8_BLOCK) {                                           \
+      __m256i va = _mm256_xor_si256(                                         \
+          _mm256_loadu_si256((const __m256i *)(a + i)), flip);                \
+      __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));             \
+      vacc = DPBUSD(vacc, va, vb);                                            \
+    }                                                                         \
+    acc = q8_hsum(vacc) - 128 * rsum;                                         \
+  }                                                                           \
+  for (; i < n; ++i)                                                          \
+    acc += (int32_t)a[i] * (int32_t)b[i];                                     \
+  return acc
+
+CPU_TARGET("avx2,avxvnni")
+static int32_t q8_dot_avxvnni(const int8_t *a, const int8_t *b, int n,
+                              int32_t rsum) {
+  Q8_DOT_VNNI(_mm256_dpbusd_avx_epi32);
+}
+
+CPU_TARGET("avx2,avx512vnni,avx512vl")
+static int32_t q8_dot_avx512vnni(const int8_t *a, const int8_t *b, int n,
+                                 int32_t rsum) {
+  Q8_DOT_VNNI(_mm256_dpbusd_epi32);
+}
+#endif
+
+/** \brief Widest dot product kernel the CPU supports. All give identical
+ *  results (exact int32 arithmetic). */
+static Q8DotFn q8_dot_select(void) {
+#if defined(CPU_X86)
+  unsigned f = cpu_features();
+  if (f & CPU_AVX512_VNNI)
+    return q8_dot_avx512vnni;
+  if (f & CPU_AVX_VNNI)
+    return q8_dot_avxvnni;
+  if (f & CPU_AVX2)
+    return q8_dot_avx2;
+#endif
+  return q8_dot_scalar;
+}
+
+/** \brief Round-to-nearest int8 in [-127,127]. */
+static inline int8_t q8_round(double v) {
+  long r = lrint(v);
+  if (r > 127)
+    r = 127;
+  if (r < -127)
+    r = -127;
+  return (int8_t)r;
+}
+
+/** \brief Quantize one weight matrix (row-major rows x cols source with
+ * element (r,c) at src[r*rs + c*cs]) into transposed int8 rows.
+ */
+static void q8_quantize_matrix(const double *src, int rows, int cols,
+                               int row_stride, int col_stride, int8_t *dst,
+                               float *scale, int32_t *rsum) {
+  int nb = cols & ~(Q8_BLOCK - 1);
+  for (int r = 0; r < rows; ++r) {
+    double mx = 0.0;
+    for (int c = 0; c < cols; ++c) {
+      double v = fabs(src[r * row_stride + c * col_stride]);
+      if (v > mx)
+        mx = v;
+    }
+    double s = mx > 0 ? mx / 127.0 : 1.0;
+    int32_t sum = 0;
+    for (int c = 0; c < cols; ++c) {
+      int8_t q = q8_round(src[r * row_stride + c * col_stride] / s);
+      dst[(size_t)r * cols + c] = q;
+      if (c < nb)
+        sum += q;
+    }
+    scale[r] = (float)s;
+    rsum[r] = sum;
+  }
+}
+
+/** Quantize MLP weights to int8 with per-channel scales. */
+int mlp_quantize_q8(const MLP *m, MLPQ8 *q) {
+  if (!m || !q || m->in_dim <= 0 || m->hid_dim <= 0 || m->out_dim <= 0)
+    return -1;
+  memset(q, 0, sizeof(*q));
+  size_t H = (size_t)m->hid_dim, O = (size_t)m->out_dim;
+  size_t n1 = (size_t)m->in_dim * H, n2 = H * O;
+  /* floats, then int32 row sums, then int8 weights: natural alignment */
+  size_t bytes = (2 * H + 2 * O) * sizeof(float) + (H + O) * sizeof(int32_t) +
+                 n1 + n2;
+  unsigned char *blk = (unsigned char *)malloc(bytes);
+  if (!blk)
+    return -1;
+  q->storage = blk;
+  q->in_dim = m->in_dim;
+  q->hid_dim = m->hid_dim;
+  q->out_dim = m->out_dim;
+  q->s1 = (float *)blk;
+  q->b1 = q->s1 + H;
+  q->s2 = q->b1 + H;
+  q->b2 = q->s2 + O;
+  q->r1 = (int32_t *)(q->b2 + O);
+  q->r2 = q->r1 + H;
+  q->w1q = (int8_t *)(q->r2 + O);
+  q->w2q = q->w1q + n1;
+  /* w1 is in_dim x hid_dim: hidden unit j reads column j */
+  q8_quantize_matrix(m->w1, m->hid_dim, m->in_dim, 1, m->hid_dim, q->w1q,
+                     q->s1, q->r1);
+  q8_quantize_matrix(m->w2, m->out_dim, m->hid_dim, 1, m->out_dim, q->w2q,
+                     q->s2, q->r2);
+  for (size_t j = 0; j < H; ++j)
+    q->b1[j] = (float)m->b1[j];
+  for (size_t k = 0; k < O; ++k)
+    q->b2[k] = (float)m->b2[k];
+  return 0;
+}
+
+/** Release quantized buffers. */
+void mlp_q8_free(MLPQ8 *q) {
+  if (!q)
+    return;
+  if (q->mapping)
+    munmap(q->mapping, q->mapping_size);
+  else
+    free(q->storage);
+  memset(q, 0, sizeof(*q));
+}
+
+/** Bytes held by int8 weights plus per-channel scales. */
+size_t mlp_q8_weight_bytes(const MLPQ8 *q) {
+  if (!q)
+    return 0;
+  size_t H = (size_t)q->hid_dim, O = (size_t)q->out_dim;
+  return (size_t)q->in_dim * H + H * O + (H + O) * sizeof(float);
+}
+
+/** Batched int8 forward pass (scratch allocated once per call). */
+int mlp_forward_q8_batch(const MLPQ8 *q, const double *xs, int n, double *ys) {
+  if (!q || !q->w1q || !xs || !ys || n < 0)
+    return -1;
+  const int I = q->in_dim, H = q->hid_dim, O = q->out_dim;
+  int8_t *xq = (int8_t *)malloc((size_t)I + (size_t)H);
+  float *h = (float *)malloc(sizeof(float) * H);
+  if (!xq || !h) {
+    free(xq);
+    free(h);
+    return -1;
+  }
+  int8_t *hq = xq + I;
+  const Q8DotFn q8_dot = q8_dot_select();
+  for (int s = 0; s < n; ++s) {
+    const double *x = xs + (size_t)s * I;
+    double *y = ys + (size_t)s * O;
+    double mx = 0.0;
+    for (int i = 0; i < I; ++i) {
+      double v = fabs(x[i]);
+      if (v > mx)
+        mx = v;
+    }
+    double sx = mx > 0 ? mx / 127.0 : 1.0;
+    double inv_sx = 1.0 / sx;
+    for (int i = 0; i < I; ++i)
+      xq[i] = q8_round(x[i] * inv_sx);
+    float hmax = 0.0f;
+    for (int j = 0; j < H; ++j) {
+      int32_t acc = q8_dot(xq, q->w1q + (size_t)j * I, I, q->r1[j]);
+      float v = (float)acc * (float)sx * q->s1[j] + q->b1[j];
+      v = v > 0.0f ? v : 0.0f;
+      h[j] = v;
+      if (v > hmax)
+        hmax = v;
+    }
+    /* ReLU output is non-negative: quantize to [0,127] */
+    float sh = hmax > 0.0f ? hmax / 127.0f : 1.0f;
+    float inv_sh = 1.0f / sh;
+    for (int j = 0; j < H; ++j)
+      hq[j] = (int8_t)lrintf(h[j] * inv_sh);
+    for (int k = 0; k < O; ++k) {
+      int32_t acc = q8_dot(hq, q->w2q + (size_t)k * H, H, q->r2[k]);
+      y[k] = (double)acc * sh * q->s2[k] + q->b2[k];
+    }
+  }
+  free(xq);
+  free(h);
+  return 0;
+}
@@ -7,6 +7,7 @@
  */
 #include "observables.h"
 #include "coins.h"
+#include "material_tables.h"
 #include <math.h>
 #include <string.h>
 #include <stdio.h>
@@ -395,3 +396,47 @@ const MaterialProperties *get_material_properties_by_composition(const char *com
   
   return NULL;  /* No match found */
 }
+
+/** \brief Number of entries in the material database. */
+size_t material_count(void) {
+  return NUM_MATERIALS;
+}
+
+/** \brief Material database entry by index. */
+const MaterialProperties *get_material_by_index(size_t index) {
+  return index < NUM_MATERIALS ? &MATERIAL_DATABASE[index] : NULL;
+}
+
+/** \brief Database index of a material pointer (-1 if foreign). */
+long material_index(const MaterialProperties *properties) {
+  for (size_t i = 0; i < NUM_MATERIALS; i++) {
+    if (properties == &MATERIAL_DATABASE[i]) {
+      return (long)i;
+    }
+  }
+  return -1;
+}
+
+/** \brief Skin depth with conductivity taken from the temperature tables.
+ *
+ * Materials outside the database fall back to their stored conductivity.
+ */
+double observable_skin_depth_at(double frequency,
+                                const MaterialProperties *properties,
+                                double T) {
+  MaterialProperties at;
+  if (material_properties_at(properties, T, &at)) {
+    return observable_skin_depth(frequency, &at);
+  }
+  return observable_skin_depth(frequency, properties);
+}
+
+/** \brief Thermal diffusivity from temperature-dependent k and cp. */
+double observable_thermal_diffusivity_at(const MaterialProperties *properties,
+                                         double T) {
+  MaterialProperties at;
+  if (material_properties_at(properties, T, &at)) {
+    return observable_thermal_diffusivity(&at);
+  }
+  return observable_thermal_diffusivity(properties);
+}
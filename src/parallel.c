@@ -0,0 +1,227 @@
+/** \file parallel.c
+ *  \brief Fork-join task runner and barrier over POSIX threads.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "parallel.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifndef COINSORTER_NO_THREADS
+#include <pthread.h>
+#endif
+
+/* Upper bound on workers spawned by one parallel_for call. */
+#define PARALLEL_MAX_THREADS 256
+
+/** Default worker count from environment or online CPUs. */
+int parallel_default_threads(void) {
+#ifdef COINSORTER_NO_THREADS
+  return 1;
+#else
+  const char *env = getenv("COINSORTER_THREADS");
+  if (env && *env) {
+    int n = atoi(env);
+    if (n > 0)
+      return n > PARALLEL_MAX_THREADS ? PARALLEL_MAX_THREADS : n;
+  }
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n < 1)
+    n = 1;
+  return n > PARALLEL_MAX_THREADS ? PARALLEL_MAX_THREADS : (int)n;
+#endif
+}
+
+typedef struct {
+  ParallelTaskFn fn;
+  void *ctx;
+  int ntasks;
+  int nthreads;
+  int thread;
+} ParallelSlice;
+
+/** \brief Run the contiguous task range owned by one thread. */
+static void *parallel_run_slice(void *arg) {
+  const ParallelSlice *s = (const ParallelSlice *)arg;
+  long lo = (long)s->ntasks * s->thread / s->nthreads;
+  long hi = (long)s->ntasks * (s->thread + 1) / s->nthreads;
+  for (long t = lo; t < hi; ++t)
+    s->fn(s->ctx, (int)t, s->thread);
+  return NULL;
+}
+
+/** \brief Clamp a requested thread count for ntasks tasks. */
+static int team_size(int ntasks, int nthreads) {
+  if (nthreads <= 0)
+    nthreads = parallel_default_threads();
+  if (nthreads > ntasks)
+    nthreads = ntasks;
+  if (nthreads > PARALLEL_MAX_THREADS)
+    nthreads = PARALLEL_MAX_THREADS;
+  return nthreads;
+}
+
+static void slices_init(ParallelSlice *slices, int ntasks, int nthreads,
+                        ParallelTaskFn fn, void *ctx) {
+  for (int t = 0; t < nthreads; ++t) {
+    slices[t].fn = fn;
+    slices[t].ctx = ctx;
+    slices[t].ntasks = ntasks;
+    slices[t].nthreads = nthreads;
+    slices[t].thread = t;
+  }
+}
+
+/** Static-partition fork-join over ntasks. */
+int parallel_for(int ntasks, int nthreads, ParallelTaskFn fn, void *ctx) {
+  if (!fn || ntasks <= 0)
+    return 0;
+  nthreads = team_size(ntasks, nthreads);
+#ifdef COINSORTER_NO_THREADS
+  nthreads = 1;
+#endif
+  ParallelSlice slices[PARALLEL_MAX_THREADS];
+  slices_init(slices, ntasks, nthreads, fn, ctx);
+#ifndef COINSORTER_NO_THREADS
+  pthread_t tids[PARALLEL_MAX_THREADS];
+  int started[PARALLEL_MAX_THREADS] = {0};
+  for (int t = 1; t < nthreads; ++t)
+    started[t] =
+        pthread_create(&tids[t], NULL, parallel_run_slice, &slices[t]) == 0;
+  parallel_run_slice(&slices[0]);
+  for (int t = 1; t < nthreads; ++t) {
+    if (started[t])
+      pthread_join(tids[t], NULL);
+    else
+      parallel_run_slice(&slices[t]); /* spawn failed: run inline */
+  }
+#else
+  parallel_run_slice(&slices[0]);
+#endif
+  return nthreads;
+}
+
+#ifndef COINSORTER_NO_THREADS
+/** \brief Start gate of a team: go is 1 to run, -1 to abandon. */
+typedef struct {
+  pthread_mutex_t mu;
+  pthread_cond_t cv;
+  int go;
+} TeamGate;
+
+typedef struct {
+  ParallelSlice slice;
+  TeamGate *gate;
+} TeamMember;
+
+static void *team_member_run(void *arg) {
+  TeamMember *m = (TeamMember *)arg;
+  pthread_mutex_lock(&m->gate->mu);
+  while (m->gate->go == 0)
+    pthread_cond_wait(&m->gate->cv, &m->gate->mu);
+  int go = m->gate->go;
+  pthread_mutex_unlock(&m->gate->mu);
+  if (go > 0)
+    parallel_run_slice(&m->slice);
+  return NULL;
+}
+
+static void team_open(TeamGate *g, int go) {
+  pthread_mutex_lock(&g->mu);
+  g->go = go;
+  pthread_cond_broadcast(&g->cv);
+  pthread_mutex_unlock(&g->mu);
+}
+#endif
+
+/** Fork-join whose slices all run concurrently, or not at all. */
+int parallel_for_team(int ntasks, int nthreads, ParallelTaskFn fn,
+                      void *ctx) {
+  if (!fn || ntasks <= 0)
+    return 0;
+  nthreads = team_size(ntasks, nthreads);
+#ifdef COINSORTER_NO_THREADS
+  /* slices run one after another would never meet at their barriers */
+  if (nthreads > 1)
+    return -1;
+  ParallelSlice slice;
+  slices_init(&slice, ntasks, 1, fn, ctx);
+  parallel_run_slice(&slice);
+  return 1;
+#else
+  TeamGate gate = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0};
+  ParallelSlice slices[PARALLEL_MAX_THREADS];
+  TeamMember members[PARALLEL_MAX_THREADS];
+  pthread_t tids[PARALLEL_MAX_THREADS];
+  slices_init(slices, ntasks, nthreads, fn, ctx);
+  int spawned = 1;
+  for (; spawned < nthreads; ++spawned) {
+    members[spawned].slice = slices[spawned];
+    members[spawned].gate = &gate;
+    if (pthread_create(&tids[spawned], NULL, team_member_run,
+                       &members[spawned]) != 0)
+      break;
+  }
+  int ok = spawned == nthreads;
+  team_open(&gate, ok ? 1 : -1);
+  if (ok)
+    parallel_run_slice(&slices[0]);
+  for (int t = 1; t < spawned; ++t)
+    pthread_join(tids[t], NULL);
+  pthread_mutex_destroy(&gate.mu);
+  pthread_cond_destroy(&gate.cv);
+  return ok ? nthreads : -1;
+#endif
+}
+
+struct ParallelBarrier {
+  int nthreads;
+  int waiting;
+  unsigned generation;
+#ifndef COINSORTER_NO_THREADS
+  pthread_mutex_t mu;
+  pthread_cond_t cv;
+#endif
+};
+
+/** Create a barrier for nthreads participants. */
+ParallelBarrier *parallel_barrier_create(int nthreads) {
+  ParallelBarrier *b = (ParallelBarrier *)calloc(1, sizeof(*b));
+  if (!b)
+    return NULL;
+  b->nthreads = nthreads > 0 ? nthreads : 1;
+#ifndef COINSORTER_NO_THREADS
+  pthread_mutex_init(&b->mu, NULL);
+  pthread_cond_init(&b->cv, NULL);
+#endif
+  return b;
+}
+
+/** Wait until all participants arrive (generation counter guards reuse). */
+void parallel_barrier_wait(ParallelBarrier *b) {
+  if (!b || b->nthreads <= 1)
+    return;
+#ifndef COINSORTER_NO_THREADS
+  pthread_mutex_lock(&b->mu);
+  unsigned gen = b->generation;
+  if (++b->waiting == b->nthreads) {
+    b->waiting = 0;
+    b->generation++;
+    pthread_cond_broadcast(&b->cv);
+  } else {
+    while (gen == b->generation)
+      pthread_cond_wait(&b->cv, &b->mu);
+  }
+  pthread_mutex_unlock(&b->mu);
+#endif
+}
+
+/** Destroy barrier. */
+void parallel_barrier_destroy(ParallelBarrier *b) {
+  if (!b)
+    return;
+#ifndef COINSORTER_NO_THREADS
+  pthread_mutex_destroy(&b->mu);
+  pthread_cond_destroy(&b->cv);
+#endif
+  free(b);
+}
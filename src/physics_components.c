@@ -249,6 +249,156 @@ static PhysicsResult qft_rg_calculate(const PhysicsComponent *comp,
     return result;
 }
 
+/* Sphere-plate Lifshitz force magnitude (N) for a Drude/plasma metal. */
+static double lifshitz_sphere_force(double radius, double distance,
+                                    double temperature, double conductivity,
+                                    LifshitzModel model) {
+    LifshitzConfig cfg;
+    if (lifshitz_config_from_conductivity(&cfg, conductivity, temperature, model) != 0)
+        return 0.0;
+    cfg.geometry = LIFSHITZ_SPHERE_PLATE;
+    cfg.radius = radius;
+    return fabs(lifshitz_force(&cfg, distance));
+}
+
+static PhysicsResult casimir_lifshitz_calculate(const PhysicsComponent *comp,
+                                                const PhysicsParam *params,
+                                                size_t num_params) {
+    (void)comp;
+    PhysicsResult result = {0};
+    
+    double radius = 0.0, distance = 0.0, temperature = 293.0;
+    double conductivity = 59.6e6; /* copper */
+    double model = 0.0;
+    bool found_radius = false, found_distance = false;
+    
+    for (size_t i = 0; i < num_params; i++) {
+        const char *name = params[i].desc.name;
+        if (strcmp(name, "radius") == 0) {
+            radius = params[i].value.d;
+            found_radius = true;
+        } else if (strcmp(name, "distance") == 0) {
+            distance = params[i].value.d;
+            found_distance = true;
+        } else if (strcmp(name, "temperature") == 0) {
+            temperature = params[i].value.d;
+        } else if (strcmp(name, "conductivity") == 0) {
+            conductivity = params[i].value.d;
+        } else if (strcmp(name, "model") == 0) {
+            model = params[i].value.d;
+        }
+    }
+    
+    if (!found_radius || !found_distance) {
+        result.is_valid = false;
+        result.error_msg = "Missing required parameters";
+        return result;
+    }
+    
+    double f_drude = lifshitz_sphere_force(radius, distance, temperature,
+                                           conductivity, LIFSHITZ_DRUDE);
+    double f_plasma = lifshitz_sphere_force(radius, distance, temperature,
+                                            conductivity, LIFSHITZ_PLASMA);
+    if (f_drude <= 0.0 || f_plasma <= 0.0) {
+        result.is_valid = false;
+        result.error_msg = "Lifshitz evaluation requires a conducting material";
+        return result;
+    }
+    
+    result.value = model >= 0.5 ? f_plasma : f_drude;
+    result.dimension = PHYSICS_DIM_FORCE;
+    result.units = "N";
+    /* Drude vs plasma spread dominates the model uncertainty */
+    result.uncertainty = fabs(f_plasma - f_drude) + fabs(result.value) * 0.01;
+    result.is_valid = true;
+    result.error_msg = NULL;
+    
+    return result;
+}
+
+/* === Simulation Component Calculations === */
+
+static PhysicsResult erosion_calculate(const PhysicsComponent *comp,
+                                       const PhysicsParam *params,
+                                       size_t num_params) {
+    (void)comp;
+    PhysicsResult result = {0};
+    
+    ErosionParams ep;
+    erosion_default_params(&ep);
+    ep.droplets = 50000;
+    int size = 257, thermal_iters = 10;
+    double hurst = 0.8, talus = 0.004;
+    double *field = NULL;
+    bool found_size = false;
+    
+    for (size_t i = 0; i < num_params; i++) {
+        const char *name = params[i].desc.name;
+        if (!params[i].is_set)
+            continue;
+        if (strcmp(name, "heightfield") == 0) {
+            field = (double *)params[i].value.p;
+        } else if (strcmp(name, "size") == 0) {
+            size = (int)params[i].value.d;
+            found_size = true;
+        } else if (strcmp(name, "droplets") == 0) {
+            ep.droplets = (long)params[i].value.d;
+        } else if (strcmp(name, "hurst") == 0) {
+            hurst = params[i].value.d;
+        } else if (strcmp(name, "seed") == 0) {
+            ep.seed = (unsigned)params[i].value.d;
+        } else if (strcmp(name, "thermal_iterations") == 0) {
+            thermal_iters = (int)params[i].value.d;
+        } else if (strcmp(name, "talus") == 0) {
+            talus = params[i].value.d;
+        }
+    }
+    
+    /* A caller's heightfield must say how big it is */
+    if (field && !found_size) {
+        result.is_valid = false;
+        result.error_msg = "Missing required parameters";
+        return result;
+    }
+    
+    size_t n = (size_t)size * (size_t)size;
+    double *h = field ? field : (double *)malloc(n * sizeof(double));
+    double *before = (double *)malloc(n * sizeof(double));
+    if (!h || !before ||
+        (!field && fbm_diamond_square(h, size, hurst, ep.seed) != 0)) {
+        if (!field)
+            free(h);
+        free(before);
+        result.is_valid = false;
+        result.error_msg = "Erosion needs a 2^k+1 grid and memory for it";
+        return result;
+    }
+    memcpy(before, h, n * sizeof(double));
+    
+    ErosionStats st;
+    if (erosion_hydraulic(h, size, size, &ep, &st) != 0 ||
+        erosion_thermal(h, size, size, talus, 0.5, thermal_iters, 0) != 0) {
+        result.is_valid = false;
+        result.error_msg = "Erosion failed";
+    } else {
+        /* mean absolute height change per cell */
+        double change = 0.0;
+        for (size_t i = 0; i < n; i++)
+            change += fabs(h[i] - before[i]);
+        result.value = change / (double)n;
+        result.dimension = PHYSICS_DIM_DIMENSIONLESS;
+        result.units = "height units";
+        result.uncertainty = 0.0; /* deterministic for a given seed */
+        result.is_valid = true;
+        result.error_msg = NULL;
+    }
+    
+    if (!field)
+        free(h);
+    free(before);
+    return result;
+}
+
 static PhysicsResult casimir_complete_calculate(const PhysicsComponent *comp,
                                                 const PhysicsParam *params,
                                                 size_t num_params) {
@@ -256,6 +406,7 @@ static PhysicsResult casimir_complete_calculate(const PhysicsComponent *comp,
     PhysicsResult result = {0};
     
     double radius = 5e-6, distance = 10e-9, temperature = 293.0, anisotropy = 1.0, theta = 0.0;
+    double conductivity = 0.0;
     
     /* Extract parameters */
     for (size_t i = 0; i < num_params; i++) {
@@ -270,12 +421,22 @@ static PhysicsResult casimir_complete_calculate(const PhysicsComponent *comp,
             anisotropy = params[i].value.d;
         } else if (strcmp(name, "theta") == 0) {
             theta = params[i].value.d;
+        } else if (strcmp(name, "conductivity") == 0) {
+            conductivity = params[i].value.d;
         }
     }
     
-    /* Compose complete Casimir calculation */
-    double F_base = casimir_base(radius, distance);
-    double F_thermal = casimir_thermal(radius, distance, temperature);
+    /* Compose complete Casimir calculation; with a conductivity the Lifshitz
+     * result (thermal effects included) replaces the ideal-metal PFA terms */
+    double F_base, F_thermal;
+    if (conductivity > 0.0) {
+        F_base = lifshitz_sphere_force(radius, distance, temperature,
+                                       conductivity, LIFSHITZ_DRUDE);
+        F_thermal = 0.0;
+    } else {
+        F_base = casimir_base(radius, distance);
+        F_thermal = casimir_thermal(radius, distance, temperature);
+    }
     double F_total = casimir_modulated(F_base, F_thermal, anisotropy, theta);
     
     result.value = F_total;
@@ -288,26 +449,23 @@ static PhysicsResult casimir_complete_calculate(const PhysicsComponent *comp,
     return result;
 }
 
-static PhysicsResult complete_demo_calculate(const PhysicsComponent *comp,
-                                             const PhysicsParam *params,
-                                             size_t num_params) {
-    (void)comp;
+/* Combine QFT and Casimir results with the environment gravity parameter */
+static PhysicsResult complete_demo_combine(const PhysicsResult *qft_result,
+                                           const PhysicsResult *casimir_result,
+                                           const PhysicsParam *params,
+                                           size_t num_params) {
     PhysicsResult result = {0};
     
-    /* This demonstrates recursive composition by combining multiple physics domains */
-    
     /* QFT contribution */
     double qft_metric = 0.0;
-    PhysicsResult qft_result = qft_rg_calculate(comp, params, num_params);
-    if (qft_result.is_valid) {
-        qft_metric = qft_result.value;
+    if (qft_result->is_valid) {
+        qft_metric = qft_result->value;
     }
     
     /* Casimir contribution */
     double casimir_force = 0.0;
-    PhysicsResult casimir_result = casimir_complete_calculate(comp, params, num_params);
-    if (casimir_result.is_valid) {
-        casimir_force = fabs(casimir_result.value);
+    if (casimir_result->is_valid) {
+        casimir_force = fabs(casimir_result->value);
     }
     
     /* Environment scaling (from parameter if provided) */
@@ -333,6 +491,31 @@ static PhysicsResult complete_demo_calculate(const PhysicsComponent *comp,
     return result;
 }
 
+static PhysicsResult complete_demo_calculate(const PhysicsComponent *comp,
+                                             const PhysicsParam *params,
+                                             size_t num_params) {
+    /* Standalone: run both domains on this component's own parameters */
+    PhysicsResult qft_result = qft_rg_calculate(comp, params, num_params);
+    PhysicsResult casimir_result = casimir_complete_calculate(comp, params, num_params);
+    return complete_demo_combine(&qft_result, &casimir_result, params, num_params);
+}
+
+static PhysicsResult complete_demo_compose(const PhysicsComponent *comp,
+                                           const PhysicsParam *params,
+                                           size_t num_params,
+                                           const PhysicsResult *upstream,
+                                           size_t num_upstream) {
+    (void)comp;
+    /* In a context: reuse the QFT and Casimir components' results */
+    if (num_upstream < 2) {
+        PhysicsResult result = {0};
+        result.is_valid = false;
+        result.error_msg = "Missing upstream results";
+        return result;
+    }
+    return complete_demo_combine(&upstream[0], &upstream[1], params, num_params);
+}
+
 static const PhysicsParamDesc casimir_complete_params[] = {
     {
         .name = "radius",
@@ -383,6 +566,69 @@ static const PhysicsParamDesc casimir_complete_params[] = {
         .required = false,
         .min_value = 0.0,
         .max_value = 6.28 /* 2π */
+    },
+    {
+        .name = "conductivity",
+        .type = PHYSICS_PARAM_DOUBLE,
+        .dimension = PHYSICS_DIM_DIMENSIONLESS,
+        .units = "S/m",
+        .description = "DC electrical conductivity of the metal",
+        .required = false,
+        .min_value = 1e3,
+        .max_value = 1e9
+    }
+};
+
+static const PhysicsParamDesc casimir_lifshitz_params[] = {
+    {
+        .name = "radius",
+        .type = PHYSICS_PARAM_DOUBLE,
+        .dimension = PHYSICS_DIM_LENGTH,
+        .units = "m",
+        .description = "Sphere radius R",
+        .required = true,
+        .min_value = 1e-9,
+        .max_value = 1e-3
+    },
+    {
+        .name = "distance",
+        .type = PHYSICS_PARAM_DOUBLE,
+        .dimension = PHYSICS_DIM_LENGTH,
+        .units = "m",
+        .description = "Plate distance d",
+        .required = true,
+        .min_value = 1e-9,
+        .max_value = 1e-5
+    },
+    {
+        .name = "temperature",
+        .type = PHYSICS_PARAM_DOUBLE,
+        .dimension = PHYSICS_DIM_TEMPERATURE,
+        .units = "K",
+        .description = "Temperature T",
+        .required = false,
+        .min_value = 0.1,
+        .max_value = 1000.0
+    },
+    {
+        .name = "conductivity",
+        .type = PHYSICS_PARAM_DOUBLE,
+        .dimension = PHYSICS_DIM_DIMENSIONLESS,
+        .units = "S/m",
+        .description = "DC electrical conductivity of the metal",
+        .required = false,
+        .min_value = 1e3,
+        .max_value = 1e9
+    },
+    {
+        .name = "model",
+        .type = PHYSICS_PARAM_DOUBLE,
+        .dimension = PHYSICS_DIM_DIMENSIONLESS,
+        .units = "dimensionless",
+        .description = "Permittivity model (0 Drude, 1 plasma)",
+        .required = false,
+        .min_value = 0.0,
+        .max_value = 1.0
     }
 };
 
@@ -439,6 +685,79 @@ static const PhysicsParamDesc complete_demo_params[] = {
     }
 };
 
+static const PhysicsParamDesc erosion_params[] = {
+    {
+        .name = "heightfield",
+        .type = PHYSICS_PARAM_POINTER,
+        .dimension = PHYSICS_DIM_DIMENSIONLESS,
+        .units = "height units",
+        .description = "size x size terrain eroded in place (generated if unset)",
+        .required = false,
+        .min_value = 0.0,
+        .max_value = 0.0
+    },
+    {
+        .name = "size",
+        .type = PHYSICS_PARAM_DOUBLE,
+        .dimension = PHYSICS_DIM_DIMENSIONLESS,
+        .units = "cells",
+        .description = "Grid side (2^k+1 when generating the terrain)",
+        .required = false,
+        .min_value = 3.0,
+        .max_value = 8193.0
+    },
+    {
+        .name = "droplets",
+        .type = PHYSICS_PARAM_DOUBLE,
+        .dimension = PHYSICS_DIM_DIMENSIONLESS,
+        .units = "count",
+        .description = "Hydraulic erosion droplets",
+        .required = false,
+        .min_value = 0.0,
+        .max_value = 1e9
+    },
+    {
+        .name = "hurst",
+        .type = PHYSICS_PARAM_DOUBLE,
+        .dimension = PHYSICS_DIM_DIMENSIONLESS,
+        .units = "dimensionless",
+        .description = "Hurst exponent of the generated terrain",
+        .required = false,
+        .min_value = 0.0,
+        .max_value = 1.0
+    },
+    {
+        .name = "seed",
+        .type = PHYSICS_PARAM_DOUBLE,
+        .dimension = PHYSICS_DIM_DIMENSIONLESS,
+        .units = "dimensionless",
+        .description = "Terrain and droplet seed",
+        .required = false,
+        .min_value = 1.0,
+        .max_value = 4294967295.0
+    },
+    {
+        .name = "thermal_iterations",
+        .type = PHYSICS_PARAM_DOUBLE,
+        .dimension = PHYSICS_DIM_DIMENSIONLESS,
+        .units = "count",
+        .description = "Thermal erosion sweeps after the droplets",
+        .required = false,
+        .min_value = 0.0,
+        .max_value = 10000.0
+    },
+    {
+        .name = "talus",
+        .type = PHYSICS_PARAM_DOUBLE,
+        .dimension = PHYSICS_DIM_DIMENSIONLESS,
+        .units = "height units/cell",
+        .description = "Slope above which material slides",
+        .required = false,
+        .min_value = 0.0,
+        .max_value = 10.0
+    }
+};
+
 /* === Validation Functions === */
 
 static bool basic_validation(const PhysicsComponent *comp,
@@ -530,6 +849,20 @@ const PhysicsComponent physics_casimir_thermal_component = {
     .result_units = "N"
 };
 
+const PhysicsComponent physics_erosion_component = {
+    .name = "erosion",
+    .description = "Droplet hydraulic + thermal erosion of a heightfield",
+    .domain = PHYSICS_DOMAIN_SIMULATION,
+    .param_descs = erosion_params,
+    .num_params = sizeof(erosion_params) / sizeof(erosion_params[0]),
+    .calculate = erosion_calculate,
+    .validate = basic_validation,
+    .dependencies = NULL,
+    .num_dependencies = 0,
+    .result_dimension = PHYSICS_DIM_DIMENSIONLESS,
+    .result_units = "height units"
+};
+
 /* === Composite Component Definitions === */
 
 const PhysicsComponent physics_qft_rg_component = {
@@ -546,6 +879,20 @@ const PhysicsComponent physics_qft_rg_component = {
     .result_units = "dimensionless"
 };
 
+const PhysicsComponent physics_casimir_lifshitz_component = {
+    .name = "casimir_lifshitz",
+    .description = "Lifshitz sphere-plate force for a Drude/plasma metal (PFA)",
+    .domain = PHYSICS_DOMAIN_CASIMIR,
+    .param_descs = casimir_lifshitz_params,
+    .num_params = sizeof(casimir_lifshitz_params) / sizeof(casimir_lifshitz_params[0]),
+    .calculate = casimir_lifshitz_calculate,
+    .validate = basic_validation,
+    .dependencies = NULL,
+    .num_dependencies = 0,
+    .result_dimension = PHYSICS_DIM_FORCE,
+    .result_units = "N"
+};
+
 const PhysicsComponent physics_casimir_complete_component = {
     .name = "casimir_complete",
     .description = "Complete Casimir system (base + thermal + modulation)",
@@ -560,6 +907,11 @@ const PhysicsComponent physics_casimir_complete_component = {
     .result_units = "N"
 };
 
+static const PhysicsComponent *complete_demo_dependencies[] = {
+    &physics_qft_rg_component,
+    &physics_casimir_complete_component
+};
+
 const PhysicsComponent physics_complete_demo_component = {
     .name = "complete_demo",
     .description = "Complete physics demonstration (QFT + Casimir + Environment)",
@@ -568,10 +920,11 @@ const PhysicsComponent physics_complete_demo_component = {
     .num_params = sizeof(complete_demo_params) / sizeof(complete_demo_params[0]),
     .calculate = complete_demo_calculate,
     .validate = basic_validation,
-    .dependencies = NULL,
-    .num_dependencies = 0,
+    .dependencies = complete_demo_dependencies,
+    .num_dependencies = 2,
     .result_dimension = PHYSICS_DIM_DIMENSIONLESS,
-    .result_units = "composite"
+    .result_units = "composite",
+    .compose = complete_demo_compose
 };
 
 /* === Registration Functions === */
@@ -580,18 +933,26 @@ void physics_components_register_all(void) {
     /* Register all component wrappers - external function in physics_framework.c */
     extern int physics_framework_register_component(const PhysicsComponent *component);
     
-    physics_framework_register_component(&physics_beta1_component);
-    physics_framework_register_component(&physics_beta2_component);
-    physics_framework_register_component(&physics_gamma_phi_component);
-    physics_framework_register_component(&physics_casimir_base_component);
-    physics_framework_register_component(&physics_casimir_thermal_component);
-    
-    /* Register composite components */
-    physics_framework_register_component(&physics_qft_rg_component);
-    physics_framework_register_component(&physics_casimir_complete_component);
-    physics_framework_register_component(&physics_complete_demo_component);
+    static const PhysicsComponent *const all[] = {
+        &physics_beta1_component,
+        &physics_beta2_component,
+        &physics_gamma_phi_component,
+        &physics_casimir_base_component,
+        &physics_casimir_thermal_component,
+        &physics_casimir_lifshitz_component,
+        &physics_erosion_component,
+        /* composite components */
+        &physics_qft_rg_component,
+        &physics_casimir_complete_component,
+        &physics_complete_demo_component
+    };
+    int registered = 0;
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++) {
+        if (physics_framework_register_component(all[i]) == 0)
+            registered++;
+    }
     
-    printf("[physics] Registered %d physics components\n", 8);
+    printf("[physics] Registered %d physics components\n", registered);
 }
 
 PhysicsContext *physics_create_demo_context(void) {
@@ -664,17 +1025,16 @@ PhysicsContext *physics_create_composite_demo_context(void) {
                                   (PhysicsComponent *)&physics_casimir_complete_component,
                                   casimir_complete_params, 5);
     
-    /* Add complete physics demo component that combines everything */
-    PhysicsParam complete_demo_params[] = {
-        physics_param_create_double("coupling", PHYSICS_DIM_DIMENSIONLESS, "dimensionless", "QFT coupling", 1.2),
-        physics_param_create_double("radius", PHYSICS_DIM_LENGTH, "m", "Sphere radius", 8e-6),
-        physics_param_create_double("distance", PHYSICS_DIM_LENGTH, "m", "Plate distance", 15e-9),
-        physics_param_create_double("temperature", PHYSICS_DIM_TEMPERATURE, "K", "Temperature", 300.0),
-        physics_param_create_double("gravity", PHYSICS_DIM_DIMENSIONLESS, "m/s^2", "Gravity", 3.71) /* Mars gravity */
-    };
+    /* Add complete physics demo component that combines everything; it reuses
+     * the results above, so only the environment is its own parameter */
+    PhysicsParam complete_demo_param = physics_param_create_double("gravity",
+                                                                   PHYSICS_DIM_DIMENSIONLESS,
+                                                                   "m/s^2",
+                                                                   "Gravity",
+                                                                   3.71); /* Mars gravity */
     physics_context_add_component(context,
                                   (PhysicsComponent *)&physics_complete_demo_component,
-                                  complete_demo_params, 5);
+                                  &complete_demo_param, 1);
     
     return context;
 }
\ No newline at end of file
@@ -0,0 +1,951 @@
+/** \file physics_expr.c
+ *  \brief Expression components: parser with dimensional checks, register
+ *  bytecode and a block-batched virtual machine.
+ */
+#include "physics_expr.h"
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_EXPR_PARAMS 64
+#define MAX_EXPR_REGISTERS 64
+#define MAX_NODES 4096
+#define NUM_BASE_DIMS 6
+
+/* Dimension: exponents of M, L, T, K, A, mol, stored doubled so that
+ * square roots stay exact */
+typedef struct {
+    signed char e[NUM_BASE_DIMS];
+} Dim;
+
+static const char *const base_dim_names[NUM_BASE_DIMS] = {"M", "L", "T", "K", "A", "mol"};
+
+static Dim dim_make(int m, int l, int t, int k, int a, int n) {
+    Dim d = {{(signed char)(2 * m), (signed char)(2 * l), (signed char)(2 * t),
+              (signed char)(2 * k), (signed char)(2 * a), (signed char)(2 * n)}};
+    return d;
+}
+
+static bool dim_equal(Dim a, Dim b) {
+    return memcmp(a.e, b.e, sizeof(a.e)) == 0;
+}
+
+static bool dim_is_none(Dim a) {
+    return dim_equal(a, dim_make(0, 0, 0, 0, 0, 0));
+}
+
+static Dim dim_of(PhysicsDimension dim) {
+    switch (dim) {
+        case PHYSICS_DIM_LENGTH: return dim_make(0, 1, 0, 0, 0, 0);
+        case PHYSICS_DIM_MASS: return dim_make(1, 0, 0, 0, 0, 0);
+        case PHYSICS_DIM_TIME: return dim_make(0, 0, 1, 0, 0, 0);
+        case PHYSICS_DIM_FORCE: return dim_make(1, 1, -2, 0, 0, 0);
+        case PHYSICS_DIM_ENERGY: return dim_make(1, 2, -2, 0, 0, 0);
+        case PHYSICS_DIM_TEMPERATURE: return dim_make(0, 0, 0, 1, 0, 0);
+        case PHYSICS_DIM_PRESSURE: return dim_make(1, -1, -2, 0, 0, 0);
+        case PHYSICS_DIM_FREQUENCY: return dim_make(0, 0, -1, 0, 0, 0);
+        case PHYSICS_DIM_DIMENSIONLESS:
+        default: return dim_make(0, 0, 0, 0, 0, 0);
+    }
+}
+
+static void dim_format(Dim d, char *buf, size_t size) {
+    size_t len = 0;
+    buf[0] = '\0';
+    for (int i = 0; i < NUM_BASE_DIMS && len < size; i++) {
+        int e = d.e[i];
+        if (e == 0) continue;
+        if (e % 2 == 0) {
+            len += (size_t)snprintf(buf + len, size - len, "%s%s^%d",
+                                    len ? " " : "", base_dim_names[i], e / 2);
+        } else {
+            len += (size_t)snprintf(buf + len, size - len, "%s%s^%d/2",
+                                    len ? " " : "", base_dim_names[i], e);
+        }
+    }
+    if (len == 0) snprintf(buf, size, "dimensionless");
+}
+
+/* Constants of physics_constants.h by macro name and short alias */
+typedef struct {
+    const char *name;
+    const char *alias;
+    double value;
+    int m, l, t, k, a, n;
+} ExprConstant;
+
+static const ExprConstant expr_constants[] = {
+    {"PHYSICS_PI", "pi", PHYSICS_PI, 0, 0, 0, 0, 0, 0},
+    {"PHYSICS_TWO_PI", NULL, PHYSICS_TWO_PI, 0, 0, 0, 0, 0, 0},
+    {"PHYSICS_PI_SQUARED", NULL, PHYSICS_PI_SQUARED, 0, 0, 0, 0, 0, 0},
+    {"PHYSICS_PI_FOURTH", NULL, PHYSICS_PI_FOURTH, 0, 0, 0, 0, 0, 0},
+    {"PHYSICS_HBAR", "hbar", PHYSICS_HBAR, 1, 2, -1, 0, 0, 0},
+    {"PHYSICS_C", "c", PHYSICS_C, 0, 1, -1, 0, 0, 0},
+    {"PHYSICS_KB", "kB", PHYSICS_KB, 1, 2, -2, -1, 0, 0},
+    {"PHYSICS_EPSILON0", "eps0", PHYSICS_EPSILON0, -1, -3, 4, 0, 2, 0},
+    {"PHYSICS_MU0", "mu0", PHYSICS_MU0, 1, 1, -2, 0, -2, 0},
+    {"PHYSICS_E", "qe", PHYSICS_E, 0, 0, 1, 0, 1, 0},
+    {"PHYSICS_ME", "me", PHYSICS_ME, 1, 0, 0, 0, 0, 0},
+    {"PHYSICS_MP", "mp", PHYSICS_MP, 1, 0, 0, 0, 0, 0},
+    {"PHYSICS_ALPHA", "alpha", PHYSICS_ALPHA, 0, 0, 0, 0, 0, 0},
+    {"PHYSICS_NA", "NA", PHYSICS_NA, 0, 0, 0, 0, 0, -1},
+    {"PHYSICS_R", "R", PHYSICS_R, 1, 2, -2, -1, 0, -1},
+    {"PHYSICS_HBAR_C", NULL, PHYSICS_HBAR_C, 1, 3, -2, 0, 0, 0},
+    {"PHYSICS_HBAR2_C", NULL, PHYSICS_HBAR2_C, 2, 5, -3, 0, 0, 0},
+    {"PHYSICS_KB_OVER_HBAR_C", NULL, PHYSICS_KB_OVER_HBAR_C, 0, -1, 0, -1, 0, 0},
+    {"PHYSICS_ALPHA_OVER_PI", NULL, PHYSICS_ALPHA_OVER_PI, 0, 0, 0, 0, 0, 0}
+};
+
+/* === Bytecode === */
+
+typedef enum {
+    OP_MOV, OP_FILL,
+    OP_ADD, OP_ADDK, OP_SUB, OP_RSUBK, OP_MUL, OP_MULK, OP_MULS, OP_DIV, OP_DIVS, OP_RDIVK,
+    OP_MIN, OP_MINK, OP_MAX, OP_MAXK, OP_POW, OP_POWK, OP_RPOWK,
+    OP_SQRT, OP_EXP, OP_LOG, OP_LOG10, OP_SIN, OP_COS, OP_TAN, OP_TANH, OP_ABS
+} ExprOp;
+
+/* Operands are slots: parameters 0..num_params-1, the output at num_params,
+ * then the scratch registers */
+typedef struct {
+    unsigned char op;
+    unsigned short dst, a, b;
+    double k;
+} ExprInsn;
+
+struct PhysicsExpr {
+    size_t num_params;
+    size_t num_registers;
+    size_t num_code;
+    ExprInsn *code;
+};
+
+/* === Syntax tree === */
+
+typedef enum {
+    N_CONST, N_PARAM, N_ADD, N_SUB, N_MUL, N_DIV, N_POW, N_MIN, N_MAX, N_FUNC
+} NodeKind;
+
+typedef struct {
+    NodeKind kind;
+    ExprOp func;     /* N_FUNC: OP_SQRT .. OP_ABS */
+    int a, b;
+    double k;        /* N_CONST value */
+    double scale;    /* N_MUL, N_DIV of two variables: constant factor */
+    size_t param;    /* N_PARAM index */
+    Dim dim;
+} Node;
+
+typedef struct {
+    const char *src;
+    const char *p;
+    const PhysicsParamDesc *params;
+    size_t num_params;
+    Node *nodes;
+    int num_nodes;
+    char *error;
+    size_t error_size;
+    bool failed;
+} Parser;
+
+static int fail(Parser *ps, const char *fmt, ...) {
+    if (!ps->failed && ps->error && ps->error_size > 0) {
+        int off = snprintf(ps->error, ps->error_size, "at %d: ", (int)(ps->p - ps->src));
+        if (off >= 0 && (size_t)off < ps->error_size) {
+            va_list ap;
+            va_start(ap, fmt);
+            vsnprintf(ps->error + off, ps->error_size - (size_t)off, fmt, ap);
+            va_end(ap);
+        }
+    }
+    ps->failed = true;
+    return -1;
+}
+
+static int new_node(Parser *ps, NodeKind kind, int a, int b, Dim dim) {
+    if (ps->num_nodes >= MAX_NODES) return fail(ps, "expression too long");
+    Node *n = &ps->nodes[ps->num_nodes];
+    memset(n, 0, sizeof(*n));
+    n->kind = kind;
+    n->a = a;
+    n->b = b;
+    n->dim = dim;
+    n->scale = 1.0;
+    return ps->num_nodes++;
+}
+
+static int const_node(Parser *ps, double value, Dim dim) {
+    int i = new_node(ps, N_CONST, -1, -1, dim);
+    if (i >= 0) ps->nodes[i].k = value;
+    return i;
+}
+
+static double apply_func(ExprOp op, double x) {
+    switch (op) {
+        case OP_SQRT: return sqrt(x);
+        case OP_EXP: return exp(x);
+        case OP_LOG: return log(x);
+        case OP_LOG10: return log10(x);
+        case OP_SIN: return sin(x);
+        case OP_COS: return cos(x);
+        case OP_TAN: return tan(x);
+        case OP_TANH: return tanh(x);
+        case OP_ABS: return fabs(x);
+        default: return NAN;
+    }
+}
+
+/* Split node i into coef * core: core is -1 for a constant, and products
+ * and quotients give up their constant factor. A core copied to drop its
+ * scale keeps the scaled dimension, which is never read again. */
+static int split_coef(Parser *ps, int i, double *coef) {
+    Node *n = &ps->nodes[i];
+    if (n->kind == N_CONST) {
+        *coef = n->k;
+        return -1;
+    }
+    if (n->kind == N_MUL && ps->nodes[n->a].kind == N_CONST) {
+        *coef = ps->nodes[n->a].k;
+        return n->b;
+    }
+    if ((n->kind == N_MUL || n->kind == N_DIV) && n->scale != 1.0 &&
+        ps->nodes[n->a].kind != N_CONST) {
+        *coef = n->scale;
+        int c = new_node(ps, n->kind, ps->nodes[i].a, ps->nodes[i].b, ps->nodes[i].dim);
+        return c >= 0 ? c : -2;
+    }
+    *coef = 1.0;
+    return i;
+}
+
+/* Products and quotients of variables carry one constant factor, which the
+ * VM applies in the same instruction: k*a*b and k*a/b */
+static int make_scaled(Parser *ps, NodeKind kind, int a, int b, Dim d) {
+    double ca, cb;
+    int xa = split_coef(ps, a, &ca);
+    int xb = split_coef(ps, b, &cb);
+    if (xa == -2 || xb == -2) return -1;
+    double k = kind == N_MUL ? ca * cb : ca / cb;
+    int r;
+    if (kind == N_MUL && k == 1.0 && (xa < 0 || xb < 0) &&
+        dim_equal(ps->nodes[xa < 0 ? xb : xa].dim, d)) {
+        return xa < 0 ? xb : xa;
+    }
+    if (xa < 0 || (kind == N_MUL && xb < 0)) {
+        /* k * x or k / x: a constant and one variable */
+        int x = xa < 0 ? xb : xa;
+        int c = const_node(ps, k, d);
+        if (c < 0) return -1;
+        r = new_node(ps, kind, c, x, d);
+    } else if (xb < 0) {
+        int c = const_node(ps, k, d);
+        if (c < 0) return -1;
+        r = new_node(ps, N_MUL, c, xa, d);
+    } else {
+        r = new_node(ps, kind, xa, xb, d);
+        if (r >= 0) ps->nodes[r].scale = k;
+    }
+    return r;
+}
+
+/* Build an operator node, checking dimensions and folding constants */
+static int make_binary(Parser *ps, NodeKind kind, int a, int b) {
+    if (a < 0 || b < 0) return -1;
+    Dim da = ps->nodes[a].dim, db = ps->nodes[b].dim, d = da;
+    char sa[64], sb[64];
+    switch (kind) {
+        case N_ADD: case N_SUB: case N_MIN: case N_MAX:
+            if (!dim_equal(da, db)) {
+                dim_format(da, sa, sizeof(sa));
+                dim_format(db, sb, sizeof(sb));
+                return fail(ps, "dimension mismatch: %s vs %s", sa, sb);
+            }
+            break;
+        case N_MUL: case N_DIV:
+            for (int i = 0; i < NUM_BASE_DIMS; i++) {
+                int e = kind == N_MUL ? da.e[i] + db.e[i] : da.e[i] - db.e[i];
+                if (e < -120 || e > 120) return fail(ps, "dimension exponent out of range");
+                d.e[i] = (signed char)e;
+            }
+            break;
+        case N_POW:
+            if (!dim_is_none(db)) {
+                dim_format(db, sb, sizeof(sb));
+                return fail(ps, "exponent must be dimensionless, got %s", sb);
+            }
+            if (!dim_is_none(da)) {
+                if (ps->nodes[b].kind != N_CONST) {
+                    return fail(ps, "power of a dimensioned value needs a constant exponent");
+                }
+                double k = ps->nodes[b].k;
+                for (int i = 0; i < NUM_BASE_DIMS; i++) {
+                    double e = da.e[i] * k;
+                    if (fabs(e - nearbyint(e)) > 1e-9 || fabs(e) > 120) {
+                        dim_format(da, sa, sizeof(sa));
+                        return fail(ps, "(%s)^%g has a non-half-integer dimension", sa, k);
+                    }
+                    d.e[i] = (signed char)nearbyint(e);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+    if (ps->nodes[a].kind == N_CONST && ps->nodes[b].kind == N_CONST) {
+        double x = ps->nodes[a].k, y = ps->nodes[b].k, v;
+        switch (kind) {
+            case N_ADD: v = x + y; break;
+            case N_SUB: v = x - y; break;
+            case N_MUL: v = x * y; break;
+            case N_DIV: v = x / y; break;
+            case N_POW: v = pow(x, y); break;
+            case N_MIN: v = fmin(x, y); break;
+            default: v = fmax(x, y); break;
+        }
+        return const_node(ps, v, d);
+    }
+    if (kind == N_MUL || kind == N_DIV) return make_scaled(ps, kind, a, b, d);
+    return new_node(ps, kind, a, b, d);
+}
+
+static int make_func(Parser *ps, ExprOp func, int a) {
+    if (a < 0) return -1;
+    Dim d = ps->nodes[a].dim;
+    if (func == OP_SQRT) {
+        for (int i = 0; i < NUM_BASE_DIMS; i++) {
+            if (d.e[i] % 2 != 0) return fail(ps, "sqrt of a half-integer dimension");
+            d.e[i] = (signed char)(d.e[i] / 2);
+        }
+    } else if (func != OP_ABS && !dim_is_none(d)) {
+        char s[64];
+        dim_format(d, s, sizeof(s));
+        return fail(ps, "function argument must be dimensionless, got %s", s);
+    }
+    if (ps->nodes[a].kind == N_CONST) {
+        double x = ps->nodes[a].k;
+        return const_node(ps, apply_func(func, x), d);
+    }
+    int i = new_node(ps, N_FUNC, a, -1, d);
+    if (i >= 0) ps->nodes[i].func = func;
+    return i;
+}
+
+static void skip_space(Parser *ps) {
+    while (*ps->p == ' ' || *ps->p == '\t' || *ps->p == '\n' || *ps->p == '\r') ps->p++;
+}
+
+static bool accept(Parser *ps, const char *tok) {
+    skip_space(ps);
+    size_t n = strlen(tok);
+    if (strncmp(ps->p, tok, n) != 0) return false;
+    ps->p += n;
+    return true;
+}
+
+static int parse_expr(Parser *ps);
+static int parse_unary(Parser *ps);
+
+static const struct {
+    const char *name;
+    ExprOp op;
+} expr_funcs[] = {
+    {"sqrt", OP_SQRT}, {"exp", OP_EXP}, {"log", OP_LOG}, {"log10", OP_LOG10},
+    {"sin", OP_SIN}, {"cos", OP_COS}, {"tan", OP_TAN}, {"tanh", OP_TANH},
+    {"abs", OP_ABS}
+};
+
+static int parse_call(Parser *ps, const char *name, size_t len) {
+    int a = parse_expr(ps);
+    if (a < 0) return -1;
+    NodeKind two = N_CONST;
+    if (len == 3 && strncmp(name, "min", 3) == 0) two = N_MIN;
+    else if (len == 3 && strncmp(name, "max", 3) == 0) two = N_MAX;
+    else if (len == 3 && strncmp(name, "pow", 3) == 0) two = N_POW;
+    int r;
+    if (two != N_CONST) {
+        if (!accept(ps, ",")) return fail(ps, "expected ',' in %.*s()", (int)len, name);
+        int b = parse_expr(ps);
+        r = make_binary(ps, two, a, b);
+    } else {
+        size_t f = 0, nf = sizeof(expr_funcs) / sizeof(expr_funcs[0]);
+        while (f < nf && !(strlen(expr_funcs[f].name) == len &&
+                           strncmp(expr_funcs[f].name, name, len) == 0)) f++;
+        if (f == nf) return fail(ps, "unknown function '%.*s'", (int)len, name);
+        r = make_func(ps, expr_funcs[f].op, a);
+    }
+    if (r < 0) return -1;
+    if (!accept(ps, ")")) return fail(ps, "expected ')'");
+    return r;
+}
+
+static int parse_name(Parser *ps) {
+    const char *name = ps->p;
+    while ((*ps->p >= 'a' && *ps->p <= 'z') || (*ps->p >= 'A' && *ps->p <= 'Z') ||
+           (*ps->p >= '0' && *ps->p <= '9') || *ps->p == '_') ps->p++;
+    size_t len = (size_t)(ps->p - name);
+    if (accept(ps, "(")) return parse_call(ps, name, len);
+
+    for (size_t i = 0; i < ps->num_params; i++) {
+        const char *pn = ps->params[i].name;
+        if (strlen(pn) == len && strncmp(pn, name, len) == 0) {
+            int n = new_node(ps, N_PARAM, -1, -1, dim_of(ps->params[i].dimension));
+            if (n >= 0) ps->nodes[n].param = i;
+            return n;
+        }
+    }
+    for (size_t i = 0; i < sizeof(expr_constants) / sizeof(expr_constants[0]); i++) {
+        const ExprConstant *c = &expr_constants[i];
+        if ((strlen(c->name) == len && strncmp(c->name, name, len) == 0) ||
+            (c->alias && strlen(c->alias) == len && strncmp(c->alias, name, len) == 0)) {
+            return const_node(ps, c->value, dim_make(c->m, c->l, c->t, c->k, c->a, c->n));
+        }
+    }
+    ps->p = name;
+    return fail(ps, "unknown name '%.*s'", (int)len, name);
+}
+
+static int parse_primary(Parser *ps) {
+    skip_space(ps);
+    char ch = *ps->p;
+    if (ch == '(') {
+        ps->p++;
+        int r = parse_expr(ps);
+        if (r < 0) return -1;
+        if (!accept(ps, ")")) return fail(ps, "expected ')'");
+        return r;
+    }
+    if ((ch >= '0' && ch <= '9') || ch == '.') {
+        char *end;
+        double v = strtod(ps->p, &end);
+        if (end == ps->p) return fail(ps, "bad number");
+        ps->p = end;
+        return const_node(ps, v, dim_make(0, 0, 0, 0, 0, 0));
+    }
+    if ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_') {
+        return parse_name(ps);
+    }
+    return fail(ps, ch ? "unexpected '%c'" : "unexpected end of expression", ch);
+}
+
+/* power := primary [('^' | '**') unary], right associative */
+static int parse_power(Parser *ps) {
+    int a = parse_primary(ps);
+    if (a < 0) return -1;
+    if (accept(ps, "^") || accept(ps, "**")) {
+        int b = parse_unary(ps);
+        return make_binary(ps, N_POW, a, b);
+    }
+    return a;
+}
+
+static int parse_unary(Parser *ps) {
+    if (accept(ps, "-")) {
+        /* negation is a scale of -1 */
+        int m = const_node(ps, -1.0, dim_make(0, 0, 0, 0, 0, 0));
+        return m < 0 ? -1 : make_binary(ps, N_MUL, m, parse_unary(ps));
+    }
+    if (accept(ps, "+")) return parse_unary(ps);
+    return parse_power(ps);
+}
+
+static int parse_term(Parser *ps) {
+    int a = parse_unary(ps);
+    while (a >= 0) {
+        skip_space(ps);
+        if (ps->p[0] == '*' && ps->p[1] != '*') {
+            ps->p++;
+            a = make_binary(ps, N_MUL, a, parse_unary(ps));
+        } else if (accept(ps, "/")) {
+            a = make_binary(ps, N_DIV, a, parse_unary(ps));
+        } else {
+            break;
+        }
+    }
+    return a;
+}
+
+static int parse_expr(Parser *ps) {
+    int a = parse_term(ps);
+    while (a >= 0) {
+        if (accept(ps, "+")) a = make_binary(ps, N_ADD, a, parse_term(ps));
+        else if (accept(ps, "-")) a = make_binary(ps, N_SUB, a, parse_term(ps));
+        else break;
+    }
+    return a;
+}
+
+/* === Code generation === */
+
+typedef struct {
+    bool is_const;
+    double k;
+    int slot;
+} Operand;
+
+typedef struct {
+    PhysicsExpr *expr;
+    size_t cap;
+    int refs[MAX_EXPR_REGISTERS];
+    int out_slot;
+    bool failed;
+} Gen;
+
+static bool is_reg(const Gen *g, Operand x) {
+    return !x.is_const && x.slot > g->out_slot;
+}
+
+static void release(Gen *g, Operand x) {
+    if (is_reg(g, x)) g->refs[x.slot - g->out_slot - 1]--;
+}
+
+static void retain(Gen *g, Operand x) {
+    if (is_reg(g, x)) g->refs[x.slot - g->out_slot - 1]++;
+}
+
+static int alloc_reg(Gen *g) {
+    for (int r = 0; r < MAX_EXPR_REGISTERS; r++) {
+        if (g->refs[r] == 0) {
+            g->refs[r] = 1;
+            if ((size_t)r + 1 > g->expr->num_registers) g->expr->num_registers = (size_t)r + 1;
+            return g->out_slot + 1 + r;
+        }
+    }
+    g->failed = true;
+    return g->out_slot;
+}
+
+/* Emit op on a and b (either may be unused) into a fresh register */
+static Operand emit(Gen *g, ExprOp op, Operand a, Operand b, double k) {
+    Operand r = {false, 0.0, g->out_slot};
+    if (g->failed) return r;
+    if (g->expr->num_code == g->cap) {
+        size_t cap = g->cap ? 2 * g->cap : 32;
+        ExprInsn *code = (ExprInsn *)realloc(g->expr->code, cap * sizeof(ExprInsn));
+        if (!code) {
+            g->failed = true;
+            return r;
+        }
+        g->expr->code = code;
+        g->cap = cap;
+    }
+    release(g, a);
+    release(g, b);
+    r.slot = alloc_reg(g);
+    ExprInsn *in = &g->expr->code[g->expr->num_code++];
+    in->op = (unsigned char)op;
+    in->dst = (unsigned short)r.slot;
+    in->a = (unsigned short)(a.is_const ? g->out_slot : a.slot);
+    in->b = (unsigned short)(b.is_const ? g->out_slot : b.slot);
+    in->k = k;
+    return r;
+}
+
+static const Operand no_operand = {true, 0.0, 0};
+
+/* x^n for a small integer n >= 1 by repeated squaring */
+static Operand emit_int_pow(Gen *g, Operand x, int n) {
+    Operand acc = no_operand, pw = x;
+    bool have = false;
+    retain(g, pw);
+    while (n > 0) {
+        if (n & 1) {
+            if (have) {
+                retain(g, pw);
+                acc = emit(g, OP_MUL, acc, pw, 0.0);
+            } else {
+                retain(g, pw);
+                acc = pw;
+                have = true;
+            }
+        }
+        n >>= 1;
+        if (n > 0) {
+            retain(g, pw);
+            pw = emit(g, OP_MUL, pw, pw, 0.0);
+        }
+    }
+    release(g, pw);
+    release(g, x);
+    return acc;
+}
+
+static Operand gen_node(Gen *g, const Node *nodes, int i);
+
+static Operand gen_pow(Gen *g, Operand x, double k) {
+    double ak = fabs(k);
+    Operand r;
+    if (ak == nearbyint(ak) && ak >= 1.0 && ak <= 16.0) {
+        r = emit_int_pow(g, x, (int)ak);
+    } else if (ak == 0.5 || ak == 1.5) {
+        if (ak == 0.5) {
+            r = emit(g, OP_SQRT, x, no_operand, 0.0);
+        } else {
+            retain(g, x);
+            r = emit(g, OP_MUL, x, emit(g, OP_SQRT, x, no_operand, 0.0), 0.0);
+        }
+    } else {
+        return emit(g, OP_POWK, x, no_operand, k);
+    }
+    return k < 0.0 ? emit(g, OP_RDIVK, r, no_operand, 1.0) : r;
+}
+
+static Operand gen_node(Gen *g, const Node *nodes, int i) {
+    const Node *n = &nodes[i];
+    Operand r = {true, 0.0, 0};
+    if (n->kind == N_CONST) {
+        r.k = n->k;
+        return r;
+    }
+    if (n->kind == N_PARAM) {
+        r.is_const = false;
+        r.slot = (int)n->param;
+        return r;
+    }
+    Operand a = gen_node(g, nodes, n->a);
+    if (n->kind == N_FUNC) return emit(g, n->func, a, no_operand, 0.0);
+    if (n->kind == N_POW && nodes[n->b].kind == N_CONST) {
+        return gen_pow(g, a, nodes[n->b].k);
+    }
+    Operand b = gen_node(g, nodes, n->b);
+    switch (n->kind) {
+        case N_ADD:
+            if (a.is_const) return emit(g, OP_ADDK, b, no_operand, a.k);
+            if (b.is_const) return emit(g, OP_ADDK, a, no_operand, b.k);
+            return emit(g, OP_ADD, a, b, 0.0);
+        case N_SUB:
+            if (a.is_const) return emit(g, OP_RSUBK, b, no_operand, a.k);
+            if (b.is_const) return emit(g, OP_ADDK, a, no_operand, -b.k);
+            return emit(g, OP_SUB, a, b, 0.0);
+        case N_MUL:
+            if (a.is_const) return emit(g, OP_MULK, b, no_operand, a.k);
+            if (n->scale != 1.0) return emit(g, OP_MULS, a, b, n->scale);
+            return emit(g, OP_MUL, a, b, 0.0);
+        case N_DIV:
+            if (a.is_const) return emit(g, OP_RDIVK, b, no_operand, a.k);
+            if (n->scale != 1.0) return emit(g, OP_DIVS, a, b, n->scale);
+            return emit(g, OP_DIV, a, b, 0.0);
+        case N_MIN:
+            if (a.is_const) return emit(g, OP_MINK, b, no_operand, a.k);
+            if (b.is_const) return emit(g, OP_MINK, a, no_operand, b.k);
+            return emit(g, OP_MIN, a, b, 0.0);
+        case N_MAX:
+            if (a.is_const) return emit(g, OP_MAXK, b, no_operand, a.k);
+            if (b.is_const) return emit(g, OP_MAXK, a, no_operand, b.k);
+            return emit(g, OP_MAX, a, b, 0.0);
+        default: /* N_POW with a variable exponent */
+            if (a.is_const) return emit(g, OP_RPOWK, b, no_operand, a.k);
+            return emit(g, OP_POW, a, b, 0.0);
+    }
+}
+
+PhysicsExpr *physics_expr_compile(const char *source,
+                                  const PhysicsParamDesc *params,
+                                  size_t num_params,
+                                  PhysicsDimension result_dimension,
+                                  char *error_buffer,
+                                  size_t buffer_size) {
+    if (error_buffer && buffer_size > 0) error_buffer[0] = '\0';
+    if (!source || (num_params > 0 && !params) || num_params > MAX_EXPR_PARAMS) {
+        if (error_buffer && buffer_size > 0) {
+            snprintf(error_buffer, buffer_size, "bad arguments (at most %d parameters)",
+                     MAX_EXPR_PARAMS);
+        }
+        return NULL;
+    }
+    for (size_t i = 0; i < num_params; i++) {
+        if (!params[i].name || params[i].type != PHYSICS_PARAM_DOUBLE) {
+            if (error_buffer && buffer_size > 0) {
+                snprintf(error_buffer, buffer_size, "parameter %zu must be a named double", i);
+            }
+            return NULL;
+        }
+    }
+
+    Parser ps;
+    memset(&ps, 0, sizeof(ps));
+    ps.src = ps.p = source;
+    ps.params = params;
+    ps.num_params = num_params;
+    ps.error = error_buffer;
+    ps.error_size = buffer_size;
+    ps.nodes = (Node *)malloc(MAX_NODES * sizeof(Node));
+    if (!ps.nodes) return NULL;
+
+    int root = parse_expr(&ps);
+    skip_space(&ps);
+    if (root >= 0 && *ps.p) root = fail(&ps, "unexpected '%c'", *ps.p);
+    if (root >= 0 && !dim_equal(ps.nodes[root].dim, dim_of(result_dimension))) {
+        char got[64];
+        dim_format(ps.nodes[root].dim, got, sizeof(got));
+        root = fail(&ps, "result has dimension %s, expected %s", got,
+                    physics_dimension_name(result_dimension));
+    }
+    if (root < 0) {
+        free(ps.nodes);
+        return NULL;
+    }
+
+    PhysicsExpr *expr = (PhysicsExpr *)calloc(1, sizeof(PhysicsExpr));
+    if (!expr) {
+        free(ps.nodes);
+        return NULL;
+    }
+    expr->num_params = num_params;
+
+    Gen g;
+    memset(&g, 0, sizeof(g));
+    g.expr = expr;
+    g.out_slot = (int)num_params;
+    Operand r = gen_node(&g, ps.nodes, root);
+    if (r.is_const) {
+        emit(&g, OP_FILL, no_operand, no_operand, r.k);
+    } else if (!is_reg(&g, r)) {
+        emit(&g, OP_MOV, r, no_operand, 0.0);
+    }
+    free(ps.nodes);
+    if (g.failed) {
+        if (error_buffer && buffer_size > 0) {
+            snprintf(error_buffer, buffer_size, "out of registers or memory");
+        }
+        physics_expr_destroy(expr);
+        return NULL;
+    }
+    /* the last instruction produces the result: write it to the output */
+    expr->code[expr->num_code - 1].dst = (unsigned short)g.out_slot;
+    return expr;
+}
+
+void physics_expr_destroy(PhysicsExpr *expr) {
+    if (!expr) return;
+    free(expr->code);
+    free(expr);
+}
+
+size_t physics_expr_num_instructions(const PhysicsExpr *expr) {
+    return expr ? expr->num_code : 0;
+}
+
+size_t physics_expr_num_registers(const PhysicsExpr *expr) {
+    return expr ? expr->num_registers : 0;
+}
+
+/* === Virtual machine === */
+
+#define VM_LOOP(body) for (size_t j = 0; j < m; j++) { body; } break
+
+/* Run the program on m <= PHYSICS_EXPR_BLOCK elements; slot holds the
+ * parameter, output and register pointers for this block */
+static void vm_run(const PhysicsExpr *expr, double *const *slot, size_t m) {
+    for (size_t p = 0; p < expr->num_code; p++) {
+        const ExprInsn *in = &expr->code[p];
+        double *d = slot[in->dst];
+        const double *a = slot[in->a];
+        const double *b = slot[in->b];
+        const double k = in->k;
+        switch ((ExprOp)in->op) {
+            case OP_MOV: VM_LOOP(d[j] = a[j]);
+            case OP_FILL: VM_LOOP(d[j] = k);
+            case OP_ADD: VM_LOOP(d[j] = a[j] + b[j]);
+            case OP_ADDK: VM_LOOP(d[j] = a[j] + k);
+            case OP_SUB: VM_LOOP(d[j] = a[j] - b[j]);
+            case OP_RSUBK: VM_LOOP(d[j] = k - a[j]);
+            case OP_MUL: VM_LOOP(d[j] = a[j] * b[j]);
+            case OP_MULK: VM_LOOP(d[j] = a[j] * k);
+            case OP_MULS: VM_LOOP(d[j] = k * a[j] * b[j]);
+            case OP_DIV: VM_LOOP(d[j] = a[j] / b[j]);
+            case OP_DIVS: VM_LOOP(d[j] = k * a[j] / b[j]);
+            case OP_RDIVK: VM_LOOP(d[j] = k / a[j]);
+            case OP_MIN: VM_LOOP(d[j] = fmin(a[j], b[j]));
+            case OP_MINK: VM_LOOP(d[j] = fmin(a[j], k));
+            case OP_MAX: VM_LOOP(d[j] = fmax(a[j], b[j]));
+            case OP_MAXK: VM_LOOP(d[j] = fmax(a[j], k));
+            case OP_POW: VM_LOOP(d[j] = pow(a[j], b[j]));
+            case OP_POWK: VM_LOOP(d[j] = pow(a[j], k));
+            case OP_RPOWK: VM_LOOP(d[j] = pow(k, a[j]));
+            case OP_SQRT: VM_LOOP(d[j] = sqrt(a[j]));
+            case OP_EXP: VM_LOOP(d[j] = exp(a[j]));
+            case OP_LOG: VM_LOOP(d[j] = log(a[j]));
+            case OP_LOG10: VM_LOOP(d[j] = log10(a[j]));
+            case OP_SIN: VM_LOOP(d[j] = sin(a[j]));
+            case OP_COS: VM_LOOP(d[j] = cos(a[j]));
+            case OP_TAN: VM_LOOP(d[j] = tan(a[j]));
+            case OP_TANH: VM_LOOP(d[j] = tanh(a[j]));
+            case OP_ABS: VM_LOOP(d[j] = fabs(a[j]));
+        }
+    }
+}
+
+int physics_expr_eval_batch(const PhysicsExpr *expr,
+                            const double *const *columns,
+                            size_t n,
+                            double *out) {
+    if (!expr || !out || (expr->num_params > 0 && !columns)) return -1;
+    if (n == 0) return 0;
+
+    size_t np = expr->num_params, nslots = np + 1 + expr->num_registers;
+    double **slot = (double **)malloc(nslots * sizeof(double *));
+    double *scratch = (double *)malloc((expr->num_registers ? expr->num_registers : 1) *
+                                       PHYSICS_EXPR_BLOCK * sizeof(double));
+    if (!slot || !scratch) {
+        free(slot);
+        free(scratch);
+        return -1;
+    }
+    for (size_t r = 0; r < expr->num_registers; r++) {
+        slot[np + 1 + r] = scratch + r * PHYSICS_EXPR_BLOCK;
+    }
+    for (size_t off = 0; off < n; off += PHYSICS_EXPR_BLOCK) {
+        size_t m = n - off < PHYSICS_EXPR_BLOCK ? n - off : PHYSICS_EXPR_BLOCK;
+        for (size_t i = 0; i < np; i++) {
+            slot[i] = (double *)(columns[i] + off); /* parameters are only read */
+        }
+        slot[np] = out + off;
+        vm_run(expr, slot, m);
+    }
+    free(slot);
+    free(scratch);
+    return 0;
+}
+
+double physics_expr_eval(const PhysicsExpr *expr, const double *values) {
+    if (!expr || (expr->num_params > 0 && !values)) return NAN;
+
+    double *slot[MAX_EXPR_PARAMS + 1 + MAX_EXPR_REGISTERS];
+    double regs[MAX_EXPR_REGISTERS];
+    double result;
+    size_t np = expr->num_params;
+    for (size_t i = 0; i < np; i++) slot[i] = (double *)&values[i];
+    slot[np] = &result;
+    for (size_t r = 0; r < expr->num_registers; r++) slot[np + 1 + r] = &regs[r];
+    vm_run(expr, slot, 1);
+    return result;
+}
+
+/* === Components === */
+
+typedef struct {
+    PhysicsComponent base;       /* first, so the component pointer converts */
+    PhysicsExpr *expr;
+    PhysicsParamDesc *descs;
+} ExprComponent;
+
+static PhysicsResult expr_component_calculate(const PhysicsComponent *comp,
+                                              const PhysicsParam *params,
+                                              size_t num_params) {
+    const ExprComponent *ec = (const ExprComponent *)comp;
+    PhysicsResult result = {0};
+    double values[MAX_EXPR_PARAMS];
+
+    for (size_t i = 0; i < ec->expr->num_params; i++) {
+        size_t j = 0;
+        while (j < num_params && !(params[j].is_set && params[j].desc.name &&
+                                   strcmp(params[j].desc.name, ec->descs[i].name) == 0)) j++;
+        if (j == num_params) {
+            result.is_valid = false;
+            result.error_msg = "Missing required parameters";
+            return result;
+        }
+        values[i] = params[j].value.d;
+    }
+
+    result.value = physics_expr_eval(ec->expr, values);
+    result.dimension = comp->result_dimension;
+    result.units = comp->result_units;
+    result.uncertainty = 0.0;
+    result.is_valid = isfinite(result.value);
+    result.error_msg = result.is_valid ? NULL : "Non-finite result";
+    return result;
+}
+
+static bool expr_component_validate(const PhysicsComponent *comp,
+                                    const PhysicsParam *params,
+                                    size_t num_params,
+                                    char *error_buffer,
+                                    size_t buffer_size) {
+    (void)comp;
+    for (size_t i = 0; i < num_params; i++) {
+        if (!physics_param_validate(&params[i], error_buffer, buffer_size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static char *copy_string(const char *s) {
+    if (!s) return NULL;
+    size_t n = strlen(s) + 1;
+    char *c = (char *)malloc(n);
+    if (c) memcpy(c, s, n);
+    return c;
+}
+
+PhysicsComponent *physics_expr_component_create(const char *name,
+                                                const char *description,
+                                                const char *source,
+                                                const PhysicsParamDesc *params,
+                                                size_t num_params,
+                                                PhysicsDimension result_dimension,
+                                                const char *result_units,
+                                                char *error_buffer,
+                                                size_t buffer_size) {
+    if (!name) return NULL;
+    PhysicsExpr *expr = physics_expr_compile(source, params, num_params, result_dimension,
+                                             error_buffer, buffer_size);
+    if (!expr) return NULL;
+
+    ExprComponent *ec = (ExprComponent *)calloc(1, sizeof(ExprComponent));
+    if (!ec) {
+        physics_expr_destroy(expr);
+        return NULL;
+    }
+    ec->expr = expr;
+    ec->descs = (PhysicsParamDesc *)calloc(num_params ? num_params : 1, sizeof(PhysicsParamDesc));
+    ec->base.name = copy_string(name);
+    ec->base.description = copy_string(description ? description : source);
+    ec->base.result_units = copy_string(result_units ? result_units : "");
+    bool ok = ec->descs && ec->base.name && ec->base.description && ec->base.result_units;
+    for (size_t i = 0; ok && i < num_params; i++) {
+        ec->descs[i] = params[i];
+        ec->descs[i].name = copy_string(params[i].name);
+        ec->descs[i].units = copy_string(params[i].units);
+        ec->descs[i].description = copy_string(params[i].description);
+        ok = ec->descs[i].name && (!params[i].units || ec->descs[i].units) &&
+             (!params[i].description || ec->descs[i].description);
+    }
+    ec->base.domain = PHYSICS_DOMAIN_COMPOSITE;
+    ec->base.param_descs = ec->descs;
+    ec->base.num_params = num_params;
+    ec->base.calculate = expr_component_calculate;
+    ec->base.validate = expr_component_validate;
+    ec->base.result_dimension = result_dimension;
+    if (!ok) {
+        physics_expr_component_destroy(&ec->base);
+        return NULL;
+    }
+    return &ec->base;
+}
+
+const PhysicsExpr *physics_expr_component_expr(const PhysicsComponent *comp) {
+    if (!comp || comp->calculate != expr_component_calculate) return NULL;
+    return ((const ExprComponent *)comp)->expr;
+}
+
+void physics_expr_component_destroy(PhysicsComponent *comp) {
+    if (!comp || comp->calculate != expr_component_calculate) return;
+    ExprComponent *ec = (ExprComponent *)comp;
+    if (ec->descs) {
+        for (size_t i = 0; i < comp->num_params; i++) {
+            free((char *)ec->descs[i].name);
+            free((char *)ec->descs[i].units);
+            free((char *)ec->descs[i].description);
+        }
+    }
+    free(ec->descs);
+    free((char *)comp->name);
+    free((char *)comp->description);
+    free((char *)comp->result_units);
+    physics_expr_destroy(ec->expr);
+    free(ec);
+}
@@ -41,9 +41,68 @@ void physics_context_destroy(PhysicsContext *context) {
     if (context->param_counts) {
         free(context->param_counts);
     }
+    if (context->upstream) {
+        for (size_t i = 0; i < context->num_components; i++) {
+            free(context->upstream[i]);
+        }
+        free(context->upstream);
+    }
+    free(context->num_upstream);
+    free(context->results);
+    free(context->dirty);
+    free(context->exec_counts);
     free(context);
 }
 
+/* Grow a per-component array to n entries (realloc keeps the pointer valid
+ * on failure, so the context stays consistent). */
+static int grow(void **array, size_t n, size_t size) {
+    void *p = realloc(*array, n * size);
+    if (!p) return -1;
+    *array = p;
+    return 0;
+}
+
+/* Context index of component comp, or -1 if it is not in the context. */
+static long find_component(PhysicsComponent *const *components, size_t n,
+                           const PhysicsComponent *comp) {
+    for (size_t i = 0; i < n; i++) {
+        if (components[i] == comp) return (long)i;
+    }
+    return -1;
+}
+
+/* Kahn's algorithm, always taking the lowest ready index so independent
+ * components keep their insertion order. Dependencies missing from the set
+ * are ignored. Returns -1 on a cycle. */
+static int dependency_order(PhysicsComponent *const *components, size_t n,
+                            size_t *order) {
+    bool *done = (bool *)calloc(n ? n : 1, sizeof(bool));
+    if (!done) return -1;
+    size_t placed = 0;
+    while (placed < n) {
+        size_t pick = n;
+        for (size_t i = 0; i < n && pick == n; i++) {
+            if (done[i]) continue;
+            bool ready = true;
+            const PhysicsComponent *comp = components[i];
+            for (size_t d = 0; comp && d < comp->num_dependencies; d++) {
+                long k = find_component(components, n, comp->dependencies[d]);
+                if (k >= 0 && !done[k]) ready = false;
+            }
+            if (ready) pick = i;
+        }
+        if (pick == n) {
+            free(done);
+            return -1;
+        }
+        done[pick] = true;
+        order[placed++] = pick;
+    }
+    free(done);
+    return 0;
+}
+
 int physics_context_add_component(PhysicsContext *context, 
                                    PhysicsComponent *component,
                                    PhysicsParam *params,
@@ -68,6 +127,14 @@ int physics_context_add_component(PhysicsContext *context,
     if (!new_param_counts) return -1;
     context->param_counts = new_param_counts;
     
+    if (grow((void **)&context->results, new_size, sizeof(PhysicsResult)) ||
+        grow((void **)&context->dirty, new_size, sizeof(bool)) ||
+        grow((void **)&context->exec_counts, new_size, sizeof(size_t)) ||
+        grow((void **)&context->upstream, new_size, sizeof(size_t *)) ||
+        grow((void **)&context->num_upstream, new_size, sizeof(size_t))) {
+        return -1;
+    }
+    
     /* Copy parameters */
     PhysicsParam *param_copy = NULL;
     if (num_params > 0 && params) {
@@ -80,42 +147,193 @@ int physics_context_add_component(PhysicsContext *context,
     context->components[context->num_components] = component;
     context->param_sets[context->num_components] = param_copy;
     context->param_counts[context->num_components] = num_params;
+    
+    /* New components run on the next execution, and so do components that
+     * can now consume this one's result */
+    size_t idx = context->num_components;
+    memset(&context->results[idx], 0, sizeof(PhysicsResult));
+    context->dirty[idx] = true;
+    context->exec_counts[idx] = 0;
+    context->upstream[idx] = NULL;
+    context->num_upstream[idx] = 0;
+    for (size_t i = 0; i < idx; i++) {
+        const PhysicsComponent *comp = context->components[i];
+        for (size_t d = 0; d < comp->num_dependencies; d++) {
+            if (comp->dependencies[d] == component) context->dirty[i] = true;
+        }
+    }
     context->num_components++;
     
     return 0;
 }
 
-int physics_context_execute(PhysicsContext *context, PhysicsResult **results) {
-    if (!context || !results) return -1;
+/* Mark every component that consumed a dirty component's result dirty,
+ * transitively. Returns the number newly marked. */
+static int propagate_dirty(PhysicsContext *context) {
+    int marked = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < context->num_components; i++) {
+            if (context->dirty[i]) continue;
+            for (size_t u = 0; u < context->num_upstream[i]; u++) {
+                if (context->dirty[context->upstream[i][u]]) {
+                    context->dirty[i] = true;
+                    changed = true;
+                    marked++;
+                    break;
+                }
+            }
+        }
+    }
+    return marked;
+}
+
+static bool param_value_equal(const PhysicsParam *param, PhysicsParamValue value) {
+    switch (param->desc.type) {
+        case PHYSICS_PARAM_DOUBLE: return param->value.d == value.d;
+        case PHYSICS_PARAM_INT: return param->value.i == value.i;
+        case PHYSICS_PARAM_STRING:
+            return param->value.s == value.s ||
+                   (param->value.s && value.s && strcmp(param->value.s, value.s) == 0);
+        case PHYSICS_PARAM_POINTER: return param->value.p == value.p;
+        default: return false;
+    }
+}
+
+int physics_context_set_param(PhysicsContext *context, const char *name,
+                              PhysicsParamValue value) {
+    if (!context || !name) return -1;
     
-    /* Allocate results array */
-    *results = (PhysicsResult *)calloc(context->num_components, sizeof(PhysicsResult));
-    if (!*results) return -1;
+    bool found = false;
+    int marked = 0;
+    for (size_t i = 0; i < context->num_components; i++) {
+        for (size_t j = 0; j < context->param_counts[i]; j++) {
+            PhysicsParam *param = &context->param_sets[i][j];
+            if (!param->desc.name || strcmp(param->desc.name, name) != 0) continue;
+            found = true;
+            if (param->is_set && param_value_equal(param, value)) continue;
+            physics_param_set_value(param, value);
+            if (!context->dirty[i]) {
+                context->dirty[i] = true;
+                marked++;
+            }
+        }
+    }
+    if (!found) return -1;
+    return marked + propagate_dirty(context);
+}
+
+/* Run one component, through compose when all its dependencies are in the
+ * context, and record the upstream results it consumed. */
+static int run_component(PhysicsContext *context, size_t i) {
+    const PhysicsComponent *comp = context->components[i];
+    PhysicsParam *params = context->param_sets[i];
+    size_t num_params = context->param_counts[i];
+    
+    free(context->upstream[i]);
+    context->upstream[i] = NULL;
+    context->num_upstream[i] = 0;
+    
+    bool compose = comp && comp->compose && comp->num_dependencies > 0;
+    for (size_t d = 0; compose && d < comp->num_dependencies; d++) {
+        if (find_component(context->components, context->num_components,
+                           comp->dependencies[d]) < 0) compose = false;
+    }
     
-    /* Validate context if enabled */
+    PhysicsResult result;
+    if (compose) {
+        size_t n = comp->num_dependencies;
+        size_t *up = (size_t *)malloc(n * sizeof(size_t));
+        PhysicsResult *inputs = (PhysicsResult *)malloc(n * sizeof(PhysicsResult));
+        if (!up || !inputs) {
+            free(up);
+            free(inputs);
+            return -1;
+        }
+        for (size_t d = 0; d < n; d++) {
+            up[d] = (size_t)find_component(context->components, context->num_components,
+                                           comp->dependencies[d]);
+            inputs[d] = context->results[up[d]];
+        }
+        result = comp->compose(comp, params, num_params, inputs, n);
+        free(inputs);
+        context->upstream[i] = up;
+        context->num_upstream[i] = n;
+    } else if (comp && comp->calculate) {
+        result = comp->calculate(comp, params, num_params);
+    } else {
+        memset(&result, 0, sizeof(result));
+        result.is_valid = false;
+        result.error_msg = "No calculation function";
+    }
+    context->results[i] = result;
+    context->exec_counts[i]++;
+    context->dirty[i] = false;
+    return 0;
+}
+
+/* Validate (if enabled) and run the dirty components in dependency order. */
+static int run_dirty(PhysicsContext *context) {
     if (context->enable_validation) {
         char error_buffer[MAX_ERROR_MSG];
         if (!physics_context_validate(context, error_buffer, sizeof(error_buffer))) {
             printf("[physics] Validation failed: %s\n", error_buffer);
-            free(*results);
-            *results = NULL;
             return -1;
         }
     }
     
-    /* Execute each component */
-    for (size_t i = 0; i < context->num_components; i++) {
-        const PhysicsComponent *comp = context->components[i];
-        PhysicsParam *params = context->param_sets[i];
-        size_t num_params = context->param_counts[i];
-        
-        if (comp && comp->calculate) {
-            (*results)[i] = comp->calculate(comp, params, num_params);
-        } else {
-            (*results)[i].is_valid = false;
-            (*results)[i].error_msg = "No calculation function";
+    size_t n = context->num_components;
+    size_t *order = (size_t *)malloc((n ? n : 1) * sizeof(size_t));
+    if (!order) return -1;
+    if (dependency_order(context->components, n, order) != 0) {
+        free(order);
+        return -1;
+    }
+    int ran = 0;
+    for (size_t k = 0; k < n; k++) {
+        size_t i = order[k];
+        if (!context->dirty[i]) continue;
+        if (run_component(context, i) != 0) {
+            free(order);
+            return -1;
         }
+        ran++;
+        /* first runs record their upstream only now */
+        propagate_dirty(context);
     }
+    free(order);
+    return ran;
+}
+
+int physics_context_execute_incremental(PhysicsContext *context,
+                                        const PhysicsResult **results) {
+    if (!context || !results) return -1;
+    
+    int ran = run_dirty(context);
+    if (ran < 0) return -1;
+    *results = context->results;
+    return ran;
+}
+
+int physics_context_execute(PhysicsContext *context, PhysicsResult **results) {
+    if (!context || !results) return -1;
+    
+    /* Allocate results array */
+    *results = (PhysicsResult *)calloc(context->num_components ? context->num_components : 1,
+                                       sizeof(PhysicsResult));
+    if (!*results) return -1;
+    
+    /* Execute every component, in dependency order */
+    for (size_t i = 0; i < context->num_components; i++) {
+        context->dirty[i] = true;
+    }
+    if (run_dirty(context) < 0) {
+        free(*results);
+        *results = NULL;
+        return -1;
+    }
+    memcpy(*results, context->results, context->num_components * sizeof(PhysicsResult));
     
     return 0;
 }
@@ -327,11 +545,22 @@ int physics_resolve_dependencies(PhysicsComponent **components,
                                  PhysicsComponent ***ordered_components) {
     if (!components || !ordered_components) return -1;
     
-    /* Simple topological sort - for now just return original order */
-    *ordered_components = (PhysicsComponent **)malloc(num_components * sizeof(PhysicsComponent *));
-    if (!*ordered_components) return -1;
+    /* Topological sort, stable for independent components */
+    size_t *order = (size_t *)malloc((num_components ? num_components : 1) * sizeof(size_t));
+    *ordered_components = (PhysicsComponent **)malloc(
+        (num_components ? num_components : 1) * sizeof(PhysicsComponent *));
+    if (!order || !*ordered_components ||
+        dependency_order(components, num_components, order) != 0) {
+        free(order);
+        free(*ordered_components);
+        *ordered_components = NULL;
+        return -1;
+    }
     
-    memcpy(*ordered_components, components, num_components * sizeof(PhysicsComponent *));
+    for (size_t i = 0; i < num_components; i++) {
+        (*ordered_components)[i] = components[order[i]];
+    }
+    free(order);
     return 0;
 }
 
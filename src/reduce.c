@@ -0,0 +1,204 @@
+/** \file reduce.c
+ *  \brief Chunked reductions with a thread-count independent combine tree.
+ *
+ *  Array kernels keep eight accumulators per chunk, lane j taking elements
+ *  j, j + 8, ... of the chunk, and fold them in a fixed order. Besides
+ *  making the result independent of scheduling, this breaks the add latency
+ *  chain of a naive loop and lets the compiler use vector registers without
+ *  reassociating anything.
+ */
+#include "reduce.h"
+#include "parallel.h"
+#include <math.h>
+#include <stdlib.h>
+
+/* With threads <= 0, inputs of fewer chunks run inline: parallel_for starts
+ * its threads on every call, which costs more than reducing this much. */
+#define REDUCE_INLINE_CHUNKS 64
+/* Partials kept on the stack before falling back to the heap. */
+#define REDUCE_STACK_PARTIALS 256
+
+#define LANES 8
+
+typedef struct {
+  size_t n, chunk;
+  int nvalues;
+  const ReduceOp *ops;
+  ReduceChunkFn fn;
+  void *ctx;
+  double *partials;
+} ChunkRun;
+
+static double identity(ReduceOp op) {
+  return op == REDUCE_MIN ? INFINITY : op == REDUCE_MAX ? -INFINITY : 0.0;
+}
+
+static void run_chunk(void *ctx, int task, int thread) {
+  (void)thread;
+  const ChunkRun *r = (const ChunkRun *)ctx;
+  double *p = r->partials + (size_t)task * (size_t)r->nvalues;
+  for (int v = 0; v < r->nvalues; ++v)
+    p[v] = identity(r->ops ? r->ops[v] : REDUCE_SUM);
+  size_t begin = (size_t)task * r->chunk;
+  size_t end = begin + r->chunk < r->n ? begin + r->chunk : r->n;
+  r->fn(r->ctx, begin, end, p);
+}
+
+static void combine(double *a, const double *b, int nvalues,
+                    const ReduceOp *ops) {
+  for (int v = 0; v < nvalues; ++v) {
+    switch (ops ? ops[v] : REDUCE_SUM) {
+    case REDUCE_MIN:
+      a[v] = b[v] < a[v] ? b[v] : a[v];
+      break;
+    case REDUCE_MAX:
+      a[v] = b[v] > a[v] ? b[v] : a[v];
+      break;
+    default:
+      a[v] += b[v];
+      break;
+    }
+  }
+}
+
+int reduce_chunks(size_t n, size_t chunk, int nvalues, const ReduceOp *ops,
+                  int threads, ReduceChunkFn fn, void *ctx, double *out) {
+  if (!fn || !out || nvalues <= 0 || nvalues > REDUCE_MAX_VALUES)
+    return -1;
+  if (chunk == 0)
+    chunk = REDUCE_CHUNK;
+  for (int v = 0; v < nvalues; ++v)
+    out[v] = identity(ops ? ops[v] : REDUCE_SUM);
+  if (n == 0)
+    return 0;
+  size_t nchunks = (n - 1) / chunk + 1;
+  if (nchunks > (size_t)1 << 30)
+    return -1;
+
+  double stack[REDUCE_STACK_PARTIALS];
+  double *partials = stack;
+  size_t need = nchunks * (size_t)nvalues;
+  if (need > REDUCE_STACK_PARTIALS) {
+    partials = (double *)malloc(need * sizeof(double));
+    if (!partials)
+      return -1;
+  }
+  ChunkRun r = {n, chunk, nvalues, ops, fn, ctx, partials};
+  if (threads <= 0 && nchunks < REDUCE_INLINE_CHUNKS)
+    threads = 1;
+  if (threads == 1) {
+    for (size_t t = 0; t < nchunks; ++t)
+      run_chunk(&r, (int)t, 0);
+  } else {
+    parallel_for((int)nchunks, threads, run_chunk, &r);
+  }
+
+  /* pairwise tree over chunk index: (0,1) (2,3) ..., then (0,2) (4,6) ... */
+  for (size_t stride = 1; stride < nchunks; stride *= 2)
+    for (size_t i = 0; i + stride < nchunks; i += 2 * stride)
+      combine(partials + i * (size_t)nvalues,
+              partials + (i + stride) * (size_t)nvalues, nvalues, ops);
+  for (int v = 0; v < nvalues; ++v)
+    out[v] = partials[v];
+  if (partials != stack)
+    free(partials);
+  return 0;
+}
+
+static double fold_lanes(const double a[LANES]) {
+  return ((a[0] + a[1]) + (a[2] + a[3])) + ((a[4] + a[5]) + (a[6] + a[7]));
+}
+
+static void sum_chunk(void *ctx, size_t begin, size_t end, double *partial) {
+  const double *x = (const double *)ctx;
+  double a[LANES] = {0};
+  size_t i = begin;
+  for (; i + LANES <= end; i += LANES)
+    for (int j = 0; j < LANES; ++j)
+      a[j] += x[i + j];
+  for (int j = 0; i < end; ++i, ++j)
+    a[j] += x[i];
+  partial[0] = fold_lanes(a);
+}
+
+double reduce_sum(const double *x, size_t n, int threads) {
+  double s = 0.0;
+  if (!x || reduce_chunks(n, REDUCE_CHUNK, 1, NULL, threads, sum_chunk,
+                          (void *)x, &s) != 0)
+    return 0.0;
+  return s;
+}
+
+typedef struct {
+  const double *x, *y;
+} DotCtx;
+
+static void dot_chunk(void *ctx, size_t begin, size_t end, double *partial) {
+  const DotCtx *d = (const DotCtx *)ctx;
+  double a[LANES] = {0};
+  size_t i = begin;
+  for (; i + LANES <= end; i += LANES)
+    for (int j = 0; j < LANES; ++j)
+      a[j] += d->x[i + j] * d->y[i + j];
+  for (int j = 0; i < end; ++i, ++j)
+    a[j] += d->x[i] * d->y[i];
+  partial[0] = fold_lanes(a);
+}
+
+double reduce_dot(const double *x, const double *y, size_t n, int threads) {
+  double s = 0.0;
+  DotCtx d = {x, y};
+  if (!x || !y ||
+      reduce_chunks(n, REDUCE_CHUNK, 1, NULL, threads, dot_chunk, &d, &s) != 0)
+    return 0.0;
+  return s;
+}
+
+static void stats_chunk(void *ctx, size_t begin, size_t end,
+                        double *partial) {
+  const double *x = (const double *)ctx;
+  double s[LANES] = {0}, q[LANES] = {0};
+  double lo[LANES], hi[LANES];
+  for (int j = 0; j < LANES; ++j) {
+    lo[j] = INFINITY;
+    hi[j] = -INFINITY;
+  }
+  size_t i = begin;
+  for (; i + LANES <= end; i += LANES)
+    for (int j = 0; j < LANES; ++j) {
+      double v = x[i + j];
+      s[j] += v;
+      q[j] += v * v;
+      lo[j] = v < lo[j] ? v : lo[j];
+      hi[j] = v > hi[j] ? v : hi[j];
+    }
+  for (int j = 0; i < end; ++i, ++j) {
+    double v = x[i];
+    s[j] += v;
+    q[j] += v * v;
+    lo[j] = v < lo[j] ? v : lo[j];
+    hi[j] = v > hi[j] ? v : hi[j];
+  }
+  partial[0] = fold_lanes(s);
+  partial[1] = fold_lanes(q);
+  for (int j = 0; j < LANES; ++j) {
+    partial[2] = lo[j] < partial[2] ? lo[j] : partial[2];
+    partial[3] = hi[j] > partial[3] ? hi[j] : partial[3];
+  }
+}
+
+int reduce_stats(const double *x, size_t n, int threads, ReduceStats *out) {
+  static const ReduceOp ops[4] = {REDUCE_SUM, REDUCE_SUM, REDUCE_MIN,
+                                  REDUCE_MAX};
+  double v[4];
+  if (!x || !out ||
+      reduce_chunks(n, REDUCE_CHUNK, 4, ops, threads, stats_chunk, (void *)x,
+                    v) != 0)
+    return -1;
+  out->sum = v[0];
+  out->sum_sq = v[1];
+  out->min = v[2];
+  out->max = v[3];
+  out->count = n;
+  return 0;
+}
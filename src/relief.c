@@ -0,0 +1,348 @@
+/**
+ * \file relief.c
+ * \brief Hillshade, monotone-stack horizon occlusion and hypsometric tinting.
+ */
+#include "relief.h"
+#include "parallel.h"
+#include "simulation.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** \brief Adjacent sweep lines advanced together (shares cache lines). */
+#define AO_LANES 16
+/** \brief Rows per hillshade band task. */
+#define BAND_ROWS 32
+
+void relief_default_params(ReliefParams *p) {
+  if (!p)
+    return;
+  p->azimuth = 315.0;
+  p->altitude = 45.0;
+  p->z_scale = 0.0;
+  p->ao_directions = 8;
+  p->ao_strength = 0.8;
+  p->ambient = 0.25;
+  p->hypsometric = 1;
+  p->threads = 0;
+}
+
+static int valid_input(const double *h, int nx, int ny, const ReliefParams *p) {
+  return h && p && nx >= 1 && ny >= 1 && p->ao_directions >= 0 &&
+         p->ao_strength >= 0.0 && p->ao_strength <= 1.0 &&
+         p->ambient >= 0.0 && p->ambient <= 1.0;
+}
+
+static int worker_count(const ReliefParams *p) {
+  int nt = p->threads > 0 ? p->threads : parallel_default_threads();
+  return nt > 256 ? 256 : nt;
+}
+
+static void height_range(const double *h, size_t n, double *mn, double *mx) {
+  double lo = h[0], hi = h[0];
+  for (size_t i = 1; i < n; ++i) {
+    lo = h[i] < lo ? h[i] : lo;
+    hi = h[i] > hi ? h[i] : hi;
+  }
+  *mn = lo;
+  *mx = hi;
+}
+
+/** \brief Cells per height unit: p->z_scale or the automatic default. */
+static double z_scale_for(const ReliefParams *p, int nx, int ny, double mn,
+                          double mx) {
+  if (p->z_scale > 0.0)
+    return p->z_scale;
+  double side = nx > ny ? nx : ny;
+  return mx > mn ? 0.1 * side / (mx - mn) : 1.0;
+}
+
+/* ---------------- Horizon-based ambient occlusion ---------------- */
+
+/** \brief State of the sweeps of one direction. The grid is addressed as
+ * (major, minor) with major the axis the direction advances fastest along:
+ * line l visits minor cell l + round(t * i) at step i. */
+typedef struct {
+  const float *z; /* heights in cell units */
+  float *occ;     /* sum over directions of sin(horizon elevation) */
+  float *stack;   /* per thread: AO_LANES stacks of (step, height) */
+  int stack_cap;  /* entries per lane stack */
+  int nmajor, nminor;
+  long smajor, sminor; /* strides of the two axes in z */
+  int flip;            /* walk major from the far end */
+  double t;            /* minor offset per major step, |t| <= 1 */
+  float step;          /* length of one step in cells */
+  int first_line;
+} SweepCtx;
+
+/** \brief Sweep AO_LANES adjacent lines of one direction. */
+static void sweep_lines(void *ctx, int task, int thread) {
+  SweepCtx *c = (SweepCtx *)ctx;
+  float *ss[AO_LANES], *zz[AO_LANES];
+  int top[AO_LANES];
+  for (int l = 0; l < AO_LANES; ++l) {
+    ss[l] = c->stack + ((size_t)thread * AO_LANES + l) * 2 * c->stack_cap;
+    zz[l] = ss[l] + c->stack_cap;
+    top[l] = 0;
+  }
+  int line0 = c->first_line + task * AO_LANES;
+  float step2 = c->step * c->step;
+  for (int i = 0; i < c->nmajor; ++i) {
+    int major = c->flip ? c->nmajor - 1 - i : i;
+    int shift = (int)floor(c->t * i + 0.5);
+    /* lanes whose cell lies on the grid at this step */
+    int lo = -shift - line0, hi = c->nminor - shift - line0;
+    lo = lo < 0 ? 0 : lo;
+    hi = hi > AO_LANES ? AO_LANES : hi;
+    const float *zrow = c->z + major * c->smajor;
+    float *orow = c->occ + major * c->smajor;
+    float s = (float)i;
+    for (int l = lo; l < hi; ++l) {
+      long cell = (long)(line0 + l + shift) * c->sminor;
+      float zq = zrow[cell];
+      float *S = ss[l], *Z = zz[l];
+      int n = top[l];
+      /* drop hull points that the new point hides from everything beyond */
+      while (n >= 2 &&
+             (Z[n - 2] - zq) * (s - S[n - 1]) >= (Z[n - 1] - zq) * (s - S[n - 2]))
+        --n;
+      if (n >= 1) {
+        float dz = Z[n - 1] - zq;
+        if (dz > 0.0f) {
+          float ds = s - S[n - 1];
+          orow[cell] += dz / sqrtf(dz * dz + ds * ds * step2);
+        }
+      }
+      S[n] = s;
+      Z[n] = zq;
+      top[l] = n + 1;
+    }
+  }
+}
+
+/** \brief Add the occlusion of every direction to occ (zeroed by caller). */
+static int occlusion_sum(const float *z, int nx, int ny, int ndirs,
+                         int threads, float *occ) {
+  int nt = threads;
+  int cap = nx > ny ? nx : ny;
+  float *stack = (float *)malloc((size_t)nt * AO_LANES * 2 * cap *
+                                 sizeof(float));
+  if (!stack)
+    return -1;
+  SweepCtx c;
+  c.z = z;
+  c.occ = occ;
+  c.stack = stack;
+  c.stack_cap = cap;
+  for (int d = 0; d < ndirs; ++d) {
+    double a = 2.0 * M_PI * d / ndirs;
+    double vx = cos(a), vy = sin(a);
+    int xmajor = fabs(vx) >= fabs(vy);
+    double vmaj = xmajor ? vx : vy, vmin = xmajor ? vy : vx;
+    c.nmajor = xmajor ? nx : ny;
+    c.nminor = xmajor ? ny : nx;
+    c.smajor = xmajor ? 1 : nx;
+    c.sminor = xmajor ? nx : 1;
+    c.flip = vmaj < 0.0;
+    c.t = vmin / fabs(vmaj);
+    c.step = (float)sqrt(1.0 + c.t * c.t);
+    /* lines reaching the grid: minor origins covering every cell */
+    int reach = (int)ceil(fabs(c.t) * (c.nmajor - 1)) + 1;
+    int first = c.t > 0.0 ? -reach : 0;
+    int last = c.t < 0.0 ? c.nminor - 1 + reach : c.nminor - 1;
+    c.first_line = first;
+    int tasks = (last - first + AO_LANES) / AO_LANES;
+    parallel_for(tasks, nt, sweep_lines, &c);
+  }
+  free(stack);
+  return 0;
+}
+
+/** \brief Heights as floats in cell units (z_scale applied). */
+static float *scaled_heights(const double *h, size_t n, double zs) {
+  float *z = (float *)malloc(n * sizeof(float));
+  if (z)
+    for (size_t i = 0; i < n; ++i)
+      z[i] = (float)(h[i] * zs);
+  return z;
+}
+
+int relief_ambient_occlusion(const double *h, int nx, int ny,
+                             const ReliefParams *p, float *vis) {
+  if (!valid_input(h, nx, ny, p) || !vis || p->ao_directions < 1)
+    return -1;
+  size_t n = (size_t)nx * ny;
+  double mn, mx;
+  height_range(h, n, &mn, &mx);
+  float *z = scaled_heights(h, n, z_scale_for(p, nx, ny, mn, mx));
+  if (!z)
+    return -1;
+  memset(vis, 0, n * sizeof(float));
+  int rc = occlusion_sum(z, nx, ny, p->ao_directions, worker_count(p), vis);
+  float inv = 1.0f / (float)p->ao_directions;
+  for (size_t i = 0; i < n; ++i)
+    vis[i] = 1.0f - vis[i] * inv;
+  free(z);
+  return rc;
+}
+
+/* ---------------- Hillshade and compositing ---------------- */
+
+/** \brief Hypsometric colour stops: lowland green to rock and snow. */
+static const struct {
+  double t;
+  double r, g, b;
+} TINT[] = {
+    {0.00, 0.18, 0.38, 0.22}, {0.25, 0.45, 0.62, 0.32},
+    {0.50, 0.80, 0.76, 0.52}, {0.72, 0.62, 0.48, 0.33},
+    {0.88, 0.70, 0.68, 0.66}, {1.00, 0.97, 0.97, 0.98},
+};
+
+static void tint(double t, double *r, double *g, double *b) {
+  t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+  int k = 1;
+  int nstops = (int)(sizeof(TINT) / sizeof(TINT[0]));
+  while (k < nstops - 1 && t > TINT[k].t)
+    ++k;
+  double u = (t - TINT[k - 1].t) / (TINT[k].t - TINT[k - 1].t);
+  *r = TINT[k - 1].r + u * (TINT[k].r - TINT[k - 1].r);
+  *g = TINT[k - 1].g + u * (TINT[k].g - TINT[k - 1].g);
+  *b = TINT[k - 1].b + u * (TINT[k].b - TINT[k - 1].b);
+}
+
+void relief_hypsometric(double t, unsigned char rgb[3]) {
+  double r, g, b;
+  tint(t, &r, &g, &b);
+  rgb[0] = (unsigned char)(r * 255.0 + 0.5);
+  rgb[1] = (unsigned char)(g * 255.0 + 0.5);
+  rgb[2] = (unsigned char)(b * 255.0 + 0.5);
+}
+
+/** \brief Shared state of the banded shading pass. */
+typedef struct {
+  const double *h;
+  int nx, ny;
+  double zs;         /* cells per height unit */
+  double lx, ly, lz; /* unit vector towards the sun */
+  double mn, inv;    /* height normalization for tinting */
+  const ReliefParams *p;
+  const float *vis; /* NULL: no occlusion */
+  double *grad;     /* per thread: 2 * (BAND_ROWS + 2) * nx */
+  float *shade;     /* output of relief_hillshade, or NULL */
+  unsigned char *rgb; /* output of relief_render, or NULL */
+} ShadeCtx;
+
+/** \brief Shade rows [band*BAND_ROWS, +BAND_ROWS); gradients come from
+ * compute_deflection on the band plus one halo row each side, which gives
+ * the same values as a whole-grid call. */
+static void shade_band(void *ctx, int band, int thread) {
+  ShadeCtx *c = (ShadeCtx *)ctx;
+  int nx = c->nx;
+  int y0 = band * BAND_ROWS;
+  int y1 = y0 + BAND_ROWS < c->ny ? y0 + BAND_ROWS : c->ny;
+  int g0 = y0 > 0 ? y0 - 1 : 0;
+  int g1 = y1 < c->ny ? y1 + 1 : c->ny;
+  double *dx = c->grad + (size_t)thread * 2 * (BAND_ROWS + 2) * nx;
+  double *dy = dx + (size_t)(BAND_ROWS + 2) * nx;
+  compute_deflection(c->h + (size_t)g0 * nx, nx, g1 - g0, dx, dy);
+  double ambient = c->p->ambient, strength = c->p->ao_strength;
+  for (int y = y0; y < y1; ++y) {
+    const double *gx = dx + (size_t)(y - g0) * nx;
+    const double *gy = dy + (size_t)(y - g0) * nx;
+    for (int x = 0; x < nx; ++x) {
+      size_t i = (size_t)y * nx + x;
+      /* normal (-gx, -gy, 1) / |.| dotted with the sun vector */
+      double sx = gx[x] * c->zs, sy = gy[x] * c->zs;
+      double lit = (c->lz - sx * c->lx - sy * c->ly) /
+                   sqrt(sx * sx + sy * sy + 1.0);
+      lit = lit > 0.0 ? lit : 0.0;
+      if (c->shade)
+        c->shade[i] = (float)lit;
+      if (!c->rgb)
+        continue;
+      double light = ambient + (1.0 - ambient) * lit;
+      if (c->vis)
+        light *= 1.0 - strength * (1.0 - c->vis[i]);
+      double r = 1.0, g = 1.0, b = 1.0;
+      if (c->p->hypsometric)
+        tint((c->h[i] - c->mn) * c->inv, &r, &g, &b);
+      unsigned char *px = c->rgb + 3 * i;
+      px[0] = (unsigned char)(fmin(r * light, 1.0) * 255.0 + 0.5);
+      px[1] = (unsigned char)(fmin(g * light, 1.0) * 255.0 + 0.5);
+      px[2] = (unsigned char)(fmin(b * light, 1.0) * 255.0 + 0.5);
+    }
+  }
+}
+
+/** \brief Run the banded pass with the given outputs. */
+static int shade_pass(const double *h, int nx, int ny, const ReliefParams *p,
+                      const float *vis, float *shade, unsigned char *rgb) {
+  size_t n = (size_t)nx * ny;
+  int nt = worker_count(p);
+  ShadeCtx c;
+  double mn, mx;
+  height_range(h, n, &mn, &mx);
+  c.h = h;
+  c.nx = nx;
+  c.ny = ny;
+  c.zs = z_scale_for(p, nx, ny, mn, mx);
+  double az = p->azimuth * M_PI / 180.0, alt = p->altitude * M_PI / 180.0;
+  c.lx = sin(az) * cos(alt);
+  c.ly = -cos(az) * cos(alt); /* north is row 0 */
+  c.lz = sin(alt);
+  c.mn = mn;
+  c.inv = mx > mn ? 1.0 / (mx - mn) : 0.0;
+  c.p = p;
+  c.vis = vis;
+  c.shade = shade;
+  c.rgb = rgb;
+  c.grad = (double *)malloc((size_t)nt * 2 * (BAND_ROWS + 2) * nx *
+                            sizeof(double));
+  if (!c.grad)
+    return -1;
+  parallel_for((ny + BAND_ROWS - 1) / BAND_ROWS, nt, shade_band, &c);
+  free(c.grad);
+  return 0;
+}
+
+int relief_hillshade(const double *h, int nx, int ny, const ReliefParams *p,
+                     float *shade) {
+  if (!valid_input(h, nx, ny, p) || !shade)
+    return -1;
+  return shade_pass(h, nx, ny, p, NULL, shade, NULL);
+}
+
+int relief_render(const double *h, int nx, int ny, const ReliefParams *p,
+                  unsigned char *rgb) {
+  if (!valid_input(h, nx, ny, p) || !rgb)
+    return -1;
+  float *vis = NULL;
+  if (p->ao_directions > 0) {
+    vis = (float *)malloc((size_t)nx * ny * sizeof(float));
+    if (!vis || relief_ambient_occlusion(h, nx, ny, p, vis) != 0) {
+      free(vis);
+      return -1;
+    }
+  }
+  int rc = shade_pass(h, nx, ny, p, vis, NULL, rgb);
+  free(vis);
+  return rc;
+}
+
+int write_relief_ppm(const char *filename, const double *h, int nx, int ny,
+                     const ReliefParams *p) {
+  ReliefParams def;
+  if (!p) {
+    relief_default_params(&def);
+    p = &def;
+  }
+  if (nx < 1 || ny < 1)
+    return 0;
+  unsigned char *rgb = (unsigned char *)malloc((size_t)nx * ny * 3);
+  if (!rgb)
+    return 0;
+  int ok = relief_render(h, nx, ny, p, rgb) == 0 &&
+           write_rgb_ppm(filename, rgb, nx, ny);
+  free(rgb);
+  return ok;
+}
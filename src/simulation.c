@@ -4,11 +4,13 @@
  * field, and tiny MLP.
  */
 #include "simulation.h"
+#include "reduce.h"
 #include <math.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <time.h>
 
 #ifdef _MSC_VER
@@ -191,12 +193,20 @@ int fbm_diamond_square(double *f, int N, double H, unsigned seed) {
   return 0;
 }
 
-/** Write field as grayscale PPM (auto normalize). */
-int write_field_ppm(const char *filename, const double *field, int nx, int ny) {
+/** Write packed RGB bytes as a binary PPM. */
+int write_rgb_ppm(const char *filename, const unsigned char *rgb, int nx,
+                  int ny) {
   FILE *fp = fopen(filename, "wb");
   if (!fp)
     return 0;
   fprintf(fp, "P6\n%d %d\n255\n", nx, ny);
+  size_t bytes = (size_t)nx * ny * 3;
+  int ok = fwrite(rgb, 1, bytes, fp) == bytes;
+  return fclose(fp) == 0 && ok;
+}
+
+/** Write field as grayscale PPM (auto normalize). */
+int write_field_ppm(const char *filename, const double *field, int nx, int ny) {
   double mn = 1e9, mx = -1e9;
   int N = nx * ny;
   for (int i = 0; i < N; ++i) {
@@ -205,16 +215,49 @@ int write_field_ppm(const char *filename, const double *field, int nx, int ny) {
     if (field[i] > mx)
       mx = field[i];
   }
+  unsigned char *rgb = (unsigned char *)malloc((size_t)N * 3);
+  if (!rgb)
+    return 0;
   double inv = (mx > mn) ? 1.0 / (mx - mn) : 1.0;
   for (int i = 0; i < N; ++i) {
     double v = (field[i] - mn) * inv;
     unsigned char g = (unsigned char)(v * 255.0 + 0.5);
-    unsigned char rgb[3] = {g, g, g};
-    fwrite(rgb, 1, 3, fp);
+    rgb[3 * i] = rgb[3 * i + 1] = rgb[3 * i + 2] = g;
+  }
+  int ok = write_rgb_ppm(filename, rgb, nx, ny);
+  free(rgb);
+  return ok;
+}
+typedef struct {
+  const double *field;
+  int nx;
+  double min_val, mean_val, range;
+} RaytraceCtx;
+
+/** \brief Transmission and scattering of the rays in sampled rows
+ * [begin, end) (every 2nd row and column). */
+static void raytrace_rows(void *ctx, size_t begin, size_t end,
+                          double *partial) {
+  const RaytraceCtx *r = (const RaytraceCtx *)ctx;
+  for (size_t row = begin; row < end; ++row) {
+    const double *line = r->field + 2 * row * (size_t)r->nx;
+    for (int x = 0; x < r->nx; x += 2) {
+      double height = line[x];
+
+      /* Normalize height to absorption coefficient [0,1] */
+      double absorption_coeff = (height - r->min_val) / (r->range + 1e-9);
+
+      /* Beer-Lambert: I = I0 * exp(-μt) where μ is absorption, t is thickness */
+      double path_length = fabs(height - r->mean_val) + 0.1;  /* Add baseline thickness */
+      double transmission = exp(-absorption_coeff * path_length);
+      double scattering = absorption_coeff * (1.0 - transmission);
+
+      partial[0] += transmission;
+      partial[1] += scattering;
+    }
   }
-  fclose(fp);
-  return 1;
 }
+
 /** \brief Forward raytrace simulation through 2D scalar field.
  *
  * Simulates rays propagating through a 2D heightfield, computing
@@ -229,44 +272,27 @@ void forward_raytrace(const double *field, int nx, int ny) {
   }
   
   /* Find field statistics for normalization */
-  double min_val = field[0], max_val = field[0];
-  double sum = 0.0;
-  for (int i = 0; i < nx * ny; i++) {
-    if (field[i] < min_val) min_val = field[i];
-    if (field[i] > max_val) max_val = field[i];
-    sum += field[i];
-  }
-  double mean_val = sum / (nx * ny);
+  ReduceStats st;
+  if (reduce_stats(field, (size_t)nx * ny, 0, &st) != 0)
+    return;
+  double min_val = st.min, max_val = st.max;
+  double mean_val = st.sum / (nx * ny);
   double range = max_val - min_val;
   
-  /* Simulate forward raytracing with Beer-Lambert law approximation */
-  double total_transmission = 0.0;
-  double total_scattering = 0.0;
-  int rays_traced = 0;
-  
-  /* Sample rays across the field */
-  for (int y = 0; y < ny; y += 2) {  /* Sample every 2nd row for efficiency */
-    for (int x = 0; x < nx; x += 2) {  /* Sample every 2nd column */
-      int idx = y * nx + x;
-      double height = field[idx];
-      
-      /* Normalize height to absorption coefficient [0,1] */
-      double absorption_coeff = (height - min_val) / (range + 1e-9);
-      
-      /* Beer-Lambert: I = I0 * exp(-μt) where μ is absorption, t is thickness */
-      double path_length = fabs(height - mean_val) + 0.1;  /* Add baseline thickness */
-      double transmission = exp(-absorption_coeff * path_length);
-      double scattering = absorption_coeff * (1.0 - transmission);
-      
-      total_transmission += transmission;
-      total_scattering += scattering;
-      rays_traced++;
-    }
-  }
+  /* Simulate forward raytracing with Beer-Lambert law approximation, sampling
+   * every 2nd row and column; chunks hold whole rows */
+  int rows = (ny + 1) / 2, cols = (nx + 1) / 2;
+  int rays_traced = rows * cols;
+  RaytraceCtx rc = {field, nx, min_val, mean_val, range};
+  double totals[2];
+  size_t rows_per_chunk = REDUCE_CHUNK / cols ? REDUCE_CHUNK / cols : 1;
+  if (reduce_chunks((size_t)rows, rows_per_chunk, 2, NULL, 0, raytrace_rows,
+                    &rc, totals) != 0)
+    return;
   
   if (rays_traced > 0) {
-    double avg_transmission = total_transmission / rays_traced;
-    double avg_scattering = total_scattering / rays_traced;
+    double avg_transmission = totals[0] / rays_traced;
+    double avg_scattering = totals[1] / rays_traced;
     
     printf("[sim] forward_raytrace: %dx%d field, %d rays\n", nx, ny, rays_traced);
     printf("      avg transmission: %.4f, avg scattering: %.4f\n", 
@@ -275,6 +301,22 @@ void forward_raytrace(const double *field, int nx, int ny) {
            min_val, max_val, mean_val);
   }
 }
+typedef struct {
+  const double *obs, *recon;
+} RetrieveCtx;
+
+/** \brief Reconstruction sum, residual sum and squared residual sum. */
+static void retrieve_metrics(void *ctx, size_t begin, size_t end,
+                             double *partial) {
+  const RetrieveCtx *r = (const RetrieveCtx *)ctx;
+  for (size_t i = begin; i < end; i++) {
+    double diff = r->recon[i] - r->obs[i];
+    partial[0] += r->recon[i];
+    partial[1] += diff;
+    partial[2] += diff * diff;
+  }
+}
+
 /** \brief Inverse retrieval using iterative regularized inversion.
  *
  * Reconstructs a field from observations using a simplified inverse
@@ -293,14 +335,11 @@ void inverse_retrieve(const double *obs, int n, double *recon) {
   }
   
   /* Compute observation statistics */
-  double obs_sum = 0.0, obs_sq_sum = 0.0;
-  double obs_min = obs[0], obs_max = obs[0];
-  for (int i = 0; i < n; i++) {
-    obs_sum += obs[i];
-    obs_sq_sum += obs[i] * obs[i];
-    if (obs[i] < obs_min) obs_min = obs[i];
-    if (obs[i] > obs_max) obs_max = obs[i];
-  }
+  ReduceStats st;
+  if (reduce_stats(obs, (size_t)n, 0, &st) != 0)
+    return;
+  double obs_sum = st.sum, obs_sq_sum = st.sum_sq;
+  double obs_min = st.min, obs_max = st.max;
   double obs_mean = obs_sum / n;
   double obs_var = (obs_sq_sum - obs_sum * obs_sum / n) / (n - 1);
   double obs_std = sqrt(fabs(obs_var));
@@ -345,13 +384,12 @@ void inverse_retrieve(const double *obs, int n, double *recon) {
   }
   
   /* Compute final reconstruction quality metrics */
-  double recon_sum = 0.0, diff_sum = 0.0, diff_sq_sum = 0.0;
-  for (int i = 0; i < n; i++) {
-    recon_sum += recon[i];
-    double diff = recon[i] - obs[i];
-    diff_sum += diff;
-    diff_sq_sum += diff * diff;
-  }
+  RetrieveCtx rc = {obs, recon};
+  double m[3];
+  if (reduce_chunks((size_t)n, REDUCE_CHUNK, 3, NULL, 0, retrieve_metrics, &rc,
+                    m) != 0)
+    return;
+  double recon_sum = m[0], diff_sum = m[1], diff_sq_sum = m[2];
   double recon_mean = recon_sum / n;
   double rms_error = sqrt(diff_sq_sum / n);
   double bias = diff_sum / n;
@@ -363,30 +401,125 @@ void inverse_retrieve(const double *obs, int n, double *recon) {
          recon_mean, rms_error, bias);
 }
 
-/** Jacobi iterations returning average absolute residual. */
+typedef struct {
+  double *phi;
+  const double *rhs;
+  double *next;
+  int nx;
+} JacobiCtx;
+
+/** \brief Jacobi update of interior rows 1+[begin, end), summing |change|. */
+static void jacobi_rows(void *ctx, size_t begin, size_t end,
+                        double *partial) {
+  const JacobiCtx *j = (const JacobiCtx *)ctx;
+  const double *phi = j->phi, *rhs = j->rhs;
+  int nx = j->nx;
+  double res = 0;
+  for (int y = (int)begin + 1; y < (int)end + 1; ++y) {
+    for (int x = 1; x < nx - 1; ++x) {
+      int i = y * nx + x;
+      double newv = 0.25 * (phi[i - 1] + phi[i + 1] + phi[i - nx] +
+                            phi[i + nx] - rhs[i]);
+      res += fabs(newv - phi[i]);
+      j->next[i] = newv;
+    }
+  }
+  partial[0] = res;
+}
+
+/** \brief One Jacobi iteration of jc->phi into jc->next and back; res
+ * receives the mean absolute change. Returns 0, or -1 on failure. */
+static int jacobi_sweep(JacobiCtx *jc, int ny, double *res) {
+  int nx = jc->nx;
+  size_t rows = ny > 2 ? (size_t)(ny - 2) : 0;
+  size_t rows_per_chunk = REDUCE_CHUNK / nx ? REDUCE_CHUNK / nx : 1;
+  if (reduce_chunks(rows, rows_per_chunk, 1, NULL, 0, jacobi_rows, jc, res) !=
+      0)
+    return -1;
+  memcpy(jc->phi + nx, jc->next + nx,
+         sizeof(double) * (nx * (ny - 2))); /* keep boundary */
+  *res /= (double)((nx - 2) * (ny - 2));
+  return 0;
+}
+
+/** Jacobi iterations returning average absolute residual. Rows are reduced
+ * in fixed chunks, so the residual does not depend on the thread count. */
 double poisson_jacobi(double *phi, const double *rhs, int nx, int ny,
                       int iters) {
   double *next = (double *)malloc(sizeof(double) * nx * ny);
   if (!next)
     return -1;
   memcpy(next, phi, sizeof(double) * nx * ny);
+  JacobiCtx jc = {phi, rhs, next, nx};
   double res = 0;
   for (int it = 0; it < iters; ++it) {
-    res = 0;
-    for (int y = 1; y < ny - 1; ++y) {
-      for (int x = 1; x < nx - 1; ++x) {
-        int i = y * nx + x;
-        double newv = 0.25 * (phi[i - 1] + phi[i + 1] + phi[i - nx] +
-                              phi[i + nx] - rhs[i]);
-        res += fabs(newv - phi[i]);
-        next[i] = newv;
-      }
+    if (jacobi_sweep(&jc, ny, &res) != 0) {
+      free(next);
+      return -1;
+    }
+  }
+  free(next);
+  return res;
+}
+
+#define TAG_PHI CHECKPOINT_TAG('P', 'H', 'I', ' ')
+#define TAG_RES CHECKPOINT_TAG('R', 'E', 'S', ' ')
+
+/** \brief Snapshot phi and the last residual after done iterations. */
+static void jacobi_snapshot(Checkpointer *ck, const uint64_t *key,
+                            const double *phi, size_t cells, double res,
+                            long done) {
+  CheckpointSection sec[3] = {{CHECKPOINT_TAG_KEY, key, 4 * sizeof(*key)},
+                              {TAG_PHI, phi, cells * sizeof(double)},
+                              {TAG_RES, &res, sizeof(res)}};
+  checkpoint_submit(ck, CHECKPOINT_KIND_POISSON, done, sec, 3);
+}
+
+/** Jacobi iterations resumable from ck's snapshots. */
+double poisson_jacobi_resume(double *phi, const double *rhs, int nx, int ny,
+                             int iters, Checkpointer *ck) {
+  if (!ck)
+    return poisson_jacobi(phi, rhs, nx, ny, iters);
+  size_t cells = (size_t)nx * ny;
+  /* the problem is the grid, rhs and the starting phi */
+  uint64_t key[4] = {(uint64_t)nx, (uint64_t)ny,
+                     checkpoint_hash(CHECKPOINT_HASH_INIT, rhs,
+                                     cells * sizeof(double)),
+                     checkpoint_hash(CHECKPOINT_HASH_INIT, phi,
+                                     cells * sizeof(double))};
+  long done = 0;
+  double res = 0;
+  CheckpointImage img;
+  if (checkpoint_resume(ck, CHECKPOINT_KIND_POISSON, key, sizeof(key),
+                        &img) == 0) {
+    size_t pb = 0, rb = 0;
+    const void *p = checkpoint_image_section(&img, TAG_PHI, &pb);
+    const void *r = checkpoint_image_section(&img, TAG_RES, &rb);
+    if (p && pb == cells * sizeof(double) && r && rb == sizeof(res) &&
+        img.step <= iters) {
+      memcpy(phi, p, pb);
+      memcpy(&res, r, rb);
+      done = img.step;
     }
-    memcpy(phi + nx, next + nx,
-           sizeof(double) * (nx * (ny - 2))); /* keep boundary */
-    res /= (double)((nx - 2) * (ny - 2));
+    checkpoint_image_free(&img);
+  }
+  double *next = (double *)malloc(sizeof(double) * cells);
+  if (!next)
+    return -1;
+  memcpy(next, phi, sizeof(double) * cells);
+  JacobiCtx jc = {phi, rhs, next, nx};
+  while (done < iters) {
+    if (jacobi_sweep(&jc, ny, &res) != 0) {
+      free(next);
+      return -1;
+    }
+    ++done;
+    if (done < iters && checkpoint_due(ck, done))
+      jacobi_snapshot(ck, key, phi, cells, res, done);
   }
   free(next);
+  jacobi_snapshot(ck, key, phi, cells, res, done);
+  checkpoint_flush(ck);
   return res;
 }
 
@@ -453,6 +586,8 @@ int mlp_init(MLP *m, int in_dim, int hid_dim, int out_dim, unsigned seed) {
   m->in_dim = in_dim;
   m->hid_dim = hid_dim;
   m->out_dim = out_dim;
+  m->mapping = NULL;
+  m->mapping_size = 0;
   size_t n1 = (size_t)in_dim * hid_dim;
   size_t n2 = (size_t)hid_dim * out_dim;
   m->w1 = (double *)malloc(sizeof(double) * n1);
@@ -472,6 +607,11 @@ int mlp_init(MLP *m, int in_dim, int hid_dim, int out_dim, unsigned seed) {
 void mlp_free(MLP *m) {
   if (!m)
     return;
+  if (m->mapping) {
+    munmap(m->mapping, m->mapping_size);
+    memset(m, 0, sizeof(*m));
+    return;
+  }
   free(m->w1);
   free(m->b1);
   free(m->w2);
@@ -0,0 +1,382 @@
+/**
+ * \file slot_sorter.c
+ * \brief Sorter slot error matrices (quadrature and Monte Carlo) and the
+ * threaded slot designation search.
+ */
+#include "slot_sorter.h"
+#include "parallel.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MASS_NODES 48    /* Simpson intervals over +-6 sd of the mass */
+#define SCAN_POINTS 256  /* coarse scan per width before golden section */
+#define MC_BLOCK 256     /* Monte Carlo draws per vector block */
+
+int slot_default_dists(const CoinSystem *sys, SlotCoinDist *dists) {
+  if (!sys || !dists)
+    return -1;
+  for (size_t i = 0; i < sys->ncoins; ++i) {
+    const CoinSpec *c = &sys->coins[i];
+    if (!(c->diameter_mm > 0.0))
+      return -1;
+    dists[i].diameter_mm = c->diameter_mm;
+    dists[i].diameter_sd_mm = 0.05;
+    dists[i].mass_g = c->mass_g > 0.0 ? c->mass_g : 0.0;
+    dists[i].mass_mean_g = 0.99 * dists[i].mass_g;
+    dists[i].mass_sd_g = 0.01 * dists[i].mass_g;
+    dists[i].weight = 1.0;
+  }
+  return 0;
+}
+
+static double normal_cdf(double x) { return 0.5 * erfc(-x * M_SQRT1_2); }
+
+/** \brief P(X * s < w) for the mint diameter X. */
+static double blank_cdf(const SlotCoinDist *d, double w, double s) {
+  if (!(s > 0.0))
+    return 1.0; /* worn away */
+  double x = w / s;
+  if (!(d->diameter_sd_mm > 0.0))
+    return x > d->diameter_mm ? 1.0 : 0.0;
+  return normal_cdf((x - d->diameter_mm) / d->diameter_sd_mm);
+}
+
+double slot_pass_cdf(const SlotCoinDist *d, double width) {
+  if (!d || !(width > 0.0))
+    return 0.0;
+  if (isinf(width))
+    return 1.0;
+  if (!(d->mass_g > 0.0))
+    return blank_cdf(d, width, 1.0);
+  if (!(d->mass_sd_g > 0.0))
+    return blank_cdf(d, width, sqrt(fmax(d->mass_mean_g, 0.0) / d->mass_g));
+  /* composite Simpson over z in [-6, 6], renormalized for the truncation */
+  double h = 12.0 / MASS_NODES, sum = 0.0, wsum = 0.0;
+  for (int i = 0; i <= MASS_NODES; ++i) {
+    double z = -6.0 + i * h;
+    double w = (i == 0 || i == MASS_NODES) ? 1.0 : (i & 1) ? 4.0 : 2.0;
+    w *= exp(-0.5 * z * z);
+    double m = d->mass_mean_g + d->mass_sd_g * z;
+    sum += w * blank_cdf(d, width, sqrt(fmax(m, 0.0) / d->mass_g));
+    wsum += w;
+  }
+  return sum / wsum;
+}
+
+/** \brief Delta-method mean and spread of the passing diameter (search
+ * ranges and ordering only). */
+static void effective_moments(const SlotCoinDist *d, double *mu,
+                              double *sd) {
+  double r = d->mass_g > 0.0 ? fmax(d->mass_mean_g, 0.0) / d->mass_g : 1.0;
+  double dr = d->mass_g > 0.0 ? d->mass_sd_g / d->mass_g : 0.0;
+  double s = sqrt(r);
+  *mu = d->diameter_mm * s;
+  double wear = s > 0.0 ? d->diameter_mm * dr / (2.0 * s) : 0.0;
+  *sd = sqrt(d->diameter_sd_mm * d->diameter_sd_mm * r + wear * wear);
+}
+
+static int valid_dists(const SlotCoinDist *d, size_t n) {
+  for (size_t i = 0; i < n; ++i)
+    if (!(d[i].diameter_mm > 0.0) || !(d[i].diameter_sd_mm >= 0.0) ||
+        !(d[i].mass_g >= 0.0) || !(d[i].mass_sd_g >= 0.0) ||
+        !(d[i].weight >= 0.0))
+      return 0;
+  return 1;
+}
+
+static int valid_widths(const double *width, int nslots) {
+  for (int s = 0; s + 1 < nslots; ++s)
+    if (!(width[s] > 0.0) || (s > 0 && !(width[s] >= width[s - 1])))
+      return 0;
+  return 1;
+}
+
+int slot_error_matrix(const SlotCoinDist *dists, size_t n,
+                      const double *width, int nslots, double *error) {
+  if (!dists || !width || !error || nslots < 1 || !valid_dists(dists, n) ||
+      !valid_widths(width, nslots))
+    return -1;
+  for (size_t c = 0; c < n; ++c) {
+    double prev = 0.0;
+    for (int s = 0; s < nslots; ++s) {
+      double f = s + 1 < nslots ? slot_pass_cdf(&dists[c], width[s]) : 1.0;
+      error[c * nslots + s] = f - prev;
+      prev = f;
+    }
+  }
+  return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Monte Carlo                                                              */
+/* ---------------------------------------------------------------------- */
+
+static inline uint64_t splitmix64(uint64_t *s) {
+  uint64_t z = (*s += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+static inline double unit(uint64_t *s) {
+  return ((double)(splitmix64(s) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+int slot_error_matrix_mc(const SlotCoinDist *dists, size_t n,
+                         const double *width, int nslots, long samples,
+                         unsigned seed, double *error) {
+  if (!dists || !width || !error || nslots < 1 || samples < 1 ||
+      !valid_dists(dists, n) || !valid_widths(width, nslots))
+    return -1;
+  double z1[MC_BLOCK], z2[MC_BLOCK], dia[MC_BLOCK];
+  long *below = (long *)malloc((size_t)nslots * sizeof(long));
+  if (!below)
+    return -1;
+  for (size_t c = 0; c < n; ++c) {
+    const SlotCoinDist *d = &dists[c];
+    uint64_t st = ((uint64_t)seed << 32) ^ (uint64_t)c;
+    double inv_m = d->mass_g > 0.0 ? 1.0 / d->mass_g : 0.0;
+    memset(below, 0, (size_t)nslots * sizeof(long));
+    for (long done = 0; done < samples; done += MC_BLOCK) {
+      int nb = samples - done < MC_BLOCK ? (int)(samples - done) : MC_BLOCK;
+      for (int i = 0; i < nb; ++i) { /* Box-Muller pair per draw */
+        double r = sqrt(-2.0 * log(unit(&st))), t = 2.0 * M_PI * unit(&st);
+        z1[i] = r * cos(t);
+        z2[i] = r * sin(t);
+      }
+      for (int i = 0; i < nb; ++i) {
+        double x = d->diameter_mm + d->diameter_sd_mm * z1[i];
+        double m = d->mass_mean_g + d->mass_sd_g * z2[i];
+        double s = inv_m > 0.0 ? sqrt(fmax(m, 0.0) * inv_m) : 1.0;
+        dia[i] = x * s;
+      }
+      for (int s = 0; s + 1 < nslots; ++s) {
+        long k = 0;
+        for (int i = 0; i < nb; ++i)
+          k += dia[i] < width[s];
+        below[s] += k;
+      }
+    }
+    below[nslots - 1] = samples;
+    long prev = 0;
+    for (int s = 0; s < nslots; ++s) {
+      error[c * nslots + s] = (double)(below[s] - prev) / (double)samples;
+      prev = below[s];
+    }
+  }
+  free(below);
+  return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Designation search                                                       */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+  const SlotCoinDist *d;
+  const size_t *order; /* coins by ascending effective diameter */
+  const double *mu, *sd;
+  size_t n;
+  int k;
+  const int *cuts;     /* per candidate: k-1 group starts in order[] */
+  double *widths;      /* per candidate: k widths */
+  double *score;       /* per candidate: weighted misroutes */
+} SearchCtx;
+
+/** \brief Width term g(w): flow of the upper group already through minus
+ * flow of the lower group already through at w (lower is better). */
+static double width_cost(const SearchCtx *c, size_t lo, size_t mid,
+                         size_t hi, double w) {
+  double g = 0.0;
+  for (size_t i = lo; i < hi; ++i) {
+    const SlotCoinDist *d = &c->d[c->order[i]];
+    double f = d->weight * slot_pass_cdf(d, w);
+    g += i < mid ? -f : f;
+  }
+  return g;
+}
+
+/** \brief Best width between groups order[lo..mid) and order[mid..hi). */
+static double best_width(const SearchCtx *c, size_t lo, size_t mid,
+                         size_t hi) {
+  double a = INFINITY, b = -INFINITY;
+  for (size_t i = lo; i < hi; ++i) {
+    size_t k = c->order[i];
+    a = fmin(a, c->mu[k] - 6.0 * c->sd[k]);
+    b = fmax(b, c->mu[k] + 6.0 * c->sd[k]);
+  }
+  a = fmax(a, 1e-6);
+  double step = (b - a) / (SCAN_POINTS - 1), best = a;
+  double gbest = width_cost(c, lo, mid, hi, a);
+  for (int j = 1; j < SCAN_POINTS; ++j) {
+    double w = a + j * step, g = width_cost(c, lo, mid, hi, w);
+    if (g < gbest) {
+      gbest = g;
+      best = w;
+    }
+  }
+  /* golden section around the coarse minimum */
+  const double phi = 0.6180339887498949;
+  double x0 = fmax(best - step, a), x1 = fmin(best + step, b);
+  double p = x1 - phi * (x1 - x0), q = x0 + phi * (x1 - x0);
+  double gp = width_cost(c, lo, mid, hi, p), gq = width_cost(c, lo, mid, hi, q);
+  for (int it = 0; it < 40; ++it) {
+    if (gp <= gq) {
+      x1 = q;
+      q = p;
+      gq = gp;
+      p = x1 - phi * (x1 - x0);
+      gp = width_cost(c, lo, mid, hi, p);
+    } else {
+      x0 = p;
+      p = q;
+      gp = gq;
+      q = x0 + phi * (x1 - x0);
+      gq = width_cost(c, lo, mid, hi, q);
+    }
+  }
+  double w = 0.5 * (x0 + x1);
+  return width_cost(c, lo, mid, hi, w) <= gbest ? w : best;
+}
+
+static void search_candidate(void *ctx, int task, int thread) {
+  (void)thread;
+  SearchCtx *c = (SearchCtx *)ctx;
+  int k = c->k;
+  const int *cut = c->cuts + (size_t)task * (k > 1 ? k - 1 : 1);
+  double *w = c->widths + (size_t)task * k;
+  for (int s = 0; s + 1 < k; ++s) {
+    size_t lo = s > 0 ? (size_t)cut[s - 1] : 0, mid = (size_t)cut[s];
+    size_t hi = s + 2 < k ? (size_t)cut[s + 1] : c->n;
+    w[s] = best_width(c, lo, mid, hi);
+    /* widths of badly overlapping neighbours may cross; keep them sorted */
+    if (s > 0 && w[s] < w[s - 1])
+      w[s] = w[s - 1];
+  }
+  w[k - 1] = INFINITY;
+  double miss = 0.0;
+  for (int s = 0; s < k; ++s) {
+    size_t lo = s > 0 ? (size_t)cut[s - 1] : 0;
+    size_t hi = s + 1 < k ? (size_t)cut[s] : c->n;
+    for (size_t i = lo; i < hi; ++i) {
+      const SlotCoinDist *d = &c->d[c->order[i]];
+      double in = slot_pass_cdf(d, w[s]) -
+                  (s > 0 ? slot_pass_cdf(d, w[s - 1]) : 0.0);
+      miss += d->weight * (1.0 - in);
+    }
+  }
+  c->score[task] = miss;
+}
+
+/** \brief Advance cut positions (ascending, in 1..n-1) to the next
+ * combination; returns 0 after the last. */
+static int next_cuts(int *cut, int m, int n) {
+  int i = m - 1;
+  while (i >= 0 && cut[i] == n - m + i)
+    --i;
+  if (i < 0)
+    return 0;
+  ++cut[i];
+  for (int j = i + 1; j < m; ++j)
+    cut[j] = cut[j - 1] + 1;
+  return 1;
+}
+
+void slot_plan_free(SlotPlan *plan) {
+  if (!plan)
+    return;
+  free(plan->width);
+  free(plan->target);
+  free(plan->error);
+  memset(plan, 0, sizeof(*plan));
+}
+
+int slot_plan_optimize(const CoinSystem *sys, const SlotCoinDist *dists,
+                       int nslots, int threads, SlotPlan *plan) {
+  if (!sys || !plan || sys->ncoins == 0 || sys->ncoins > 64)
+    return -1;
+  memset(plan, 0, sizeof(*plan));
+  size_t n = sys->ncoins;
+  int k = nslots > 0 ? nslots : (int)n;
+  if ((size_t)k > n)
+    return -1;
+  SlotCoinDist own[64];
+  if (!dists) {
+    if (slot_default_dists(sys, own) != 0)
+      return -1;
+    dists = own;
+  }
+  if (!valid_dists(dists, n))
+    return -1;
+
+  /* candidates: every choice of k-1 cuts among the n-1 gaps */
+  double ncand_d = 1.0;
+  for (int i = 0; i < k - 1; ++i)
+    ncand_d = ncand_d * (double)(n - 1 - i) / (double)(i + 1);
+  if (ncand_d > 1e6)
+    return -1;
+  size_t ncand = (size_t)(ncand_d + 0.5), m = k > 1 ? (size_t)k - 1 : 1;
+  size_t order[64];
+  double mu[64], sd[64], total = 0.0;
+  int *cuts = (int *)malloc(ncand * m * sizeof(int));
+  double *widths = (double *)malloc(ncand * (size_t)k * sizeof(double));
+  double *score = (double *)malloc(ncand * sizeof(double));
+  plan->width = (double *)malloc((size_t)k * sizeof(double));
+  plan->target = (int *)malloc(n * sizeof(int));
+  plan->error = (double *)malloc(n * (size_t)k * sizeof(double));
+  if (!cuts || !widths || !score || !plan->width || !plan->target ||
+      !plan->error) {
+    free(cuts);
+    free(widths);
+    free(score);
+    slot_plan_free(plan);
+    return -1;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    effective_moments(&dists[i], &mu[i], &sd[i]);
+    total += dists[i].weight;
+    /* insertion sort by passing diameter, stable on system order */
+    size_t j = i;
+    while (j > 0 && mu[order[j - 1]] > mu[i]) {
+      order[j] = order[j - 1];
+      --j;
+    }
+    order[j] = i;
+  }
+  int cut[64];
+  for (int i = 0; i < k - 1; ++i)
+    cut[i] = i + 1;
+  for (size_t ci = 0; ci < ncand; ++ci) {
+    memcpy(cuts + ci * m, cut, (size_t)(k - 1) * sizeof(int));
+    next_cuts(cut, k - 1, (int)n);
+  }
+
+  SearchCtx ctx = {dists, order, mu, sd, n, k, cuts, widths, score};
+  parallel_for((int)ncand, threads, search_candidate, &ctx);
+  size_t best = 0;
+  for (size_t ci = 1; ci < ncand; ++ci)
+    if (score[ci] < score[best])
+      best = ci;
+
+  plan->ncoins = n;
+  plan->nslots = k;
+  plan->candidates = ncand;
+  memcpy(plan->width, widths + best * k, (size_t)k * sizeof(double));
+  for (int s = 0; s < k; ++s) {
+    size_t lo = s > 0 ? (size_t)cuts[best * m + s - 1] : 0;
+    size_t hi = s + 1 < k ? (size_t)cuts[best * m + s] : n;
+    for (size_t i = lo; i < hi; ++i)
+      plan->target[order[i]] = s;
+  }
+  slot_error_matrix(dists, n, plan->width, k, plan->error);
+  double miss = 0.0;
+  for (size_t c = 0; c < n; ++c)
+    miss += dists[c].weight * (1.0 - plan->error[c * k + plan->target[c]]);
+  plan->misroute = total > 0.0 ? miss / total : 0.0;
+  free(cuts);
+  free(widths);
+  free(score);
+  return 0;
+}
@@ -1,18 +1,44 @@
+#include "arrow_ipc.h"
 #include "beta.h"
+#include "big_alloc.h"
 #include "casimir.h"
 #include "coins.h"
 #include "color.h"
 #include "env.h"
+#include "fdtd.h"
+#include "field_codec.h"
+#include "relief.h"
 #include "simulation.h"
 #include "version.h"
 #include "physics_framework.h"
 #include "physics_components.h"
+#include "material_tables.h"
+#include <fcntl.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-static void physics_block(void) {
+/** Write one record batch of nrows rows as an Arrow IPC stream file. */
+static int write_arrow_file(const char *path, const ArrowField *fields,
+                            int nfields, int64_t nrows,
+                            const ArrowColumn *cols) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return -1;
+  ArrowWriter *w = arrow_writer_open(fd, fields, nfields);
+  int rc = w ? arrow_writer_batch(w, nrows, cols) : -1;
+  if (w && arrow_writer_close(w) != 0)
+    rc = -1;
+  if (close(fd) != 0)
+    rc = -1;
+  return rc;
+}
+
+/** phi^4 couplings and the Casimir angle sweep (to casimir_sweep.arrows
+ * instead of stdout when arrow is set). */
+static void physics_block(int arrow) {
   printf("=== phi^4 RG ===\n");
   printf("beta1=%.12e\n", beta1());
   printf("beta2=%.12e\n", beta2());
@@ -21,10 +47,24 @@ static void physics_block(void) {
   double R = 5e-6, d = 10e-9, T = 4.0, ani = 5.0;
   double F0 = casimir_base(R, d);
   double Fth = casimir_thermal(R, d, T);
-  for (int deg = 0; deg <= 180; deg += 30) {
+  int32_t angle[7];
+  double force[7];
+  int n = 0;
+  for (int deg = 0; deg <= 180; deg += 30, ++n) {
     double th = deg * M_PI / 180.0;
-    double Fm = casimir_modulated(F0, Fth, ani, th);
-    printf("%3d %.6e\n", deg, Fm);
+    angle[n] = deg;
+    force[n] = casimir_modulated(F0, Fth, ani, th);
+    if (!arrow)
+      printf("%3d %.6e\n", deg, force[n]);
+  }
+  if (arrow) {
+    static const ArrowField fields[2] = {{"angle_deg", ARROW_INT32, 0},
+                                         {"force_N", ARROW_FLOAT64, 0}};
+    const ArrowColumn cols[2] = {{angle, NULL, NULL}, {force, NULL, NULL}};
+    if (write_arrow_file("casimir_sweep.arrows", fields, 2, n, cols) == 0)
+      printf("[arrow] %d rows -> casimir_sweep.arrows\n", n);
+    else
+      fputs("[arrow] cannot write casimir_sweep.arrows\n", stderr);
   }
   puts("");
 }
@@ -104,17 +144,51 @@ static void simulation_block(void) {
   free(f);
 }
 
+/** 10 GHz pulse scattered by the largest coin of the system (1 mm cells). */
+static void fdtd_block(const CoinSystem *cs) {
+  FdtdGrid *g = fdtd_create(256, 256, 1e-3, 16);
+  if (!g || !cs || fdtd_add_coin(g, &cs->coins[0], 0.150, 0.128) != 0) {
+    fputs("[fdtd] setup failed\n", stderr);
+    fdtd_destroy(g);
+    return;
+  }
+  fdtd_add_source(g, 80, 128, 10e9, 1.0);
+  int behind = fdtd_add_probe(g, 200, 128);
+  double peak = 0.0;
+  for (int k = 0; k < 20; ++k) {
+    fdtd_run(g, 50, 0);
+    double e = fdtd_energy(g, NULL);
+    peak = e > peak ? e : peak;
+  }
+  double freq[1024], amp[1024];
+  size_t bins = fdtd_probe_spectrum(g, behind, freq, amp, 1024);
+  size_t best = 0;
+  for (size_t k = 1; k < bins; ++k)
+    if (amp[k] > amp[best])
+      best = k;
+  printf("[fdtd] %s behind %s: peak energy %.3e J/m, left %.3e J/m, "
+         "probe peak %.2f GHz\n",
+         cs->system_name, cs->coins[0].code, peak, fdtd_energy(g, NULL),
+         bins ? freq[best] * 1e-9 : 0.0);
+  fdtd_destroy(g);
+}
+
 int main(int argc, char **argv) {
   color_init();
   int do_phys = 0, do_sim = 0, do_unified = 0;
   int fbm_size = 129; /* 2^7+1 default */
   double fbm_H = 0.5;
   int save_fbm = 0;
+  const char *field_out = NULL, *field_in = NULL;
+  double field_err = 0.0; /* 0 => lossless */
   int do_poisson = 0;
   int do_vectors = 0;
+  int do_relief = 0;
+  int do_fdtd = 0;
   const char *system = "usd";
   int amount = 137;
   int json = 0;
+  int arrow = 0;
   int show_version = 0;
   OptimizeMode opt_mode = OPT_COUNT;
   int no_thermal = 0;
@@ -133,14 +207,35 @@ int main(int argc, char **argv) {
       fbm_size = atoi(argv[i] + 8);
     else if (!strncmp(argv[i], "fbmH=", 5))
       fbm_H = strtod(argv[i] + 5, NULL);
+    else if (!strncmp(argv[i], "fieldOut=", 9))
+      field_out = argv[i] + 9;
+    else if (!strncmp(argv[i], "fieldIn=", 8))
+      field_in = argv[i] + 8;
+    else if (!strncmp(argv[i], "fieldErr=", 9))
+      field_err = strtod(argv[i] + 9, NULL);
     else if (!strcmp(argv[i], "--fbm-ppm"))
       save_fbm = 1;
     else if (!strcmp(argv[i], "--poisson"))
       do_poisson = 1;
     else if (!strcmp(argv[i], "--vectors"))
       do_vectors = 1;
+    else if (!strcmp(argv[i], "--relief"))
+      do_relief = 1;
+    else if (!strcmp(argv[i], "--fdtd"))
+      do_fdtd = 1;
     else if (!strcmp(argv[i], "--json"))
       json = 1;
+    else if (!strncmp(argv[i], "--format=", 9)) {
+      const char *f = argv[i] + 9;
+      json = !strcmp(f, "json");
+      arrow = !strcmp(f, "arrow");
+      if (!json && !arrow && strcmp(f, "text")) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "Unknown format %s\n", f);
+        fputs(msg, stderr);
+        return 1;
+      }
+    }
     else if (!strcmp(argv[i], "--version"))
       show_version = 1;
     else if (!strcmp(argv[i], "--no-thermal"))
@@ -176,9 +271,17 @@ int main(int argc, char **argv) {
   }
   if (do_phys) {
     printf("%s", C_BOLD);
-    physics_block();
+    physics_block(arrow);
     printf("%sEnvironment:%s %s g=%.3f m/s^2  T=%.1fK  P=%.3fkPa\n", C_CYAN,
            C_RESET, env->name, env->g, env->temperature_K, env->pressure_kPa);
+    for (size_t m = 0; m < material_count(); ++m) {
+      const MaterialProperties *mp = get_material_by_index(m);
+      MaterialProperties at;
+      if (material_properties_at(mp, env->temperature_K, &at))
+        printf("  %-20s sigma=%.3e S/m  k=%6.1f W/(m K)  alpha=%.2e /K\n",
+               mp->material_class, at.electrical_conductivity,
+               at.thermal_conductivity, at.thermal_expansion_coeff);
+    }
     if (no_thermal)
       printf("%s[casimir]%s thermal contribution disabled\n", C_YELLOW,
              C_RESET);
@@ -256,10 +359,40 @@ int main(int argc, char **argv) {
       color_enabled = 0;
   }
   if (do_sim) {
+    /* a compressed field replaces the generated fBm */
+    double *loaded = NULL;
+    if (field_in) {
+      int lx = 0, ly = 0;
+      loaded = field_codec_read(field_in, &lx, &ly, NULL, 0);
+      if (!loaded || lx != ly || lx <= 3) {
+        fprintf(stderr, "fieldIn=%s: not a square compressed field\n",
+                field_in);
+        free(loaded);
+        return 1;
+      }
+      fbm_size = lx;
+    }
     /* If square fBm request */
     if (fbm_size > 3) {
-      double *fbm = (double *)malloc(sizeof(double) * fbm_size * fbm_size);
-      if (fbm_diamond_square(fbm, fbm_size, fbm_H, 0) == 0) {
+      /* large fields go on huge pages, first touched by the solver threads */
+      size_t field_bytes = sizeof(double) * fbm_size * fbm_size;
+      BigAllocInfo ai;
+      double *fbm = (double *)big_alloc(field_bytes, 0, 1, &ai);
+      if (ai.kind != BIG_ALLOC_HEAP) {
+        char amsg[128];
+        snprintf(amsg, sizeof(amsg),
+                 "[alloc] fields: %s, first touch by %d threads, %d NUMA "
+                 "nodes\n",
+                 big_alloc_kind_name(ai.kind), ai.touch_threads,
+                 ai.numa_nodes);
+        fputs(amsg, stderr);
+      }
+      if (loaded) {
+        memcpy(fbm, loaded, field_bytes);
+        free(loaded);
+        if (save_fbm)
+          write_field_ppm("fbm.ppm", fbm, fbm_size, fbm_size);
+      } else if (fbm_diamond_square(fbm, fbm_size, fbm_H, 0) == 0) {
         if (save_fbm)
           write_field_ppm("fbm.ppm", fbm, fbm_size, fbm_size);
       } else {
@@ -268,8 +401,12 @@ int main(int argc, char **argv) {
         if (save_fbm)
           write_field_ppm("fbm_noise.ppm", fbm, fbm_size, fbm_size);
       }
+      if (field_out &&
+          field_codec_write(field_out, fbm, fbm_size, fbm_size, field_err,
+                            0) != 0)
+        fprintf(stderr, "fieldOut=%s: write failed\n", field_out);
       if (do_poisson) {
-        double *rhs = (double *)calloc(fbm_size * fbm_size, sizeof(double));
+        double *rhs = (double *)big_alloc(field_bytes, 0, 1, NULL);
         /* simple rhs: laplacian of fbm approximation */
         for (int y = 1; y < fbm_size - 1; ++y) {
           for (int x = 1; x < fbm_size - 1; ++x) {
@@ -278,26 +415,31 @@ int main(int argc, char **argv) {
                      fbm[i + fbm_size];
           }
         }
-        double *phi = (double *)calloc(fbm_size * fbm_size, sizeof(double));
+        double *phi = (double *)big_alloc(field_bytes, 0, 1, NULL);
         double res = poisson_jacobi(phi, rhs, fbm_size, fbm_size, 200);
         char pmsg[128];
         snprintf(pmsg, sizeof(pmsg), "[poisson] residual=%.3e\n", res);
         fputs(pmsg, stderr);
         write_field_ppm("poisson_phi.ppm", phi, fbm_size, fbm_size);
-        free(rhs);
-        free(phi);
+        big_free(rhs, field_bytes);
+        big_free(phi, field_bytes);
       }
       if (do_vectors) {
-        double *dx = (double *)malloc(sizeof(double) * fbm_size * fbm_size);
-        double *dy = (double *)malloc(sizeof(double) * fbm_size * fbm_size);
+        double *dx = (double *)big_alloc(field_bytes, 0, 1, NULL);
+        double *dy = (double *)big_alloc(field_bytes, 0, 1, NULL);
         compute_deflection(fbm, fbm_size, fbm_size, dx, dy);
         write_field_with_vectors_ppm("fbm_vectors.ppm", fbm, dx, dy, fbm_size,
                                      fbm_size, 8);
-        free(dx);
-        free(dy);
+        big_free(dx, field_bytes);
+        big_free(dy, field_bytes);
       }
-      free(fbm);
+      if (do_relief && !write_relief_ppm("fbm_relief.ppm", fbm, fbm_size,
+                                         fbm_size, NULL))
+        fputs("[relief] render failed\n", stderr);
+      big_free(fbm, field_bytes);
     }
+    if (do_fdtd)
+      fdtd_block(get_coin_system(system));
     simulation_block();
   }
   const CoinSystem *cs = get_coin_system(system);
@@ -319,15 +461,27 @@ int main(int argc, char **argv) {
     greedy_make_change(cs, amount, counts);
   else
     dp_make_change(cs, amount, counts);
-  if (json) {
+  const char *strategy =
+      (opt_mode == OPT_MASS
+           ? "dp-mass"
+           : (opt_mode == OPT_DIAMETER
+                  ? "dp-diam"
+                  : (opt_mode == OPT_AREA ? "dp-area"
+                                          : (use_greedy ? "greedy" : "dp"))));
+  if (arrow) {
+    ArrowChangeBatch row;
+    ArrowColumn cols[ARROW_CHANGE_COLUMNS];
+    arrow_change_init(&row);
+    int rc = arrow_change_append(&row, cs, amount, counts, strategy);
+    arrow_change_columns(&row, cols);
+    if (rc == 0 && write_arrow_file("change.arrows", arrow_change_fields(),
+                                    ARROW_CHANGE_COLUMNS, 1, cols) == 0)
+      printf("[arrow] change result -> change.arrows\n");
+    else
+      fputs("[arrow] cannot write change.arrows\n", stderr);
+    arrow_change_free(&row);
+  } else if (json) {
     char buf[768];
-    const char *strategy =
-        (opt_mode == OPT_MASS
-             ? "dp-mass"
-             : (opt_mode == OPT_DIAMETER
-                    ? "dp-diam"
-                    : (opt_mode == OPT_AREA ? "dp-area"
-                                            : (use_greedy ? "greedy" : "dp"))));
     if (format_change_json(cs, amount, counts, strategy, COINSORTER_VERSION_STR,
                            buf, sizeof(buf)) == 0)
       puts(buf);
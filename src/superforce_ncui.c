@@ -6,6 +6,7 @@
 #include "coins.h"
 #include "env.h"
 #include "observables.h"
+#include "reduce.h"
 #include "simulation.h"
 #include "version.h"
 #include <curses.h>
@@ -271,6 +272,21 @@ static void run_poisson(App *A, WINDOW *w_sim) {
   free(rhs);
 }
 
+typedef struct {
+  const double *dx, *dy;
+  int n;
+} EnergyCtx;
+
+/** \brief Sum energy density over interior rows 1+[begin, end). */
+static void energy_rows(void *ctx, size_t begin, size_t end, double *partial) {
+  const EnergyCtx *e = (const EnergyCtx *)ctx;
+  for (int y = (int)begin + 1; y < (int)end + 1; ++y)
+    for (int x = 1; x < e->n - 1; ++x) {
+      int i = y * e->n + x;
+      partial[0] += observable_energy_density(e->dx[i], e->dy[i]);
+    }
+}
+
 static void run_vectors(App *A) {
   if (!A->fbm)
     return;
@@ -287,14 +303,13 @@ static void run_vectors(App *A) {
     return;
   }
   compute_deflection(A->fbm, N, N, A->dx, A->dy);
+  EnergyCtx ec = {A->dx, A->dy, N};
   double acc = 0.0;
-  int samples = 0;
-  for (int y = 1; y < N - 1; ++y)
-    for (int x = 1; x < N - 1; ++x) {
-      int i = y * N + x;
-      acc += observable_energy_density(A->dx[i], A->dy[i]);
-      ++samples;
-    }
+  int samples = N > 2 ? (N - 2) * (N - 2) : 0;
+  size_t rows_per_chunk = REDUCE_CHUNK / N ? REDUCE_CHUNK / N : 1;
+  if (samples > 0)
+    reduce_chunks((size_t)(N - 2), rows_per_chunk, 1, NULL, 0, energy_rows,
+                  &ec, &acc);
   A->energy_avg = samples ? acc / samples : 0.0;
 }
 
@@ -415,10 +430,19 @@ static void draw_sim(WINDOW *w, const App *A) {
   wrefresh(w);
 }
 
+/* Weights persisted between MLP demo runs. */
+#define MLP_DEMO_FILE "superforce_mlp.bin"
+
 static void run_mlp_demo(WINDOW *w_change) {
   int h = getmaxy(w_change);
   MLP mlp;
-  if (mlp_init(&mlp, 2, 8, 2, 123) != 0)
+  /* resume from the last saved weights when present (mapped, not copied) */
+  int resumed = mlp_load_mmap(&mlp, MLP_DEMO_FILE) == 0;
+  if (resumed && (mlp.in_dim != 2 || mlp.out_dim != 2)) {
+    mlp_free(&mlp);
+    resumed = 0;
+  }
+  if (!resumed && mlp_init(&mlp, 2, 8, 2, 123) != 0)
     return;
   int n = 20;
   double xs[40], ys[40];
@@ -447,7 +471,9 @@ static void run_mlp_demo(WINDOW *w_change) {
       napms(40);
     }
   }
-  mvwprintw(w_change, h - 2, 2, "MLP done          ");
+  int saved = mlp_save(&mlp, MLP_DEMO_FILE) == 0;
+  mvwprintw(w_change, h - 2, 2, "MLP done%s%s   ", resumed ? " (resumed)" : "",
+            saved ? " saved" : "");
   wrefresh(w_change);
   mlp_free(&mlp);
 }
@@ -14,6 +14,8 @@
 #include "coins.h"
 #include "color.h"
 #include "env.h"
+#include "latency_hist.h"
+#include "relief.h"
 #include "simulation.h"
 #include "version.h"
 
@@ -66,6 +68,7 @@ static void help_menu(void) {
        "  r  regenerate fBm with last params\n"
        "  P  Poisson solve on last fBm -> ui_poisson_phi.ppm\n"
        "  V  vector overlay -> ui_fbm_vectors.ppm\n"
+       "  R  shaded relief (hillshade + occlusion) -> ui_fbm_relief.ppm\n"
        "  m  train tiny MLP demo (identity 2->2)\n"
        "  M  train MLP with debug loss prints\n"
        "  C  toggle color on/off\n"
@@ -225,6 +228,19 @@ static void do_vectors(const AppState *S) {
   free(dy);
 }
 
+/** Render shaded relief of the last fBm. */
+static void do_relief(const AppState *S) {
+  if (!S->fbm_field) {
+    puts("no fbm yet");
+    return;
+  }
+  if (write_relief_ppm("ui_fbm_relief.ppm", S->fbm_field, S->fbm_size,
+                       S->fbm_size, NULL))
+    puts("wrote ui_fbm_relief.ppm");
+  else
+    puts("relief render failed");
+}
+
 /** Benchmark DP/opt solver. */
 static void do_bench(const AppState *S) {
   char in[64];
@@ -245,22 +261,28 @@ static void do_bench(const AppState *S) {
     puts("alloc fail");
     return;
   }
-  clock_t t0, t1;
-  double tot = 0, best = 1e9;
+  LatencyHist *hist = (LatencyHist *)malloc(sizeof(LatencyHist));
+  if (!hist) {
+    free(tmp);
+    puts("alloc fail");
+    return;
+  }
+  latency_hist_reset(hist);
   for (int i = 0; i < iters; ++i) {
     memset(tmp, 0, S->coin_sys->ncoins * sizeof(int));
-    t0 = clock();
+    uint64_t t0 = latency_now_ns();
     if (S->opt_mode == OPT_COUNT)
       dp_make_change(S->coin_sys, amt, tmp);
     else
       dp_make_change_opt(S->coin_sys, amt, tmp, S->opt_mode);
-    t1 = clock();
-    double dt = (double)(t1 - t0) / CLOCKS_PER_SEC;
-    tot += dt;
-    if (dt < best)
-      best = dt;
+    latency_hist_record(hist, latency_now_ns() - t0);
   }
-  printf("bench avg=%.4g best=%.4g sec\n", tot / iters, best);
+  printf("bench avg=%.4g best=%.4g p99=%.4g p999=%.4g sec\n",
+         latency_hist_mean(hist) * 1e-9, hist->min * 1e-9,
+         latency_hist_percentile(hist, 99.0) * 1e-9,
+         latency_hist_percentile(hist, 99.9) * 1e-9);
+  latency_hist_print(hist, "dp", stdout);
+  free(hist);
   free(tmp);
 }
 
@@ -345,6 +367,9 @@ int main(void) {
     case 'V':
       do_vectors(&S);
       break;
+    case 'R':
+      do_relief(&S);
+      break;
     case 'b':
       do_bench(&S);
       break;
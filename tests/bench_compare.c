@@ -0,0 +1,493 @@
+/**
+ * \file bench_compare.c
+ * \brief Benchmark recorder and baseline/candidate regression comparator.
+ *
+ * Usage:
+ *   bench_compare run OUT [reps]          record samples of the built-in cases
+ *   bench_compare BASE CAND [options]     compare two recorded files
+ *   bench_compare --selftest              check the statistics on synthetic data
+ *
+ * Result files are plain text, one "case nanoseconds" sample per line ('#'
+ * starts a comment), so samples from other tools can be appended by hand.
+ * Each case is compared by the ratio of medians with a percentile bootstrap
+ * confidence interval and a two-sided Mann-Whitney U test; a case regresses
+ * when it is slower by more than the threshold, the whole interval lies above
+ * 1 and p < alpha. Exit status: 0 no regression, 1 regression, 2 usage or
+ * input error.
+ */
+#include "coins.h"
+#include "latency_hist.h"
+#include "physics_expr.h"
+#include "simulation.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CASES 64
+
+/** \brief All samples of one named case. */
+typedef struct {
+  char name[64];
+  double *v;
+  size_t n, cap;
+} Case;
+
+/** \brief Cases read from one result file. */
+typedef struct {
+  Case cases[MAX_CASES];
+  size_t ncases;
+} ResultSet;
+
+/** \brief Comparison options. */
+typedef struct {
+  double threshold; /* relative slowdown tolerated (0.05 = 5%) */
+  double alpha;     /* significance level of the U test */
+  int resamples;    /* bootstrap resamples */
+  unsigned seed;    /* bootstrap RNG seed */
+} CompareOpts;
+
+static Case *find_case(ResultSet *rs, const char *name, int create) {
+  for (size_t i = 0; i < rs->ncases; ++i)
+    if (strcmp(rs->cases[i].name, name) == 0)
+      return &rs->cases[i];
+  if (!create || rs->ncases == MAX_CASES)
+    return NULL;
+  Case *c = &rs->cases[rs->ncases++];
+  memset(c, 0, sizeof(*c));
+  snprintf(c->name, sizeof(c->name), "%s", name);
+  return c;
+}
+
+static int add_sample(ResultSet *rs, const char *name, double v) {
+  Case *c = find_case(rs, name, 1);
+  if (!c)
+    return -1;
+  if (c->n == c->cap) {
+    size_t cap = c->cap ? 2 * c->cap : 16;
+    double *nv = (double *)realloc(c->v, cap * sizeof(double));
+    if (!nv)
+      return -1;
+    c->v = nv;
+    c->cap = cap;
+  }
+  c->v[c->n++] = v;
+  return 0;
+}
+
+static void free_results(ResultSet *rs) {
+  for (size_t i = 0; i < rs->ncases; ++i)
+    free(rs->cases[i].v);
+  rs->ncases = 0;
+}
+
+static int load_results(const char *path, ResultSet *rs) {
+  FILE *fp = fopen(path, "r");
+  if (!fp) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return -1;
+  }
+  char line[256], name[64];
+  double v;
+  int lineno = 0, rc = 0;
+  while (rc == 0 && fgets(line, sizeof(line), fp)) {
+    ++lineno;
+    char *p = line + strspn(line, " \t");
+    if (*p == '#' || *p == '\n' || *p == '\0')
+      continue;
+    if (sscanf(p, "%63s %lf", name, &v) != 2 || !(v >= 0)) {
+      fprintf(stderr, "%s:%d: expected 'case nanoseconds'\n", path, lineno);
+      rc = -1;
+    } else if (add_sample(rs, name, v) != 0) {
+      fprintf(stderr, "%s: too many cases\n", path);
+      rc = -1;
+    }
+  }
+  fclose(fp);
+  return rc;
+}
+
+/* ---------------- Statistics ---------------- */
+
+static int cmp_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/** \brief Median of v[0..n) (sorts v). */
+static double median_inplace(double *v, size_t n) {
+  qsort(v, n, sizeof(double), cmp_double);
+  return n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+static double median(const double *v, size_t n, double *scratch) {
+  memcpy(scratch, v, n * sizeof(double));
+  return median_inplace(scratch, n);
+}
+
+static unsigned xorshift(unsigned *s) {
+  unsigned x = *s;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *s = x;
+}
+
+/** \brief Percentile bootstrap CI (95%) of median(cand) / median(base). */
+static int bootstrap_ratio_ci(const Case *base, const Case *cand,
+                              const CompareOpts *o, double *lo, double *hi) {
+  size_t n = base->n > cand->n ? base->n : cand->n;
+  double *scratch = (double *)malloc(n * sizeof(double));
+  double *ratios = (double *)malloc((size_t)o->resamples * sizeof(double));
+  if (!scratch || !ratios) {
+    free(scratch);
+    free(ratios);
+    return -1;
+  }
+  unsigned s = o->seed ? o->seed : 1u;
+  for (int r = 0; r < o->resamples; ++r) {
+    for (size_t i = 0; i < base->n; ++i)
+      scratch[i] = base->v[xorshift(&s) % base->n];
+    double mb = median_inplace(scratch, base->n);
+    for (size_t i = 0; i < cand->n; ++i)
+      scratch[i] = cand->v[xorshift(&s) % cand->n];
+    double mc = median_inplace(scratch, cand->n);
+    ratios[r] = mb > 0 ? mc / mb : 1.0;
+  }
+  qsort(ratios, (size_t)o->resamples, sizeof(double), cmp_double);
+  *lo = ratios[(size_t)(0.025 * (o->resamples - 1) + 0.5)];
+  *hi = ratios[(size_t)(0.975 * (o->resamples - 1) + 0.5)];
+  free(scratch);
+  free(ratios);
+  return 0;
+}
+
+/** \brief Index sort helper for the rank computation. */
+typedef struct {
+  double v;
+  int from_cand;
+} Tagged;
+
+static int cmp_tagged(const void *a, const void *b) {
+  return cmp_double(&((const Tagged *)a)->v, &((const Tagged *)b)->v);
+}
+
+/** \brief Two-sided Mann-Whitney U p-value (normal approximation with tie
+ * and continuity correction). */
+static double mann_whitney_p(const Case *base, const Case *cand) {
+  size_t n1 = base->n, n2 = cand->n, N = n1 + n2;
+  Tagged *t = (Tagged *)malloc(N * sizeof(Tagged));
+  if (!t)
+    return 1.0;
+  for (size_t i = 0; i < n1; ++i)
+    t[i] = (Tagged){base->v[i], 0};
+  for (size_t i = 0; i < n2; ++i)
+    t[n1 + i] = (Tagged){cand->v[i], 1};
+  qsort(t, N, sizeof(Tagged), cmp_tagged);
+  double rank_base = 0.0, ties = 0.0;
+  for (size_t i = 0; i < N;) {
+    size_t j = i;
+    while (j < N && t[j].v == t[i].v)
+      ++j;
+    double avg = 0.5 * (double)(i + 1 + j); /* ranks i+1..j */
+    double k = (double)(j - i);
+    ties += k * k * k - k;
+    for (size_t q = i; q < j; ++q)
+      if (!t[q].from_cand)
+        rank_base += avg;
+    i = j;
+  }
+  free(t);
+  double u = rank_base - 0.5 * (double)n1 * (double)(n1 + 1);
+  double mu = 0.5 * (double)n1 * (double)n2;
+  double var = (double)n1 * (double)n2 / 12.0 *
+               ((double)(N + 1) - ties / ((double)N * (double)(N - 1)));
+  if (var <= 0)
+    return 1.0;
+  double z = (fabs(u - mu) - 0.5) / sqrt(var);
+  if (z < 0)
+    z = 0;
+  return erfc(z / sqrt(2.0));
+}
+
+/** \brief Outcome of one case comparison. */
+typedef struct {
+  double med_base, med_cand; /* medians (ns) */
+  double ratio, ci_lo, ci_hi; /* cand / base */
+  double p;                   /* U test p-value */
+  int verdict;                /* -1 faster, 0 same, 1 regression */
+} CaseResult;
+
+static int compare_case(const Case *b, const Case *c, const CompareOpts *o,
+                        CaseResult *r) {
+  size_t n = b->n > c->n ? b->n : c->n;
+  double *scratch = (double *)malloc(n * sizeof(double));
+  if (!scratch || bootstrap_ratio_ci(b, c, o, &r->ci_lo, &r->ci_hi) != 0) {
+    free(scratch);
+    return -1;
+  }
+  r->med_base = median(b->v, b->n, scratch);
+  r->med_cand = median(c->v, c->n, scratch);
+  free(scratch);
+  r->ratio = r->med_base > 0 ? r->med_cand / r->med_base : 1.0;
+  r->p = mann_whitney_p(b, c);
+  r->verdict = 0;
+  if (r->p < o->alpha && r->ratio > 1.0 + o->threshold && r->ci_lo > 1.0)
+    r->verdict = 1;
+  else if (r->p < o->alpha && r->ratio < 1.0 - o->threshold && r->ci_hi < 1.0)
+    r->verdict = -1;
+  return 0;
+}
+
+/** \brief Human-readable duration with an adaptive unit. */
+static const char *fmt_ns(double ns, char *buf, size_t len) {
+  if (ns >= 1e9)
+    snprintf(buf, len, "%.3f s", ns * 1e-9);
+  else if (ns >= 1e6)
+    snprintf(buf, len, "%.3f ms", ns * 1e-6);
+  else if (ns >= 1e3)
+    snprintf(buf, len, "%.3f us", ns * 1e-3);
+  else
+    snprintf(buf, len, "%.1f ns", ns);
+  return buf;
+}
+
+/** \brief Print the comparison table; returns the number of regressions. */
+static int compare_sets(ResultSet *base, ResultSet *cand, const CompareOpts *o,
+                        FILE *out) {
+  static const char *const VERDICT[] = {"faster", "same", "REGRESSION"};
+  int regressions = 0;
+  char b1[32], b2[32];
+  fprintf(out, "%-28s %12s %12s %8s %19s %9s  %s\n", "case", "baseline",
+          "candidate", "change", "95% CI", "p(U)", "verdict");
+  for (size_t i = 0; i < base->ncases; ++i) {
+    Case *b = &base->cases[i];
+    Case *c = find_case(cand, b->name, 0);
+    if (!c || c->n < 2 || b->n < 2) {
+      fprintf(out, "%-28s %s\n", b->name,
+              c ? "too few samples" : "missing in candidate");
+      continue;
+    }
+    CaseResult r;
+    if (compare_case(b, c, o, &r) != 0) {
+      fprintf(stderr, "out of memory\n");
+      return -1;
+    }
+    regressions += r.verdict == 1;
+    fprintf(out, "%-28s %12s %12s %+7.1f%% [%+7.1f%%,%+7.1f%%] %9.2g  %s\n",
+            b->name, fmt_ns(r.med_base, b1, sizeof(b1)),
+            fmt_ns(r.med_cand, b2, sizeof(b2)), 100.0 * (r.ratio - 1.0),
+            100.0 * (r.ci_lo - 1.0), 100.0 * (r.ci_hi - 1.0), r.p,
+            VERDICT[r.verdict + 1]);
+  }
+  for (size_t i = 0; i < cand->ncases; ++i)
+    if (!find_case(base, cand->cases[i].name, 0))
+      fprintf(out, "%-28s %s\n", cand->cases[i].name, "new (no baseline)");
+  return regressions;
+}
+
+/* ---------------- Recording ---------------- */
+
+/** \brief Built-in benchmark case. */
+typedef struct {
+  const char *name;
+  void (*run)(void *scratch);
+} BenchCase;
+
+enum { GRID = 256, PGRID = 128, EXPR_ROWS = 16384 };
+
+static void run_dp_usd(void *scratch) {
+  dp_make_change(get_coin_system("usd"), 20000, (int *)scratch);
+}
+
+static void run_dp_eur(void *scratch) {
+  dp_make_change(get_coin_system("eur"), 20000, (int *)scratch);
+}
+
+static void run_poisson(void *scratch) {
+  double *phi = (double *)scratch, *rhs = phi + PGRID * PGRID;
+  for (int i = 0; i < PGRID * PGRID; ++i) {
+    phi[i] = 0.0;
+    rhs[i] = (i % 7) * 0.01;
+  }
+  poisson_jacobi(phi, rhs, PGRID, PGRID, 200);
+}
+
+static void run_fbm(void *scratch) {
+  generate_fbm((double *)scratch, GRID, GRID, 0.8);
+}
+
+static void run_value_noise(void *scratch) {
+  generate_value_noise((double *)scratch, GRID, GRID, 1234u, 6);
+}
+
+static void run_diamond_square(void *scratch) {
+  fbm_diamond_square((double *)scratch, GRID + 1, 0.8, 1234u);
+}
+
+static void run_expr_casimir(void *scratch) {
+  static PhysicsExpr *expr;
+  static const PhysicsParamDesc params[] = {
+      {"radius", PHYSICS_PARAM_DOUBLE, PHYSICS_DIM_LENGTH, "m", "", true, 0, 1},
+      {"distance", PHYSICS_PARAM_DOUBLE, PHYSICS_DIM_LENGTH, "m", "", true, 0,
+       1}};
+  if (!expr)
+    expr = physics_expr_compile(
+        "pi^3 * hbar * c * radius / (360 * distance^3)", params, 2,
+        PHYSICS_DIM_FORCE, NULL, 0);
+  double *radius = (double *)scratch, *distance = radius + EXPR_ROWS;
+  for (int i = 0; i < EXPR_ROWS; ++i) {
+    radius[i] = 1e-6 * (1 + i % 17);
+    distance[i] = 1e-8 * (1 + i % 13);
+  }
+  const double *columns[2] = {radius, distance};
+  physics_expr_eval_batch(expr, columns, EXPR_ROWS, distance + EXPR_ROWS);
+}
+
+static const BenchCase CASES[] = {
+    {"dp_make_change/usd/20000", run_dp_usd},
+    {"dp_make_change/eur/20000", run_dp_eur},
+    {"poisson_jacobi/128x128x200", run_poisson},
+    {"generate_fbm/256", run_fbm},
+    {"generate_value_noise/256x6", run_value_noise},
+    {"fbm_diamond_square/257", run_diamond_square},
+    {"physics_expr_eval_batch/casimir/16384", run_expr_casimir}};
+
+static int record(const char *path, int reps) {
+  FILE *fp = fopen(path, "w");
+  double *scratch =
+      (double *)malloc((size_t)(GRID + 1) * (GRID + 1) * sizeof(double));
+  if (!fp || !scratch) {
+    fprintf(stderr, "cannot write %s\n", path);
+    if (fp)
+      fclose(fp);
+    free(scratch);
+    return 2;
+  }
+  fprintf(fp, "# bench_compare samples (ns): case value\n");
+  for (size_t k = 0; k < sizeof(CASES) / sizeof(CASES[0]); ++k) {
+    CASES[k].run(scratch); /* warm-up */
+    for (int r = 0; r < reps; ++r) {
+      uint64_t t0 = latency_now_ns();
+      CASES[k].run(scratch);
+      fprintf(fp, "%s %llu\n", CASES[k].name,
+              (unsigned long long)(latency_now_ns() - t0));
+    }
+    fprintf(stderr, "recorded %s\n", CASES[k].name);
+  }
+  free(scratch);
+  return fclose(fp) == 0 ? 0 : 2;
+}
+
+/* ---------------- Self test ---------------- */
+
+/** \brief Roughly normal noise from the sum of uniforms. */
+static double noisy(unsigned *s, double mean, double sd) {
+  double u = 0.0;
+  for (int i = 0; i < 12; ++i)
+    u += (xorshift(s) & 0xffffff) / 16777216.0;
+  return mean + sd * (u - 6.0);
+}
+
+static int selftest(const CompareOpts *o) {
+  ResultSet *base = (ResultSet *)calloc(2, sizeof(ResultSet));
+  if (!base)
+    return 2;
+  ResultSet *cand = base + 1;
+  unsigned s = 42u;
+  for (int i = 0; i < 40; ++i) {
+    add_sample(base, "same", noisy(&s, 1000, 50));
+    add_sample(cand, "same", noisy(&s, 1000, 50));
+    add_sample(base, "slower", noisy(&s, 1000, 50));
+    add_sample(cand, "slower", noisy(&s, 1200, 50));
+    add_sample(base, "faster", noisy(&s, 1000, 50));
+    add_sample(cand, "faster", noisy(&s, 700, 50));
+    add_sample(base, "tiny", noisy(&s, 1000, 50));
+    add_sample(cand, "tiny", noisy(&s, 1020, 50)); /* under threshold */
+  }
+  int expect[] = {0, 1, -1, 0};
+  int fail = 0;
+  for (size_t i = 0; i < base->ncases; ++i) {
+    CaseResult r;
+    if (compare_case(&base->cases[i], &cand->cases[i], o, &r) != 0 ||
+        r.verdict != expect[i] || !(r.ci_lo <= r.ratio && r.ratio <= r.ci_hi)) {
+      fprintf(stderr, "selftest: case %s verdict %d\n", base->cases[i].name,
+              r.verdict);
+      fail = 1;
+    }
+  }
+  /* identical samples: U test must not reject */
+  if (mann_whitney_p(&base->cases[0], &base->cases[0]) < 0.5)
+    fail = 1;
+  free_results(base);
+  free_results(cand);
+  free(base);
+  if (!fail)
+    printf("bench_compare selftest passed\n");
+  return fail;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s run OUT [reps]\n"
+          "       %s BASE CAND [--threshold PCT] [--alpha A] "
+          "[--resamples N] [--seed S]\n"
+          "       %s --selftest\n",
+          prog, prog, prog);
+}
+
+int main(int argc, char **argv) {
+  CompareOpts o = {0.05, 0.01, 2000, 12345u};
+  if (argc >= 2 && strcmp(argv[1], "--selftest") == 0)
+    return selftest(&o);
+  if (argc >= 3 && strcmp(argv[1], "run") == 0) {
+    int reps = argc > 3 ? atoi(argv[3]) : 15;
+    if (reps < 2) {
+      usage(argv[0]);
+      return 2;
+    }
+    return record(argv[2], reps);
+  }
+  if (argc < 3) {
+    usage(argv[0]);
+    return 2;
+  }
+  for (int i = 3; i < argc; ++i) {
+    if (i + 1 >= argc) {
+      usage(argv[0]);
+      return 2;
+    }
+    if (strcmp(argv[i], "--threshold") == 0)
+      o.threshold = atof(argv[++i]) / 100.0;
+    else if (strcmp(argv[i], "--alpha") == 0)
+      o.alpha = atof(argv[++i]);
+    else if (strcmp(argv[i], "--resamples") == 0)
+      o.resamples = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--seed") == 0)
+      o.seed = (unsigned)strtoul(argv[++i], NULL, 10);
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (o.threshold < 0 || !(o.alpha > 0 && o.alpha < 1) || o.resamples < 100) {
+    fprintf(stderr, "bad --threshold/--alpha/--resamples\n");
+    return 2;
+  }
+  ResultSet *sets = (ResultSet *)calloc(2, sizeof(ResultSet));
+  if (!sets)
+    return 2;
+  int rc = 2;
+  if (load_results(argv[1], &sets[0]) == 0 &&
+      load_results(argv[2], &sets[1]) == 0) {
+    int reg = compare_sets(&sets[0], &sets[1], &o, stdout);
+    if (reg > 0)
+      printf("%d case(s) regressed by more than %.1f%%\n", reg,
+             100.0 * o.threshold);
+    rc = reg < 0 ? 2 : reg > 0 ? 1 : 0;
+  }
+  free_results(&sets[0]);
+  free_results(&sets[1]);
+  free(sets);
+  return rc;
+}
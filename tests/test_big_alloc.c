@@ -0,0 +1,90 @@
+#include "big_alloc.h"
+#include "coins.h"
+#include "parallel.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(void) {
+  const CoinSystem *usd = get_coin_system("usd");
+  if (!usd) {
+    fprintf(stderr, "usd missing\n");
+    return 1;
+  }
+  BigAllocStats s0, s1;
+  BigAllocInfo info;
+  big_alloc_stats(&s0);
+  void *small = big_alloc(4096, 0, 1, &info);
+  if (!small || info.kind != BIG_ALLOC_HEAP || info.numa_nodes < 1) {
+    fprintf(stderr, "big_alloc small block\n");
+    return 1;
+  }
+  big_free(small, 4096);
+
+  const size_t bytes = (size_t)5 << 20;
+  const char *policies[] = {"off", "thp", "hugetlb"};
+  /* first touch splits each plane over the default team (1 without
+   * threads) */
+  setenv("COINSORTER_FIRST_TOUCH", "1", 1);
+  setenv("COINSORTER_THREADS", "3", 1);
+  const int touch = parallel_default_threads();
+  for (int k = 0; k < 3; ++k) {
+    setenv("COINSORTER_HUGEPAGES", policies[k], 1);
+    unsigned char *p = (unsigned char *)big_alloc(bytes, 0, 2, &info);
+    int kind_ok = k == 0   ? info.kind == BIG_ALLOC_PAGES
+                  : k == 1 ? info.kind == BIG_ALLOC_THP ||
+                                 info.kind == BIG_ALLOC_PAGES
+                           : info.kind != BIG_ALLOC_HEAP;
+    if (!p || !kind_ok || info.mapped_bytes != (size_t)6 << 20 ||
+        info.touch_threads != touch ||
+        ((uintptr_t)p & (BIG_ALLOC_HUGE_PAGE - 1)) != 0) {
+      fprintf(stderr, "big_alloc %s: kind %s\n", policies[k],
+              big_alloc_kind_name(info.kind));
+      return 1;
+    }
+    for (size_t i = 0; i < bytes; i += 4093)
+      if (p[i] != 0) {
+        fprintf(stderr, "big_alloc not zeroed\n");
+        return 1;
+      }
+    p[bytes - 1] = 1;
+    big_free(p, bytes);
+  }
+  setenv("COINSORTER_FIRST_TOUCH", "0", 1);
+  unsetenv("COINSORTER_HUGEPAGES");
+  unsetenv("COINSORTER_THREADS");
+  void *lazy = big_alloc(bytes, 0, 1, &info);
+  if (!lazy || info.touch_threads != 0) {
+    fprintf(stderr, "big_alloc lazy touch\n");
+    return 1;
+  }
+  big_free(lazy, bytes);
+  unsetenv("COINSORTER_FIRST_TOUCH");
+
+  /* 6 bytes per amount: both tables are mapped, result matches greedy */
+  const int amount = 1100000;
+  int dp[16], greedy[16];
+  if (dp_make_change(usd, amount, dp) != 0 ||
+      greedy_make_change(usd, amount, greedy) != 0 ||
+      memcmp(dp, greedy, usd->ncoins * sizeof(int)) != 0) {
+    fprintf(stderr, "big DP table mismatch\n");
+    return 1;
+  }
+  big_alloc_stats(&s1);
+  uint64_t mapped0 = 0, mapped1 = 0;
+  for (int k = BIG_ALLOC_PAGES; k < BIG_ALLOC_KINDS; ++k) {
+    mapped0 += s0.allocs[k];
+    mapped1 += s1.allocs[k];
+  }
+  if (s1.allocs[BIG_ALLOC_HEAP] <= s0.allocs[BIG_ALLOC_HEAP] ||
+      mapped1 < mapped0 + 6 || s1.first_touched < s0.first_touched + 3 ||
+      s1.hugetlb_fallbacks + s1.allocs[BIG_ALLOC_HUGETLB] <
+          s0.hugetlb_fallbacks + s0.allocs[BIG_ALLOC_HUGETLB] + 1 ||
+      s1.numa_nodes != info.numa_nodes) {
+    fprintf(stderr, "big_alloc stats\n");
+    return 1;
+  }
+  printf("big_alloc tests passed\n");
+  return 0;
+}
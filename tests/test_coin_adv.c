@@ -1,8 +1,24 @@
+#include "arrow_ipc.h"
+#include "change_table.h"
+#include "coin_bitset.h"
 #include "coins.h"
+#include "cpu_features.h"
+#include "latency_hist.h"
+#include "metrics.h"
+#include "mixed_change.h"
+#include "parallel.h"
+#include "slot_sorter.h"
+#include <glob.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 static int sum_value(const CoinSystem *s, const int *c) {
   int total = 0;
@@ -10,6 +26,538 @@ static int sum_value(const CoinSystem *s, const int *c) {
     total += c[i] * s->coins[i].value;
   return total;
 }
+/* Reference DP counts for 0..max (-1 = unreachable). */
+static int *reference_counts(const CoinSystem *s, int max) {
+  int *best = malloc(sizeof(int) * (size_t)(max + 1));
+  if (!best)
+    return NULL;
+  best[0] = 0;
+  for (int a = 1; a <= max; a++) {
+    best[a] = -1;
+    for (size_t c = 0; c < s->ncoins; c++) {
+      int v = s->coins[c].value;
+      if (v <= a && best[a - v] >= 0 &&
+          (best[a] < 0 || best[a - v] + 1 < best[a]))
+        best[a] = best[a - v] + 1;
+    }
+  }
+  return best;
+}
+
+/* Compressed table agrees with the reference DP, rank/select and mmap. */
+static int check_change_table(const CoinSystem *s, int max, const char *path) {
+  ChangeTable t, m;
+  int *ref = reference_counts(s, max);
+  if (!ref || change_table_build(s, max, &t) != 0) {
+    fprintf(stderr, "%s change table build failed\n", s->system_name);
+    free(ref);
+    return 1;
+  }
+  int fail = 0;
+  long reach = 0;
+  int c1[32], c2[32];
+  for (int a = 0; a <= max && !fail; a++) {
+    reach += ref[a] >= 0;
+    if (change_table_count(&t, a) != ref[a] ||
+        change_table_rank(&t, a) != reach) {
+      fprintf(stderr, "%s table count/rank mismatch at %d\n", s->system_name,
+              a);
+      fail = 1;
+    } else if (ref[a] >= 0 && change_table_select(&t, reach - 1) != a) {
+      fprintf(stderr, "%s table select mismatch at %d\n", s->system_name, a);
+      fail = 1;
+    }
+  }
+  if (!fail && change_table_select(&t, reach) != -1) {
+    fprintf(stderr, "%s select past end\n", s->system_name);
+    fail = 1;
+  }
+  for (int a = 1; a <= max && !fail; a += 97) {
+    int rc = change_table_make_change(&t, a, c1);
+    if (rc != dp_make_change(s, a, c2)) {
+      fail = 1;
+    } else if (rc == 0) {
+      for (size_t c = 0; c < s->ncoins; c++)
+        fail |= c1[c] != c2[c];
+    }
+    if (fail)
+      fprintf(stderr, "%s table reconstruction mismatch at %d\n",
+              s->system_name, a);
+  }
+  if (!fail && (double)change_table_bytes(&t) / (max + 1) > 1.0) {
+    fprintf(stderr, "%s table uses %.3f bytes/amount\n", s->system_name,
+            (double)change_table_bytes(&t) / (max + 1));
+    fail = 1;
+  }
+  if (!fail && (change_table_save(&t, path) != 0 ||
+                change_table_load_mmap(&m, path) != 0)) {
+    fprintf(stderr, "%s table save/load failed\n", s->system_name);
+    fail = 1;
+  } else if (!fail) {
+    for (int a = 0; a <= max; a += 13)
+      fail |= change_table_count(&m, a) != ref[a] ||
+              change_table_last(&m, a) != change_table_last(&t, a);
+    if (fail)
+      fprintf(stderr, "%s mapped table differs\n", s->system_name);
+    change_table_free(&m);
+    /* a damaged directory entry must be rejected */
+    FILE *fp = fopen(path, "r+b");
+    if (fp && fseek(fp, 200, SEEK_SET) == 0 && fputc(0x5A, fp) != EOF) {
+      fclose(fp);
+      if (change_table_load_mmap(&m, path) == 0) {
+        fprintf(stderr, "%s corrupt table accepted\n", s->system_name);
+        change_table_free(&m);
+        fail = 1;
+      }
+    } else if (fp) {
+      fclose(fp);
+    }
+    remove(path);
+  }
+  change_table_free(&t);
+  free(ref);
+  return fail;
+}
+
+/* Bitset engines agree with the reference DP and a bounded brute force. */
+static int check_bitsets(const CoinSystem *s, int max) {
+  int *ref = reference_counts(s, max);
+  int *mk = malloc(sizeof(int) * (size_t)(max + 1));
+  char *bounded = calloc((size_t)max + 1, 1);
+  CoinBitset all, k3, bs;
+  int fail = !ref || !mk || !bounded || coin_bitset_init(&all, max) ||
+             coin_bitset_init(&k3, max) || coin_bitset_init(&bs, max);
+  if (fail) {
+    fprintf(stderr, "bitset alloc fail\n");
+    return 1;
+  }
+  int supply[32];
+  for (size_t c = 0; c < s->ncoins; c++)
+    supply[c] = c == 1 ? -1 : (int)(c * 3 % 7); /* one unlimited coin */
+  bounded[0] = 1;
+  for (size_t c = 0; c < s->ncoins; c++) {
+    int v = s->coins[c].value;
+    int uses = supply[c] < 0 ? max / v : supply[c];
+    for (int u = 0; u < uses; u++)
+      for (int a = max; a >= v; a--)
+        bounded[a] |= bounded[a - v];
+  }
+  fail = coin_bitset_reachable(s, &all) != 0 ||
+         coin_bitset_reachable_k(s, 3, &k3) != 0 ||
+         coin_bitset_reachable_bounded(s, supply, &bs) != 0 ||
+         coin_bitset_min_coins(s, max, 0, mk) < 0;
+  size_t nall = 0;
+  for (int a = 0; a <= max && !fail; a++) {
+    nall += ref[a] >= 0;
+    if (coin_bitset_test(&all, a) != (ref[a] >= 0) ||
+        coin_bitset_test(&k3, a) != (ref[a] >= 0 && ref[a] <= 3) ||
+        coin_bitset_test(&bs, a) != bounded[a] || mk[a] != ref[a]) {
+      fprintf(stderr, "%s bitset mismatch at %d\n", s->system_name, a);
+      fail = 1;
+    }
+  }
+  if (!fail && coin_bitset_count(&all) != nall) {
+    fprintf(stderr, "%s bitset count mismatch\n", s->system_name);
+    fail = 1;
+  }
+  coin_bitset_free(&all);
+  coin_bitset_free(&k3);
+  coin_bitset_free(&bs);
+  free(ref);
+  free(mk);
+  free(bounded);
+  return fail;
+}
+
+/* Mixed usd+eur till against a per-coin bounded reference DP. */
+static int check_mixed(const CoinSystem *usd, const CoinSystem *eur) {
+  static const int usd_inv[] = {2, 3, 0, 4};
+  MixedSource src[2] = {{eur, 1.0, NULL}, {usd, 0.92, usd_inv}};
+  MixedChangeSolver m;
+  enum { MAXA = 600 };
+  if (mixed_change_init(&m, src, 2, MAXA, OPT_COUNT) != 0 || m.scale != 25) {
+    fprintf(stderr, "mixed init failed\n");
+    return 1;
+  }
+  /* reference: every inventory coin as its own 0/1 item */
+  size_t span = m.span;
+  int *ref = malloc(sizeof(int) * span);
+  if (!ref)
+    return 1;
+  for (size_t a = 0; a < span; a++)
+    ref[a] = a ? -1 : 0;
+  for (size_t k = 0; k < m.ncoins; k++) {
+    const MixedSource *sk = &src[m.coins[k].source];
+    size_t v = (size_t)m.coins[k].value;
+    int uses = sk->inventory ? sk->inventory[m.coins[k].coin] : -1;
+    if (uses < 0) {
+      for (size_t a = v; a < span; a++)
+        if (ref[a - v] >= 0 && (ref[a] < 0 || ref[a - v] + 1 < ref[a]))
+          ref[a] = ref[a - v] + 1;
+      continue;
+    }
+    for (int u = 0; u < uses; u++)
+      for (size_t a = span - 1; a >= v; a--)
+        if (ref[a - v] >= 0 && (ref[a] < 0 || ref[a - v] + 1 < ref[a]))
+          ref[a] = ref[a - v] + 1;
+  }
+  int fail = 0, counts[32];
+  double obj;
+  for (int amt = 0; amt <= MAXA && !fail; amt++) {
+    size_t a = (size_t)amt * (size_t)m.scale;
+    int rc = mixed_change_pay(&m, amt, counts, &obj);
+    if ((rc == 0) != (ref[a] >= 0)) {
+      fprintf(stderr, "mixed feasibility mismatch at %d\n", amt);
+      fail = 1;
+      break;
+    }
+    if (rc != 0)
+      continue;
+    long paid = 0;
+    int used = 0;
+    for (size_t k = 0; k < m.ncoins; k++) {
+      const MixedSource *sk = &src[m.coins[k].source];
+      paid += (long)counts[k] * m.coins[k].value;
+      used += counts[k];
+      if (sk->inventory && counts[k] > sk->inventory[m.coins[k].coin])
+        fail = 1;
+    }
+    if (fail || paid != (long)a || used != ref[a] || obj != used) {
+      fprintf(stderr, "mixed solution wrong at %d (%d vs %d coins)\n", amt,
+              used, ref[a]);
+      fail = 1;
+    }
+  }
+  free(ref);
+  mixed_change_free(&m);
+  /* a five-decimal rate in lowest terms needs scale 10^5; seven decimals
+   * exceed MIXED_MAX_SCALE and are refused */
+  MixedSource fine[2] = {{eur, 1.0, NULL}, {usd, 1.23457, usd_inv}};
+  if (mixed_change_init(&m, fine, 2, 20, OPT_COUNT) != 0 ||
+      m.scale != 100000) {
+    fprintf(stderr, "mixed five-decimal rate refused\n");
+    return 1;
+  }
+  for (int amt = 0; amt <= 20 && !fail; amt++) {
+    long long paid = 0;
+    if (mixed_change_pay(&m, amt, counts, &obj) != 0)
+      fail = 1;
+    for (size_t k = 0; !fail && k < m.ncoins; k++)
+      paid += (long long)counts[k] * m.coins[k].value;
+    if (fail || paid != (long long)amt * m.scale) {
+      fprintf(stderr, "mixed five-decimal payment wrong at %d\n", amt);
+      fail = 1;
+    }
+  }
+  mixed_change_free(&m);
+  fine[1].rate = 1.2345678;
+  if (!fail && mixed_change_init(&m, fine, 2, 20, OPT_COUNT) == 0) {
+    fprintf(stderr, "mixed seven-decimal rate accepted\n");
+    return 1;
+  }
+  /* one source, other objectives: matches the single-system DP */
+  MixedSource only = {usd, 1.0, NULL};
+  for (int mode = OPT_COUNT; mode < OPT_MODE_COUNT && !fail; mode++) {
+    if (mixed_change_init(&m, &only, 1, 300, (OptimizeMode)mode) != 0)
+      return 1;
+    int c2[32];
+    for (int amt = 1; amt <= 300 && !fail; amt += 7) {
+      dp_make_change_opt(usd, amt, c2, (OptimizeMode)mode);
+      double want = 0;
+      for (size_t c = 0; c < usd->ncoins; c++)
+        want += c2[c] * coin_weight(&usd->coins[c], (OptimizeMode)mode);
+      if (mixed_change_pay(&m, amt, counts, &obj) != 0 ||
+          fabs(obj - want) > 1e-9) {
+        fprintf(stderr, "mixed mode %d mismatch at %d\n", mode, amt);
+        fail = 1;
+      }
+    }
+    mixed_change_free(&m);
+  }
+  return fail;
+}
+
+static void record_task(void *ctx, int task, int thread) {
+  (void)thread;
+  LatencyHist *h = latency_set_local((LatencyHistSet *)ctx);
+  for (int i = 0; h && i < 1000; i++)
+    latency_hist_record(h, (uint64_t)task * 1000 + i);
+}
+
+static int check_latency(const CoinSystem *usd) {
+  LatencyHist *h = calloc(2, sizeof(LatencyHist));
+  if (!h)
+    return 1;
+  int fail = 0;
+  latency_hist_reset(&h[0]);
+  latency_hist_reset(&h[1]);
+  /* bucket bounds: exact below 64, within 1/64 above */
+  uint64_t probe[] = {0, 1, 63, 64, 65, 1000, 123456789, UINT64_MAX / 3};
+  for (size_t i = 0; i < sizeof probe / sizeof probe[0]; i++) {
+    latency_hist_reset(&h[1]);
+    latency_hist_record(&h[1], probe[i]);
+    latency_hist_record(&h[1], probe[i] < 64 ? 64 : 0);
+    uint64_t got = latency_hist_percentile(&h[1], probe[i] < 64 ? 50 : 100);
+    if (got < probe[i] || (double)(got - probe[i]) > probe[i] / 64.0)
+      fail = 1;
+  }
+  /* 1..10000 uniform: percentiles land within bucket resolution */
+  latency_hist_reset(&h[1]);
+  for (uint64_t v = 1; v <= 10000; v++)
+    latency_hist_record(v <= 5000 ? &h[0] : &h[1], v);
+  latency_hist_merge(&h[0], &h[1]);
+  static const double ps[] = {50, 90, 99, 99.9};
+  for (size_t i = 0; i < 4; i++) {
+    double want = ps[i] * 100.0;
+    double got = (double)latency_hist_percentile(&h[0], ps[i]);
+    if (fabs(got - want) > want / 64.0 + 1.0)
+      fail = 1;
+  }
+  if (h[0].total != 10000 || h[0].min != 1 || h[0].max != 10000 ||
+      fabs(latency_hist_mean(&h[0]) - 5000.5) > 1e-9 ||
+      latency_hist_percentile(&h[0], 100) != 10000)
+    fail = 1;
+  char *buf = malloc(1 << 16);
+  if (!buf || latency_hist_to_json(&h[0], buf, 1 << 16) != 0 ||
+      !strstr(buf, "\"p99_ns\":") || latency_hist_to_json(&h[0], buf, 16) == 0)
+    fail = 1;
+  free(buf);
+  if (fail)
+    fprintf(stderr, "latency histogram accuracy failed\n");
+
+  /* per-thread sets: nothing lost under concurrent recording */
+  LatencyHistSet set;
+  memset(&set, 0, sizeof set);
+  parallel_for(32, 0, record_task, &set);
+  latency_set_snapshot(&set, &h[0]);
+  latency_set_free(&set);
+  if (h[0].total != 32000 || h[0].min != 0 || h[0].max != 31999) {
+    fprintf(stderr, "latency set snapshot lost samples\n");
+    fail = 1;
+  }
+
+  /* solver probes: one sample per probed call, none once disabled */
+  int counts[16];
+  latency_probes_reset();
+  latency_probes_enable(1);
+  for (int amt = 1; amt <= 50; amt++)
+    dp_make_change(usd, amt, counts);
+  greedy_make_change(usd, 99, counts);
+  latency_probes_enable(0);
+  dp_make_change(usd, 51, counts);
+  latency_probe_snapshot(LAT_SOLVER_DP, &h[0]);
+  latency_probe_snapshot(LAT_SOLVER_GREEDY, &h[1]);
+  if (h[0].total != 50 || h[1].total != 1 ||
+      strcmp(latency_solver_name(LAT_SOLVER_DP), "dp") != 0) {
+    fprintf(stderr, "solver probes recorded %llu/%llu calls\n",
+            (unsigned long long)h[0].total, (unsigned long long)h[1].total);
+    fail = 1;
+  }
+  latency_probes_reset();
+  free(h);
+  return fail;
+}
+
+static void count_task(void *ctx, int task, int thread) {
+  (void)thread;
+  for (int i = 0; i < 1000; i++)
+    metrics_counter_add((Metric *)ctx, 1);
+  metrics_observe_ns(metrics_register(METRIC_HISTOGRAM, "test_seconds", NULL,
+                                      "test histogram"),
+                     (uint64_t)task * 1000);
+}
+
+#ifndef COINSORTER_NO_THREADS
+/** \brief Read one plain-text rendering from the metrics Unix socket. */
+static char *scrape_unix(const char *path) {
+  struct sockaddr_un sun;
+  memset(&sun, 0, sizeof sun);
+  sun.sun_family = AF_UNIX;
+  strcpy(sun.sun_path, path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr *)&sun, sizeof sun) != 0) {
+    if (fd >= 0)
+      close(fd);
+    return NULL;
+  }
+  size_t cap = 1 << 16, len = 0;
+  char *buf = malloc(cap);
+  ssize_t n;
+  while (buf && len + 1 < cap && (n = read(fd, buf + len, cap - len - 1)) > 0)
+    len += (size_t)n;
+  close(fd);
+  if (buf)
+    buf[len] = '\0';
+  return buf;
+}
+#endif
+
+static int check_metrics(const CoinSystem *usd) {
+  int fail = 0;
+  Metric *c = metrics_register(METRIC_COUNTER, "test_events_total",
+                               "kind=\"a\"", "test counter");
+  Metric *g = metrics_register(METRIC_GAUGE, "test_level", NULL, "test gauge");
+  if (!c || !g ||
+      c != metrics_register(METRIC_COUNTER, "test_events_total", "kind=\"a\"",
+                            NULL) ||
+      metrics_register(METRIC_GAUGE, "test_events_total", NULL, NULL) ||
+      metrics_register(METRIC_COUNTER, "9bad", NULL, NULL)) {
+    fprintf(stderr, "metrics registration failed\n");
+    return 1;
+  }
+  /* sharded counters and per-thread histograms lose nothing */
+  parallel_for(16, 0, count_task, c);
+  metrics_gauge_set(g, 5);
+  metrics_gauge_max(g, 3);
+  metrics_gauge_max(g, 9);
+  metrics_gauge_add(g, -2);
+  if (metrics_value(c) != 16000 || metrics_value(g) != 7) {
+    fprintf(stderr, "metrics values %lld/%lld\n", (long long)metrics_value(c),
+            (long long)metrics_value(g));
+    fail = 1;
+  }
+  /* library instrumentation only counts while enabled */
+  int counts[16];
+  dp_make_change(usd, 100, counts);
+  metrics_enable(1);
+  dp_make_change(usd, 100, counts);
+  metrics_enable(0);
+  char *text = metrics_render(NULL);
+  if (!text || !strstr(text, "# TYPE test_events_total counter\n") ||
+      !strstr(text, "test_events_total{kind=\"a\"} 16000\n") ||
+      !strstr(text, "test_level 7\n") ||
+      !strstr(text, "test_seconds_bucket{le=\"1e-06\"} 1\n") ||
+      !strstr(text, "test_seconds_count 16\n") ||
+      !strstr(text, "coinsorter_dp_cells_total 400\n")) {
+    fprintf(stderr, "metrics rendering wrong:\n%s", text ? text : "");
+    fail = 1;
+  }
+  free(text);
+#ifndef COINSORTER_NO_THREADS
+  /* socket exposition (served from a background thread) */
+  if (metrics_serve("unix:test_metrics.sock") != 0) {
+    fprintf(stderr, "metrics_serve failed\n");
+    return 1;
+  }
+  text = scrape_unix("test_metrics.sock");
+  metrics_serve_stop();
+  if (!text || !strstr(text, "test_level 7\n") ||
+      access("test_metrics.sock", F_OK) == 0) {
+    fprintf(stderr, "metrics socket scrape failed\n");
+    fail = 1;
+  }
+  free(text);
+#else
+  if (metrics_serve("unix:test_metrics.sock") != -1) {
+    fprintf(stderr, "metrics_serve without threads\n");
+    fail = 1;
+  }
+#endif
+  return fail;
+}
+
+/** \brief Flow-weighted misroutes of widths for targets t. */
+static double misroute_of(const SlotCoinDist *d, size_t n, const double *w,
+                          int k, const int *t) {
+  double e[64 * 16], miss = 0.0, total = 0.0;
+  slot_error_matrix(d, n, w, k, e);
+  for (size_t c = 0; c < n; c++) {
+    miss += d[c].weight * (1.0 - e[c * k + t[c]]);
+    total += d[c].weight;
+  }
+  return miss / total;
+}
+
+static int check_slots(void) {
+  /* every system: one slot per coin, targets follow the diameters */
+  for (size_t si = 0; si < coin_system_count(); si++) {
+    const CoinSystem *s = get_coin_system_by_index(si);
+    SlotPlan p;
+    if (slot_plan_optimize(s, NULL, 0, 0, &p) != 0 || p.nslots != (int)s->ncoins ||
+        p.candidates != 1 || !(p.misroute < 1e-3) || !isinf(p.width[p.nslots - 1])) {
+      fprintf(stderr, "slot plan for %s failed\n", s->system_name);
+      return 1;
+    }
+    for (size_t c = 0; c < s->ncoins; c++) {
+      double row = 0.0;
+      for (int k = 0; k < p.nslots; k++)
+        row += p.error[c * p.nslots + k];
+      int rank = 0;
+      for (size_t o = 0; o < s->ncoins; o++)
+        rank += s->coins[o].diameter_mm < s->coins[c].diameter_mm;
+      if (fabs(row - 1.0) > 1e-12 || p.target[c] != rank) {
+        fprintf(stderr, "%s %s: row sum %g, slot %d (rank %d)\n", s->system_name,
+                s->coins[c].code, row, p.target[c], rank);
+        return 1;
+      }
+    }
+    slot_plan_free(&p);
+    /* fewer slots than coins: all C(n-1, 2) groupings searched */
+    if (s->ncoins >= 3) {
+      size_t n1 = s->ncoins - 1;
+      if (slot_plan_optimize(s, NULL, 3, 0, &p) != 0 ||
+          p.candidates != n1 * (n1 - 1) / 2) {
+        fprintf(stderr, "3-slot plan for %s failed\n", s->system_name);
+        return 1;
+      }
+      slot_plan_free(&p);
+    }
+  }
+
+  /* a badly worn euro population: plan vs midpoints, threads, Monte Carlo */
+  const CoinSystem *eur = get_coin_system("eur");
+  SlotCoinDist d[16];
+  slot_default_dists(eur, d);
+  for (size_t c = 0; c < eur->ncoins; c++) {
+    d[c].diameter_sd_mm = c % 2 ? 0.15 : 0.4;
+    d[c].mass_mean_g = 0.95 * d[c].mass_g;
+    d[c].mass_sd_g = 0.04 * d[c].mass_g;
+  }
+  SlotPlan p1, p3;
+  if (slot_plan_optimize(eur, d, 0, 1, &p1) != 0 ||
+      slot_plan_optimize(eur, d, 0, 3, &p3) != 0 ||
+      memcmp(p1.width, p3.width, sizeof(double) * p1.nslots) != 0 ||
+      memcmp(p1.error, p3.error, sizeof(double) * p1.nslots * p1.ncoins) != 0) {
+    fprintf(stderr, "slot plan depends on thread count\n");
+    return 1;
+  }
+  int k = p1.nslots;
+  double mid[16], sorted[16];
+  for (size_t c = 0; c < eur->ncoins; c++)
+    sorted[p1.target[c]] = eur->coins[c].diameter_mm * sqrt(0.95);
+  for (int s = 0; s + 1 < k; s++)
+    mid[s] = 0.5 * (sorted[s] + sorted[s + 1]);
+  mid[k - 1] = INFINITY;
+  double plan_miss = misroute_of(d, eur->ncoins, p1.width, k, p1.target);
+  double mid_miss = misroute_of(d, eur->ncoins, mid, k, p1.target);
+  if (fabs(plan_miss - p1.misroute) > 1e-12 || !(plan_miss > 1e-3) ||
+      !(plan_miss < mid_miss)) {
+    fprintf(stderr, "slot widths %g not better than midpoints %g\n", plan_miss,
+            mid_miss);
+    return 1;
+  }
+  double mc[64 * 16];
+  long draws = 200000;
+  if (slot_error_matrix_mc(d, eur->ncoins, p1.width, k, draws, 7u, mc) != 0)
+    return 1;
+  for (size_t i = 0; i < eur->ncoins * (size_t)k; i++) {
+    double q = p1.error[i], tol = 5.0 * sqrt(q * (1.0 - q) / draws) + 1e-4;
+    if (fabs(mc[i] - q) > tol) {
+      fprintf(stderr, "Monte Carlo %g vs exact %g\n", mc[i], q);
+      return 1;
+    }
+  }
+  printf("worn eur: %.4f misrouted (midpoints %.4f)\n", plan_miss, mid_miss);
+  slot_plan_free(&p1);
+  slot_plan_free(&p3);
+  SlotPlan bad;
+  if (slot_plan_optimize(eur, NULL, 9, 0, &bad) != -1) {
+    fprintf(stderr, "more slots than coins accepted\n");
+    return 1;
+  }
+  return 0;
+}
+
 static int sum_counts(const CoinSystem *s, const int *c) {
   int total = 0;
   for (size_t i = 0; i < s->ncoins; i++)
@@ -17,6 +565,191 @@ static int sum_counts(const CoinSystem *s, const int *c) {
   return total;
 }
 
+/* large blocks: backing per policy, alignment, zeroing, first touch and the
+ * counters, plus a DP table large enough to be mapped */
+/* change table builds survive preemption: a child building with frequent
+ * snapshots is killed at an arbitrary point, and the resumed build must
+ * equal a plain one wherever the child stopped */
+static int check_change_table_resume(const CoinSystem *sys) {
+  const char *ckp = "test_change_ckpt.bin";
+  const int amount = 3000000;
+  ChangeTable ref, got;
+  if (change_table_build(sys, amount, &ref) != 0)
+    return 1;
+  for (int round = 0; round < 3; ++round) {
+    remove(ckp);
+    pid_t pid = fork();
+    if (pid == 0) {
+      Checkpointer *ck = checkpoint_open(ckp, 0.0, 64);
+      ChangeTable t;
+      change_table_build_resume(sys, amount, &t, ck);
+      _exit(0);
+    }
+    if (pid < 0)
+      return 1;
+    usleep(20000 * (useconds_t)round);
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    /* a write cut short leaves its temporary file behind */
+    glob_t g;
+    if (glob("test_change_ckpt.bin.*", 0, NULL, &g) == 0) {
+      for (size_t i = 0; i < g.gl_pathc; ++i)
+        remove(g.gl_pathv[i]);
+      globfree(&g);
+    }
+    Checkpointer *ck = checkpoint_open(ckp, 0.0, 0);
+    if (change_table_build_resume(sys, amount, &got, ck) != 0 ||
+        got.nblocks != ref.nblocks || got.counts_words != ref.counts_words ||
+        memcmp(got.blocks, ref.blocks,
+               ref.nblocks * sizeof(ChangeTableBlock)) != 0 ||
+        memcmp(got.counts, ref.counts, ref.counts_words * 8) != 0 ||
+        memcmp(got.last, ref.last, ref.last_words * 8) != 0) {
+      fprintf(stderr, "change table resume differs (round %d)\n", round);
+      return 1;
+    }
+    /* the final snapshot makes a second resume free */
+    CheckpointStats cs;
+    checkpoint_stats(ck, &cs);
+    CheckpointImage img;
+    if (cs.written != 1 || checkpoint_load(ckp, &img) != 0 ||
+        img.step != (long)ref.nblocks) {
+      fprintf(stderr, "change table final snapshot\n");
+      return 1;
+    }
+    checkpoint_image_free(&img);
+    checkpoint_close(ck);
+    change_table_free(&got);
+  }
+  change_table_free(&ref);
+  remove(ckp);
+  return 0;
+}
+
+static uint32_t le32(const unsigned char *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+static uint64_t le64(const unsigned char *p) {
+  return (uint64_t)le32(p) | (uint64_t)le32(p + 4) << 32;
+}
+
+/* position of field id of the flatbuffer table at t (0 if absent) */
+static size_t fb_at(const unsigned char *m, size_t t, int id) {
+  size_t vt = t - (size_t)(int32_t)le32(m + t);
+  unsigned vsize = m[vt] | m[vt + 1] << 8;
+  if (4 + 2 * (unsigned)id >= vsize)
+    return 0;
+  unsigned off = m[vt + 4 + 2 * id] | m[vt + 5 + 2 * id] << 8;
+  return off ? t + off : 0;
+}
+
+/* follow the offset stored at slot */
+static size_t fb_deref(const unsigned char *m, size_t slot) {
+  return slot + le32(m + slot);
+}
+
+/* Arrow IPC stream of change results: framing, batch lengths, null counts
+ * of missing metadata and the amount column bytes, read back by hand */
+static int check_arrow(const CoinSystem *usd) {
+  static const CoinSpec bare_coins[] = {{10, "10", "ten", 0.0, 20.0, NULL},
+                                        {1, "1", "one", 0.0, 0.0, NULL}};
+  const CoinSystem bare = {"bare", bare_coins, 2, 1, 1};
+  const char *path = "test_arrow.arrows";
+  FILE *fp = fopen(path, "wb+");
+  if (!fp)
+    return 1;
+  ArrowWriter *w = arrow_writer_open(fileno(fp), arrow_change_fields(),
+                                     ARROW_CHANGE_COLUMNS);
+  ArrowChangeBatch b;
+  arrow_change_init(&b);
+  int counts[16];
+  const int sizes[2] = {2500, 500};
+  int amount = 0;
+  for (int k = 0; k < 2 && w; ++k) {
+    for (int i = 0; i < sizes[k]; ++i, ++amount) {
+      const CoinSystem *sys = amount & 1 ? &bare : usd;
+      greedy_make_change(sys, amount, counts);
+      if (arrow_change_append(&b, sys, amount, counts, "greedy") != 0)
+        return 1;
+    }
+    if (arrow_change_flush(w, &b) != 0 || arrow_change_flush(w, &b) != 0) {
+      fprintf(stderr, "arrow flush\n");
+      return 1;
+    }
+  }
+  if (!w || arrow_writer_batch(w, 3, NULL) == 0 ||
+      arrow_writer_close(w) != 0) {
+    fprintf(stderr, "arrow writer\n");
+    return 1;
+  }
+  arrow_change_free(&b);
+  long len = ftell(fp);
+  unsigned char *data = (unsigned char *)malloc((size_t)len);
+  rewind(fp);
+  if (!data || fread(data, 1, (size_t)len, fp) != (size_t)len)
+    return 1;
+  fclose(fp);
+  remove(path);
+  size_t pos = 0;
+  int batches = 0, schema = 0, first = 0;
+  for (;;) {
+    if (pos + 8 > (size_t)len || le32(data + pos) != 0xFFFFFFFFu) {
+      fprintf(stderr, "arrow framing at %zu\n", pos);
+      return 1;
+    }
+    uint32_t meta = le32(data + pos + 4);
+    if (meta == 0) {
+      pos += 8;
+      break;
+    }
+    const unsigned char *m = data + pos + 8;
+    size_t msg = fb_deref(m, 0);
+    unsigned type = m[fb_at(m, msg, 1)];
+    size_t bl = fb_at(m, msg, 3);
+    uint64_t body = bl ? le64(m + bl) : 0;
+    const unsigned char *bodyp = m + meta;
+    if (meta % 8 || body % 8) {
+      fprintf(stderr, "arrow alignment\n");
+      return 1;
+    }
+    if (type == 1) {
+      size_t sc = fb_deref(m, fb_at(m, msg, 2));
+      size_t fields = fb_deref(m, fb_at(m, sc, 1));
+      schema += le32(m + fields) == ARROW_CHANGE_COLUMNS;
+    } else if (type == 3) {
+      size_t rb = fb_deref(m, fb_at(m, msg, 2));
+      int64_t rows = (int64_t)le64(m + fb_at(m, rb, 0));
+      size_t nodes = fb_deref(m, fb_at(m, rb, 1));
+      size_t bufs = fb_deref(m, fb_at(m, rb, 2));
+      /* amount, system, strategy, counts + item, total_coins, mass_g */
+      int64_t mass_nulls = (int64_t)le64(m + nodes + 4 + 16 * 6 + 8);
+      uint64_t aoff = le64(m + bufs + 4 + 16), alen = le64(m + bufs + 4 + 24);
+      if (rows != sizes[batches] || mass_nulls != rows / 2 ||
+          alen != 4 * (uint64_t)rows || aoff + alen > body) {
+        fprintf(stderr, "arrow batch %d: rows %lld nulls %lld\n", batches,
+                (long long)rows, (long long)mass_nulls);
+        return 1;
+      }
+      for (int64_t i = 0; i < rows; ++i)
+        if ((int32_t)le32(bodyp + aoff + 4 * i) != first + (int)i) {
+          fprintf(stderr, "arrow amount column\n");
+          return 1;
+        }
+      first += (int)rows;
+      ++batches;
+    }
+    pos += 8 + meta + body;
+  }
+  free(data);
+  if (schema != 1 || batches != 2 || pos != (size_t)len) {
+    fprintf(stderr, "arrow stream: %d schemas, %d batches\n", schema,
+            batches);
+    return 1;
+  }
+  return 0;
+}
+
 int main(void) {
   const CoinSystem *usd = get_coin_system("usd");
   if (!usd) {
@@ -126,6 +859,125 @@ int main(void) {
   /* eur may or may not be canonical; just call to exercise path */
   audit_canonical(eur, 0, &ex);
 
+  /* batched greedy matches the scalar loop for every system */
+  const char *names[] = {"usd", "eur", "cad", "aud", "nzd", "cny"};
+  enum { NB = 1003 }; /* not a multiple of the SIMD width */
+  int *amts = malloc(sizeof(int) * NB);
+  int *tc = malloc(sizeof(int) * NB * 32);
+  int *rows = malloc(sizeof(int) * NB * 32);
+  if (!amts || !tc || !rows) {
+    fprintf(stderr, "batch alloc fail\n");
+    return 1;
+  }
+  for (int i = 0; i < NB; i++)
+    amts[i] = i < 900 ? i * 7 : 2147483647 - (i - 900) * 1234567;
+  amts[5] = -3;
+  for (size_t k = 0; k < sizeof(names) / sizeof(names[0]); k++) {
+    const CoinSystem *s = get_coin_system(names[k]);
+    if (!s)
+      continue;
+    int expect_bad = 0;
+    for (int i = 0; i < NB; i++)
+      if (amts[i] < 0 || greedy_make_change(s, amts[i], c1) != 0)
+        expect_bad++;
+    int bad = greedy_make_change_batch(s, amts, NB, tc);
+    /* the scalar path (no SIMD) gives the same counts */
+    unsigned simd = cpu_features_limit(0);
+    int bad0 = greedy_make_change_batch(s, amts, NB, rows);
+    cpu_features_limit(simd);
+    if (bad0 != bad || memcmp(rows, tc, sizeof(int) * NB * s->ncoins) != 0) {
+      fprintf(stderr, "%s batch SIMD/scalar mismatch\n", names[k]);
+      return 1;
+    }
+    change_counts_transpose(tc, NB, s->ncoins, rows);
+    if (bad != expect_bad) {
+      fprintf(stderr, "%s batch inexact %d != %d\n", names[k], bad,
+              expect_bad);
+      return 1;
+    }
+    for (int i = 0; i < NB; i++) {
+      if (amts[i] < 0)
+        continue;
+      greedy_make_change(s, amts[i], c1);
+      for (size_t c = 0; c < s->ncoins; c++)
+        if (rows[i * s->ncoins + c] != c1[c] ||
+            tc[c * NB + i] != c1[c]) {
+          fprintf(stderr, "%s batch mismatch amount %d coin %zu\n", names[k],
+                  amts[i], c);
+          return 1;
+        }
+    }
+    for (size_t c = 0; c < s->ncoins; c++)
+      if (rows[5 * s->ncoins + c] != 0) {
+        fprintf(stderr, "negative amount produced counts\n");
+        return 1;
+      }
+  }
+  free(amts);
+  free(tc);
+  free(rows);
+  /* outputs beyond the caches take the streaming-store path when aligned */
+  {
+    const size_t nb = (size_t)1 << 21, bytes = nb * usd->ncoins * sizeof(int);
+    int *big = malloc(nb * sizeof(int));
+    char *raw = malloc(bytes + 32), *raw0 = malloc(bytes);
+    if (!big || !raw || !raw0) {
+      fprintf(stderr, "batch alloc fail\n");
+      return 1;
+    }
+    int *out = (int *)(raw + (32 - ((uintptr_t)raw & 31)) % 32);
+    for (size_t i = 0; i < nb; i++)
+      big[i] = (int)((i * 2654435761u) % 1000000u);
+    unsigned simd = cpu_features_limit(0);
+    greedy_make_change_batch(usd, big, nb, (int *)raw0);
+    cpu_features_limit(simd);
+    greedy_make_change_batch(usd, big, nb, out);
+    if (memcmp(out, raw0, bytes) != 0) {
+      fprintf(stderr, "streamed batch mismatch\n");
+      return 1;
+    }
+    free(big);
+    free(raw);
+    free(raw0);
+  }
+
+  /* compressed change tables, including a system with gaps (no unit coin) */
+  static const CoinSpec gap_coins[] = {{7, "7", "seven", 0, 0, NULL},
+                                       {5, "5", "five", 0, 0, NULL},
+                                       {3, "3", "three", 0, 0, NULL}};
+  const CoinSystem gap = {"gap", gap_coins, 3, 1, 0};
+  if (check_change_table(usd, 20000, "test_change_usd.tbl") ||
+      check_change_table(eur, 20000, "test_change_eur.tbl") ||
+      check_change_table(&gap, 3000, "test_change_gap.tbl"))
+    return 1;
+
+  /* bitset reachability, including coins wider than a word (>= 64, 256) */
+  static const CoinSpec wide_coins[] = {{300, "300", "wide", 0, 0, NULL},
+                                        {70, "70", "word", 0, 0, NULL},
+                                        {9, "9", "nine", 0, 0, NULL}};
+  const CoinSystem wide = {"wide", wide_coins, 3, 1, 0};
+  /* with the CPU's SIMD kernels, then with the scalar ones */
+  unsigned simd = cpu_features();
+  for (int pass = 0; pass < 2; pass++) {
+    cpu_features_limit(pass ? 0 : simd);
+    if (check_bitsets(usd, 5000) || check_bitsets(eur, 5000) ||
+        check_bitsets(&gap, 2000) || check_bitsets(&wide, 7000))
+      return 1;
+  }
+  cpu_features_limit(simd);
+  if (check_mixed(usd, eur))
+    return 1;
+  if (check_latency(usd))
+    return 1;
+  if (check_metrics(usd))
+    return 1;
+  if (check_slots())
+    return 1;
+  if (check_change_table_resume(eur))
+    return 1;
+  if (check_arrow(usd))
+    return 1;
+
   printf("advanced coin tests passed\n");
   return 0;
 }
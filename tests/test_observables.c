@@ -6,10 +6,16 @@
  * to ensure accurate material property lookup and calculations.
  */
 #include "observables.h"
+#include "material_tables.h"
 #include "coins.h"
+#include "fdtd.h"
+#include "fft.h"
+#include "coin_acoustics.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <time.h>
 
 #define TEST_TOLERANCE 1e-6
 
@@ -169,6 +175,214 @@ int main(void) {
     assert_test(fabs(al_props->magnetic_susceptibility) < 1e-4, "Aluminum weakly magnetic");
   }
   
+  /* Temperature-dependent property tables */
+  printf("\n--- Temperature Table Tests ---\n");
+  
+  long cu_idx = material_index(get_material_properties_by_composition("copper"));
+  assert_test(cu_idx == 0, "Copper database index");
+  assert_test(material_index(NULL) == -1, "Foreign material index");
+  double sigma_ref = material_table_lookup(0, MT_ELECTRICAL_CONDUCTIVITY, 293.15);
+  assert_test(fabs(sigma_ref / 59.6e6 - 1.0) < 5e-3, "Table matches database at 293 K");
+  double sigma_mars = material_table_lookup(0, MT_ELECTRICAL_CONDUCTIVITY, 210.0);
+  double sigma_hot = material_table_lookup(0, MT_ELECTRICAL_CONDUCTIVITY, 400.0);
+  assert_test(sigma_mars > sigma_ref && sigma_ref > sigma_hot, "Metal conductivity falls with T");
+  double cp_cold = material_table_lookup(0, MT_SPECIFIC_HEAT, 150.0);
+  assert_test(cp_cold < 385.0 && cp_cold > 250.0, "Debye specific heat drop at 150 K");
+  assert_test(material_table_lookup(0, MT_THERMAL_EXPANSION, 10.0) ==
+              material_table_lookup(0, MT_THERMAL_EXPANSION, 150.0), "Lookup clamps below grid");
+  
+  double temps[7] = {100.0, 150.0, 212.5, 250.0, 293.15, 377.7, 900.0};
+  double batch[7];
+  material_table_lookup_batch(5, MT_THERMAL_CONDUCTIVITY, temps, batch, 7);
+  int batch_ok = 1;
+  for (int i = 0; i < 7; i++) {
+    batch_ok &= batch[i] == material_table_lookup(5, MT_THERMAL_CONDUCTIVITY, temps[i]);
+    if (i > 0) {
+      batch_ok &= batch[i] >= batch[i - 1]; /* alloy: lattice + rising electronic part */
+    }
+  }
+  assert_test(batch_ok, "Batch lookup matches scalar and is monotone");
+  size_t mats[3] = {0, 3, 99};
+  double mixed[3];
+  material_table_lookup_mixed(mats, MT_ELECTRICAL_CONDUCTIVITY, temps + 3, mixed, 3);
+  assert_test(mixed[0] == material_table_lookup(0, MT_ELECTRICAL_CONDUCTIVITY, 250.0) &&
+              mixed[1] == material_table_lookup(3, MT_ELECTRICAL_CONDUCTIVITY, 293.15) &&
+              mixed[2] == 0.0, "Mixed-material lookup");
+  
+  double skin_cold = observable_skin_depth_at(1e6, cu_props, 150.0);
+  double skin_warm = observable_skin_depth_at(1e6, cu_props, 400.0);
+  assert_test(skin_cold < skin_warm, "Skin depth grows with temperature");
+  double diff_ref = observable_thermal_diffusivity(cu_props);
+  assert_test(fabs(observable_thermal_diffusivity_at(cu_props, 293.15) / diff_ref - 1.0) < 1e-2,
+              "Diffusivity at reference temperature");
+  
+  /* FFT and FDTD field solver */
+  printf("\n--- FDTD Tests ---\n");
+  
+  double re[64], im[64], orig[64];
+  for (int i = 0; i < 64; i++) {
+    orig[i] = re[i] = cos(2.0 * M_PI * 5.0 * i / 64.0) + 0.25 * sin(0.3 * i * i);
+    im[i] = 0.0;
+  }
+  fft_radix2(re, im, 64, 0);
+  assert_test(fabs(hypot(re[5], im[5]) - 32.0) < 2.0,
+              "FFT puts a cosine in its bin");
+  fft_radix2(re, im, 64, 1);
+  double roundtrip = 0.0;
+  for (int i = 0; i < 64; i++)
+    roundtrip = fmax(roundtrip, fabs(re[i] - orig[i]) + fabs(im[i]));
+  assert_test(roundtrip < 1e-12, "FFT inverse round trip");
+  assert_test(fft_radix2(re, im, 48, 0) == -1, "FFT rejects non power of two");
+  
+  assert_test(fdtd_create(20, 20, 1e-3, 10) == NULL, "FDTD rejects grid smaller than PML");
+  FdtdGrid *g1 = fdtd_create(96, 80, 1e-3, 10);
+  FdtdGrid *g3 = fdtd_create(96, 80, 1e-3, 10);
+  int probe = -1;
+  if (g1 && g3) {
+    const CoinSystem *usd = get_coin_system("usd");
+    for (int k = 0; k < 2; k++) {
+      FdtdGrid *g = k ? g3 : g1;
+      fdtd_add_source(g, 30, 40, 10e9, 1.0);
+      probe = fdtd_add_probe(g, 45, 40);
+      fdtd_add_coin(g, &usd->coins[0], 0.066, 0.040);
+    }
+    int steps_ok = fdtd_run(g1, 120, 1) == 0 && fdtd_run(g3, 120, 3) == 0;
+    assert_test(steps_ok && memcmp(fdtd_ez(g1), fdtd_ez(g3), sizeof(float) * 96 * 80) == 0,
+                "FDTD independent of thread count");
+    double peak = fdtd_energy(g1, NULL);
+    double *density = malloc(sizeof(double) * 96 * 80);
+    fdtd_energy(g1, density);
+    double vac = density[40 * 96 + 45], metal = density[40 * 96 + 66];
+    assert_test(peak > 0.0 && metal < 1e-6 * vac, "Field excluded from metal coin");
+    free(density);
+    fdtd_run(g1, 1500, 0);
+    assert_test(fdtd_energy(g1, NULL) < 1e-3 * peak, "CPML absorbs outgoing waves");
+    double freq[512], amp[512];
+    size_t bins = fdtd_probe_spectrum(g1, probe, freq, amp, 512);
+    size_t best = 1;
+    for (size_t k = 1; k < bins; k++)
+      if (amp[k] > amp[best])
+        best = k;
+    assert_test(bins > 0 && fabs(freq[best] / 10e9 - 1.0) < 0.15,
+                "Probe spectrum peaks at source frequency");
+    assert_test(fdtd_probe_samples(g1, probe, NULL) == 1620, "Probe records every step");
+  }
+  assert_test(g1 && g3, "FDTD grids created");
+  fdtd_destroy(g1);
+  fdtd_destroy(g3);
+
+  /* Acoustic ring signatures */
+  printf("\n--- Coin Acoustics Tests ---\n");
+
+  FftPlan *plan = fft_plan_create(64);
+  double pr[64], pi[64], m1[33], m2[33], sr[64], si[64];
+  for (int i = 0; i < 64; i++) {
+    pr[i] = orig[i];
+    pi[i] = sin(2.0 * M_PI * 9.0 * i / 64.0);
+  }
+  fft_real_pair(plan, pr, pi, m1, m2);
+  double pair_err = 0.0;
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < 64; i++) {
+      sr[i] = pass ? sin(2.0 * M_PI * 9.0 * i / 64.0) : orig[i];
+      si[i] = 0.0;
+    }
+    fft_radix2(sr, si, 64, 0);
+    for (int k = 0; k <= 32; k++)
+      pair_err = fmax(pair_err, fabs(hypot(sr[k], si[k]) - (pass ? m2 : m1)[k]));
+  }
+  assert_test(plan && pair_err < 1e-12, "Paired real FFT splits both spectra");
+  fft_plan_destroy(plan);
+  assert_test(fft_plan_create(48) == NULL, "FFT plan rejects non power of two");
+
+  /* Leissa, Vibration of Plates, table 2.3 (nu = 0.33) */
+  assert_test(fabs(coin_plate_lambda2(2, 0, 0.33) / 5.253 - 1.0) < 5e-3 &&
+              fabs(coin_plate_lambda2(0, 1, 0.33) / 9.084 - 1.0) < 5e-3 &&
+              fabs(coin_plate_lambda2(3, 0, 0.33) / 12.23 - 1.0) < 5e-3 &&
+              fabs(coin_plate_lambda2(1, 1, 0.33) / 20.52 - 1.0) < 5e-3,
+              "Free plate roots match Leissa");
+  assert_test(coin_plate_lambda2(0, 0, 0.33) < 0.0 && coin_plate_lambda2(1, 0, 0.33) < 0.0,
+              "Rigid-body modes rejected");
+
+  CoinMode modes[8], thick[8];
+  int nm = coin_ring_modes(&usd->coins[0], 0.0, 3, 5, modes);
+  int order_ok = nm == 8;
+  for (int i = 1; i < nm; i++)
+    if (i != 3 && modes[i].freq_hz <= modes[i - 1].freq_hz)
+      order_ok = 0;
+  for (int i = 0; i < nm; i++)
+    if ((i < 3) != (modes[i].nodal_diameters == 0))
+      order_ok = 0;
+  assert_test(order_ok && modes[3].nodal_diameters == 2 && modes[3].nodal_circles == 0,
+              "Ring modes grouped and ordered");
+  double h = coin_plate_thickness_mm(&usd->coins[0]);
+  coin_ring_modes(&usd->coins[0], 2.0 * h, 3, 5, thick);
+  assert_test(fabs(thick[3].freq_hz / modes[3].freq_hz - 2.0) < 1e-9 &&
+              modes[3].freq_hz > 5e3 && modes[3].freq_hz < 20e3,
+              "Ring frequency linear in thickness, audible for a quarter");
+
+  AcousticMatcher *am = acoustic_matcher_create(NULL);
+  size_t nref = acoustic_reference_count(am);
+  size_t total_coins = 0;
+  for (size_t sidx = 0; sidx < coin_system_count(); sidx++)
+    total_coins += get_coin_system_by_index(sidx)->ncoins;
+  assert_test(am && nref == total_coins, "Reference for every coin of every system");
+  if (am) {
+    size_t N = 4096, drops = 3 * nref + 1;
+    double *sig = malloc(sizeof(double) * N * drops);
+    AcousticMatch *res1 = malloc(sizeof(AcousticMatch) * drops);
+    AcousticMatch *res3 = malloc(sizeof(AcousticMatch) * drops);
+    for (size_t r = 0; r < nref; r++) {
+      acoustic_synthesize(am, r, 1.0, 0.0, 1u, sig + (3 * r) * N, N);
+      acoustic_synthesize(am, r, 1.0, 0.15, 2u, sig + (3 * r + 1) * N, N);
+      acoustic_synthesize(am, r, 1.01, 0.05, 3u, sig + (3 * r + 2) * N, N);
+    }
+    memset(sig + (drops - 1) * N, 0, sizeof(double) * N);
+    AcousticConfig ac;
+    acoustic_default_config(&ac);
+    ac.threads = 3;
+    AcousticMatcher *am3 = acoustic_matcher_create(&ac);
+    int run_ok = acoustic_match_batch(am, sig, drops, N, N, res1) == 0 &&
+                 acoustic_match_batch(am3, sig, drops, N, N, res3) == 0;
+    int clean = 0, noisy = 0, scaled = 0, scale_ok = 1;
+    for (size_t r = 0; r < nref; r++) {
+      clean += res1[3 * r].ref == (long)r;
+      noisy += res1[3 * r + 1].ref == (long)r;
+      /* same-alloy coins whose modes lie within max_scale of each other
+       * are indistinguishable once scaled, so the truth must be in the top
+       * two */
+      const AcousticMatch *sm = &res1[3 * r + 2];
+      scaled += sm->ref == (long)r || sm->runner_up == (long)r;
+      if (sm->ref == (long)r && fabs(sm->scale - 1.01) > 0.01)
+        scale_ok = 0;
+    }
+    printf("  identified %d/%zu clean, %d noisy, %d scaled by 1%% (top two)\n", clean, nref,
+           noisy, scaled);
+    assert_test(run_ok && clean == (int)nref && res1[0].score > 0.95,
+                "Clean drops identified");
+    assert_test(noisy == (int)nref, "Noisy drops identified");
+    assert_test(scaled == (int)nref && scale_ok, "Scaled drops identified with scale");
+    assert_test(res1[drops - 1].ref == -1, "Silent drop matches nothing");
+    assert_test(run_ok && memcmp(res1, res3, sizeof(AcousticMatch) * drops) == 0,
+                "Matching independent of thread count");
+    assert_test(acoustic_match_batch(am, sig, 2, N / 2, N, res1) == -1,
+                "Overlapping recordings rejected");
+
+    clock_t t0 = clock();
+    int reps = 0;
+    do {
+      acoustic_match_batch(am, sig, drops, N, N, res1);
+      reps++;
+    } while (clock() - t0 < CLOCKS_PER_SEC / 4);
+    double secs = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    printf("  %.0f drops/s against %zu references\n", reps * drops / secs, nref);
+    free(sig);
+    free(res1);
+    free(res3);
+    acoustic_matcher_destroy(am3);
+  }
+  acoustic_matcher_destroy(am);
+  
   /* Summary */
   printf("\n=== Test Results ===\n");
   printf("Tests passed: %d/%d\n", test_passed, test_count);
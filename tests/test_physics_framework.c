@@ -3,6 +3,10 @@
  */
 #include "physics_framework.h"
 #include "physics_components.h"
+#include "physics_constants.h"
+#include "physics_expr.h"
+#include "casimir.h"
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -140,6 +144,341 @@ static int test_physics_calculations(void) {
     return 0;
 }
 
+static int test_lifshitz(void) {
+    printf("Testing Lifshitz Casimir engine...\n");
+    
+    /* perfect reflectors recover the T=0 ideal-metal pressure at short range */
+    LifshitzConfig cfg;
+    assert(lifshitz_config_from_conductivity(&cfg, 59.6e6, 300.0, LIFSHITZ_IDEAL) == 0);
+    double a = 100e-9;
+    double p0 = -PHYSICS_PI * PHYSICS_PI * PHYSICS_HBAR_C / (240.0 * a * a * a * a);
+    assert(fabs(lifshitz_pressure(&cfg, a) / p0 - 1.0) < 1e-3);
+    
+    /* real metals: weaker than ideal, plasma >= Drude, sphere matches PFA */
+    cfg.model = LIFSHITZ_DRUDE;
+    double pd = lifshitz_pressure(&cfg, a);
+    cfg.model = LIFSHITZ_PLASMA;
+    double pp = lifshitz_pressure(&cfg, a);
+    assert(pd < 0.0 && pp < 0.0);
+    assert(fabs(pp) < fabs(p0) && fabs(pd) <= fabs(pp));
+    cfg.geometry = LIFSHITZ_SPHERE_PLATE;
+    cfg.radius = 5e-6;
+    double seps[8], curve[8];
+    for (int i = 0; i < 8; i++)
+        seps[i] = 20e-9 * (i + 1);
+    assert(lifshitz_force_curve(&cfg, seps, 8, curve, 2) == 0);
+    for (int i = 0; i < 8; i++) {
+        assert(curve[i] < 0.0);
+        assert(fabs(curve[i]) < casimir_base(cfg.radius, seps[i]));
+        if (i > 0)
+            assert(fabs(curve[i]) < fabs(curve[i - 1]));
+    }
+    assert(fabs(curve[4] - lifshitz_force(&cfg, seps[4])) <= 1e-12 * fabs(curve[4]));
+    
+    /* framework component and the composite that consumes it */
+    PhysicsParam params[] = {
+        physics_param_create_double("radius", PHYSICS_DIM_LENGTH, "m", "Sphere radius", 5e-6),
+        physics_param_create_double("distance", PHYSICS_DIM_LENGTH, "m", "Plate distance", 100e-9),
+        physics_param_create_double("conductivity", PHYSICS_DIM_DIMENSIONLESS, "S/m", "Conductivity", 59.6e6)
+    };
+    PhysicsResult r = physics_casimir_lifshitz_component.calculate(
+        &physics_casimir_lifshitz_component, params, 3);
+    assert(r.is_valid && r.dimension == PHYSICS_DIM_FORCE);
+    assert(r.value > 0.0 && r.value < casimir_base(5e-6, 100e-9));
+    assert(r.uncertainty > 0.0);
+    PhysicsResult c = physics_casimir_complete_component.calculate(
+        &physics_casimir_complete_component, params, 3);
+    assert(c.is_valid && fabs(c.value - 1.5 * r.value) < 1e-6 * r.value);
+    
+    printf("✓ Lifshitz Casimir engine\n");
+    return 0;
+}
+
+static double max_slope(const double *h, int n) {
+    double m = 0.0;
+    for (int y = 0; y + 1 < n; y++)
+        for (int x = 0; x + 1 < n; x++) {
+            m = fmax(m, fabs(h[y * n + x + 1] - h[y * n + x]));
+            m = fmax(m, fabs(h[(y + 1) * n + x] - h[y * n + x]));
+        }
+    return m;
+}
+
+static int test_erosion(void) {
+    printf("Testing erosion...\n");
+    
+    const int n = 129;
+    size_t cells = (size_t)n * n;
+    double *a = malloc(cells * sizeof(double));
+    double *b = malloc(cells * sizeof(double));
+    assert(a && b);
+    assert(fbm_diamond_square(a, n, 0.8, 11) == 0);
+    memcpy(b, a, cells * sizeof(double));
+    double before = 0.0;
+    for (size_t i = 0; i < cells; i++)
+        before += a[i];
+    
+    /* hydraulic: mass balance and thread-count independence */
+    ErosionParams ep;
+    erosion_default_params(&ep);
+    ep.droplets = 20000;
+    ep.seed = 3;
+    ep.threads = 1;
+    ErosionStats sa, sb;
+    assert(erosion_hydraulic(a, n, n, &ep, &sa) == 0);
+    ep.threads = 4;
+    assert(erosion_hydraulic(b, n, n, &ep, &sb) == 0);
+    assert(memcmp(a, b, cells * sizeof(double)) == 0);
+    assert(sa.steps == sb.steps && sa.steps > 0 && sa.eroded > 0.0);
+    double after = 0.0;
+    for (size_t i = 0; i < cells; i++)
+        after += a[i];
+    assert(fabs(after - (before - sa.eroded + sa.deposited)) <=
+           1e-9 * fabs(before));
+    /* stopped droplets drop their load: the heightfield keeps its mass */
+    assert(fabs(after - before) <= 1e-9 * fabs(before));
+    assert(fabs(sa.eroded - sa.deposited) <= 1e-9 * sa.eroded);
+    ep.radius = 99;
+    assert(erosion_hydraulic(a, n, n, &ep, NULL) == -1);
+    
+    /* thermal: conserves mass, flattens slopes, deterministic */
+    double slope = max_slope(a, n);
+    assert(erosion_thermal(a, n, n, 0.002, 0.5, 40, 1) == 0);
+    assert(erosion_thermal(b, n, n, 0.002, 0.5, 40, 3) == 0);
+    assert(memcmp(a, b, cells * sizeof(double)) == 0);
+    double relaxed = 0.0;
+    for (size_t i = 0; i < cells; i++)
+        relaxed += a[i];
+    assert(fabs(relaxed - after) <= 1e-9 * fabs(after));
+    assert(max_slope(a, n) < slope);
+    assert(erosion_thermal(a, n, n, 0.002, 1.5, 1, 1) == -1);
+    
+    /* framework component on a caller-owned terrain */
+    assert(fbm_diamond_square(b, n, 0.8, 11) == 0);
+    PhysicsParam terrain = {0};
+    terrain.desc.name = "heightfield";
+    terrain.desc.type = PHYSICS_PARAM_POINTER;
+    terrain.value.p = b;
+    terrain.is_set = true;
+    PhysicsParam params[] = {
+        terrain,
+        physics_param_create_double("size", PHYSICS_DIM_DIMENSIONLESS, "cells", "Grid side", n),
+        physics_param_create_double("droplets", PHYSICS_DIM_DIMENSIONLESS, "count", "Droplets", 5000)
+    };
+    PhysicsResult r = physics_erosion_component.calculate(
+        &physics_erosion_component, params, 3);
+    assert(r.is_valid && r.value > 0.0);
+    /* A heightfield without its size is refused rather than overrun */
+    r = physics_erosion_component.calculate(&physics_erosion_component,
+                                            params, 1);
+    assert(!r.is_valid && r.error_msg != NULL);
+    free(a);
+    free(b);
+    
+    printf("✓ Hydraulic and thermal erosion\n");
+    return 0;
+}
+
+static int test_incremental(void) {
+    printf("Testing incremental re-execution...\n");
+    
+    PhysicsContext *context = physics_create_composite_demo_context();
+    assert(context != NULL);
+    assert(context->num_components == 3);
+    
+    /* First run computes everything, in dependency order */
+    const PhysicsResult *results = NULL;
+    assert(physics_context_execute_incremental(context, &results) == 3);
+    for (size_t i = 0; i < 3; i++) {
+        assert(results[i].is_valid);
+        assert(context->exec_counts[i] == 1);
+    }
+    assert(context->num_upstream[2] == 2);
+    double qft = results[0].value;
+    double casimir = fabs(results[1].value);
+    assert(fabs(results[2].value - (qft * 1e6 + casimir * 1e12 + 0.371)) <=
+           1e-12 * fabs(results[2].value));
+    
+    /* Nothing changed: nothing to do */
+    assert(physics_context_execute_incremental(context, &results) == 0);
+    
+    /* Gravity only feeds the composite */
+    PhysicsParamValue v;
+    v.d = 9.807;
+    assert(physics_context_set_param(context, "gravity", v) == 1);
+    assert(physics_context_execute_incremental(context, &results) == 1);
+    assert(context->exec_counts[0] == 1);
+    assert(context->exec_counts[1] == 1);
+    assert(context->exec_counts[2] == 2);
+    assert(fabs(results[2].value - (qft * 1e6 + casimir * 1e12 + 0.9807)) <=
+           1e-12 * fabs(results[2].value));
+    
+    /* Setting the same value is not a change */
+    assert(physics_context_set_param(context, "gravity", v) == 0);
+    
+    /* Temperature reaches the composite through the Casimir result */
+    v.d = 350.0;
+    assert(physics_context_set_param(context, "temperature", v) == 2);
+    assert(physics_context_execute_incremental(context, &results) == 2);
+    assert(context->exec_counts[0] == 1);
+    assert(context->exec_counts[1] == 2);
+    assert(context->exec_counts[2] == 3);
+    
+    v.d = 1.2;
+    assert(physics_context_set_param(context, "coupling", v) == 2);
+    assert(physics_context_execute_incremental(context, &results) == 2);
+    assert(context->exec_counts[0] == 2);
+    assert(context->exec_counts[1] == 2);
+    
+    v.d = 1.0;
+    assert(physics_context_set_param(context, "no_such_param", v) == -1);
+    
+    /* A full run agrees with the incremental state */
+    PhysicsResult *full = NULL;
+    assert(physics_context_execute(context, &full) == 0);
+    for (size_t i = 0; i < 3; i++) {
+        assert(full[i].value == results[i].value);
+        assert(context->exec_counts[i] >= 3);
+    }
+    free(full);
+    
+    /* Dependencies are ordered before their consumers */
+    PhysicsComponent *comps[3] = {
+        (PhysicsComponent *)&physics_complete_demo_component,
+        (PhysicsComponent *)&physics_casimir_complete_component,
+        (PhysicsComponent *)&physics_qft_rg_component
+    };
+    PhysicsComponent **ordered = NULL;
+    assert(physics_resolve_dependencies(comps, 3, &ordered) == 0);
+    assert(ordered[0] == comps[1]);
+    assert(ordered[1] == comps[2]);
+    assert(ordered[2] == comps[0]);
+    free(ordered);
+    
+    physics_context_destroy(context);
+    
+    printf("✓ Incremental re-execution\n");
+    return 0;
+}
+
+static int test_expressions(void) {
+    printf("Testing expression components...\n");
+    
+    const PhysicsParamDesc casimir_descs[] = {
+        {"radius", PHYSICS_PARAM_DOUBLE, PHYSICS_DIM_LENGTH, "m", "Sphere radius", true, 1e-9, 1e-3},
+        {"distance", PHYSICS_PARAM_DOUBLE, PHYSICS_DIM_LENGTH, "m", "Plate distance", true, 1e-12, 1e-6}
+    };
+    char err[256];
+    
+    /* Same formula as casimir_base, compiled at runtime */
+    PhysicsComponent *comp = physics_expr_component_create(
+        "casimir_expr", "Sphere-plate Casimir force",
+        "pi^3 * hbar * c * radius / (360 * distance^3)",
+        casimir_descs, 2, PHYSICS_DIM_FORCE, "N", err, sizeof(err));
+    assert(comp != NULL);
+    const PhysicsExpr *expr = physics_expr_component_expr(comp);
+    assert(expr != NULL);
+    assert(physics_expr_num_instructions(expr) <= 5); /* constants folded */
+    assert(physics_expr_component_expr(&physics_casimir_base_component) == NULL);
+    
+    /* Runs in a context next to the built-in it replicates */
+    PhysicsContext *context = physics_context_create();
+    assert(context != NULL);
+    PhysicsParam params[] = {
+        physics_param_create_double("radius", PHYSICS_DIM_LENGTH, "m", "Sphere radius", 5e-6),
+        physics_param_create_double("distance", PHYSICS_DIM_LENGTH, "m", "Plate distance", 20e-9)
+    };
+    assert(physics_context_add_component(context, (PhysicsComponent *)&physics_casimir_base_component,
+                                         params, 2) == 0);
+    assert(physics_context_add_component(context, comp, params, 2) == 0);
+    PhysicsResult *results = NULL;
+    assert(physics_context_execute(context, &results) == 0);
+    assert(results[1].is_valid);
+    assert(results[1].dimension == PHYSICS_DIM_FORCE);
+    assert(fabs(results[1].value - results[0].value) <= 1e-12 * fabs(results[0].value));
+    free(results);
+    physics_context_destroy(context);
+    
+    /* Batched evaluation matches the scalar path */
+    enum { N = 1000 };
+    double *radius = (double *)malloc(3 * N * sizeof(double));
+    assert(radius != NULL);
+    double *distance = radius + N, *out = radius + 2 * N;
+    for (int i = 0; i < N; i++) {
+        radius[i] = 1e-6 * (1 + i % 17);
+        distance[i] = 1e-8 * (1 + i % 13);
+    }
+    const double *columns[2] = {radius, distance};
+    assert(physics_expr_eval_batch(expr, columns, N, out) == 0);
+    for (int i = 0; i < N; i++) {
+        double ref = casimir_base(radius[i], distance[i]);
+        assert(fabs(out[i] - ref) <= 1e-12 * fabs(ref));
+    }
+    free(radius);
+    
+    /* Operators, functions, precedence */
+    const PhysicsParamDesc x_desc[] = {
+        {"x", PHYSICS_PARAM_DOUBLE, PHYSICS_DIM_DIMENSIONLESS, "", "x", true, -INFINITY, INFINITY}
+    };
+    const struct {
+        const char *src;
+        double x, expect;
+    } cases[] = {
+        {"-x^2", 3.0, -9.0},
+        {"2^-1 + x", 1.0, 1.5},
+        {"x ** 3 - 2*x + 1", 2.0, 5.0},
+        {"x^-2", 2.0, 0.25},
+        {"x^1.5", 4.0, 8.0},
+        {"x^0.3", 2.0, pow(2.0, 0.3)},
+        {"2^x", 3.0, 8.0},
+        {"pow(x, x)", 3.0, 27.0},
+        {"max(x, 1) + min(x, 0)", -2.0, -1.0},
+        {"exp(log(x)) + abs(-x) + sqrt(x*x) + tanh(0)", 2.0, 6.0},
+        {"sin(x)^2 + cos(x)^2", 0.7, 1.0},
+        {"(1 - x) / (1 + x)", 3.0, -0.5},
+        {"7", 5.0, 7.0},
+        {"x", 5.0, 5.0},
+        {"PHYSICS_ALPHA * 0 + alpha / PHYSICS_ALPHA", 0.0, 1.0},
+        {"x*x*x*x*x*x*x*x + x^12", 1.0, 2.0}
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        PhysicsExpr *e = physics_expr_compile(cases[i].src, x_desc, 1, PHYSICS_DIM_DIMENSIONLESS,
+                                              err, sizeof(err));
+        assert(e != NULL);
+        double v = physics_expr_eval(e, &cases[i].x);
+        assert(fabs(v - cases[i].expect) <= 1e-12 * (1.0 + fabs(cases[i].expect)));
+        physics_expr_destroy(e);
+    }
+    
+    /* Dimensional and syntax errors are found at compile time */
+    const char *bad[] = {
+        "radius + distance^2",        /* L + L^2 */
+        "exp(radius)",                /* dimensioned argument */
+        "radius^distance",            /* dimensioned exponent */
+        "hbar * c / distance",        /* energy, not force */
+        "radius * (distance",         /* syntax */
+        "radius * depth",             /* unknown name */
+        "cosh(radius)",               /* unknown function */
+        "sqrt(sqrt(radius)) * radius" /* L^(1/4) */
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        err[0] = '\0';
+        assert(physics_expr_compile(bad[i], casimir_descs, 2, PHYSICS_DIM_FORCE,
+                                    err, sizeof(err)) == NULL);
+        assert(err[0] != '\0');
+    }
+    /* Half-integer dimensions are allowed in between */
+    PhysicsExpr *e = physics_expr_compile("sqrt(radius) * sqrt(distance) * hbar * c / distance^3",
+                                          casimir_descs, 2, PHYSICS_DIM_FORCE, err, sizeof(err));
+    assert(e != NULL);
+    physics_expr_destroy(e);
+    
+    physics_expr_component_destroy(comp);
+    
+    printf("✓ Expression components\n");
+    return 0;
+}
+
 int main(void) {
     printf("=== Physics Framework Test Suite ===\n");
     
@@ -150,6 +489,10 @@ int main(void) {
     failed += test_parameter_validation();
     failed += test_dimensional_analysis();
     failed += test_physics_calculations();
+    failed += test_lifshitz();
+    failed += test_erosion();
+    failed += test_incremental();
+    failed += test_expressions();
     
     if (failed == 0) {
         printf("\n✓ All physics framework tests passed!\n");
@@ -1,7 +1,32 @@
+#include "checkpoint.h"
+#include "cpu_features.h"
+#include "field_codec.h"
+#include "parallel.h"
+#include "reduce.h"
+#include "relief.h"
 #include "simulation.h"
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  ParallelBarrier *barrier;
+  int size;
+  int arrived;
+  int early; /* slices that passed the barrier before everyone arrived */
+} TeamCheck;
+
+static void team_task(void *ctx, int task, int thread) {
+  (void)task;
+  (void)thread;
+  TeamCheck *c = (TeamCheck *)ctx;
+  __atomic_fetch_add(&c->arrived, 1, __ATOMIC_SEQ_CST);
+  parallel_barrier_wait(c->barrier);
+  if (__atomic_load_n(&c->arrived, __ATOMIC_SEQ_CST) != c->size)
+    __atomic_fetch_add(&c->early, 1, __ATOMIC_SEQ_CST);
+}
 
 int main(void) {
   int N = 33;
@@ -27,6 +52,179 @@ int main(void) {
     fprintf(stderr, "residual not decreasing %g -> %g\n", r1, r2);
     return 1;
   }
+  /* batched SOR: quadratic solutions are exact on the grid, one lane group
+   * is partial, and the result does not depend on the thread count */
+  {
+    enum { BX = 33, BY = 21, BC = 13 };
+    size_t bsz = poisson_batch_size(BX, BY, BC), cells = (size_t)BX * BY;
+    double *exact = malloc(sizeof(double) * cells * BC);
+    double *fields = malloc(sizeof(double) * cells * BC);
+    double *bphi = malloc(sizeof(double) * bsz);
+    double *bphi2 = malloc(sizeof(double) * bsz);
+    double *brhs = malloc(sizeof(double) * bsz);
+    int iters[BC];
+    double resid[BC];
+    if (!exact || !fields || !bphi || !bphi2 || !brhs)
+      return 1;
+    for (int p = 0; p < BC; ++p) {
+      double a = 0.01 * (1 + p % 5), b = 0.1 * (p % 3), c = -0.05 * p;
+      for (int y = 0; y < BY; ++y)
+        for (int x = 0; x < BX; ++x) {
+          size_t i = (size_t)p * cells + (size_t)y * BX + x;
+          exact[i] = a * (x * x + y * y) + b * x + c * y;
+          int edge = x == 0 || y == 0 || x == BX - 1 || y == BY - 1;
+          fields[i] = edge ? exact[i] : 0.0;
+        }
+    }
+    poisson_batch_pack(bphi, fields, BX, BY, BC);
+    if (poisson_batch_index(BX, BY, 9, 2, 1) !=
+            ((1 * (size_t)BY + 1) * BX + 2) * POISSON_BATCH_LANES + 1 ||
+        bphi[poisson_batch_index(BX, BY, 9, 0, 1)] !=
+            fields[9 * cells + BX]) {
+      fprintf(stderr, "poisson batch layout\n");
+      return 1;
+    }
+    for (int p = 0; p < BC; ++p)
+      for (size_t i = 0; i < cells; ++i)
+        fields[(size_t)p * cells + i] = 0.04 * (1 + p % 5);
+    poisson_batch_pack(brhs, fields, BX, BY, BC);
+    memcpy(bphi2, bphi, sizeof(double) * bsz);
+    double *bphi0 = malloc(sizeof(double) * bsz);
+    if (!bphi0)
+      return 1;
+    memcpy(bphi0, bphi, sizeof(double) * bsz);
+
+    PoissonBatchConfig pc;
+    poisson_batch_default_config(&pc);
+    pc.tolerance = 1e-10;
+    pc.threads = 1;
+    if (poisson_batch_solve(bphi, brhs, BX, BY, BC, &pc, iters, resid) != 0) {
+      fprintf(stderr, "poisson batch did not converge\n");
+      return 1;
+    }
+    pc.threads = 3;
+    if (poisson_batch_solve(bphi2, brhs, BX, BY, BC, &pc, NULL, NULL) != 0 ||
+        memcmp(bphi, bphi2, sizeof(double) * bsz) != 0) {
+      fprintf(stderr, "poisson batch depends on threads\n");
+      return 1;
+    }
+    poisson_batch_unpack(fields, bphi, BX, BY, BC);
+    double err = 0.0;
+    for (size_t i = 0; i < cells * BC; ++i)
+      err = fmax(err, fabs(fields[i] - exact[i]));
+    if (err > 1e-7 || iters[0] > 500 || !(resid[BC - 1] <= 1e-10)) {
+      fprintf(stderr, "poisson batch error %g after %d sweeps\n", err,
+              iters[0]);
+      return 1;
+    }
+    /* the scalar sweep reaches the same solution */
+    unsigned simd = cpu_features_limit(0);
+    int rc0 = poisson_batch_solve(bphi0, brhs, BX, BY, BC, &pc, NULL, NULL);
+    cpu_features_limit(simd);
+    double diff = 0.0;
+    for (size_t i = 0; i < bsz; ++i)
+      diff = fmax(diff, fabs(bphi0[i] - bphi[i]));
+    if (rc0 != 0 || diff > 1e-8) {
+      fprintf(stderr, "poisson batch scalar sweep differs by %g\n", diff);
+      return 1;
+    }
+    free(bphi0);
+    pc.max_iters = 3;
+    if (poisson_batch_solve(bphi2, brhs, BX, BY, BC, NULL, NULL, NULL) != 0 ||
+        poisson_batch_solve(bphi, brhs, 2, BY, BC, &pc, NULL, NULL) != -1) {
+      fprintf(stderr, "poisson batch status\n");
+      return 1;
+    }
+    memcpy(bphi2, brhs, sizeof(double) * bsz); /* far from the solution */
+    if (poisson_batch_solve(bphi2, brhs, BX, BY, BC, &pc, NULL, NULL) != 1) {
+      fprintf(stderr, "poisson batch max_iters not reported\n");
+      return 1;
+    }
+    free(exact);
+    free(fields);
+    free(bphi);
+    free(bphi2);
+    free(brhs);
+  }
+  /* chunked reductions: bitwise identical for any thread count, accurate
+   * against a long double reference */
+  {
+    enum { RN = 1000003 };
+    double *x = malloc(sizeof(double) * RN), *y = malloc(sizeof(double) * RN);
+    if (!x || !y)
+      return 1;
+    unsigned st = 12345u;
+    long double ref_sum = 0, ref_dot = 0;
+    for (int i = 0; i < RN; ++i) {
+      st = st * 1664525u + 1013904223u;
+      x[i] = ((double)(st >> 8) / 16777216.0 - 0.3) * pow(10.0, (int)(st % 7));
+      y[i] = 1.0 / (1.0 + i % 97);
+      ref_sum += x[i];
+      ref_dot += (long double)x[i] * y[i];
+    }
+    double s1 = reduce_sum(x, RN, 1), d1 = reduce_dot(x, y, RN, 1);
+    ReduceStats t1, tk;
+    if (reduce_stats(x, RN, 1, &t1) != 0 || t1.count != RN ||
+        fabs(s1 - (double)ref_sum) > 1e-9 * fabsl(ref_sum) ||
+        fabs(d1 - (double)ref_dot) > 1e-9 * fabsl(ref_dot) ||
+        memcmp(&t1.sum, &s1, sizeof(double)) != 0) {
+      fprintf(stderr, "reduce accuracy %.17g vs %.17Lg\n", s1, ref_sum);
+      return 1;
+    }
+    const int threads[] = {2, 3, 7, 64, 0};
+    for (int k = 0; k < 5; ++k) {
+      double sk = reduce_sum(x, RN, threads[k]);
+      double dk = reduce_dot(x, y, RN, threads[k]);
+      if (reduce_stats(x, RN, threads[k], &tk) != 0 ||
+          memcmp(&sk, &s1, sizeof(double)) != 0 ||
+          memcmp(&dk, &d1, sizeof(double)) != 0 ||
+          memcmp(&tk, &t1, sizeof(tk)) != 0) {
+        fprintf(stderr, "reduce not reproducible with %d threads\n",
+                threads[k]);
+        return 1;
+      }
+    }
+    double lo = x[0], hi = x[0];
+    for (int i = 1; i < RN; ++i) {
+      lo = x[i] < lo ? x[i] : lo;
+      hi = x[i] > hi ? x[i] : hi;
+    }
+    ReduceStats e;
+    if (t1.min != lo || t1.max != hi || reduce_stats(x, 0, 4, &e) != 0 ||
+        e.sum != 0.0 || e.min != INFINITY || e.max != -INFINITY ||
+        reduce_sum(x, 5, 0) != (((x[0] + x[1]) + (x[2] + x[3])) + x[4]) ||
+        reduce_chunks(RN, 0, REDUCE_MAX_VALUES + 1, NULL, 1, NULL, NULL,
+                      &s1) != -1) {
+      fprintf(stderr, "reduce stats/edge cases\n");
+      return 1;
+    }
+    free(x);
+    free(y);
+
+    /* poisson_jacobi residual over a grid large enough to go parallel */
+    enum { JN = 1100 };
+    double *jr = calloc((size_t)JN * JN, sizeof(double));
+    double *jp1 = calloc((size_t)JN * JN, sizeof(double));
+    double *jp2 = calloc((size_t)JN * JN, sizeof(double));
+    if (!jr || !jp1 || !jp2)
+      return 1;
+    for (int i = 0; i < JN * JN; ++i)
+      jr[i] = sin(0.001 * i) * (i % 13);
+    setenv("COINSORTER_THREADS", "1", 1);
+    double j1 = poisson_jacobi(jp1, jr, JN, JN, 3);
+    setenv("COINSORTER_THREADS", "7", 1);
+    double j2 = poisson_jacobi(jp2, jr, JN, JN, 3);
+    unsetenv("COINSORTER_THREADS");
+    if (!(j1 > 0) || memcmp(&j1, &j2, sizeof(double)) != 0 ||
+        memcmp(jp1, jp2, sizeof(double) * JN * JN) != 0) {
+      fprintf(stderr, "poisson_jacobi not reproducible %.17g %.17g\n", j1,
+              j2);
+      return 1;
+    }
+    free(jr);
+    free(jp1);
+    free(jp2);
+  }
   MLP mlp;
   if (mlp_init(&mlp, 2, 6, 2, 42) != 0) {
     fprintf(stderr, "mlp init fail\n");
@@ -52,12 +250,480 @@ int main(void) {
     fprintf(stderr, "mlp poor fit (%.3f,%.3f)\n", o[0], o[1]);
     return 1;
   }
+  /* int8 quantized inference tracks the double-precision forward pass */
+  MLPQ8 q8;
+  if (mlp_quantize_q8(&mlp, &q8) != 0) {
+    fprintf(stderr, "mlp quantize fail\n");
+    return 1;
+  }
+  double *yq = malloc(sizeof(double) * 2 * samples);
+  if (!yq || mlp_forward_q8_batch(&q8, xs, samples, yq) != 0) {
+    fprintf(stderr, "q8 forward fail\n");
+    return 1;
+  }
+  for (int i = 0; i < samples; i++) {
+    double ref[2];
+    mlp_forward(&mlp, &xs[2 * i], ref);
+    if (fabs(ref[0] - yq[2 * i]) > 0.05 || fabs(ref[1] - yq[2 * i + 1]) > 0.05) {
+      fprintf(stderr, "q8 mismatch sample %d (%.4f,%.4f) vs (%.4f,%.4f)\n", i,
+              yq[2 * i], yq[2 * i + 1], ref[0], ref[1]);
+      return 1;
+    }
+  }
+  free(yq);
+  mlp_q8_free(&q8);
   mlp_free(&mlp);
+  /* wider net exercises the SIMD blocks and the weight footprint */
+  MLP wide;
+  if (mlp_init(&wide, 64, 128, 16, 7) != 0) {
+    fprintf(stderr, "wide mlp init fail\n");
+    return 1;
+  }
+  for (int j = 0; j < 128; j++)
+    wide.b1[j] = 0.05;
+  if (mlp_quantize_q8(&wide, &q8) != 0) {
+    fprintf(stderr, "wide quantize fail\n");
+    return 1;
+  }
+  size_t fp_bytes = sizeof(double) * (64 * 128 + 128 * 16);
+  if (mlp_q8_weight_bytes(&q8) * 7 > fp_bytes) {
+    fprintf(stderr, "q8 weights not compact: %zu bytes\n",
+            mlp_q8_weight_bytes(&q8));
+    return 1;
+  }
+  double wx[64], wy[16], wref[16];
+  for (int i = 0; i < 64; i++)
+    wx[i] = sin(0.37 * i);
+  mlp_forward_q8_batch(&q8, wx, 1, wy);
+  mlp_forward(&wide, wx, wref);
+  double err = 0, mag = 0;
+  for (int k = 0; k < 16; k++) {
+    err += fabs(wy[k] - wref[k]);
+    mag += fabs(wref[k]);
+  }
+  if (err > 0.03 * mag + 1e-3) {
+    fprintf(stderr, "q8 wide relative error %.4f\n", err / mag);
+    return 1;
+  }
+  /* every dot product kernel the CPU has (scalar, AVX2, AVX-VNNI,
+   * AVX512-VNNI) gives the same outputs bit for bit */
+  const unsigned q8_sets[] = {0, CPU_AVX2, CPU_AVX2 | CPU_AVX_VNNI, ~0u};
+  for (size_t k = 0; k < sizeof(q8_sets) / sizeof(q8_sets[0]); k++) {
+    double wk[16];
+    unsigned simd = cpu_features_limit(q8_sets[k]);
+    mlp_forward_q8_batch(&q8, wx, 1, wk);
+    cpu_features_limit(simd);
+    if (memcmp(wk, wy, sizeof(wk)) != 0) {
+      fprintf(stderr, "q8 kernels disagree (features %#x)\n", q8_sets[k]);
+      return 1;
+    }
+  }
+  /* weight files round-trip through a zero-copy mapping */
+  MLP mapped;
+  MLPQ8 q8m;
+  if (mlp_save(&wide, "test_sim_mlp.bin") != 0 ||
+      mlp_load_mmap(&mapped, "test_sim_mlp.bin") != 0 || !mapped.mapping ||
+      mapped.hid_dim != 128 ||
+      ((uintptr_t)mapped.w1 | (uintptr_t)mapped.w2) % 64 != 0 ||
+      memcmp(mapped.w2, wide.w2, sizeof(double) * 128 * 16) != 0) {
+    fprintf(stderr, "mlp save/load mismatch\n");
+    return 1;
+  }
+  mlp_forward(&mapped, wx, wy);
+  if (memcmp(wy, wref, sizeof(wref)) != 0) {
+    fprintf(stderr, "mapped mlp forward differs\n");
+    return 1;
+  }
+  mlp_free(&mapped);
+  if (mlp_q8_save(&q8, "test_sim_mlp.bin") != 0 ||
+      mlp_load_mmap(&mapped, "test_sim_mlp.bin") == 0 ||
+      mlp_q8_load_mmap(&q8m, "test_sim_mlp.bin") != 0 ||
+      memcmp(q8m.w1q, q8.w1q, 64 * 128) != 0 ||
+      memcmp(q8m.s2, q8.s2, sizeof(float) * 16) != 0) {
+    fprintf(stderr, "q8 save/load mismatch\n");
+    return 1;
+  }
+  /* a flipped payload byte must fail the checksum */
+  FILE *mf = fopen("test_sim_mlp.bin", "r+b");
+  if (mf) {
+    fseek(mf, 200, SEEK_SET);
+    int c = fgetc(mf);
+    fseek(mf, 200, SEEK_SET);
+    fputc(c ^ 1, mf);
+    fclose(mf);
+  }
+  MLPQ8 q8bad;
+  if (!mf || mlp_q8_load_mmap(&q8bad, "test_sim_mlp.bin") == 0) {
+    fprintf(stderr, "corrupt weight file accepted\n");
+    return 1;
+  }
+  remove("test_sim_mlp.bin");
+  mlp_q8_free(&q8m);
+  mlp_q8_free(&q8);
+  mlp_free(&wide);
+  /* a team runs all of its slices at once, so its barrier releases only
+   * when every slice has arrived; without threads (or with a thread that
+   * cannot be spawned) none of them runs. A team of one always runs. */
+  {
+    TeamCheck c4 = {parallel_barrier_create(4), 4, 0, 0};
+    TeamCheck c1 = {parallel_barrier_create(1), 1, 0, 0};
+    int rc = c4.barrier ? parallel_for_team(4, 4, team_task, &c4) : 0;
+    if (!c4.barrier || !c1.barrier ||
+        (rc == 4 ? c4.arrived != 4 || c4.early != 0
+                 : rc != -1 || c4.arrived != 0) ||
+        parallel_for_team(1, 4, team_task, &c1) != 1 || c1.arrived != 1 ||
+        parallel_for_team(0, 4, team_task, &c4) != 0) {
+      fprintf(stderr, "parallel_for_team\n");
+      return 1;
+    }
+    parallel_barrier_destroy(c4.barrier);
+    parallel_barrier_destroy(c1.barrier);
+  }
+  /* parallel trainers: SYNC mode must be reproducible, both must learn */
+  MLP pa, pb;
+  mlp_init(&pa, 2, 6, 2, 42);
+  mlp_init(&pb, 2, 6, 2, 42);
+  memcpy(pb.w1, pa.w1, sizeof(double) * 12);
+  memcpy(pb.w2, pa.w2, sizeof(double) * 12);
+  MLPTrainer *ta = mlp_trainer_create(&pa, 3, MLP_TRAIN_SYNC, 4, 99);
+  MLPTrainer *tb = mlp_trainer_create(&pb, 3, MLP_TRAIN_SYNC, 4, 99);
+  if (!ta || !tb) {
+    fprintf(stderr, "trainer create fail\n");
+    return 1;
+  }
+  double first = -1, last = -1;
+  for (int e = 0; e < 300; e++) {
+    last = mlp_trainer_epoch(ta, &pa, xs, ys, samples, 0.05);
+    mlp_trainer_epoch(tb, &pb, xs, ys, samples, 0.05);
+    if (e == 0)
+      first = last;
+  }
+  if (memcmp(pa.w1, pb.w1, sizeof(double) * 12) != 0 ||
+      memcmp(pa.w2, pb.w2, sizeof(double) * 12) != 0) {
+    fprintf(stderr, "sync trainer not deterministic\n");
+    return 1;
+  }
+  if (!(last < 0.5 * first)) {
+    fprintf(stderr, "sync trainer loss %.4f -> %.4f\n", first, last);
+    return 1;
+  }
+  mlp_trainer_destroy(ta);
+  mlp_trainer_destroy(tb);
+  MLPTrainer *th = mlp_trainer_create(&pb, 2, MLP_TRAIN_HOGWILD, 0, 5);
+  first = mlp_trainer_epoch(th, &pb, xs, ys, samples, 0.02);
+  for (int e = 0; e < 100; e++)
+    last = mlp_trainer_epoch(th, &pb, xs, ys, samples, 0.02);
+  if (!(last <= first)) {
+    fprintf(stderr, "hogwild loss rose %.4f -> %.4f\n", first, last);
+    return 1;
+  }
+  mlp_trainer_destroy(th);
+  /* checkpoint/restart: a run resumed from a snapshot ends bitwise where an
+   * uninterrupted run does, and snapshots of other problems are ignored */
+  {
+    const char *ckp = "test_sim_ckpt.bin";
+    remove(ckp);
+    double *p0 = calloc(NN, sizeof(double)), *p1 = calloc(NN, sizeof(double));
+    double *p2 = calloc(NN, sizeof(double));
+    if (!p0 || !p1 || !p2)
+      return 1;
+    for (int x = 0; x < N; ++x)
+      p0[x] = 1.0; /* boundary row */
+    memcpy(p1, p0, sizeof(double) * NN);
+    double rref = poisson_jacobi(p1, rhs, N, N, 50);
+    Checkpointer *ck = checkpoint_open(ckp, 0.0, 7);
+    memcpy(p2, p0, sizeof(double) * NN);
+    double rfirst = poisson_jacobi_resume(p2, rhs, N, N, 20, ck);
+    CheckpointStats cs;
+    checkpoint_stats(ck, &cs);
+    CheckpointImage img;
+    if (!ck || cs.submitted != 3 || cs.written < 1 || cs.failed != 0 ||
+        checkpoint_load(ckp, &img) != 0 || img.step != 20 ||
+        img.kind != CHECKPOINT_KIND_POISSON) {
+      fprintf(stderr, "poisson checkpoint not written\n");
+      return 1;
+    }
+    checkpoint_image_free(&img);
+    memcpy(p2, p0, sizeof(double) * NN); /* restart from the initial state */
+    double rres = poisson_jacobi_resume(p2, rhs, N, N, 50, ck);
+    if (!(rfirst > 0) || memcmp(&rres, &rref, sizeof(double)) != 0 ||
+        memcmp(p1, p2, sizeof(double) * NN) != 0) {
+      fprintf(stderr, "poisson resume %.17g vs %.17g\n", rres, rref);
+      return 1;
+    }
+    /* a different starting phi is a different problem */
+    memcpy(p2, p0, sizeof(double) * NN);
+    p2[0] = 2.0;
+    memcpy(p1, p2, sizeof(double) * NN);
+    rref = poisson_jacobi(p1, rhs, N, N, 10);
+    rres = poisson_jacobi_resume(p2, rhs, N, N, 10, ck);
+    if (memcmp(&rres, &rref, sizeof(double)) != 0 ||
+        memcmp(p1, p2, sizeof(double) * NN) != 0) {
+      fprintf(stderr, "poisson resume used a foreign snapshot\n");
+      return 1;
+    }
+    /* a damaged file fails its checksum and is ignored */
+    FILE *cf = fopen(ckp, "r+b");
+    if (!cf || fseek(cf, 200, SEEK_SET) != 0 || fputc(0x5a, cf) == EOF) {
+      fprintf(stderr, "checkpoint corrupt\n");
+      return 1;
+    }
+    fclose(cf);
+    if (checkpoint_load(ckp, &img) == 0) {
+      fprintf(stderr, "corrupt checkpoint accepted\n");
+      return 1;
+    }
+    checkpoint_close(ck);
+
+    /* training: SYNC trainer (weights and RNG streams) and plain SGD */
+    for (int mode = 0; mode < 2; ++mode) {
+      remove(ckp);
+      MLP ma, mb;
+      mlp_init(&ma, 2, 6, 2, 7);
+      mlp_init(&mb, 2, 6, 2, 7);
+      memcpy(mb.w1, ma.w1, sizeof(double) * 12);
+      memcpy(mb.w2, ma.w2, sizeof(double) * 12);
+      double w1[12], w2[12];
+      memcpy(w1, ma.w1, sizeof(w1));
+      memcpy(w2, ma.w2, sizeof(w2));
+      MLPTrainer *tra =
+          mode ? NULL : mlp_trainer_create(&ma, 2, MLP_TRAIN_SYNC, 4, 11);
+      double ea = 0, eb = 0;
+      if (mlp_train_resume(&ma, tra, xs, ys, samples, 0.05, 12, NULL, &ea)) {
+        fprintf(stderr, "train resume failed\n");
+        return 1;
+      }
+      ck = checkpoint_open(ckp, 0.0, 2);
+      MLPTrainer *trb =
+          mode ? NULL : mlp_trainer_create(&mb, 2, MLP_TRAIN_SYNC, 4, 11);
+      mlp_train_resume(&mb, trb, xs, ys, samples, 0.05, 5, ck, NULL);
+      mlp_trainer_destroy(trb);
+      /* "preempted": new process state, same starting weights and seed */
+      memcpy(mb.w1, w1, sizeof(w1));
+      memcpy(mb.w2, w2, sizeof(w2));
+      memset(mb.b1, 0, sizeof(double) * 6);
+      memset(mb.b2, 0, sizeof(double) * 2);
+      trb = mode ? NULL : mlp_trainer_create(&mb, 2, MLP_TRAIN_SYNC, 4, 11);
+      if (mlp_train_resume(&mb, trb, xs, ys, samples, 0.05, 12, ck, &eb) ||
+          memcmp(ma.w1, mb.w1, sizeof(double) * 12) != 0 ||
+          memcmp(ma.w2, mb.w2, sizeof(double) * 12) != 0 ||
+          memcmp(ma.b1, mb.b1, sizeof(double) * 6) != 0 ||
+          memcmp(&ea, &eb, sizeof(double)) != 0) {
+        fprintf(stderr, "train resume differs (mode %d)\n", mode);
+        return 1;
+      }
+      checkpoint_close(ck);
+      mlp_trainer_destroy(tra);
+      mlp_trainer_destroy(trb);
+      mlp_free(&ma);
+      mlp_free(&mb);
+    }
+    remove(ckp);
+    /* durable writes concatenate their parts; a failed one leaves no file */
+    const char *wparts[3] = {"head", "", "tail"};
+    const size_t wbytes[3] = {4, 0, 4};
+    char wback[9] = {0};
+    FILE *wf = NULL;
+    if (checkpoint_write_file(ckp, (const void *const *)wparts, wbytes, 3) !=
+            0 ||
+        !(wf = fopen(ckp, "rb")) || fread(wback, 1, 9, wf) != 8 ||
+        strcmp(wback, "headtail") != 0 ||
+        checkpoint_write_file("no_such_dir/ckpt.bin",
+                              (const void *const *)wparts, wbytes, 3) == 0) {
+      fprintf(stderr, "checkpoint_write_file\n");
+      return 1;
+    }
+    fclose(wf);
+    remove(ckp);
+    free(p0);
+    free(p1);
+    free(p2);
+  }
+  mlp_free(&pa);
+  mlp_free(&pb);
   free(f);
   free(rhs);
   free(phi);
   free(xs);
   free(ys);
+  /* shaded relief: exact horizons, lighting, thread independence, PPM */
+  {
+    enum { RN = 33 };
+    double *t = calloc(RN * RN, sizeof(double));
+    float *v = malloc(sizeof(float) * RN * RN);
+    unsigned char *c1 = malloc(RN * RN * 3), *c3 = malloc(RN * RN * 3);
+    if (!t || !v || !c1 || !c3)
+      return 1;
+    ReliefParams rp;
+    relief_default_params(&rp);
+    rp.z_scale = 1.0;
+    rp.ao_directions = 4;
+    t[16 * RN + 16] = -1.0; /* one-cell pit: 45 degree horizon each way */
+    if (relief_ambient_occlusion(t, RN, RN, &rp, v) != 0 ||
+        fabs(v[16 * RN + 16] - (1.0 - sqrt(0.5))) > 1e-6 ||
+        v[0] != 1.0f || v[16 * RN + 15] != 1.0f) {
+      fprintf(stderr, "pit occlusion %g\n", v[16 * RN + 16]);
+      return 1;
+    }
+    if (relief_hillshade(t, RN, RN, &rp, v) != 0 ||
+        fabs(v[0] - sin(rp.altitude * M_PI / 180.0)) > 1e-6) {
+      fprintf(stderr, "flat hillshade %g\n", v[0]);
+      return 1;
+    }
+    for (int y = 0; y < RN; ++y) /* plane rising to the east */
+      for (int x = 0; x < RN; ++x)
+        t[y * RN + x] = 0.5 * x;
+    rp.azimuth = 90.0;
+    relief_hillshade(t, RN, RN, &rp, v);
+    float away = v[16 * RN + 16];
+    rp.azimuth = 270.0;
+    relief_hillshade(t, RN, RN, &rp, v);
+    if (!(v[16 * RN + 16] > away)) {
+      fprintf(stderr, "slope facing the sun not brighter\n");
+      return 1;
+    }
+    relief_default_params(&rp);
+    fbm_diamond_square(t, RN, 0.7, 9);
+    rp.threads = 1;
+    if (relief_render(t, RN, RN, &rp, c1) != 0)
+      return 1;
+    rp.threads = 3;
+    relief_render(t, RN, RN, &rp, c3);
+    if (memcmp(c1, c3, RN * RN * 3) != 0) {
+      fprintf(stderr, "relief depends on thread count\n");
+      return 1;
+    }
+    unsigned char lo[3], hi[3];
+    relief_hypsometric(0.0, lo);
+    relief_hypsometric(1.0, hi);
+    rp.ambient = 2.0;
+    if (!(hi[0] > 240 && lo[1] > lo[0]) ||
+        relief_render(t, RN, RN, &rp, c1) != -1) {
+      fprintf(stderr, "hypsometric tint / bad params\n");
+      return 1;
+    }
+    FILE *rf = NULL;
+    if (!write_relief_ppm("test_sim_relief.ppm", t, RN, RN, NULL) ||
+        !(rf = fopen("test_sim_relief.ppm", "rb")) ||
+        fseek(rf, 0, SEEK_END) != 0 ||
+        ftell(rf) != (long)(RN * RN * 3 + strlen("P6\n33 33\n255\n"))) {
+      fprintf(stderr, "relief ppm size\n");
+      return 1;
+    }
+    fclose(rf);
+    remove("test_sim_relief.ppm");
+    free(t);
+    free(v);
+    free(c1);
+    free(c3);
+  }
+  /* field codec: lossless round trips bitwise, lossy stays within the
+   * bound, output does not depend on the thread count, damage is rejected */
+  {
+    const int CX = 301, CY = 517; /* several bands, odd sizes */
+    size_t cn = (size_t)CX * CY;
+    double *src = malloc(sizeof(double) * cn), *dst = malloc(sizeof(double) * cn);
+    if (!src || !dst)
+      return 1;
+    for (int y = 0; y < CY; ++y)
+      for (int x = 0; x < CX; ++x)
+        src[(size_t)y * CX + x] = sin(0.03 * x) * cos(0.02 * y) + 1e-3 * x;
+    src[5] = NAN;
+    src[6] = INFINITY;
+    src[7] = -0.0;
+    src[cn - 1] = -1e300;
+    unsigned char *b1 = NULL, *b4 = NULL;
+    size_t n1 = 0, n4 = 0;
+    if (field_codec_compress(src, CX, CY, 0.0, 1, &b1, &n1) != 0 ||
+        field_codec_compress(src, CX, CY, 0.0, 4, &b4, &n4) != 0 ||
+        n1 != n4 || memcmp(b1, b4, n1) != 0 ||
+        field_codec_decompress(b1, n1, dst, CX, CY, 3) != 0 ||
+        memcmp(src, dst, sizeof(double) * cn) != 0) {
+      fprintf(stderr, "field codec lossless round trip\n");
+      return 1;
+    }
+    int ix = 0, iy = 0;
+    double ieb = -1;
+    if (field_codec_info(b1, n1, &ix, &iy, &ieb) != 0 || ix != CX ||
+        iy != CY || ieb != 0.0 ||
+        field_codec_decompress(b1, n1, dst, CX + 1, CY, 1) == 0 ||
+        field_codec_decompress(b1, n1 - 1, dst, CX, CY, 1) == 0) {
+      fprintf(stderr, "field codec info/shape checks\n");
+      return 1;
+    }
+    b1[n1 / 2] ^= 0x10;
+    if (field_codec_decompress(b1, n1, dst, CX, CY, 1) == 0) {
+      fprintf(stderr, "field codec accepted a corrupt buffer\n");
+      return 1;
+    }
+    free(b1);
+    free(b4);
+    const double eb = 1e-4;
+    if (field_codec_compress(src, CX, CY, eb, 2, &b1, &n1) != 0 ||
+        field_codec_decompress(b1, n1, dst, CX, CY, 2) != 0) {
+      fprintf(stderr, "field codec lossy round trip\n");
+      return 1;
+    }
+    for (size_t i = 0; i < cn; ++i) {
+      int same = memcmp(&src[i], &dst[i], sizeof(double)) == 0;
+      if (!same && !(fabs(src[i] - dst[i]) <= eb)) {
+        fprintf(stderr, "field codec error bound at %zu: %g vs %g\n", i,
+                src[i], dst[i]);
+        return 1;
+      }
+    }
+    if (n1 * 4 > sizeof(double) * cn) {
+      fprintf(stderr, "field codec lossy ratio %.2f\n",
+              (double)(sizeof(double) * cn) / (double)n1);
+      return 1;
+    }
+    free(b1);
+    const char *fp = "test_sim_field.csf";
+    int rx = 0, ry = 0;
+    double *back = NULL;
+    if (field_codec_write(fp, src, CX, CY, 0.0, 0) != 0 ||
+        !(back = field_codec_read(fp, &rx, &ry, NULL, 0)) || rx != CX ||
+        ry != CY || memcmp(back, src, sizeof(double) * cn) != 0) {
+      fprintf(stderr, "field codec file round trip\n");
+      return 1;
+    }
+    remove(fp);
+    free(back);
+    /* a single row and a single column */
+    if (field_codec_compress(src, 1, 1, 0.0, 1, &b1, &n1) != 0 ||
+        field_codec_decompress(b1, n1, dst, 1, 1, 1) != 0 ||
+        memcmp(src, dst, sizeof(double)) != 0) {
+      fprintf(stderr, "field codec 1x1\n");
+      return 1;
+    }
+    free(b1);
+    if (field_codec_compress(src, 1, CY, eb, 0, &b1, &n1) != 0 ||
+        field_codec_decompress(b1, n1, dst, 1, CY, 0) != 0) {
+      fprintf(stderr, "field codec column\n");
+      return 1;
+    }
+    free(b1);
+    /* a sparse plane with a bitmap bit past the band's end is refused even
+     * when the checksum is recomputed over the damage: {0,0,0,0,1000} at a
+     * 0.5 bound is one band (after the 64-byte header, two offsets, nesc and
+     * a raw first plane) whose second plane is sparse with bitmap 0x10 */
+    const double row5[5] = {0, 0, 0, 0, 1000};
+    if (field_codec_compress(row5, 5, 1, 0.5, 1, &b1, &n1) != 0 ||
+        n1 < 92 || b1[90] != 2 || b1[91] != 0x10) {
+      fprintf(stderr, "field codec sparse plane layout\n");
+      return 1;
+    }
+    b1[91] |= 0x20;
+    uint64_t h = checkpoint_hash(CHECKPOINT_HASH_INIT, b1 + 64, n1 - 64);
+    memcpy(b1 + 56, &h, 8);
+    if (field_codec_decompress(b1, n1, dst, 5, 1, 1) == 0) {
+      fprintf(stderr, "field codec accepted a sparse padding bit\n");
+      return 1;
+    }
+    free(b1);
+    free(src);
+    free(dst);
+  }
   /* Color disable logic (indirect): just ensure color_init doesn't crash with
    * NO_COLOR set */
   setenv("NO_COLOR", "1", 1);